@@ -112,7 +112,7 @@ static const char *log_get_date(PurpleLog *log)
 static void search_cb(GntWidget *button, FinchLogViewer *lv)
 {
 	const char *search_term = gnt_entry_get_text(GNT_ENTRY(lv->entry));
-	GList *logs;
+	GList *hits, *l;
 
 	if (!(*search_term)) {
 		/* reset the tree */
@@ -133,18 +133,17 @@ static void search_cb(GntWidget *button, FinchLogViewer *lv)
 	gnt_tree_remove_all(GNT_TREE(lv->tree));
 	gnt_text_view_clear(GNT_TEXT_VIEW(lv->text));
 
-	for (logs = lv->logs; logs != NULL; logs = logs->next) {
-		char *read = purple_log_read((PurpleLog*)logs->data, NULL);
-		if (read && *read && purple_strcasestr(read, search_term)) {
-			PurpleLog *log = logs->data;
+	hits = purple_log_search(lv->logs, search_term);
+	for (l = hits; l != NULL; l = l->next) {
+		PurpleLog *log = ((PurpleLogSearchHit *)l->data)->log;
 
-			gnt_tree_add_row_last(GNT_TREE(lv->tree),
-									log,
-									gnt_tree_create_row(GNT_TREE(lv->tree), log_get_date(log)),
-									NULL);
-		}
-		g_free(read);
+		gnt_tree_add_row_last(GNT_TREE(lv->tree),
+								log,
+								gnt_tree_create_row(GNT_TREE(lv->tree), log_get_date(log)),
+								NULL);
 	}
+	g_list_foreach(hits, (GFunc)g_free, NULL);
+	g_list_free(hits);
 
 }
 
@@ -484,7 +484,6 @@ sync_accounts(void)
 {
 	PurpleAccountPrefsUiOps *ui_ops;
 	xmlnode *node;
-	char *data;
 
 	if (!accounts_loaded)
 	{
@@ -501,9 +500,7 @@ sync_accounts(void)
 	}
 
 	node = accounts_to_xmlnode();
-	data = xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_file("accounts.xml", data, -1);
-	g_free(data);
+	purple_util_write_xml_to_file("accounts.xml", node);
 	xmlnode_free(node);
 }
 
@@ -1771,7 +1768,14 @@ purple_account_set_connection(PurpleAccount *account, PurpleConnection *gc)
 {
 	g_return_if_fail(account != NULL);
 
+	if (account->gc == gc)
+		return;
+
 	account->gc = gc;
+
+	/* Offline messages, which are part of the presence scores of the
+	 * account's buddies, can only be sent while it is connected */
+	_purple_presence_scores_changed();
 }
 
 void
@@ -2011,12 +2015,19 @@ purple_account_set_silence_suppression(PurpleAccount *account, gboolean value)
 void
 purple_account_clear_settings(PurpleAccount *account)
 {
+	gboolean had_score;
+
 	g_return_if_fail(account != NULL);
 
+	had_score = g_hash_table_lookup(account->settings, "score") != NULL;
+
 	g_hash_table_destroy(account->settings);
 
 	account->settings = g_hash_table_new_full(g_str_hash, g_str_equal,
 											  g_free, delete_setting);
+
+	if (had_score)
+		_purple_presence_scores_changed();
 }
 
 void
@@ -2025,7 +2036,9 @@ purple_account_remove_setting(PurpleAccount *account, const char *setting)
 	g_return_if_fail(account != NULL);
 	g_return_if_fail(setting != NULL);
 
-	g_hash_table_remove(account->settings, setting);
+	if (g_hash_table_remove(account->settings, setting) &&
+			purple_strequal(setting, "score"))
+		_purple_presence_scores_changed();
 }
 
 void
@@ -2044,6 +2057,10 @@ purple_account_set_int(PurpleAccount *account, const char *name, int value)
 
 	g_hash_table_insert(account->settings, g_strdup(name), setting);
 
+	/* The score is part of every presence score of this account */
+	if (purple_strequal(name, "score"))
+		_purple_presence_scores_changed();
+
 	ui_ops = purple_account_prefs_get_ui_ops();
 
 	if (ui_ops != NULL && ui_ops->set_int != NULL) {
@@ -59,6 +59,29 @@ static GHashTable *groups_cache = NULL;
 static guint          save_timer = 0;
 static gboolean       blist_loaded = FALSE;
 
+/*
+ * Changes that only touch the aliases or settings of a node are appended
+ * to blist.journal instead of rewriting all of blist.xml.  Each journal
+ * record carries the serial of the snapshot it applies to, so records left
+ * behind by a crash right after a snapshot are never replayed on top of a
+ * newer one.  Anything else (adding, moving or removing nodes, privacy
+ * changes) still writes a full snapshot, which also empties the journal.
+ */
+#define BLIST_JOURNAL_FILE "blist.journal"
+#define BLIST_JOURNAL_MIN_COMPACT_SIZE (64 * 1024)
+
+static gboolean       save_full = FALSE;
+static GHashTable    *journal_pending = NULL;
+static guint          blist_serial = 0;
+static gsize          blist_snapshot_size = 0;
+static gsize          blist_journal_size = 0;
+static gboolean       blist_replaying = FALSE;
+
+/* Presence signals, emitted for every status update of every buddy */
+static PurpleSignal  *buddy_signed_on_signal = NULL;
+static PurpleSignal  *buddy_signed_off_signal = NULL;
+static PurpleSignal  *buddy_status_changed_signal = NULL;
+
 /*********************************************************************
  * Private utility functions                                         *
  *********************************************************************/
@@ -368,11 +391,26 @@ blist_to_xmlnode(void)
 	return node;
 }
 
+/* The size of blist.xml, never 0 once it exists */
+static gsize
+get_snapshot_size(void)
+{
+	char *snapshot = g_build_filename(purple_user_dir(), "blist.xml", NULL);
+	struct stat st;
+	gsize size = 1;
+
+	if (g_stat(snapshot, &st) == 0 && st.st_size > 0)
+		size = st.st_size;
+	g_free(snapshot);
+
+	return size;
+}
+
 static void
 purple_blist_sync(void)
 {
 	xmlnode *node;
-	char *data;
+	char buf[11];
 
 	if (!blist_loaded)
 	{
@@ -382,16 +420,223 @@ purple_blist_sync(void)
 	}
 
 	node = blist_to_xmlnode();
-	data = xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_file("blist.xml", data, -1);
-	g_free(data);
+	g_snprintf(buf, sizeof(buf), "%u", blist_serial + 1);
+	xmlnode_set_attrib(node, "serial", buf);
+	if (purple_util_write_xml_to_file("blist.xml", node)) {
+		char *journal = g_build_filename(purple_user_dir(),
+				BLIST_JOURNAL_FILE, NULL);
+
+		/* The journal applied to the previous snapshot */
+		if (g_unlink(journal) == -1 && errno != ENOENT)
+			purple_debug_error("blist", "Error removing %s: %s\n",
+					journal, g_strerror(errno));
+		g_free(journal);
+
+		blist_serial++;
+		blist_snapshot_size = get_snapshot_size();
+		blist_journal_size = 0;
+	}
 	xmlnode_free(node);
+
+	save_full = FALSE;
+	if (journal_pending != NULL)
+		g_hash_table_remove_all(journal_pending);
+}
+
+/* A contact is identified in the journal by its first saved buddy */
+static PurpleBuddy *
+contact_journal_buddy(PurpleBlistNode *cnode)
+{
+	PurpleBlistNode *bnode;
+
+	for (bnode = cnode->child; bnode != NULL; bnode = bnode->next)
+	{
+		if (PURPLE_BLIST_NODE_IS_BUDDY(bnode) &&
+				PURPLE_BLIST_NODE_SHOULD_SAVE(bnode))
+			return (PurpleBuddy *)bnode;
+	}
+
+	return NULL;
+}
+
+/*
+ * Whether another buddy in the same group has the same account and name.
+ * Journal records find buddies by those, so they couldn't tell them apart.
+ */
+static gboolean
+buddy_journal_is_ambiguous(PurpleBuddy *buddy)
+{
+	PurpleBlistNode *gnode = (PurpleBlistNode *)purple_buddy_get_group(buddy);
+	PurpleBlistNode *cnode, *bnode;
+	gboolean ret = FALSE;
+	char *name;
+
+	name = g_strdup(purple_normalize(buddy->account, buddy->name));
+
+	for (cnode = gnode->child; cnode != NULL && !ret; cnode = cnode->next)
+	{
+		if (!PURPLE_BLIST_NODE_IS_CONTACT(cnode))
+			continue;
+
+		for (bnode = cnode->child; bnode != NULL && !ret; bnode = bnode->next)
+		{
+			PurpleBuddy *other = (PurpleBuddy *)bnode;
+
+			ret = (other != buddy && PURPLE_BLIST_NODE_IS_BUDDY(bnode) &&
+					other->account == buddy->account &&
+					purple_strequal(purple_normalize(other->account, other->name), name));
+		}
+	}
+
+	g_free(name);
+	return ret;
+}
+
+static xmlnode *
+node_to_journal_xmlnode(PurpleBlistNode *node)
+{
+	xmlnode *record = NULL;
+	char buf[11];
+
+	/* Transient nodes aren't in the snapshot either */
+	if (!PURPLE_BLIST_NODE_SHOULD_SAVE(node))
+		return NULL;
+
+	if (PURPLE_BLIST_NODE_IS_GROUP(node))
+	{
+		record = xmlnode_new("group");
+		xmlnode_set_attrib(record, "name", ((PurpleGroup *)node)->name);
+		g_hash_table_foreach(node->settings, value_to_xmlnode, record);
+	}
+	else if (PURPLE_BLIST_NODE_IS_BUDDY(node))
+	{
+		record = buddy_to_xmlnode(node);
+		xmlnode_set_attrib(record, "group",
+				purple_group_get_name(purple_buddy_get_group((PurpleBuddy *)node)));
+	}
+	else if (PURPLE_BLIST_NODE_IS_CONTACT(node))
+	{
+		PurpleContact *contact = (PurpleContact *)node;
+		PurpleBuddy *buddy = contact_journal_buddy(node);
+
+		if (buddy == NULL)
+			return NULL;
+
+		record = xmlnode_new("contact");
+		xmlnode_set_attrib(record, "account", purple_account_get_username(buddy->account));
+		xmlnode_set_attrib(record, "proto", purple_account_get_protocol_id(buddy->account));
+		xmlnode_set_attrib(record, "group",
+				purple_group_get_name(purple_buddy_get_group(buddy)));
+		xmlnode_set_attrib(record, "buddy", buddy->name);
+		if (contact->alias != NULL)
+			xmlnode_set_attrib(record, "alias", contact->alias);
+		g_hash_table_foreach(node->settings, value_to_xmlnode, record);
+	}
+
+	if (record != NULL)
+	{
+		g_snprintf(buf, sizeof(buf), "%u", blist_serial);
+		xmlnode_set_attrib(record, "serial", buf);
+	}
+
+	return record;
+}
+
+static void
+journal_record_append(gpointer key, gpointer value, gpointer user_data)
+{
+	GString *str = user_data;
+	xmlnode *record;
+	char *data, *c;
+
+	record = node_to_journal_xmlnode(key);
+	if (record == NULL)
+		return;
+
+	data = xmlnode_to_str(record, NULL);
+
+	/* Keep one record per line; character references survive parsing */
+	for (c = data; *c; c++)
+	{
+		if (*c == '\n')
+			g_string_append(str, "&#10;");
+		else if (*c == '\r')
+			g_string_append(str, "&#13;");
+		else
+			g_string_append_c(str, *c);
+	}
+	g_string_append_c(str, '\n');
+
+	g_free(data);
+	xmlnode_free(record);
+}
+
+static gboolean
+purple_blist_journal_write(const char *data, gsize size)
+{
+	gchar *filename;
+	FILE *file;
+	gboolean ret = TRUE;
+
+	filename = g_build_filename(purple_user_dir(), BLIST_JOURNAL_FILE, NULL);
+
+	file = g_fopen(filename, "ab");
+	if (file == NULL)
+	{
+		purple_debug_error("blist", "Error opening %s for appending: %s\n",
+				filename, g_strerror(errno));
+		g_free(filename);
+		return FALSE;
+	}
+
+	if (fwrite(data, 1, size, file) != size || fflush(file) != 0)
+		ret = FALSE;
+#ifdef HAVE_FILENO
+	else if (fsync(fileno(file)) < 0)
+		ret = FALSE;
+#endif
+
+	if (fclose(file) != 0)
+		ret = FALSE;
+
+	if (!ret)
+		purple_debug_error("blist", "Error appending to %s: %s\n",
+				filename, g_strerror(errno));
+
+	g_free(filename);
+	return ret;
+}
+
+static void
+purple_blist_sync_changes(void)
+{
+	GString *str;
+
+	if (save_full || blist_snapshot_size == 0 || journal_pending == NULL)
+	{
+		purple_blist_sync();
+		return;
+	}
+
+	str = g_string_new(NULL);
+	g_hash_table_foreach(journal_pending, journal_record_append, str);
+	g_hash_table_remove_all(journal_pending);
+
+	/* Compact once replaying the journal would cost more than the snapshot */
+	if (blist_journal_size + str->len >
+			MAX(BLIST_JOURNAL_MIN_COMPACT_SIZE, blist_snapshot_size / 2) ||
+			!purple_blist_journal_write(str->str, str->len))
+		purple_blist_sync();
+	else
+		blist_journal_size += str->len;
+
+	g_string_free(str, TRUE);
 }
 
 static gboolean
 save_cb(gpointer data)
 {
-	purple_blist_sync();
+	purple_blist_sync_changes();
 	save_timer = 0;
 	return FALSE;
 }
@@ -399,6 +644,7 @@ save_cb(gpointer data)
 static void
 _purple_blist_schedule_save()
 {
+	save_full = TRUE;
 	if (save_timer == 0)
 		save_timer = purple_timeout_add_seconds(5, save_cb, NULL);
 }
@@ -420,9 +666,59 @@ purple_blist_save_account(PurpleAccount *account)
 static void
 purple_blist_save_node(PurpleBlistNode *node)
 {
+	/* The node may be about to be destroyed */
+	if (journal_pending != NULL)
+		g_hash_table_remove(journal_pending, node);
+
 	_purple_blist_schedule_save();
 }
 
+static void
+purple_blist_journal_node(PurpleBlistNode *node)
+{
+	PurpleBuddy *buddy = NULL;
+
+	if (PURPLE_BLIST_NODE_IS_BUDDY(node))
+		buddy = (PurpleBuddy *)node;
+	else if (PURPLE_BLIST_NODE_IS_CONTACT(node))
+		buddy = contact_journal_buddy(node);
+
+	if (save_full || PURPLE_BLIST_NODE_IS_CHAT(node) ||
+			(PURPLE_BLIST_NODE_IS_CONTACT(node) && buddy == NULL) ||
+			(buddy != NULL && buddy_journal_is_ambiguous(buddy)))
+	{
+		purple_blist_save_node(node);
+		return;
+	}
+
+	if (journal_pending == NULL)
+		journal_pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_hash_table_insert(journal_pending, node, node);
+
+	if (save_timer == 0)
+		save_timer = purple_timeout_add_seconds(5, save_cb, NULL);
+}
+
+/*
+ * Called instead of the save_node UI op when only the alias or the
+ * settings of a node changed.  The built-in storage journals such
+ * changes, UIs with their own storage get the usual save_node call.
+ */
+static void
+purple_blist_node_changed(PurpleBlistNode *node)
+{
+	PurpleBlistUiOps *ops = purple_blist_get_ui_ops();
+
+	/* What the journal replays is already on disk */
+	if (ops == NULL || ops->save_node == NULL || blist_replaying)
+		return;
+
+	if (ops->save_node == purple_blist_save_node)
+		purple_blist_journal_node(node);
+	else
+		ops->save_node(node);
+}
+
 void purple_blist_schedule_save()
 {
 	PurpleBlistUiOps *ops = purple_blist_get_ui_ops();
@@ -603,11 +899,159 @@ parse_group(xmlnode *groupnode)
 	}
 }
 
+static void
+replay_settings(PurpleBlistNode *node, xmlnode *record)
+{
+	xmlnode *x;
+
+	/* A record holds every setting of the node at the time it was written */
+	g_hash_table_remove_all(node->settings);
+	for (x = xmlnode_get_child(record, "setting"); x; x = xmlnode_get_next_twin(x))
+		parse_setting(node, x);
+}
+
+static PurpleBuddy *
+find_journal_buddy(xmlnode *record, const char *name)
+{
+	PurpleAccount *account;
+	PurpleGroup *group;
+	const char *acct_name, *proto, *group_name;
+
+	acct_name = xmlnode_get_attrib(record, "account");
+	proto = xmlnode_get_attrib(record, "proto");
+	group_name = xmlnode_get_attrib(record, "group");
+
+	if (!acct_name || !proto || !group_name || !name)
+		return NULL;
+
+	account = purple_accounts_find(acct_name, proto);
+	group = purple_find_group(group_name);
+
+	if (!account || !group)
+		return NULL;
+
+	return purple_find_buddy_in_group(account, name, group);
+}
+
+static void
+replay_journal_record(xmlnode *record)
+{
+	if (purple_strequal(record->name, "group"))
+	{
+		PurpleGroup *group = purple_find_group(xmlnode_get_attrib(record, "name"));
+
+		if (group != NULL)
+			replay_settings((PurpleBlistNode *)group, record);
+	}
+	else if (purple_strequal(record->name, "buddy"))
+	{
+		PurpleBuddy *buddy;
+		xmlnode *x;
+		char *name = NULL, *alias = NULL;
+
+		if ((x = xmlnode_get_child(record, "name")))
+			name = xmlnode_get_data(x);
+		if ((x = xmlnode_get_child(record, "alias")))
+			alias = xmlnode_get_data(x);
+
+		buddy = find_journal_buddy(record, name);
+		if (buddy != NULL)
+		{
+			purple_blist_alias_buddy(buddy, alias);
+			replay_settings((PurpleBlistNode *)buddy, record);
+		}
+
+		g_free(name);
+		g_free(alias);
+	}
+	else if (purple_strequal(record->name, "contact"))
+	{
+		PurpleBuddy *buddy;
+
+		buddy = find_journal_buddy(record, xmlnode_get_attrib(record, "buddy"));
+		if (buddy != NULL)
+		{
+			PurpleContact *contact = purple_buddy_get_contact(buddy);
+
+			purple_blist_alias_contact(contact, xmlnode_get_attrib(record, "alias"));
+			replay_settings((PurpleBlistNode *)contact, record);
+		}
+	}
+}
+
+static void
+replay_journal(void)
+{
+	gchar *filename, *contents, **lines;
+	gsize length;
+	char serial[11];
+	gboolean damaged;
+	int i;
+
+	filename = g_build_filename(purple_user_dir(), BLIST_JOURNAL_FILE, NULL);
+	if (!g_file_get_contents(filename, &contents, &length, NULL))
+	{
+		g_free(filename);
+		return;
+	}
+
+	g_snprintf(serial, sizeof(serial), "%u", blist_serial);
+	lines = g_strsplit(contents, "\n", -1);
+
+	/* A crash in the middle of an append leaves a last line without its
+	 * newline, and the next record appended would be glued onto it */
+	damaged = (length > 0 && contents[length - 1] != '\n');
+
+	blist_replaying = TRUE;
+
+	for (i = 0; lines[i] != NULL; i++)
+	{
+		xmlnode *record;
+
+		if (*lines[i] == '\0')
+			continue;
+
+		record = xmlnode_from_str(lines[i], -1);
+		if (record == NULL)
+		{
+			damaged = TRUE;
+			continue;
+		}
+
+		/* Records for an older snapshot are already part of this one */
+		if (purple_strequal(xmlnode_get_attrib(record, "serial"), serial))
+			replay_journal_record(record);
+
+		xmlnode_free(record);
+	}
+
+	blist_replaying = FALSE;
+
+	purple_debug_info("blist", "Replayed %" G_GSIZE_FORMAT " bytes of %s\n",
+			length, filename);
+
+	blist_journal_size = length;
+
+	/* Write a full snapshot, which starts a new journal, before anything
+	 * else is appended to this one */
+	if (damaged)
+	{
+		purple_debug_warning("blist", "%s is damaged, the buddy list will "
+				"be saved in full\n", filename);
+		_purple_blist_schedule_save();
+	}
+
+	g_strfreev(lines);
+	g_free(contents);
+	g_free(filename);
+}
+
 /* TODO: Make static and rename to load_blist */
 void
 purple_blist_load()
 {
 	xmlnode *purple, *blist, *privacy;
+	const char *serial;
 
 	blist_loaded = TRUE;
 
@@ -625,6 +1069,11 @@ purple_blist_load()
 		}
 	}
 
+	serial = xmlnode_get_attrib(purple, "serial");
+	blist_serial = serial ? strtoul(serial, NULL, 10) : 0;
+	replay_journal();
+	blist_snapshot_size = get_snapshot_size();
+
 	privacy = xmlnode_get_child(purple, "privacy");
 	if (privacy) {
 		xmlnode *anode;
@@ -684,9 +1133,12 @@ purple_contact_compute_priority_buddy(PurpleContact *contact)
 {
 	PurpleBlistNode *bnode;
 	PurpleBuddy *new_priority = NULL;
+	gboolean last_match;
 
 	g_return_if_fail(contact != NULL);
 
+	last_match = purple_prefs_get_bool("/purple/contact/last_match");
+
 	contact->priority = NULL;
 	for (bnode = ((PurpleBlistNode*)contact)->child;
 			bnode != NULL;
@@ -711,8 +1163,7 @@ purple_contact_compute_priority_buddy(PurpleContact *contact)
 				cmp = purple_presence_compare(purple_buddy_get_presence(new_priority),
 						purple_buddy_get_presence(buddy));
 
-			if (cmp > 0 || (cmp == 0 &&
-			                purple_prefs_get_bool("/purple/contact/last_match")))
+			if (cmp > 0 || (cmp == 0 && last_match))
 			{
 				new_priority = buddy;
 			}
@@ -917,7 +1368,7 @@ purple_blist_update_buddy_status(PurpleBuddy *buddy, PurpleStatus *old_status)
 	if (purple_status_is_online(status) &&
 		!purple_status_is_online(old_status)) {
 
-		purple_signal_emit(purple_blist_get_handle(), "buddy-signed-on", buddy);
+		purple_signal_emit_resolved(buddy_signed_on_signal, buddy);
 
 		cnode = buddy->node.parent;
 		if (++(PURPLE_CONTACT(cnode)->online) == 1)
@@ -926,15 +1377,14 @@ purple_blist_update_buddy_status(PurpleBuddy *buddy, PurpleStatus *old_status)
 				purple_status_is_online(old_status)) {
 
 		purple_blist_node_set_int(&buddy->node, "last_seen", time(NULL));
-		purple_signal_emit(purple_blist_get_handle(), "buddy-signed-off", buddy);
+		purple_signal_emit_resolved(buddy_signed_off_signal, buddy);
 
 		cnode = buddy->node.parent;
 		if (--(PURPLE_CONTACT(cnode)->online) == 0)
 			PURPLE_GROUP(cnode->parent)->online--;
 	} else {
-		purple_signal_emit(purple_blist_get_handle(),
-		                 "buddy-status-changed", buddy, old_status,
-		                 status);
+		purple_signal_emit_resolved(buddy_status_changed_signal,
+		                 buddy, old_status, status);
 	}
 
 	/*
@@ -1044,8 +1494,7 @@ void purple_blist_alias_contact(PurpleContact *contact, const char *alias)
 		g_free(new_alias); /* could be "\0" */
 	}
 
-	if (ops && ops->save_node)
-		ops->save_node((PurpleBlistNode*) contact);
+	purple_blist_node_changed((PurpleBlistNode*) contact);
 
 	if (ops && ops->update)
 		ops->update(purplebuddylist, (PurpleBlistNode *)contact);
@@ -1127,8 +1576,7 @@ void purple_blist_alias_buddy(PurpleBuddy *buddy, const char *alias)
 		g_free(new_alias); /* could be "\0" */
 	}
 
-	if (ops && ops->save_node)
-		ops->save_node((PurpleBlistNode*) buddy);
+	purple_blist_node_changed((PurpleBlistNode*) buddy);
 
 	if (ops && ops->update)
 		ops->update(purplebuddylist, (PurpleBlistNode *)buddy);
@@ -1169,8 +1617,7 @@ void purple_blist_server_alias_buddy(PurpleBuddy *buddy, const char *alias)
 		g_free(new_alias); /* could be "\0"; */
 	}
 
-	if (ops && ops->save_node)
-		ops->save_node((PurpleBlistNode*) buddy);
+	purple_blist_node_changed((PurpleBlistNode*) buddy);
 
 	if (ops && ops->update)
 		ops->update(purplebuddylist, (PurpleBlistNode *)buddy);
@@ -1796,6 +2243,24 @@ void purple_contact_invalidate_priority_buddy(PurpleContact *contact)
 	contact->priority_valid = FALSE;
 }
 
+void
+_purple_blist_invalidate_priorities(void)
+{
+	PurpleBlistNode *gnode, *cnode;
+
+	if (purplebuddylist == NULL)
+		return;
+
+	for (gnode = purplebuddylist->root; gnode != NULL; gnode = gnode->next) {
+		if (!PURPLE_BLIST_NODE_IS_GROUP(gnode))
+			continue;
+		for (cnode = gnode->child; cnode != NULL; cnode = cnode->next) {
+			if (PURPLE_BLIST_NODE_IS_CONTACT(cnode))
+				((PurpleContact *)cnode)->priority_valid = FALSE;
+		}
+	}
+}
+
 PurpleGroup *purple_group_new(const char *name)
 {
 	PurpleBlistUiOps *ops = purple_blist_get_ui_ops();
@@ -2909,16 +3374,13 @@ static void purple_blist_node_initialize_settings(PurpleBlistNode *node)
 
 void purple_blist_node_remove_setting(PurpleBlistNode *node, const char *key)
 {
-	PurpleBlistUiOps *ops;
 	g_return_if_fail(node != NULL);
 	g_return_if_fail(node->settings != NULL);
 	g_return_if_fail(key != NULL);
 
 	g_hash_table_remove(node->settings, key);
 
-	ops = purple_blist_get_ui_ops();
-	if (ops && ops->save_node)
-		ops->save_node(node);
+	purple_blist_node_changed(node);
 }
 
 void
@@ -2948,7 +3410,6 @@ void
 purple_blist_node_set_bool(PurpleBlistNode* node, const char *key, gboolean data)
 {
 	PurpleValue *value;
-	PurpleBlistUiOps *ops;
 
 	g_return_if_fail(node != NULL);
 	g_return_if_fail(node->settings != NULL);
@@ -2959,9 +3420,7 @@ purple_blist_node_set_bool(PurpleBlistNode* node, const char *key, gboolean data
 
 	g_hash_table_replace(node->settings, g_strdup(key), value);
 
-	ops = purple_blist_get_ui_ops();
-	if (ops && ops->save_node)
-		ops->save_node(node);
+	purple_blist_node_changed(node);
 }
 
 gboolean
@@ -2987,7 +3446,6 @@ void
 purple_blist_node_set_int(PurpleBlistNode* node, const char *key, int data)
 {
 	PurpleValue *value;
-	PurpleBlistUiOps *ops;
 
 	g_return_if_fail(node != NULL);
 	g_return_if_fail(node->settings != NULL);
@@ -2998,9 +3456,7 @@ purple_blist_node_set_int(PurpleBlistNode* node, const char *key, int data)
 
 	g_hash_table_replace(node->settings, g_strdup(key), value);
 
-	ops = purple_blist_get_ui_ops();
-	if (ops && ops->save_node)
-		ops->save_node(node);
+	purple_blist_node_changed(node);
 }
 
 int
@@ -3026,7 +3482,6 @@ void
 purple_blist_node_set_string(PurpleBlistNode* node, const char *key, const char *data)
 {
 	PurpleValue *value;
-	PurpleBlistUiOps *ops;
 
 	g_return_if_fail(node != NULL);
 	g_return_if_fail(node->settings != NULL);
@@ -3037,9 +3492,7 @@ purple_blist_node_set_string(PurpleBlistNode* node, const char *key, const char
 
 	g_hash_table_replace(node->settings, g_strdup(key), value);
 
-	ops = purple_blist_get_ui_ops();
-	if (ops && ops->save_node)
-		ops->save_node(node);
+	purple_blist_node_changed(node);
 }
 
 const char *
@@ -3230,6 +3683,11 @@ purple_blist_init(void)
 			purple_value_new(PURPLE_TYPE_INT),
 			purple_value_new(PURPLE_TYPE_INT));
 
+	buddy_signed_on_signal = purple_signal_resolve(handle, "buddy-signed-on");
+	buddy_signed_off_signal = purple_signal_resolve(handle, "buddy-signed-off");
+	buddy_status_changed_signal =
+		purple_signal_resolve(handle, "buddy-status-changed");
+
 	purple_signal_connect(purple_accounts_get_handle(), "account-created",
 			handle,
 			PURPLE_CALLBACK(purple_blist_buddies_cache_add_account),
@@ -3253,7 +3711,12 @@ purple_blist_uninit(void)
 	if (save_timer != 0) {
 		purple_timeout_remove(save_timer);
 		save_timer = 0;
-		purple_blist_sync();
+		purple_blist_sync_changes();
+	}
+
+	if (journal_pending != NULL) {
+		g_hash_table_destroy(journal_pending);
+		journal_pending = NULL;
 	}
 
 	purple_blist_destroy();
@@ -3279,4 +3742,7 @@ purple_blist_uninit(void)
 
 	purple_signals_disconnect_by_handle(purple_blist_get_handle());
 	purple_signals_unregister_by_instance(purple_blist_get_handle());
+	buddy_signed_on_signal = NULL;
+	buddy_signed_off_signal = NULL;
+	buddy_status_changed_signal = NULL;
 }
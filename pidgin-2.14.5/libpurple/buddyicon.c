@@ -102,6 +102,32 @@ static GHashTable *pointer_icon_cache = NULL;
 
 static char       *cache_dir     = NULL;
 
+/**
+ * The pack of the icons in cache_dir, mapped read-only, so that looking up
+ * an icon doesn't have to open its file.  It is rebuilt in the background
+ * after the buddy list is loaded when it is missing icons.  See
+ * _purple_image_pack_open().
+ */
+static PurpleImagePack *icon_pack = NULL;
+static gboolean         icon_pack_opened = FALSE;
+
+#define ICON_PACK_FILENAME "icons.pack"
+
+/**
+ * Icons which aren't in icon_pack and are being read by the image loader
+ * thread for purple_buddy_icons_find_async().
+ *
+ * Key is the filename of the icon.
+ * Value is a GSList of PurpleBuddyIconLoad for the users waiting on it.
+ */
+static GHashTable *icon_loads = NULL;
+
+typedef struct
+{
+	PurpleAccount *account;
+	char *username;
+} PurpleBuddyIconLoad;
+
 /** "Should icons be cached to disk?" */
 static gboolean    icon_caching  = TRUE;
 
@@ -114,6 +140,107 @@ static void delete_buddy_icon_settings(PurpleBlistNode *node, const char *settin
  * Begin functions for dealing with the on-disk icon cache
  */
 
+static char *
+get_icon_pack_path(void)
+{
+	return g_build_filename(purple_buddy_icons_get_cache_dir(),
+	                        ICON_PACK_FILENAME, NULL);
+}
+
+static PurpleImagePack *
+get_icon_pack(void)
+{
+	if (!icon_pack_opened && purple_buddy_icons_get_cache_dir() != NULL)
+	{
+		char *path = get_icon_pack_path();
+		icon_pack = _purple_image_pack_open(path);
+		icon_pack_opened = TRUE;
+		g_free(path);
+	}
+
+	return icon_pack;
+}
+
+static void
+close_icon_pack(void)
+{
+	_purple_image_pack_unref(icon_pack);
+	icon_pack = NULL;
+	icon_pack_opened = FALSE;
+}
+
+static gboolean
+icon_file_exists(const char *dirname, const char *filename)
+{
+	char *path;
+	gboolean ret;
+
+	if (_purple_image_pack_lookup(get_icon_pack(), filename, NULL) != NULL)
+		return TRUE;
+
+	path = g_build_filename(dirname, filename, NULL);
+	ret = g_file_test(path, G_FILE_TEST_EXISTS);
+	g_free(path);
+
+	return ret;
+}
+
+static void
+icon_pack_built_cb(const char *path, gboolean success, gpointer user_data)
+{
+	char *current_path;
+
+	if (!success)
+		return;
+
+	/* Ignore a pack for a cache directory we no longer use. */
+	current_path = get_icon_pack_path();
+	if (purple_strequal(path, current_path))
+	{
+		close_icon_pack();
+		get_icon_pack();
+	}
+	g_free(current_path);
+}
+
+/*
+ * Rewrites the icon pack in the background when it is missing some of the
+ * icons in use or carries too many unused ones.
+ */
+static void
+update_icon_pack(void)
+{
+	PurpleImagePack *pack = get_icon_pack();
+	GList *filenames, *l;
+	guint missing = 0, used;
+	char *path;
+
+	if (!purple_buddy_icons_is_caching())
+		return;
+
+	filenames = g_hash_table_get_keys(icon_file_cache);
+	used = g_list_length(filenames);
+	for (l = filenames; l != NULL; l = l->next)
+	{
+		if (_purple_image_pack_lookup(pack, l->data, NULL) == NULL)
+			missing++;
+	}
+
+	if (missing > 0 || _purple_image_pack_get_count(pack) > used + used / 4)
+	{
+		purple_debug_info("buddyicon", "Rebuilding the icon pack "
+		                  "(%u of %u icons missing).\n", missing, used);
+		path = get_icon_pack_path();
+		_purple_image_pack_build_async(path, pack,
+		                               purple_buddy_icons_get_cache_dir(),
+		                               filenames, icon_pack_built_cb,
+		                               purple_buddy_icons_get_handle());
+		g_free(path);
+	}
+
+	g_list_free(filenames);
+}
+
 static void
 ref_filename(const char *filename)
 {
@@ -632,8 +759,155 @@ read_icon_file(const char *path, guchar **data, size_t *len)
 	return TRUE;
 }
 
-PurpleBuddyIcon *
-purple_buddy_icons_find(PurpleAccount *account, const char *username)
+/* Reads an icon from the icon cache directory, through the icon pack. */
+static gboolean
+read_cached_icon_file(const char *filename, guchar **data, size_t *len)
+{
+	GError *err = NULL;
+	gsize size;
+
+	if (!_purple_image_pack_read(get_icon_pack(),
+	                             purple_buddy_icons_get_cache_dir(),
+	                             filename, data, &size, &err))
+	{
+		purple_debug_error("buddyicon", "Error reading %s: %s\n",
+		                   filename, err->message);
+		g_error_free(err);
+
+		return FALSE;
+	}
+
+	*len = size;
+
+	return TRUE;
+}
+
+/* Creates the icon of a buddy from the data of its cached icon file.
+ * This takes ownership of data. */
+static PurpleBuddyIcon *
+buddy_icon_create_from_cache(PurpleAccount *account, const char *username,
+                             PurpleBuddy *b, guchar *data, size_t len)
+{
+	PurpleBuddyIcon *icon;
+	gboolean caching;
+
+	caching = purple_buddy_icons_is_caching();
+	/* By disabling caching temporarily, we avoid a loop
+	 * and don't have to add special code through several
+	 * functions. */
+	purple_buddy_icons_set_caching(FALSE);
+
+	icon = purple_buddy_icon_create(account, username);
+	icon->img = NULL;
+	purple_buddy_icon_set_data(icon, data, len,
+	                           purple_blist_node_get_string((PurpleBlistNode*)b,
+	                                                        "icon_checksum"));
+
+	purple_buddy_icons_set_caching(caching);
+
+	return icon;
+}
+
+static void
+buddy_icon_load_free(PurpleBuddyIconLoad *load)
+{
+	g_free(load->username);
+	g_free(load);
+}
+
+static void
+buddy_icon_loaded_cb(const char *filename, guchar *data, gsize len,
+                     gpointer user_data)
+{
+	gpointer key;
+	GSList *loads = NULL;
+
+	if (!g_hash_table_lookup_extended(icon_loads, filename, &key, (gpointer *)&loads))
+	{
+		g_free(data);
+		return;
+	}
+	g_hash_table_steal(icon_loads, filename);
+	g_free(key);
+
+	while (loads != NULL)
+	{
+		PurpleBuddyIconLoad *load = loads->data;
+		GHashTable *icon_cache;
+		PurpleBuddy *b = NULL;
+
+		/* Nothing to do if the account went away, the user got an icon in
+		 * the meantime, or the buddy's icon is no longer this file. */
+		icon_cache = g_hash_table_lookup(account_cache, load->account);
+		if (g_list_find(purple_accounts_get_all(), load->account) &&
+		    (icon_cache == NULL || g_hash_table_lookup(icon_cache, load->username) == NULL))
+		{
+			b = purple_find_buddy(load->account, load->username);
+		}
+
+		if (b != NULL && purple_strequal(filename,
+				purple_blist_node_get_string((PurpleBlistNode*)b, "buddy_icon")))
+		{
+			if (data != NULL)
+			{
+				/* This emits buddy-icon-changed for each of the user's
+				 * buddies.  The buddies hold the reference now. */
+				purple_buddy_icon_unref(buddy_icon_create_from_cache(
+						load->account, load->username, b,
+						g_memdup2(data, len), len));
+			}
+			else
+				delete_buddy_icon_settings((PurpleBlistNode*)b, "buddy_icon");
+		}
+
+		loads = g_slist_delete_link(loads, loads);
+		buddy_icon_load_free(load);
+	}
+
+	g_free(data);
+}
+
+static void
+buddy_icon_load(PurpleAccount *account, const char *username, const char *filename)
+{
+	PurpleBuddyIconLoad *load;
+	GSList *loads, *l;
+
+	loads = g_hash_table_lookup(icon_loads, filename);
+	for (l = loads; l != NULL; l = l->next)
+	{
+		load = l->data;
+		if (load->account == account && purple_strequal(load->username, username))
+			return;
+	}
+
+	load = g_new(PurpleBuddyIconLoad, 1);
+	load->account = account;
+	load->username = g_strdup(username);
+
+	if (loads != NULL)
+	{
+		/* Already being read; the head of the list stays the same. */
+		g_slist_append(loads, load);
+		return;
+	}
+
+	g_hash_table_insert(icon_loads, g_strdup(filename),
+	                    g_slist_prepend(NULL, load));
+	_purple_image_read_async(NULL, purple_buddy_icons_get_cache_dir(),
+	                         filename, buddy_icon_loaded_cb,
+	                         purple_buddy_icons_get_handle());
+}
+
+static void
+buddy_icon_loads_free(GSList *loads)
+{
+	g_slist_foreach(loads, (GFunc)buddy_icon_load_free, NULL);
+	g_slist_free(loads);
+}
+
+static PurpleBuddyIcon *
+buddy_icons_find(PurpleAccount *account, const char *username, gboolean wait)
 {
 	GHashTable *icon_cache;
 	PurpleBuddyIcon *icon = NULL;
@@ -647,10 +921,8 @@ purple_buddy_icons_find(PurpleAccount *account, const char *username)
 	{
 		PurpleBuddy *b = purple_find_buddy(account, username);
 		const char *protocol_icon_file;
-		const char *dirname;
-		gboolean caching;
-		guchar *data;
-		size_t len;
+		gconstpointer packed;
+		gsize len;
 
 		if (!b)
 			return NULL;
@@ -660,45 +932,49 @@ purple_buddy_icons_find(PurpleAccount *account, const char *username)
 		if (protocol_icon_file == NULL)
 			return NULL;
 
-		dirname = purple_buddy_icons_get_cache_dir();
-
-		caching = purple_buddy_icons_is_caching();
-		/* By disabling caching temporarily, we avoid a loop
-		 * and don't have to add special code through several
-		 * functions. */
-		purple_buddy_icons_set_caching(FALSE);
-
-		if (protocol_icon_file != NULL)
+		/* Icons in the pack are a memcpy away.  Anything else is read
+		 * from its file, or when not waiting, by the image loader thread
+		 * so a slow home directory can't block us; buddy-icon-changed is
+		 * emitted once it is here. */
+		packed = _purple_image_pack_lookup(get_icon_pack(), protocol_icon_file, &len);
+		if (packed != NULL)
+			icon = buddy_icon_create_from_cache(account, username, b,
+			                                    g_memdup2(packed, len), len);
+		else if (wait)
 		{
-			char *path = g_build_filename(dirname, protocol_icon_file, NULL);
-			if (read_icon_file(path, &data, &len))
-			{
-				const char *checksum;
+			guchar *data;
+			size_t data_len;
 
-				icon = purple_buddy_icon_create(account, username);
-				icon->img = NULL;
-				checksum = purple_blist_node_get_string((PurpleBlistNode*)b, "icon_checksum");
-				purple_buddy_icon_set_data(icon, data, len, checksum);
-			}
+			if (read_cached_icon_file(protocol_icon_file, &data, &data_len))
+				icon = buddy_icon_create_from_cache(account, username, b,
+				                                    data, data_len);
 			else
 				delete_buddy_icon_settings((PurpleBlistNode*)b, "buddy_icon");
-
-			g_free(path);
 		}
-
-		purple_buddy_icons_set_caching(caching);
+		else
+			buddy_icon_load(account, username, protocol_icon_file);
 	}
 
 	return (icon ? purple_buddy_icon_ref(icon) : NULL);
 }
 
+PurpleBuddyIcon *
+purple_buddy_icons_find(PurpleAccount *account, const char *username)
+{
+	return buddy_icons_find(account, username, TRUE);
+}
+
+PurpleBuddyIcon *
+purple_buddy_icons_find_async(PurpleAccount *account, const char *username)
+{
+	return buddy_icons_find(account, username, FALSE);
+}
+
 PurpleStoredImage *
 purple_buddy_icons_find_account_icon(PurpleAccount *account)
 {
 	PurpleStoredImage *img;
 	const char *account_icon_file;
-	const char *dirname;
-	char *path;
 	guchar *data;
 	size_t len;
 
@@ -714,16 +990,11 @@ purple_buddy_icons_find_account_icon(PurpleAccount *account)
 	if (account_icon_file == NULL)
 		return NULL;
 
-	dirname = purple_buddy_icons_get_cache_dir();
-	path = g_build_filename(dirname, account_icon_file, NULL);
-
-	if (read_icon_file(path, &data, &len))
+	if (read_cached_icon_file(account_icon_file, &data, &len))
 	{
-		g_free(path);
 		img = purple_buddy_icons_set_account_icon(account, data, len);
 		return purple_imgstore_ref(img);
 	}
-	g_free(path);
 
 	return NULL;
 }
@@ -819,11 +1090,10 @@ purple_buddy_icons_node_has_custom_icon(PurpleBlistNode *node)
 PurpleStoredImage *
 purple_buddy_icons_node_find_custom_icon(PurpleBlistNode *node)
 {
-	char *path;
 	size_t len;
 	guchar *data;
 	PurpleStoredImage *img;
-	const char *custom_icon_file, *dirname;
+	const char *custom_icon_file;
 
 	g_return_val_if_fail(node != NULL, NULL);
 
@@ -838,16 +1108,11 @@ purple_buddy_icons_node_find_custom_icon(PurpleBlistNode *node)
 	if (custom_icon_file == NULL)
 		return NULL;
 
-	dirname = purple_buddy_icons_get_cache_dir();
-	path = g_build_filename(dirname, custom_icon_file, NULL);
-
-	if (read_icon_file(path, &data, &len))
+	if (read_cached_icon_file(custom_icon_file, &data, &len))
 	{
-		g_free(path);
 		img = purple_buddy_icons_node_set_custom_icon(node, data, len);
 		return purple_imgstore_ref(img);
 	}
-	g_free(path);
 
 	return NULL;
 }
@@ -1123,14 +1388,12 @@ _purple_buddy_icons_account_loaded_cb()
 
 		if (account_icon_file != NULL)
 		{
-			char *path = g_build_filename(dirname, account_icon_file, NULL);
-			if (!g_file_test(path, G_FILE_TEST_EXISTS))
+			if (!icon_file_exists(dirname, account_icon_file))
 			{
 				purple_account_set_string(account, "buddy_icon", NULL);
 			} else {
 				ref_filename(account_icon_file);
 			}
-			g_free(path);
 		}
 	}
 }
@@ -1174,8 +1437,7 @@ _purple_buddy_icons_blist_loaded_cb()
 				}
 				else
 				{
-					char *path = g_build_filename(dirname, filename, NULL);
-					if (!g_file_test(path, G_FILE_TEST_EXISTS))
+					if (!icon_file_exists(dirname, filename))
 					{
 						purple_blist_node_remove_setting(node,
 						                                 "buddy_icon");
@@ -1184,7 +1446,6 @@ _purple_buddy_icons_blist_loaded_cb()
 					}
 					else
 						ref_filename(filename);
-					g_free(path);
 				}
 			}
 		}
@@ -1205,20 +1466,20 @@ _purple_buddy_icons_blist_loaded_cb()
 				}
 				else
 				{
-					char *path = g_build_filename(dirname, filename, NULL);
-					if (!g_file_test(path, G_FILE_TEST_EXISTS))
+					if (!icon_file_exists(dirname, filename))
 					{
 						purple_blist_node_remove_setting(node,
 						                                 "custom_buddy_icon");
 					}
 					else
 						ref_filename(filename);
-					g_free(path);
 				}
 			}
 		}
 		node = purple_blist_node_next(node, TRUE);
 	}
+
+	update_icon_pack();
 }
 
 void
@@ -1240,6 +1501,7 @@ purple_buddy_icons_set_cache_dir(const char *dir)
 
 	g_free(cache_dir);
 	cache_dir = g_strdup(dir);
+	close_icon_pack();
 }
 
 const char *
@@ -1268,6 +1530,8 @@ purple_buddy_icons_init()
 	icon_file_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
 	                                        g_free, NULL);
 	pointer_icon_cache = g_hash_table_new(g_direct_hash, g_direct_equal);
+	icon_loads = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                   g_free, (GDestroyNotify)buddy_icon_loads_free);
 
 	if (!cache_dir)
 		cache_dir = g_build_filename(purple_user_dir(), "icons", NULL);
@@ -1281,11 +1545,14 @@ void
 purple_buddy_icons_uninit()
 {
 	purple_signals_disconnect_by_handle(purple_buddy_icons_get_handle());
+	_purple_image_jobs_cancel(purple_buddy_icons_get_handle());
 
 	g_hash_table_destroy(account_cache);
 	g_hash_table_destroy(icon_data_cache);
 	g_hash_table_destroy(icon_file_cache);
 	g_hash_table_destroy(pointer_icon_cache);
+	g_hash_table_destroy(icon_loads);
+	close_icon_pack();
 	g_free(old_icons_dir);
 	g_free(cache_dir);
 
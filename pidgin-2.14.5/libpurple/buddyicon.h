@@ -220,6 +220,26 @@ purple_buddy_icons_get_checksum_for_user(PurpleBuddy *buddy);
 PurpleBuddyIcon *
 purple_buddy_icons_find(PurpleAccount *account, const char *username);
 
+/**
+ * Returns the buddy icon information for a user, without waiting for the
+ * disk.
+ *
+ * If the icon isn't loaded yet and can't be read without touching the disk,
+ * it is read in the background and this returns @c NULL.  The
+ * "buddy-icon-changed" signal is emitted for the user's buddies once the
+ * icon is available.
+ *
+ * @param account  The account the user is on.
+ * @param username The username of the user.
+ *
+ * @return The icon (with a reference for the caller) if found, or @c NULL if
+ *         not found or still being loaded.
+ *
+ * @since 2.14.6
+ */
+PurpleBuddyIcon *
+purple_buddy_icons_find_async(PurpleAccount *account, const char *username);
+
 /**
  * Returns the buddy icon image for an account.
  *
@@ -765,27 +765,68 @@ static PurpleCertificateVerifier x509_singleuse = {
 
 
 /***** X.509 Certificate Authority pool, keyed by Distinguished Name *****/
-/* This is implemented in what may be the most inefficient and bugprone way
-   possible; however, future optimizations should not be difficult. */
+/* The certificates are indexed by DN, and only parsed once they are needed.
+   To know which DNs a CA file holds without parsing it, a summary of every
+   file (its mtime and size, and the DN and fingerprint of each certificate
+   in it, in order) is kept in X509_CA_SUMMARY_FILE.  Files that did not
+   change since the summary was written are only parsed, as a whole, when
+   one of their certificates is asked for. */
 
 static PurpleCertificatePool x509_ca;
 
+#define X509_CA_SUMMARY_FILE "certificates" G_DIR_SEPARATOR_S "x509" \
+	G_DIR_SEPARATOR_S "ca-summary.xml"
+
+typedef struct _x509_ca_file x509_ca_file;
+
 /** Holds a key-value pair for quickish certificate lookup */
 typedef struct {
 	gchar *dn;
+	/** NULL until the certificate has been parsed */
 	PurpleCertificate *crt;
+	/** The file it came from, or NULL if it was added at runtime */
+	x509_ca_file *file;
+	/** Hex SHA-1 fingerprint, used to check the summary is not stale */
+	gchar *fingerprint;
 } x509_ca_element;
 
+/** A CA file, with its x509_ca_elements in the order they appear in it */
+struct _x509_ca_file {
+	gchar *path;
+	GPtrArray *elements;
+	gboolean parsed;
+};
+
 static void
 x509_ca_element_free(x509_ca_element *el)
 {
+	guint i;
+
 	if (NULL == el) return;
 
+	/* Keep the other elements at their index in the file */
+	if (el->file) {
+		for (i = 0; i < el->file->elements->len; i++) {
+			if (g_ptr_array_index(el->file->elements, i) == el)
+				el->file->elements->pdata[i] = NULL;
+		}
+	}
+
 	g_free(el->dn);
-	purple_certificate_destroy(el->crt);
+	g_free(el->fingerprint);
+	if (el->crt)
+		purple_certificate_destroy(el->crt);
 	g_free(el);
 }
 
+static void
+x509_ca_file_free(x509_ca_file *file)
+{
+	g_ptr_array_free(file->elements, TRUE);
+	g_free(file->path);
+	g_free(file);
+}
+
 /** System directory to probe for CA certificates */
 /* This is set in the lazy_init function */
 static GList *x509_ca_paths = NULL;
@@ -794,12 +835,59 @@ static GList *x509_ca_paths = NULL;
     happens. Contains pointers to x509_ca_elements */
 static GList *x509_ca_certs = NULL;
 
+/** Maps a DN to the GList of x509_ca_elements with that DN.  The key is
+    the dn of the first element of the list. */
+static GHashTable *x509_ca_index = NULL;
+
+/** The x509_ca_files the certificates were read from */
+static GList *x509_ca_files = NULL;
+
 /** Used for lazy initialization purposes. */
 static gboolean x509_ca_initialized = FALSE;
 
+static void
+x509_ca_index_add(x509_ca_element *el)
+{
+	GList *l = g_hash_table_lookup(x509_ca_index, el->dn);
+
+	x509_ca_certs = g_list_prepend(x509_ca_certs, el);
+	g_hash_table_steal(x509_ca_index, el->dn);
+	g_hash_table_insert(x509_ca_index, el->dn, g_list_prepend(l, el));
+}
+
+static void
+x509_ca_index_remove(x509_ca_element *el)
+{
+	GList *l = g_hash_table_lookup(x509_ca_index, el->dn);
+
+	x509_ca_certs = g_list_remove(x509_ca_certs, el);
+
+	g_hash_table_steal(x509_ca_index, el->dn);
+	l = g_list_remove(l, el);
+	if (l != NULL)
+		g_hash_table_insert(x509_ca_index,
+				((x509_ca_element *)l->data)->dn, l);
+}
+
+static gchar *
+x509_ca_fingerprint(PurpleCertificate *crt)
+{
+	GByteArray *sha1;
+	gchar *fpr;
+
+	sha1 = purple_certificate_get_fingerprint_sha1(crt);
+	if (sha1 == NULL)
+		return NULL;
+
+	fpr = purple_base16_encode_chunked(sha1->data, sha1->len);
+	g_byte_array_free(sha1, TRUE);
+
+	return fpr;
+}
+
 /** Adds a certificate to the in-memory cache, and mark it as trusted */
 static gboolean
-x509_ca_quiet_put_cert(PurpleCertificate *crt)
+x509_ca_quiet_put_cert(PurpleCertificate *crt, x509_ca_file *file)
 {
 	gboolean ret;
 	x509_ca_element *el;
@@ -823,12 +911,195 @@ x509_ca_quiet_put_cert(PurpleCertificate *crt)
 		el = g_new0(x509_ca_element, 1);
 		el->dn = purple_certificate_get_unique_id(crt);
 		el->crt = purple_certificate_copy(crt);
-		x509_ca_certs = g_list_prepend(x509_ca_certs, el);
+		el->fingerprint = x509_ca_fingerprint(crt);
+		el->file = file;
+		if (file)
+			g_ptr_array_add(file->elements, el);
+		x509_ca_index_add(el);
 	}
 
 	return ret;
 }
 
+static x509_ca_file *
+x509_ca_file_new(const gchar *path)
+{
+	x509_ca_file *file = g_new0(x509_ca_file, 1);
+
+	file->path = g_strdup(path);
+	file->elements = g_ptr_array_new();
+	x509_ca_files = g_list_prepend(x509_ca_files, file);
+
+	return file;
+}
+
+/** Parses a CA file and puts all of its certificates in the pool */
+static x509_ca_file *
+x509_ca_load_file(PurpleCertificateScheme *x509, const gchar *fullpath)
+{
+	x509_ca_file *file;
+	GSList *crts;
+	PurpleCertificate *crt;
+
+	file = x509_ca_file_new(fullpath);
+	file->parsed = TRUE;
+
+	/* TODO: Respond to a failure in the following? */
+	crts = purple_certificates_import(x509, fullpath);
+
+	while (crts && crts->data) {
+		crt = crts->data;
+		if (x509_ca_quiet_put_cert(crt, file)) {
+			gchar *name;
+			name = purple_certificate_get_subject_name(crt);
+			purple_debug_info("certificate/x509/ca",
+					  "Loaded %s from %s\n",
+					  name ? name : "(unknown)", fullpath);
+			g_free(name);
+		} else {
+			purple_debug_error("certificate/x509/ca",
+					  "Failed to load certificate from %s\n",
+					  fullpath);
+		}
+		purple_certificate_destroy(crt);
+		crts = g_slist_delete_link(crts, crts);
+	}
+
+	return file;
+}
+
+/** Puts the certificates of an unchanged CA file in the pool, unparsed */
+static x509_ca_file *
+x509_ca_load_summary(const gchar *fullpath, xmlnode *summary)
+{
+	x509_ca_file *file;
+	xmlnode *child;
+	x509_ca_element *el;
+	const char *dn;
+
+	file = x509_ca_file_new(fullpath);
+
+	for (child = xmlnode_get_child(summary, "cert"); child;
+			child = xmlnode_get_next_twin(child)) {
+		dn = xmlnode_get_attrib(child, "dn");
+		if (dn == NULL)
+			continue;
+
+		el = g_new0(x509_ca_element, 1);
+		el->dn = g_strdup(dn);
+		el->fingerprint = g_strdup(xmlnode_get_attrib(child, "fingerprint"));
+		el->file = file;
+		g_ptr_array_add(file->elements, el);
+		x509_ca_index_add(el);
+	}
+
+	return file;
+}
+
+static gboolean
+x509_ca_summary_matches(xmlnode *summary, struct stat *st)
+{
+	const char *mtime, *size;
+
+	if (summary == NULL)
+		return FALSE;
+
+	mtime = xmlnode_get_attrib(summary, "mtime");
+	size = xmlnode_get_attrib(summary, "size");
+	if (mtime == NULL || size == NULL)
+		return FALSE;
+
+	return g_ascii_strtoll(mtime, NULL, 10) == (gint64)st->st_mtime &&
+		g_ascii_strtoll(size, NULL, 10) == (gint64)st->st_size;
+}
+
+static xmlnode *
+x509_ca_file_to_xmlnode(x509_ca_file *file, struct stat *st)
+{
+	xmlnode *node, *child;
+	x509_ca_element *el;
+	char buf[32];
+	guint i;
+
+	node = xmlnode_new("file");
+	xmlnode_set_attrib(node, "path", file->path);
+	g_snprintf(buf, sizeof(buf), "%" G_GINT64_FORMAT, (gint64)st->st_mtime);
+	xmlnode_set_attrib(node, "mtime", buf);
+	g_snprintf(buf, sizeof(buf), "%" G_GINT64_FORMAT, (gint64)st->st_size);
+	xmlnode_set_attrib(node, "size", buf);
+
+	for (i = 0; i < file->elements->len; i++) {
+		el = g_ptr_array_index(file->elements, i);
+		if (el == NULL)
+			continue;
+
+		child = xmlnode_new_child(node, "cert");
+		xmlnode_set_attrib(child, "dn", el->dn);
+		if (el->fingerprint)
+			xmlnode_set_attrib(child, "fingerprint", el->fingerprint);
+	}
+
+	return node;
+}
+
+/** Returns the certificate of an element, parsing its file if needed.
+    Certificates that do not match what the summary said are ignored. */
+static PurpleCertificate *
+x509_ca_element_get_crt(x509_ca_element *el)
+{
+	PurpleCertificateScheme *x509;
+	x509_ca_file *file = el->file;
+	x509_ca_element *cur;
+	PurpleCertificate *crt;
+	GSList *crts;
+	gchar *dn, *fpr;
+	guint i;
+
+	if (el->crt != NULL || file == NULL || file->parsed)
+		return el->crt;
+
+	x509 = purple_certificate_find_scheme(x509_ca.scheme_name);
+	g_return_val_if_fail(x509 != NULL, NULL);
+
+	file->parsed = TRUE;
+	crts = purple_certificates_import(x509, file->path);
+
+	for (i = 0; crts && crts->data; i++) {
+		crt = crts->data;
+		cur = (i < file->elements->len) ?
+			g_ptr_array_index(file->elements, i) : NULL;
+
+		if (cur != NULL && cur->crt == NULL) {
+			dn = purple_certificate_get_unique_id(crt);
+			fpr = x509_ca_fingerprint(crt);
+
+			if (purple_strequal(dn, cur->dn) &&
+					purple_strequal(fpr, cur->fingerprint)) {
+				cur->crt = crt;
+				crt = NULL;
+			} else {
+				purple_debug_warning("certificate/x509/ca",
+						"Certificate %u of %s changed since "
+						"it was indexed; ignoring it\n",
+						i, file->path);
+			}
+
+			g_free(dn);
+			g_free(fpr);
+		}
+
+		if (crt != NULL)
+			purple_certificate_destroy(crt);
+		crts = g_slist_delete_link(crts, crts);
+	}
+
+	if (el->crt == NULL)
+		purple_debug_error("certificate/x509/ca",
+				"Failed to load %s from %s\n", el->dn, file->path);
+
+	return el->crt;
+}
+
 /* Since the libpurple CertificatePools get registered before plugins are
    loaded, an X.509 Scheme is generally not available when x509_ca_init is
    called, but x509_ca requires X.509 operations in order to properly load.
@@ -845,7 +1116,9 @@ x509_ca_lazy_init(void)
 	const gchar *entry;
 	GPatternSpec *pempat, *crtpat;
 	GList *iter = NULL;
-	GSList *crts = NULL;
+	GHashTable *summaries;
+	xmlnode *summary = NULL, *new_summary, *child;
+	gboolean eager, changed = FALSE;
 
 	if (x509_ca_initialized) return TRUE;
 
@@ -859,6 +1132,28 @@ x509_ca_lazy_init(void)
 		return FALSE;
 	}
 
+	x509_ca_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+			NULL, (GDestroyNotify)g_list_free);
+
+	/* A scheme that keeps its own store of trusted certificates has to
+	   be given all of them up front */
+	eager = (x509->register_trusted_tls_cert != NULL);
+
+	summaries = g_hash_table_new(g_str_hash, g_str_equal);
+	if (!eager)
+		summary = purple_util_read_xml_from_file(X509_CA_SUMMARY_FILE,
+				_("certificate authority summary"));
+	if (summary != NULL) {
+		for (child = xmlnode_get_child(summary, "file"); child;
+				child = xmlnode_get_next_twin(child)) {
+			const char *path = xmlnode_get_attrib(child, "path");
+			if (path != NULL)
+				g_hash_table_insert(summaries, (gpointer)path, child);
+		}
+	}
+	new_summary = xmlnode_new("ca-summary");
+	xmlnode_set_attrib(new_summary, "version", "1.0");
+
 	/* Use a glob to only read .pem files */
 	pempat = g_pattern_spec_new("*.pem");
 	crtpat = g_pattern_spec_new("*.crt");
@@ -873,7 +1168,9 @@ x509_ca_lazy_init(void)
 
 		while ( (entry = g_dir_read_name(certdir)) ) {
 			gchar *fullpath;
-			PurpleCertificate *crt;
+			struct stat st;
+			x509_ca_file *file;
+			xmlnode *file_summary;
 
 			if (!g_pattern_match_string(pempat, entry) && !g_pattern_match_string(crtpat, entry)) {
 				continue;
@@ -881,26 +1178,22 @@ x509_ca_lazy_init(void)
 
 			fullpath = g_build_filename(iter->data, entry, NULL);
 
-			/* TODO: Respond to a failure in the following? */
-			crts = purple_certificates_import(x509, fullpath);
-
-			while (crts && crts->data) {
-				crt = crts->data;
-				if (x509_ca_quiet_put_cert(crt)) {
-					gchar *name;
-					name = purple_certificate_get_subject_name(crt);
-					purple_debug_info("certificate/x509/ca",
-							  "Loaded %s from %s\n",
-							  name ? name : "(unknown)", fullpath);
-					g_free(name);
-				} else {
-					purple_debug_error("certificate/x509/ca",
-							  "Failed to load certificate from %s\n",
-							  fullpath);
-				}
-				purple_certificate_destroy(crt);
-				crts = g_slist_delete_link(crts, crts);
+			if (eager || g_stat(fullpath, &st) != 0) {
+				x509_ca_load_file(x509, fullpath);
+				g_free(fullpath);
+				continue;
+			}
+
+			file_summary = g_hash_table_lookup(summaries, fullpath);
+			if (x509_ca_summary_matches(file_summary, &st)) {
+				file = x509_ca_load_summary(fullpath, file_summary);
+				g_hash_table_remove(summaries, fullpath);
+			} else {
+				file = x509_ca_load_file(x509, fullpath);
+				changed = TRUE;
 			}
+			xmlnode_insert_child(new_summary,
+					x509_ca_file_to_xmlnode(file, &st));
 
 			g_free(fullpath);
 		}
@@ -910,6 +1203,20 @@ x509_ca_lazy_init(void)
 	g_pattern_spec_free(pempat);
 	g_pattern_spec_free(crtpat);
 
+	/* Leftover summaries are for files that are gone */
+	if (!eager && (changed || g_hash_table_size(summaries) > 0)) {
+		gchar *dir = g_build_filename(purple_user_dir(),
+				"certificates", "x509", NULL);
+		if (purple_build_dir(dir, S_IRUSR | S_IWUSR | S_IXUSR) == 0)
+			purple_util_write_xml_to_file(X509_CA_SUMMARY_FILE, new_summary);
+		g_free(dir);
+	}
+
+	g_hash_table_destroy(summaries);
+	if (summary != NULL)
+		xmlnode_free(summary);
+	xmlnode_free(new_summary);
+
 	purple_debug_info("certificate/x509/ca",
 			  "Lazy init completed.\n");
 	x509_ca_initialized = TRUE;
@@ -950,56 +1257,38 @@ x509_ca_uninit(void)
 {
 	GList *l;
 
+	if (x509_ca_index != NULL) {
+		g_hash_table_destroy(x509_ca_index);
+		x509_ca_index = NULL;
+	}
 	for (l = x509_ca_certs; l; l = l->next) {
 		x509_ca_element *el = l->data;
 		x509_ca_element_free(el);
 	}
 	g_list_free(x509_ca_certs);
 	x509_ca_certs = NULL;
+	g_list_free_full(x509_ca_files, (GDestroyNotify)x509_ca_file_free);
+	x509_ca_files = NULL;
 	x509_ca_initialized = FALSE;
 	/** TODO: the cert store in the SSL implementation wouldn't be cleared by this */
 	g_list_free_full(x509_ca_paths, (GDestroyNotify)g_free);
 	x509_ca_paths = NULL;
 }
 
-/** Look up a ca_element by dn */
-static x509_ca_element *
-x509_ca_locate_cert(GList *lst, const gchar *dn)
+/** Look up the ca_elements with a dn */
+static GList *
+x509_ca_locate_certs(const gchar *dn)
 {
-	GList *cur;
-
-	for (cur = lst; cur; cur = cur->next) {
-		x509_ca_element *el = cur->data;
-		if (purple_strequal(dn, el->dn)) {
-			return el;
-		}
-	}
-	return NULL;
+	return g_hash_table_lookup(x509_ca_index, dn);
 }
 
-static GSList *
-x509_ca_locate_certs(GList *lst, const gchar *dn)
-{
-	GList *cur;
-	GSList *crts = NULL;
-
-	for (cur = lst; cur; cur = cur->next) {
-		x509_ca_element *el = cur->data;
-		if (purple_strequal(dn, el->dn)) {
-			crts = g_slist_prepend(crts, el);
-		}
-	}
-	return crts;
-}
-
-
 static gboolean
 x509_ca_cert_in_pool(const gchar *id)
 {
 	g_return_val_if_fail(x509_ca_lazy_init(), FALSE);
 	g_return_val_if_fail(id, FALSE);
 
-	if (x509_ca_locate_cert(x509_ca_certs, id) != NULL) {
+	if (x509_ca_locate_certs(id) != NULL) {
 		return TRUE;
 	} else {
 		return FALSE;
@@ -1012,45 +1301,40 @@ static PurpleCertificate *
 x509_ca_get_cert(const gchar *id)
 {
 	PurpleCertificate *crt = NULL;
-	x509_ca_element *el;
+	GList *els;
 
 	g_return_val_if_fail(x509_ca_lazy_init(), NULL);
 	g_return_val_if_fail(id, NULL);
 
 	/* Search the memory-cached pool */
-	el = x509_ca_locate_cert(x509_ca_certs, id);
-
-	if (el != NULL) {
-		/* Make a copy of the memcached one for the function caller
-		   to play with */
-		crt = purple_certificate_copy(el->crt);
-	} else {
-		crt = NULL;
+	for (els = x509_ca_locate_certs(id); els; els = els->next) {
+		crt = x509_ca_element_get_crt(els->data);
+		if (crt != NULL) {
+			/* Make a copy of the memcached one for the function caller
+			   to play with */
+			return purple_certificate_copy(crt);
+		}
 	}
 
-	return crt;
+	return NULL;
 }
 
 static GSList *
 x509_ca_get_certs(const gchar *id)
 {
-	GSList *crts = NULL, *els = NULL;
+	GSList *crts = NULL;
+	GList *els;
+	PurpleCertificate *crt;
 
 	g_return_val_if_fail(x509_ca_lazy_init(), NULL);
 	g_return_val_if_fail(id, NULL);
 
-	/* Search the memory-cached pool */
-	els = x509_ca_locate_certs(x509_ca_certs, id);
-
-	if (els != NULL) {
-		GSList *cur;
-		/* Make a copy of the memcached ones for the function caller
-		   to play with */
-		for (cur = els; cur; cur = cur->next) {
-			x509_ca_element *el = cur->data;
-			crts = g_slist_prepend(crts, purple_certificate_copy(el->crt));
-		}
-		g_slist_free(els);
+	/* Search the memory-cached pool, making copies of the memcached
+	   ones for the function caller to play with */
+	for (els = x509_ca_locate_certs(id); els; els = els->next) {
+		crt = x509_ca_element_get_crt(els->data);
+		if (crt != NULL)
+			crts = g_slist_prepend(crts, purple_certificate_copy(crt));
 	}
 
 	return crts;
@@ -1065,7 +1349,7 @@ x509_ca_put_cert(const gchar *id, PurpleCertificate *crt)
 
 	/* TODO: This is a quick way of doing this. At some point the change
 	   ought to be flushed to disk somehow. */
-	ret = x509_ca_quiet_put_cert(crt);
+	ret = x509_ca_quiet_put_cert(crt, NULL);
 
 	return ret;
 }
@@ -1073,14 +1357,15 @@ x509_ca_put_cert(const gchar *id, PurpleCertificate *crt)
 static gboolean
 x509_ca_delete_cert(const gchar *id)
 {
+	GList *els;
 	x509_ca_element *el;
 
 	g_return_val_if_fail(x509_ca_lazy_init(), FALSE);
 	g_return_val_if_fail(id, FALSE);
 
 	/* Is the id even in the pool? */
-	el = x509_ca_locate_cert(x509_ca_certs, id);
-	if ( el == NULL ) {
+	els = x509_ca_locate_certs(id);
+	if ( els == NULL ) {
 		purple_debug_warning("certificate/x509/ca",
 				     "Id %s wasn't in the pool\n",
 				     id);
@@ -1088,7 +1373,8 @@ x509_ca_delete_cert(const gchar *id)
 	}
 
 	/* Unlink it from the memory cache and destroy it */
-	x509_ca_certs = g_list_remove(x509_ca_certs, el);
+	el = els->data;
+	x509_ca_index_remove(el);
 	x509_ca_element_free(el);
 
 	return TRUE;
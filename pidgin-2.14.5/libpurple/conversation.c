@@ -41,6 +41,31 @@ static GList *ims = NULL;
 static GList *chats = NULL;
 static PurpleConversationUiOps *default_ops = NULL;
 
+/*
+ * The signals emitted for every message, resolved once so emitting them
+ * does not look them up by name.  Indexed by PurpleConvSignal.
+ */
+static PurpleSignal *conv_signals[PURPLE_CONV_SIGNAL_LAST];
+
+static const char * const conv_signal_names[PURPLE_CONV_SIGNAL_LAST] = {
+	"writing-im-msg",
+	"wrote-im-msg",
+	"sending-im-msg",
+	"sent-im-msg",
+	"receiving-im-msg",
+	"received-im-msg",
+	"writing-chat-msg",
+	"wrote-chat-msg",
+	"sending-chat-msg",
+	"sent-chat-msg",
+	"receiving-chat-msg",
+	"received-chat-msg",
+	"buddy-typing",
+	"buddy-typed",
+	"buddy-typing-stopped",
+	"conversation-updated"
+};
+
 /**
  * A hash table used for efficient lookups of conversations by name.
  * struct _purple_hconv => PurpleConversation*
@@ -174,7 +199,7 @@ common_send(PurpleConversation *conv, const char *message, PurpleMessageFlags ms
 	if (type == PURPLE_CONV_TYPE_IM) {
 		PurpleConvIm *im = PURPLE_CONV_IM(conv);
 
-		purple_signal_emit(purple_conversations_get_handle(), "sending-im-msg",
+		purple_signal_emit_resolved(conv_signals[PURPLE_CONV_SIGNAL_SENDING_IM_MSG],
 						 account,
 						 purple_conversation_get_name(conv), &sent);
 
@@ -186,20 +211,20 @@ common_send(PurpleConversation *conv, const char *message, PurpleMessageFlags ms
 			if ((err > 0) && (displayed != NULL))
 				purple_conv_im_write(im, NULL, displayed, msgflags, time(NULL));
 
-			purple_signal_emit(purple_conversations_get_handle(), "sent-im-msg",
+			purple_signal_emit_resolved(conv_signals[PURPLE_CONV_SIGNAL_SENT_IM_MSG],
 							 account,
 							 purple_conversation_get_name(conv), sent);
 		}
 	}
 	else {
-		purple_signal_emit(purple_conversations_get_handle(), "sending-chat-msg",
+		purple_signal_emit_resolved(conv_signals[PURPLE_CONV_SIGNAL_SENDING_CHAT_MSG],
 						 account, &sent,
 						 purple_conv_chat_get_id(PURPLE_CONV_CHAT(conv)));
 
 		if (sent != NULL && sent[0] != '\0') {
 			err = serv_chat_send(gc, purple_conv_chat_get_id(PURPLE_CONV_CHAT(conv)), sent, msgflags);
 
-			purple_signal_emit(purple_conversations_get_handle(), "sent-chat-msg",
+			purple_signal_emit_resolved(conv_signals[PURPLE_CONV_SIGNAL_SENT_CHAT_MSG],
 							 account, sent,
 							 purple_conv_chat_get_id(PURPLE_CONV_CHAT(conv)));
 		}
@@ -1012,9 +1037,10 @@ purple_conversation_write(PurpleConversation *conv, const char *who,
 	alias = who;
 
 	plugin_return =
-		GPOINTER_TO_INT(purple_signal_emit_return_1(
-			purple_conversations_get_handle(),
-			(type == PURPLE_CONV_TYPE_IM ? "writing-im-msg" : "writing-chat-msg"),
+		GPOINTER_TO_INT(purple_signal_emit_resolved_return_1(
+			conv_signals[type == PURPLE_CONV_TYPE_IM ?
+				PURPLE_CONV_SIGNAL_WRITING_IM_MSG :
+				PURPLE_CONV_SIGNAL_WRITING_CHAT_MSG],
 			account, who, &displayed, conv, flags));
 
 	if (displayed == NULL)
@@ -1079,8 +1105,10 @@ purple_conversation_write(PurpleConversation *conv, const char *who,
 
 	add_message_to_history(conv, who, alias, message, flags, mtime);
 
-	purple_signal_emit(purple_conversations_get_handle(),
-		(type == PURPLE_CONV_TYPE_IM ? "wrote-im-msg" : "wrote-chat-msg"),
+	purple_signal_emit_resolved(
+		conv_signals[type == PURPLE_CONV_TYPE_IM ?
+			PURPLE_CONV_SIGNAL_WROTE_IM_MSG :
+			PURPLE_CONV_SIGNAL_WROTE_CHAT_MSG],
 		account, who, displayed, conv, flags);
 
 	g_free(displayed);
@@ -1114,8 +1142,8 @@ purple_conversation_update(PurpleConversation *conv, PurpleConvUpdateType type)
 {
 	g_return_if_fail(conv != NULL);
 
-	purple_signal_emit(purple_conversations_get_handle(),
-					 "conversation-updated", conv, type);
+	purple_signal_emit_resolved(
+		conv_signals[PURPLE_CONV_SIGNAL_CONVERSATION_UPDATED], conv, type);
 }
 
 /**************************************************************************
@@ -1165,16 +1193,19 @@ purple_conv_im_set_typing_state(PurpleConvIm *im, PurpleTypingState state)
 		switch (state)
 		{
 			case PURPLE_TYPING:
-				purple_signal_emit(purple_conversations_get_handle(),
-								   "buddy-typing", im->conv->account, im->conv->name);
+				purple_signal_emit_resolved(
+					conv_signals[PURPLE_CONV_SIGNAL_BUDDY_TYPING],
+					im->conv->account, im->conv->name);
 				break;
 			case PURPLE_TYPED:
-				purple_signal_emit(purple_conversations_get_handle(),
-								   "buddy-typed", im->conv->account, im->conv->name);
+				purple_signal_emit_resolved(
+					conv_signals[PURPLE_CONV_SIGNAL_BUDDY_TYPED],
+					im->conv->account, im->conv->name);
 				break;
 			case PURPLE_NOT_TYPING:
-				purple_signal_emit(purple_conversations_get_handle(),
-								   "buddy-typing-stopped", im->conv->account, im->conv->name);
+				purple_signal_emit_resolved(
+					conv_signals[PURPLE_CONV_SIGNAL_BUDDY_TYPING_STOPPED],
+					im->conv->account, im->conv->name);
 				break;
 		}
 
@@ -2435,6 +2466,7 @@ void
 purple_conversations_init(void)
 {
 	void *handle = purple_conversations_get_handle();
+	int i;
 
 	conversation_cache = g_hash_table_new_full((GHashFunc)_purple_conversations_hconv_hash,
 						(GEqualFunc)_purple_conversations_hconv_equal,
@@ -2752,6 +2784,17 @@ purple_conversations_init(void)
 			     purple_value_new(PURPLE_TYPE_SUBTYPE,
 					    PURPLE_SUBTYPE_CONVERSATION),
 			     purple_value_new(PURPLE_TYPE_BOXED, "GList **"));
+
+	for (i = 0; i < PURPLE_CONV_SIGNAL_LAST; i++)
+		conv_signals[i] = purple_signal_resolve(handle, conv_signal_names[i]);
+}
+
+PurpleSignal *
+_purple_conversations_get_signal(PurpleConvSignal which)
+{
+	g_return_val_if_fail(which < PURPLE_CONV_SIGNAL_LAST, NULL);
+
+	return conv_signals[which];
 }
 
 void
@@ -2761,5 +2804,6 @@ purple_conversations_uninit(void)
 		purple_conversation_destroy((PurpleConversation*)conversations->data);
 	g_hash_table_destroy(conversation_cache);
 	purple_signals_unregister_by_instance(purple_conversations_get_handle());
+	memset(conv_signals, 0, sizeof(conv_signals));
 }
 
@@ -206,6 +206,7 @@ purple_core_quit(void)
 
 	/* Transmission ends */
 	purple_connections_disconnect_all();
+	_purple_util_fetch_url_close_idle();
 
 	/*
 	 * Certificates must be destroyed before the SSL plugins, because
@@ -261,11 +262,13 @@ purple_core_quit(void)
 #endif
 
 	purple_cmds_uninit();
+	/* The log code saves its indexes when it is uninitialized */
+	purple_log_uninit();
 	/* Everything after util_uninit cannot try to write things to the confdir */
 	purple_util_uninit();
-	purple_log_uninit();
 
 	purple_signals_uninit();
+	purple_debug_uninit();
 
 	g_free(core->ui);
 	g_free(core);
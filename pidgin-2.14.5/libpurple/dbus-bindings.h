@@ -105,6 +105,14 @@ typedef struct {
 
 void purple_dbus_register_bindings(void *handle, PurpleDBusBinding *bindings);
 
+/**
+ * Removes all the bindings registered with a handle.  This is done for
+ * plugins when they are unloaded.
+ *
+ * @since 2.14.6
+ */
+void purple_dbus_unregister_bindings(void *handle);
+
 DBusConnection *purple_dbus_get_connection(void);
 
 #ifdef __cplusplus
@@ -20,6 +20,7 @@
     purple_dbus_register_pointer(typed_ptr, PURPLE_DBUS_TYPE(type));	\
 }
 #define PURPLE_DBUS_UNREGISTER_POINTER(ptr) purple_dbus_unregister_pointer(ptr)
+#define PURPLE_DBUS_UNREGISTER_BINDINGS(handle) purple_dbus_unregister_bindings(handle)
 
 #else  /* !HAVE_DBUS */
 
@@ -28,6 +29,7 @@
 }
 
 #define PURPLE_DBUS_UNREGISTER_POINTER(ptr)
+#define PURPLE_DBUS_UNREGISTER_BINDINGS(handle)
 #define DBUS_EXPORT
 
 #endif	/* HAVE_DBUS */
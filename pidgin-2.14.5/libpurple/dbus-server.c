@@ -44,6 +44,7 @@
 #include "dbus-bindings.h"
 #include "debug.h"
 #include "core.h"
+#include "prefs.h"
 #include "savedstatuses.h"
 #include "smiley.h"
 #include "util.h"
@@ -64,13 +65,27 @@
 #include "dbus-types.c"
 
 /*
- * The following three hashtables map are used to translate between
- * pointers (nodes) and the corresponding handles (ids).
+ * Handles are resolved to pointers through a slab of slots indexed by the
+ * lower bits of the id; the upper bits hold a generation counter that is
+ * bumped whenever a slot is released, so that a stale handle does not
+ * resolve to a new object reusing the slot.  Released slots are chained
+ * in a free list.  The reverse direction uses a single hashtable.
  */
 
+#define DBUS_ID_SLOT_BITS 22
+#define DBUS_ID_SLOT_MASK ((1 << DBUS_ID_SLOT_BITS) - 1)
+#define DBUS_ID_GENERATION_MASK 0x1ff
+
+typedef struct {
+	gpointer node;           /* NULL if the slot is free */
+	PurpleDBusType *type;
+	guint generation;
+	guint next_free;         /* Next free slot, 0 terminates the list */
+} PurpleDBusSlot;
+
 static GHashTable *map_node_id;
-static GHashTable *map_id_node;
-static GHashTable *map_id_type;
+static GArray *id_slots;
+static guint id_free_slot;
 
 static gchar *init_error;
 static int dbus_request_name_reply = DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER;
@@ -82,43 +97,90 @@ gboolean purple_dbus_is_owner(void)
 
 /**
  * This function initializes the pointer-id traslation system.  It
- * creates the three above hashtables and defines parents of some types.
+ * creates the above tables and defines parents of some types.
  */
 void
 purple_dbus_init_ids(void)
 {
-	map_id_node = g_hash_table_new(g_direct_hash, g_direct_equal);
-	map_id_type = g_hash_table_new(g_direct_hash, g_direct_equal);
+	PurpleDBusSlot unused = { NULL, NULL, 0, 0 };
+
 	map_node_id = g_hash_table_new(g_direct_hash, g_direct_equal);
 
+	/* Slot 0 is never handed out, so that 0 keeps meaning NULL */
+	id_slots = g_array_sized_new(FALSE, FALSE, sizeof(PurpleDBusSlot), 1024);
+	g_array_append_val(id_slots, unused);
+	id_free_slot = 0;
+
 	PURPLE_DBUS_TYPE(PurpleBuddy)->parent   = PURPLE_DBUS_TYPE(PurpleBlistNode);
 	PURPLE_DBUS_TYPE(PurpleContact)->parent = PURPLE_DBUS_TYPE(PurpleBlistNode);
 	PURPLE_DBUS_TYPE(PurpleChat)->parent    = PURPLE_DBUS_TYPE(PurpleBlistNode);
 	PURPLE_DBUS_TYPE(PurpleGroup)->parent   = PURPLE_DBUS_TYPE(PurpleBlistNode);
 }
 
+static PurpleDBusSlot *
+purple_dbus_id_to_slot(gint id)
+{
+	PurpleDBusSlot *slot;
+	guint index = id & DBUS_ID_SLOT_MASK;
+
+	if (id_slots == NULL || id <= 0 || index >= id_slots->len)
+		return NULL;
+
+	slot = &g_array_index(id_slots, PurpleDBusSlot, index);
+	if (slot->node == NULL ||
+			slot->generation != ((guint)id >> DBUS_ID_SLOT_BITS))
+		return NULL;
+
+	return slot;
+}
+
 void
 purple_dbus_register_pointer(gpointer node, PurpleDBusType *type)
 {
-	static gint last_id = 0;
+	PurpleDBusSlot *slot;
+	guint index;
 
 	g_return_if_fail(map_node_id);
 	g_return_if_fail(g_hash_table_lookup(map_node_id, node) == NULL);
 
-	last_id++;
-	g_hash_table_insert(map_node_id, node, GINT_TO_POINTER(last_id));
-	g_hash_table_insert(map_id_node, GINT_TO_POINTER(last_id), node);
-	g_hash_table_insert(map_id_type, GINT_TO_POINTER(last_id), type);
+	if (id_free_slot != 0) {
+		index = id_free_slot;
+		slot = &g_array_index(id_slots, PurpleDBusSlot, index);
+		id_free_slot = slot->next_free;
+	} else {
+		PurpleDBusSlot empty = { NULL, NULL, 0, 0 };
+
+		index = id_slots->len;
+		g_return_if_fail(index <= DBUS_ID_SLOT_MASK);
+
+		g_array_append_val(id_slots, empty);
+		slot = &g_array_index(id_slots, PurpleDBusSlot, index);
+	}
+
+	slot->node = node;
+	slot->type = type;
+	slot->next_free = 0;
+
+	g_hash_table_insert(map_node_id, node,
+			GINT_TO_POINTER((slot->generation << DBUS_ID_SLOT_BITS) | index));
 }
 
 void
 purple_dbus_unregister_pointer(gpointer node)
 {
-	gpointer id = g_hash_table_lookup(map_node_id, node);
+	gint id = GPOINTER_TO_INT(g_hash_table_lookup(map_node_id, node));
+	PurpleDBusSlot *slot = purple_dbus_id_to_slot(id);
 
 	g_hash_table_remove(map_node_id, node);
-	g_hash_table_remove(map_id_node, GINT_TO_POINTER(id));
-	g_hash_table_remove(map_id_type, GINT_TO_POINTER(id));
+
+	if (slot == NULL)
+		return;
+
+	slot->node = NULL;
+	slot->type = NULL;
+	slot->generation = (slot->generation + 1) & DBUS_ID_GENERATION_MASK;
+	slot->next_free = id_free_slot;
+	id_free_slot = id & DBUS_ID_SLOT_MASK;
 }
 
 gint
@@ -139,16 +201,20 @@ purple_dbus_pointer_to_id(gconstpointer node)
 gpointer
 purple_dbus_id_to_pointer(gint id, PurpleDBusType *type)
 {
+	PurpleDBusSlot *slot;
 	PurpleDBusType *objtype;
 
-	objtype = (PurpleDBusType*)g_hash_table_lookup(map_id_type,
-			GINT_TO_POINTER(id));
+	slot = purple_dbus_id_to_slot(id);
+	if (slot == NULL)
+		return NULL;
+
+	objtype = slot->type;
 
 	while (objtype != type && objtype != NULL)
 		objtype = objtype->parent;
 
 	if (objtype == type)
-		return g_hash_table_lookup(map_id_node, GINT_TO_POINTER(id));
+		return slot->node;
 	else
 		return NULL;
 }
@@ -417,6 +483,52 @@ error:
 
 static DBusConnection *purple_dbus_connection;
 
+/*
+ * Maps each registered PurpleDBusBinding array to a hash table indexing
+ * its entries by method name, so a method call is resolved with a single
+ * lookup per binding set instead of a strcmp over every exported method.
+ * An array may be registered with more than one handle, so the index
+ * counts its registrations and goes away with the last of them.
+ */
+typedef struct
+{
+	GHashTable *methods;
+	guint registrations;
+} PurpleDBusBindingsIndex;
+
+static GHashTable *map_bindings_index;
+
+/* Maps each handle to the GSList of binding arrays registered with it */
+static GHashTable *map_handle_bindings;
+
+/*
+ * D-Bus side state of the purple signals.  signal_info_by_name caches the
+ * converted name of each purple signal, so emitting one does not allocate,
+ * and signal_info_by_dbus_name owns the entries.  Clients that call
+ * PurpleDBusSubscribeSignal are tracked in signal_subscriptions, mapping
+ * their unique bus name to the set of entries they subscribed to.
+ */
+typedef struct
+{
+	char *dbus_name;
+	guint subscribers;
+} PurpleDBusSignalInfo;
+
+/* The match rule for the bus telling us about names changing owners */
+#define NAME_OWNER_CHANGED_MATCH \
+	"type='signal',sender='" DBUS_SERVICE_DBUS "'," \
+	"interface='" DBUS_INTERFACE_DBUS "',member='NameOwnerChanged'"
+
+static GHashTable *signal_info_by_name;
+static GHashTable *signal_info_by_dbus_name;
+static GHashTable *signal_subscriptions;
+static gboolean signals_on_demand;
+
+static PurpleDBusSignalInfo *purple_dbus_signal_info(const char *dbus_name);
+static gboolean purple_dbus_signal_has_dbus_name(gpointer key, gpointer value,
+		gpointer user_data);
+static void purple_dbus_signal_unsubscribe_all(const char *sender);
+
 DBusConnection *
 purple_dbus_get_connection(void)
 {
@@ -431,10 +543,10 @@ purple_dbus_dispatch_cb(DBusConnection *connection,
 		DBusMessage *message, void *user_data)
 {
 	const char *name;
-	PurpleDBusBinding *bindings;
-	int i;
+	PurpleDBusBinding *binding;
+	PurpleDBusBindingsIndex *index;
 
-	bindings = (PurpleDBusBinding*) user_data;
+	index = (PurpleDBusBindingsIndex*) user_data;
 
 	if (!dbus_message_has_path(message, DBUS_PATH_PURPLE))
 		return FALSE;
@@ -447,32 +559,87 @@ purple_dbus_dispatch_cb(DBusConnection *connection,
 	if (dbus_message_get_type(message) != DBUS_MESSAGE_TYPE_METHOD_CALL)
 		return FALSE;
 
-	for (i = 0; bindings[i].name; i++)
-		if (purple_strequal(name, bindings[i].name))
-		{
-			DBusMessage *reply;
-			DBusError error;
+	binding = g_hash_table_lookup(index->methods, name);
+	if (binding != NULL)
+	{
+		DBusMessage *reply;
+		DBusError error;
 
-			dbus_error_init(&error);
+		dbus_error_init(&error);
 
-			reply = bindings[i].handler(message, &error);
+		reply = binding->handler(message, &error);
 
-			if (reply == NULL && dbus_error_is_set(&error))
-				reply = dbus_message_new_error (message,
-						error.name, error.message);
+		if (reply == NULL && dbus_error_is_set(&error))
+			reply = dbus_message_new_error (message,
+					error.name, error.message);
 
-			if (reply != NULL)
-			{
-				dbus_connection_send(connection, reply, NULL);
-				dbus_message_unref(reply);
-			}
-
-			return TRUE; /* return reply! */
+		if (reply != NULL)
+		{
+			dbus_connection_send(connection, reply, NULL);
+			dbus_message_unref(reply);
 		}
 
+		return TRUE; /* return reply! */
+	}
+
 	return FALSE;
 }
 
+static void
+purple_dbus_bindings_index_free(PurpleDBusBindingsIndex *index)
+{
+	g_hash_table_destroy(index->methods);
+	g_free(index);
+}
+
+static PurpleDBusBindingsIndex *
+purple_dbus_bindings_index_ref(PurpleDBusBinding *bindings)
+{
+	PurpleDBusBindingsIndex *index;
+	int i;
+
+	if (map_bindings_index == NULL)
+		map_bindings_index = g_hash_table_new_full(g_direct_hash,
+				g_direct_equal, NULL,
+				(GDestroyNotify)purple_dbus_bindings_index_free);
+
+	index = g_hash_table_lookup(map_bindings_index, bindings);
+	if (index != NULL)
+	{
+		index->registrations++;
+		return index;
+	}
+
+	/* The names are static strings owned by the bindings array */
+	index = g_new0(PurpleDBusBindingsIndex, 1);
+	index->methods = g_hash_table_new(g_str_hash, g_str_equal);
+	index->registrations = 1;
+	for (i = 0; bindings[i].name; i++)
+	{
+		/* Keep the first entry for a name, as the linear scan used to */
+		if (g_hash_table_lookup(index->methods, bindings[i].name) == NULL)
+			g_hash_table_insert(index->methods, (gpointer)bindings[i].name,
+					&bindings[i]);
+	}
+
+	g_hash_table_insert(map_bindings_index, bindings, index);
+
+	return index;
+}
+
+static void
+purple_dbus_bindings_index_unref(PurpleDBusBinding *bindings)
+{
+	PurpleDBusBindingsIndex *index;
+
+	if (map_bindings_index == NULL)
+		return;
+
+	index = g_hash_table_lookup(map_bindings_index, bindings);
+	if (index != NULL && --index->registrations == 0)
+		g_hash_table_remove(map_bindings_index, bindings);
+}
+
 
 static const char *
 dbus_gettext(const char **ptr)
@@ -586,16 +753,374 @@ purple_dbus_dispatch(DBusConnection *connection,
 void
 purple_dbus_register_bindings(void *handle, PurpleDBusBinding *bindings)
 {
+	GSList *list;
+
+	if (map_handle_bindings == NULL)
+		map_handle_bindings = g_hash_table_new_full(g_direct_hash,
+				g_direct_equal, NULL, (GDestroyNotify)g_slist_free);
+
+	list = g_hash_table_lookup(map_handle_bindings, handle);
+	g_hash_table_steal(map_handle_bindings, handle);
+	g_hash_table_insert(map_handle_bindings, handle,
+			g_slist_prepend(list, bindings));
+
 	purple_signal_connect(purple_dbus_get_handle(), "dbus-method-called",
 			handle,
 			PURPLE_CALLBACK(purple_dbus_dispatch_cb),
-			bindings);
+			purple_dbus_bindings_index_ref(bindings));
 	purple_signal_connect(purple_dbus_get_handle(), "dbus-introspect",
 			handle,
 			PURPLE_CALLBACK(purple_dbus_introspect_cb),
 			bindings);
 }
 
+void
+purple_dbus_unregister_bindings(void *handle)
+{
+	GSList *list, *l;
+
+	if (map_handle_bindings == NULL ||
+			(list = g_hash_table_lookup(map_handle_bindings, handle)) == NULL)
+		return;
+
+	/* The arrays may go away with the plugin, so must their indexes */
+	for (l = list; l != NULL; l = l->next)
+	{
+		purple_dbus_bindings_index_unref(l->data);
+
+		/* Without a server the signals were never there to connect to */
+		if (init_error != NULL)
+			continue;
+
+		purple_signal_disconnect(purple_dbus_get_handle(), "dbus-method-called",
+				handle, PURPLE_CALLBACK(purple_dbus_dispatch_cb));
+		purple_signal_disconnect(purple_dbus_get_handle(), "dbus-introspect",
+				handle, PURPLE_CALLBACK(purple_dbus_introspect_cb));
+	}
+
+	g_hash_table_remove(map_handle_bindings, handle);
+}
+
+/*
+ * Copies the value under the iterator "from", including any container
+ * contents, to the end of the message being built with "to".
+ */
+static void
+purple_dbus_iter_copy_value(DBusMessageIter *from, DBusMessageIter *to)
+{
+	int type = dbus_message_iter_get_arg_type(from);
+
+	if (TYPE_IS_CONTAINER(type))
+	{
+		DBusMessageIter subfrom, subto;
+		char *signature = NULL;
+
+		dbus_message_iter_recurse(from, &subfrom);
+		if (type == DBUS_TYPE_ARRAY || type == DBUS_TYPE_VARIANT)
+			signature = dbus_message_iter_get_signature(&subfrom);
+
+		dbus_message_iter_open_container(to, type, signature, &subto);
+		while (dbus_message_iter_get_arg_type(&subfrom) != DBUS_TYPE_INVALID)
+		{
+			purple_dbus_iter_copy_value(&subfrom, &subto);
+			dbus_message_iter_next(&subfrom);
+		}
+		dbus_message_iter_close_container(to, &subto);
+
+		dbus_free(signature);
+	}
+	else
+	{
+		/* Large enough for any basic type, strings are pointers */
+		union {
+			dbus_uint64_t u64;
+			double dbl;
+			const char *str;
+		} value;
+
+		dbus_message_iter_get_basic(from, &value);
+		dbus_message_iter_append_basic(to, type, &value);
+	}
+}
+
+static PurpleDBusBinding *
+purple_dbus_find_binding(GList *bindings_list, const char *name)
+{
+	if (map_bindings_index == NULL)
+		return NULL;
+
+	for (; bindings_list; bindings_list = bindings_list->next)
+	{
+		PurpleDBusBindingsIndex *index;
+		PurpleDBusBinding *binding;
+
+		/* Every array handed out by "dbus-introspect" is registered */
+		index = g_hash_table_lookup(map_bindings_index, bindings_list->data);
+		if (index == NULL)
+			continue;
+
+		binding = g_hash_table_lookup(index->methods, name);
+		if (binding != NULL)
+			return binding;
+	}
+
+	return NULL;
+}
+
+/*
+ * Runs a single call of a PurpleBatch request.  "call" points at the
+ * (sav) struct of the request; the (sav) reply struct is appended to
+ * "replies".  The reply string is empty on success and holds the D-Bus
+ * error name otherwise, in which case the array carries the error text.
+ */
+static void
+purple_dbus_batch_call(DBusMessage *batch, GList *bindings_list,
+		DBusMessageIter *call, DBusMessageIter *replies)
+{
+	DBusMessageIter args, reply_struct, reply_args;
+	DBusMessage *request, *reply = NULL;
+	DBusError error;
+	const char *method, *error_name = "", *error_message;
+	PurpleDBusBinding *binding;
+
+	dbus_error_init(&error);
+
+	dbus_message_iter_get_basic(call, &method);
+	dbus_message_iter_next(call);
+
+	binding = purple_dbus_find_binding(bindings_list, method);
+	if (binding == NULL)
+	{
+		dbus_set_error(&error, DBUS_ERROR_UNKNOWN_METHOD,
+				"Unknown method \"%s\"", method);
+	}
+	else
+	{
+		DBusMessageIter append, variant;
+
+		/* The handlers only ever see a regular method call */
+		request = dbus_message_new_method_call(NULL, DBUS_PATH_PURPLE,
+				DBUS_INTERFACE_PURPLE, method);
+		dbus_message_set_serial(request, dbus_message_get_serial(batch));
+		dbus_message_set_sender(request, dbus_message_get_sender(batch));
+
+		dbus_message_iter_init_append(request, &append);
+		dbus_message_iter_recurse(call, &args);
+		while (dbus_message_iter_get_arg_type(&args) == DBUS_TYPE_VARIANT)
+		{
+			dbus_message_iter_recurse(&args, &variant);
+			purple_dbus_iter_copy_value(&variant, &append);
+			dbus_message_iter_next(&args);
+		}
+
+		reply = binding->handler(request, &error);
+		dbus_message_unref(request);
+	}
+
+	if (reply == NULL && !dbus_error_is_set(&error))
+		dbus_set_error(&error, DBUS_ERROR_FAILED,
+				"Method \"%s\" returned no reply", method);
+
+	dbus_message_iter_open_container(replies, DBUS_TYPE_STRUCT, NULL, &reply_struct);
+
+	if (dbus_error_is_set(&error))
+	{
+		DBusMessageIter variant;
+
+		error_name = error.name;
+		error_message = null_to_empty(error.message);
+
+		dbus_message_iter_append_basic(&reply_struct, DBUS_TYPE_STRING, &error_name);
+		dbus_message_iter_open_container(&reply_struct, DBUS_TYPE_ARRAY,
+				DBUS_TYPE_VARIANT_AS_STRING, &reply_args);
+		dbus_message_iter_open_container(&reply_args, DBUS_TYPE_VARIANT,
+				DBUS_TYPE_STRING_AS_STRING, &variant);
+		dbus_message_iter_append_basic(&variant, DBUS_TYPE_STRING, &error_message);
+		dbus_message_iter_close_container(&reply_args, &variant);
+	}
+	else
+	{
+		DBusMessageIter result;
+
+		dbus_message_iter_append_basic(&reply_struct, DBUS_TYPE_STRING, &error_name);
+		dbus_message_iter_open_container(&reply_struct, DBUS_TYPE_ARRAY,
+				DBUS_TYPE_VARIANT_AS_STRING, &reply_args);
+
+		if (dbus_message_iter_init(reply, &result))
+		{
+			do {
+				DBusMessageIter variant;
+				char *signature = dbus_message_iter_get_signature(&result);
+
+				dbus_message_iter_open_container(&reply_args, DBUS_TYPE_VARIANT,
+						signature, &variant);
+				purple_dbus_iter_copy_value(&result, &variant);
+				dbus_message_iter_close_container(&reply_args, &variant);
+				dbus_free(signature);
+			} while (dbus_message_iter_next(&result));
+		}
+	}
+
+	dbus_message_iter_close_container(&reply_struct, &reply_args);
+	dbus_message_iter_close_container(replies, &reply_struct);
+
+	if (reply != NULL)
+		dbus_message_unref(reply);
+	dbus_error_free(&error);
+}
+
+/*
+ * PurpleBatch runs an array of (method, arguments) calls through the
+ * registered bindings in one go, so clients that need many small queries
+ * pay for a single round trip.
+ */
+static DBusMessage *
+purple_dbus_batch(DBusMessage *message, DBusError *error)
+{
+	DBusMessage *reply;
+	DBusMessageIter iter, calls, append, replies;
+	GList *bindings_list = NULL;
+
+	if (!dbus_message_iter_init(message, &iter) ||
+			!purple_strequal(dbus_message_get_signature(message), "a(sav)"))
+	{
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				"PurpleBatch expects a single argument of type a(sav)");
+		return NULL;
+	}
+
+	purple_signal_emit(purple_dbus_get_handle(), "dbus-introspect", &bindings_list);
+	/* Match the order in which "dbus-method-called" tries the bindings */
+	bindings_list = g_list_reverse(bindings_list);
+
+	reply = dbus_message_new_method_return(message);
+	dbus_message_iter_init_append(reply, &append);
+	dbus_message_iter_open_container(&append, DBUS_TYPE_ARRAY, "(sav)", &replies);
+
+	dbus_message_iter_recurse(&iter, &calls);
+	while (dbus_message_iter_get_arg_type(&calls) == DBUS_TYPE_STRUCT)
+	{
+		DBusMessageIter call;
+
+		dbus_message_iter_recurse(&calls, &call);
+		purple_dbus_batch_call(message, bindings_list, &call, &replies);
+		dbus_message_iter_next(&calls);
+	}
+
+	dbus_message_iter_close_container(&append, &replies);
+	g_list_free(bindings_list);
+
+	return reply;
+}
+
+static DBusMessage *
+purple_dbus_subscribe_signal(DBusMessage *message, DBusError *error)
+{
+	const char *sender = dbus_message_get_sender(message);
+	const char *name;
+	GHashTable *subscribed;
+	PurpleDBusSignalInfo *info;
+
+	if (!dbus_message_get_args(message, error,
+			DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID))
+		return NULL;
+
+	if (sender == NULL)
+	{
+		dbus_set_error(error, DBUS_ERROR_FAILED,
+				"Signal subscriptions need a sender");
+		return NULL;
+	}
+
+	/* Don't let clients fill our tables with names of their choosing */
+	if (g_hash_table_lookup(signal_info_by_dbus_name, name) == NULL &&
+			!_purple_signals_find_dbus_exported(purple_dbus_signal_has_dbus_name,
+				(gpointer)name))
+	{
+		dbus_set_error(error, DBUS_ERROR_INVALID_ARGS,
+				"No signal named %s", name);
+		return NULL;
+	}
+
+	if (signal_subscriptions == NULL)
+	{
+		/* Learn about clients leaving the bus, to drop what they left */
+		dbus_bus_add_match(purple_dbus_connection,
+				NAME_OWNER_CHANGED_MATCH, NULL);
+		signal_subscriptions = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, (GDestroyNotify)g_hash_table_destroy);
+	}
+
+	subscribed = g_hash_table_lookup(signal_subscriptions, sender);
+	if (subscribed == NULL)
+	{
+		subscribed = g_hash_table_new(g_direct_hash, g_direct_equal);
+		g_hash_table_insert(signal_subscriptions, g_strdup(sender), subscribed);
+	}
+
+	info = purple_dbus_signal_info(name);
+	if (g_hash_table_lookup(subscribed, info) == NULL)
+	{
+		g_hash_table_insert(subscribed, info, info);
+		info->subscribers++;
+	}
+
+	return dbus_message_new_method_return(message);
+}
+
+static DBusMessage *
+purple_dbus_unsubscribe_signal(DBusMessage *message, DBusError *error)
+{
+	const char *sender = dbus_message_get_sender(message);
+	const char *name;
+	GHashTable *subscribed = NULL;
+	PurpleDBusSignalInfo *info;
+
+	if (!dbus_message_get_args(message, error,
+			DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID))
+		return NULL;
+
+	if (sender != NULL && signal_subscriptions != NULL)
+		subscribed = g_hash_table_lookup(signal_subscriptions, sender);
+
+	if (subscribed != NULL)
+	{
+		info = g_hash_table_lookup(signal_info_by_dbus_name, name);
+		if (info != NULL && g_hash_table_remove(subscribed, info))
+			info->subscribers--;
+
+		if (g_hash_table_size(subscribed) == 0)
+			g_hash_table_remove(signal_subscriptions, sender);
+	}
+
+	return dbus_message_new_method_return(message);
+}
+
+static DBusHandlerResult
+purple_dbus_filter(DBusConnection *connection, DBusMessage *message,
+		void *user_data)
+{
+	const char *name, *old_owner, *new_owner;
+
+	if (dbus_message_is_signal(message, DBUS_INTERFACE_DBUS, "NameOwnerChanged") &&
+			dbus_message_get_args(message, NULL,
+				DBUS_TYPE_STRING, &name,
+				DBUS_TYPE_STRING, &old_owner,
+				DBUS_TYPE_STRING, &new_owner,
+				DBUS_TYPE_INVALID) &&
+			*new_owner == '\0')
+		purple_dbus_signal_unsubscribe_all(name);
+
+	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static PurpleDBusBinding batch_bindings_DBUS[] = {
+	{"PurpleBatch", "in\0a(sav)\0calls\0out\0a(sav)\0replies\0", purple_dbus_batch},
+	{"PurpleDBusSubscribeSignal", "in\0s\0signal\0", purple_dbus_subscribe_signal},
+	{"PurpleDBusUnsubscribeSignal", "in\0s\0signal\0", purple_dbus_unsubscribe_signal},
+	{NULL, NULL, NULL}
+};
+
 static void
 purple_dbus_dispatch_init(void)
 {
@@ -637,6 +1162,8 @@ purple_dbus_dispatch_init(void)
 	}
 
 	dbus_connection_setup_with_g_main(purple_dbus_connection, NULL);
+	dbus_connection_add_filter(purple_dbus_connection, purple_dbus_filter,
+			NULL, NULL);
 
 	purple_debug_misc("dbus", "okkk\n");
 
@@ -645,12 +1172,15 @@ purple_dbus_dispatch_init(void)
 			 purple_value_new(PURPLE_TYPE_BOOLEAN), 2,
 			 purple_value_new(PURPLE_TYPE_POINTER),
 			 purple_value_new(PURPLE_TYPE_POINTER));
+	purple_signal_set_dbus_exported(purple_dbus_get_handle(),
+			"dbus-method-called", FALSE);
 
 	purple_signal_register(purple_dbus_get_handle(), "dbus-introspect",
 			 purple_marshal_VOID__POINTER, NULL, 1,
 			 purple_value_new_outgoing(PURPLE_TYPE_POINTER));
 
 	PURPLE_DBUS_REGISTER_BINDINGS(purple_dbus_get_handle());
+	purple_dbus_register_bindings(purple_dbus_get_handle(), batch_bindings_DBUS);
 }
 
 
@@ -684,6 +1214,86 @@ purple_dbus_convert_signal_name(const char *purple_name)
 	return g_name;
 }
 
+static PurpleDBusSignalInfo *
+purple_dbus_signal_info(const char *dbus_name)
+{
+	PurpleDBusSignalInfo *info;
+
+	info = g_hash_table_lookup(signal_info_by_dbus_name, dbus_name);
+	if (info == NULL)
+	{
+		info = g_new0(PurpleDBusSignalInfo, 1);
+		info->dbus_name = g_strdup(dbus_name);
+		g_hash_table_insert(signal_info_by_dbus_name, info->dbus_name, info);
+	}
+
+	return info;
+}
+
+static PurpleDBusSignalInfo *
+purple_dbus_signal_info_for_purple_name(const char *name)
+{
+	PurpleDBusSignalInfo *info;
+
+	info = g_hash_table_lookup(signal_info_by_name, name);
+	if (info == NULL)
+	{
+		char *dbus_name = purple_dbus_convert_signal_name(name);
+		info = purple_dbus_signal_info(dbus_name);
+		g_free(dbus_name);
+		g_hash_table_insert(signal_info_by_name, g_strdup(name), info);
+	}
+
+	return info;
+}
+
+static gboolean
+purple_dbus_signal_has_dbus_name(gpointer key, gpointer value, gpointer user_data)
+{
+	PurpleDBusSignalInfo *info = purple_dbus_signal_info_for_purple_name(key);
+
+	return purple_strequal(info->dbus_name, user_data);
+}
+
+static void
+purple_dbus_signal_info_free(PurpleDBusSignalInfo *info)
+{
+	g_free(info->dbus_name);
+	g_free(info);
+}
+
+static void
+purple_dbus_signal_unsubscribe_one(gpointer key, gpointer value,
+		gpointer user_data)
+{
+	PurpleDBusSignalInfo *info = value;
+
+	info->subscribers--;
+}
+
+static void
+purple_dbus_signal_unsubscribe_all(const char *sender)
+{
+	GHashTable *subscribed;
+
+	if (signal_subscriptions == NULL)
+		return;
+
+	subscribed = g_hash_table_lookup(signal_subscriptions, sender);
+	if (subscribed == NULL)
+		return;
+
+	g_hash_table_foreach(subscribed, purple_dbus_signal_unsubscribe_one, NULL);
+	g_hash_table_remove(signal_subscriptions, sender);
+}
+
+static void
+purple_dbus_signals_on_demand_cb(const char *name, PurplePrefType type,
+		gconstpointer value, gpointer data)
+{
+	signals_on_demand = GPOINTER_TO_INT(value);
+}
+
 #define my_arg(type) (ptr != NULL ? * ((type *)ptr) : va_arg(data, type))
 
 static gboolean
@@ -772,7 +1382,7 @@ purple_dbus_signal_emit_purple(const char *name, int num_values,
 {
 	DBusMessage *signal;
 	DBusMessageIter iter;
-	char *newname;
+	PurpleDBusSignalInfo *info;
 
 #if 0 /* this is noisy with no dbus connection */
 	g_return_if_fail(purple_dbus_connection);
@@ -781,18 +1391,13 @@ purple_dbus_signal_emit_purple(const char *name, int num_values,
 		return;
 #endif
 
+	info = purple_dbus_signal_info_for_purple_name(name);
 
-	/*
-	 * The test below is a hack that prevents our "dbus-method-called"
-	 * signal from being propagated to dbus.  What we really need is a
-	 * flag for each signal that states whether this signal is to be
-	 * dbus-propagated or not.
-	 */
-	if (purple_strequal(name, "dbus-method-called"))
+	/* Nobody asked for it, so don't bother marshalling it */
+	if (signals_on_demand && info->subscribers == 0)
 		return;
 
-	newname = purple_dbus_convert_signal_name(name);
-	signal = dbus_message_new_signal(DBUS_PATH_PURPLE, DBUS_INTERFACE_PURPLE, newname);
+	signal = dbus_message_new_signal(DBUS_PATH_PURPLE, DBUS_INTERFACE_PURPLE, info->dbus_name);
 	dbus_message_iter_init_append(signal, &iter);
 
 	if (purple_dbus_message_append_purple_values(&iter, num_values, values, vargs))
@@ -804,7 +1409,6 @@ purple_dbus_signal_emit_purple(const char *name, int num_values,
 
 	dbus_connection_send(purple_dbus_connection, signal, NULL);
 
-	g_free(newname);
 	dbus_message_unref(signal);
 }
 
@@ -830,6 +1434,18 @@ purple_dbus_init(void)
 
 	purple_dbus_init_ids();
 
+	signal_info_by_name = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, NULL);
+	signal_info_by_dbus_name = g_hash_table_new_full(g_str_hash, g_str_equal,
+			NULL, (GDestroyNotify)purple_dbus_signal_info_free);
+
+	purple_prefs_add_none("/purple/dbus");
+	purple_prefs_add_bool("/purple/dbus/signals_on_demand", FALSE);
+	signals_on_demand = purple_prefs_get_bool("/purple/dbus/signals_on_demand");
+	purple_prefs_connect_callback(purple_dbus_get_handle(),
+			"/purple/dbus/signals_on_demand",
+			purple_dbus_signals_on_demand_cb, NULL);
+
 	g_free(init_error);
 	init_error = NULL;
 	purple_dbus_dispatch_init();
@@ -841,10 +1457,34 @@ void
 purple_dbus_uninit(void)
 {
 	DBusError error;
+
+	purple_prefs_disconnect_by_handle(purple_dbus_get_handle());
+
+	if (signal_subscriptions != NULL) {
+		if (purple_dbus_connection != NULL)
+			dbus_bus_remove_match(purple_dbus_connection,
+					NAME_OWNER_CHANGED_MATCH, NULL);
+		g_hash_table_destroy(signal_subscriptions);
+		signal_subscriptions = NULL;
+	}
+	g_hash_table_destroy(signal_info_by_name);
+	signal_info_by_name = NULL;
+	g_hash_table_destroy(signal_info_by_dbus_name);
+	signal_info_by_dbus_name = NULL;
+	if (map_bindings_index != NULL) {
+		g_hash_table_destroy(map_bindings_index);
+		map_bindings_index = NULL;
+	}
+	if (map_handle_bindings != NULL) {
+		g_hash_table_destroy(map_handle_bindings);
+		map_handle_bindings = NULL;
+	}
+
 	if (!purple_dbus_connection)
 		return;
 
 	dbus_error_init(&error);
+	dbus_connection_remove_filter(purple_dbus_connection, purple_dbus_filter, NULL);
 	dbus_connection_unregister_object_path(purple_dbus_connection, DBUS_PATH_PURPLE);
 	dbus_bus_release_name(purple_dbus_connection, DBUS_SERVICE_PURPLE, &error);
 	dbus_error_free(&error);
@@ -50,6 +50,98 @@ static gboolean debug_enabled = FALSE;
 static gboolean debug_verbose = FALSE;
 static gboolean debug_unsafe = FALSE;
 
+/* Categories whose output is dropped before it is even formatted */
+static GHashTable *muted_categories = NULL;
+
+/*
+ * The debug ring keeps the last messages in memory, so debug traffic can
+ * be captured under load and looked at later.  Its entries and their text
+ * buffers are reused, so once the ring is warm, recording a message is a
+ * single vsnprintf; timestamps are only turned into text when dumped.
+ */
+#define DEBUG_RING_CATEGORY_SIZE 32
+#define DEBUG_RING_TEXT_SIZE 128
+
+typedef struct
+{
+	time_t time;
+	PurpleDebugLevel level;
+	char category[DEBUG_RING_CATEGORY_SIZE];
+	char *text;
+	gsize text_size;
+} PurpleDebugRingEntry;
+
+static PurpleDebugRingEntry *debug_ring = NULL;
+static guint debug_ring_size = 0;
+static guint debug_ring_next = 0;
+static guint debug_ring_count = 0;
+
+static const char * const debug_level_names[] = {
+	"all", "misc", "info", "warning", "error", "fatal"
+};
+
+static gboolean
+debug_category_is_muted(const char *category)
+{
+	return muted_categories != NULL && category != NULL &&
+		g_hash_table_lookup(muted_categories, category) != NULL;
+}
+
+static PurpleDebugRingEntry *
+debug_ring_next_entry(PurpleDebugLevel level, const char *category)
+{
+	PurpleDebugRingEntry *entry = &debug_ring[debug_ring_next];
+
+	debug_ring_next = (debug_ring_next + 1) % debug_ring_size;
+	if (debug_ring_count < debug_ring_size)
+		debug_ring_count++;
+
+	entry->time = time(NULL);
+	entry->level = level;
+	g_strlcpy(entry->category, category ? category : "",
+			sizeof(entry->category));
+
+	if (entry->text == NULL) {
+		entry->text_size = DEBUG_RING_TEXT_SIZE;
+		entry->text = g_malloc(entry->text_size);
+	}
+
+	return entry;
+}
+
+static void
+debug_ring_append_vprintf(PurpleDebugLevel level, const char *category,
+		const char *format, va_list args)
+{
+	PurpleDebugRingEntry *entry = debug_ring_next_entry(level, category);
+	va_list tmp;
+	gint len;
+
+	G_VA_COPY(tmp, args);
+	len = g_vsnprintf(entry->text, entry->text_size, format, tmp);
+	va_end(tmp);
+
+	if (len >= 0 && (gsize)len >= entry->text_size) {
+		entry->text_size = len + 1;
+		entry->text = g_realloc(entry->text, entry->text_size);
+		g_vsnprintf(entry->text, entry->text_size, format, args);
+	}
+}
+
+static void
+debug_ring_append(PurpleDebugLevel level, const char *category,
+		const char *text)
+{
+	PurpleDebugRingEntry *entry = debug_ring_next_entry(level, category);
+	gsize len = strlen(text);
+
+	if (len >= entry->text_size) {
+		entry->text_size = len + 1;
+		entry->text = g_realloc(entry->text, entry->text_size);
+	}
+	memcpy(entry->text, text, len + 1);
+}
+
 static void
 purple_debug_vargs(PurpleDebugLevel level, const char *category,
 				 const char *format, va_list args)
@@ -60,29 +152,33 @@ purple_debug_vargs(PurpleDebugLevel level, const char *category,
 	g_return_if_fail(level != PURPLE_DEBUG_ALL);
 	g_return_if_fail(format != NULL);
 
+	if (debug_category_is_muted(category))
+		return;
+
 	ops = purple_debug_get_ui_ops();
 
 	if (!debug_enabled && ((ops == NULL) || (ops->print == NULL) ||
-			(ops->is_enabled && !ops->is_enabled(level, category))))
+			(ops->is_enabled && !ops->is_enabled(level, category)))) {
+		if (debug_ring != NULL)
+			debug_ring_append_vprintf(level, category, format, args);
 		return;
+	}
 
 	arg_s = g_strdup_vprintf(format, args);
 
+	if (debug_ring != NULL)
+		debug_ring_append(level, category, arg_s);
+
 	if (debug_enabled) {
-		gchar *ts_s;
 		const char *mdate;
 		time_t mtime = time(NULL);
 
-
 		mdate = purple_utf8_strftime("%H:%M:%S", localtime(&mtime));
-		ts_s = g_strdup_printf("(%s) ", mdate);
 
 		if (category == NULL)
-			g_print("%s%s", ts_s, arg_s);
+			g_print("(%s) %s", mdate, arg_s);
 		else
-			g_print("%s%s: %s", ts_s, category, arg_s);
-
-		g_free(ts_s);
+			g_print("(%s) %s: %s", mdate, category, arg_s);
 	}
 
 	if (ops != NULL && ops->print != NULL)
@@ -91,6 +187,77 @@ purple_debug_vargs(PurpleDebugLevel level, const char *category,
 	g_free(arg_s);
 }
 
+gboolean
+purple_debug_is_active(PurpleDebugLevel level, const char *category)
+{
+	PurpleDebugUiOps *ops = debug_ui_ops;
+
+	if (debug_category_is_muted(category))
+		return FALSE;
+
+	if (debug_enabled || debug_ring != NULL)
+		return TRUE;
+
+	return ops != NULL && ops->print != NULL &&
+		(ops->is_enabled == NULL || ops->is_enabled(level, category));
+}
+
+void
+purple_debug_set_category_enabled(const char *category, gboolean enabled)
+{
+	g_return_if_fail(category != NULL);
+
+	if (enabled) {
+		if (muted_categories != NULL)
+			g_hash_table_remove(muted_categories, category);
+		return;
+	}
+
+	if (muted_categories == NULL)
+		muted_categories = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, NULL);
+	g_hash_table_insert(muted_categories, g_strdup(category),
+			GINT_TO_POINTER(TRUE));
+}
+
+void
+purple_debug_set_ring_size(guint entries)
+{
+	guint i;
+
+	for (i = 0; i < debug_ring_size; i++)
+		g_free(debug_ring[i].text);
+	g_free(debug_ring);
+
+	debug_ring = entries > 0 ? g_new0(PurpleDebugRingEntry, entries) : NULL;
+	debug_ring_size = entries;
+	debug_ring_next = 0;
+	debug_ring_count = 0;
+}
+
+char *
+purple_debug_ring_dump(void)
+{
+	GString *str = g_string_new(NULL);
+	guint i;
+
+	for (i = 0; i < debug_ring_count; i++) {
+		PurpleDebugRingEntry *entry;
+		const char *mdate;
+
+		entry = &debug_ring[(debug_ring_next + debug_ring_size -
+				debug_ring_count + i) % debug_ring_size];
+		mdate = purple_utf8_strftime("%H:%M:%S", localtime(&entry->time));
+
+		g_string_append_printf(str, "(%s) [%s] %s%s%s", mdate,
+				debug_level_names[entry->level], entry->category,
+				*entry->category ? ": " : "",
+				entry->text ? entry->text : "");
+	}
+
+	return g_string_free(str, FALSE);
+}
+
 void
 purple_debug(PurpleDebugLevel level, const char *category,
 		   const char *format, ...)
@@ -223,6 +390,9 @@ purple_debug_init(void)
 	if(g_getenv("PURPLE_VERBOSE_DEBUG"))
 		purple_debug_set_verbose(TRUE);
 
+	if(g_getenv("PURPLE_DEBUG_RING") && atoi(g_getenv("PURPLE_DEBUG_RING")) > 0)
+		purple_debug_set_ring_size(atoi(g_getenv("PURPLE_DEBUG_RING")));
+
 	purple_prefs_add_none("/purple/debug");
 
 	/*
@@ -233,3 +403,14 @@ purple_debug_init(void)
 	purple_prefs_add_bool("/purple/debug/timestamps", TRUE);
 }
 
+void
+purple_debug_uninit(void)
+{
+	purple_debug_set_ring_size(0);
+
+	if (muted_categories != NULL) {
+		g_hash_table_destroy(muted_categories);
+		muted_categories = NULL;
+	}
+}
+
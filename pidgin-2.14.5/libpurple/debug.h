@@ -141,6 +141,57 @@ void purple_debug_error(const char *category, const char *format, ...) G_GNUC_PR
  */
 void purple_debug_fatal(const char *category, const char *format, ...) G_GNUC_PRINTF(2, 3);
 
+/**
+ * Checks whether debug output of a level and category would go anywhere.
+ *
+ * Callers that build expensive arguments for a debug message (copies,
+ * escaped or serialized data) should check this first and skip the
+ * work when it returns FALSE.
+ *
+ * @param level    The debug level.
+ * @param category The category (or @c NULL).
+ *
+ * @return TRUE if a message would be printed or recorded.
+ *
+ * @since 2.14.6
+ */
+gboolean purple_debug_is_active(PurpleDebugLevel level, const char *category);
+
+/**
+ * Enable or disable all debug output of a category.  Messages of a
+ * disabled category are dropped before they are formatted.  Categories
+ * are enabled by default.
+ *
+ * @param category The category.
+ * @param enabled  TRUE to enable the category or FALSE to disable it.
+ *
+ * @since 2.14.6
+ */
+void purple_debug_set_category_enabled(const char *category, gboolean enabled);
+
+/**
+ * Sets how many of the most recent debug messages are kept in memory,
+ * whether or not debug output is otherwise enabled.  This can also be
+ * set with the PURPLE_DEBUG_RING environment variable.
+ *
+ * @param entries The number of messages to keep, or 0 to stop keeping
+ *                them.  Changing the size drops the messages kept so far.
+ *
+ * @since 2.14.6
+ */
+void purple_debug_set_ring_size(guint entries);
+
+/**
+ * Returns the debug messages kept in memory, oldest first.
+ *
+ * @return The messages, one per line, with their time, level and
+ *         category.  This must be g_free'd.
+ *
+ * @see purple_debug_set_ring_size()
+ * @since 2.14.6
+ */
+char *purple_debug_ring_dump(void);
+
 /**
  * Enable or disable printing debug output to the console.
  *
@@ -234,6 +285,14 @@ PurpleDebugUiOps *purple_debug_get_ui_ops(void);
  */
 void purple_debug_init(void);
 
+/**
+ * Uninitializes the debug subsystem, dropping the messages kept in memory
+ * and the disabled categories.
+ *
+ * @since 2.14.6
+ */
+void purple_debug_uninit(void);
+
 /*@}*/
 
 #ifdef __cplusplus
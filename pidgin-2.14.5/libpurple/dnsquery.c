@@ -33,6 +33,7 @@
 #include "network.h"
 #include "notify.h"
 #include "prefs.h"
+#include "signals.h"
 #include "util.h"
 
 #ifndef _WIN32
@@ -60,6 +61,15 @@ struct _PurpleDnsQueryData {
 	guint timeout;
 	PurpleAccount *account;
 
+	/* Set while this query is the one actually resolving cache_key */
+	gchar *cache_key;
+	/* Identical queries waiting for this one's answer */
+	GSList *waiters;
+	/* The query this one is waiting on, if any */
+	PurpleDnsQueryData *leader;
+	/* The resolver itself answered "no such host", so remember that */
+	gboolean cache_failure;
+
 #if defined(PURPLE_DNSQUERY_USE_FORK)
 	PurpleDnsQueryResolverProcess *resolver;
 #elif defined _WIN32 /* end PURPLE_DNSQUERY_USE_FORK  */
@@ -98,10 +108,200 @@ typedef struct {
 } dns_params_t;
 #endif /* end PURPLE_DNSQUERY_USE_FORK */
 
+/*
+ * Answers are cached per hostname and port, since the port is part of
+ * the returned addresses.  getaddrinfo() doesn't tell us the TTL of the
+ * records it found, so successful lookups are kept for a fixed time.
+ * Failures are kept for a shorter time, so that a mistyped server
+ * doesn't keep the resolvers busy but a flaky network recovers quickly.
+ * The cache is flushed whenever the network configuration changes.
+ */
+#define DNS_CACHE_TTL           300
+#define DNS_CACHE_NEGATIVE_TTL  30
+#define DNS_CACHE_MAX_ENTRIES   256
+
+typedef struct {
+	GSList *hosts;
+	gchar *error_message;
+	time_t expires;
+} PurpleDnsCacheEntry;
+
+static GHashTable *dns_cache = NULL;
+/* Maps a cache key to the query currently resolving it */
+static GHashTable *dns_in_flight = NULL;
+
+static gboolean initiate_resolving(gpointer data);
+
+static void *
+dnsquery_get_handle(void)
+{
+	static int handle;
+
+	return &handle;
+}
+
+static void
+dns_hosts_free(GSList *hosts)
+{
+	/* The list is pairs of address lengths and sockaddrs */
+	while (hosts != NULL)
+	{
+		hosts = g_slist_delete_link(hosts, hosts);
+		g_free(hosts->data);
+		hosts = g_slist_delete_link(hosts, hosts);
+	}
+}
+
+static GSList *
+dns_hosts_copy(GSList *hosts)
+{
+	GSList *copy = NULL;
+
+	for (; hosts != NULL && hosts->next != NULL; hosts = hosts->next->next)
+	{
+		gsize len = GPOINTER_TO_SIZE(hosts->data);
+
+		copy = g_slist_prepend(copy, hosts->data);
+		copy = g_slist_prepend(copy, g_memdup2(hosts->next->data, len));
+	}
+
+	return g_slist_reverse(copy);
+}
+
+static void
+dns_cache_entry_free(PurpleDnsCacheEntry *entry)
+{
+	dns_hosts_free(entry->hosts);
+	g_free(entry->error_message);
+	g_free(entry);
+}
+
+static gchar *
+dns_cache_key(PurpleDnsQueryData *query_data)
+{
+	gchar *host = g_ascii_strdown(query_data->hostname, -1);
+	gchar *key = g_strdup_printf("%s:%d", host, query_data->port);
+
+	g_free(host);
+
+	return key;
+}
+
+static PurpleDnsCacheEntry *
+dns_cache_lookup(const gchar *key)
+{
+	PurpleDnsCacheEntry *entry;
+
+	if (dns_cache == NULL)
+		return NULL;
+
+	entry = g_hash_table_lookup(dns_cache, key);
+	if (entry != NULL && entry->expires <= time(NULL))
+	{
+		g_hash_table_remove(dns_cache, key);
+		entry = NULL;
+	}
+
+	return entry;
+}
+
+static gboolean
+dns_cache_entry_expired(gpointer key, gpointer value, gpointer now)
+{
+	PurpleDnsCacheEntry *entry = value;
+
+	return entry->expires <= *(time_t *)now;
+}
+
+static void
+dns_cache_store(const gchar *key, GSList *hosts, const gchar *error_message,
+		int ttl)
+{
+	PurpleDnsCacheEntry *entry;
+	time_t now = time(NULL);
+
+	if (dns_cache == NULL)
+		dns_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+				(GDestroyNotify)dns_cache_entry_free);
+
+	if (g_hash_table_size(dns_cache) >= DNS_CACHE_MAX_ENTRIES)
+		g_hash_table_foreach_remove(dns_cache, dns_cache_entry_expired, &now);
+
+	if (g_hash_table_size(dns_cache) >= DNS_CACHE_MAX_ENTRIES)
+	{
+		/* Still full of live entries; drop the one closest to expiring */
+		GHashTableIter iter;
+		gpointer k, v;
+		gpointer oldest = NULL;
+		time_t oldest_expires = 0;
+
+		g_hash_table_iter_init(&iter, dns_cache);
+		while (g_hash_table_iter_next(&iter, &k, &v))
+		{
+			PurpleDnsCacheEntry *e = v;
+			if (oldest == NULL || e->expires < oldest_expires)
+			{
+				oldest = k;
+				oldest_expires = e->expires;
+			}
+		}
+		g_hash_table_remove(dns_cache, oldest);
+	}
+
+	entry = g_new0(PurpleDnsCacheEntry, 1);
+	entry->hosts = hosts;
+	entry->error_message = g_strdup(error_message);
+	entry->expires = now + ttl;
+
+	g_hash_table_replace(dns_cache, g_strdup(key), entry);
+}
+
+static void
+dns_cache_clear(void)
+{
+	if (dns_cache != NULL)
+		g_hash_table_remove_all(dns_cache);
+}
+
+/*
+ * Stop being the query that resolves this name and restart everything
+ * that was waiting on us.  Normally they find our answer in the cache;
+ * if we were cancelled or failed for some local reason, the first of
+ * them takes over the lookup.
+ */
+static void
+dns_query_release_waiters(PurpleDnsQueryData *query_data)
+{
+	if (query_data->cache_key == NULL)
+		return;
+
+	g_hash_table_remove(dns_in_flight, query_data->cache_key);
+	g_free(query_data->cache_key);
+	query_data->cache_key = NULL;
+
+	while (query_data->waiters != NULL)
+	{
+		PurpleDnsQueryData *waiter = query_data->waiters->data;
+
+		query_data->waiters = g_slist_delete_link(query_data->waiters,
+				query_data->waiters);
+		waiter->leader = NULL;
+		waiter->timeout = purple_timeout_add(0, initiate_resolving, waiter);
+	}
+}
+
 static void
 purple_dnsquery_resolved(PurpleDnsQueryData *query_data, GSList *hosts)
 {
 	purple_debug_info("dnsquery", "IP resolved for %s\n", query_data->hostname);
+
+	if (query_data->cache_key != NULL)
+	{
+		dns_cache_store(query_data->cache_key, dns_hosts_copy(hosts), NULL,
+				DNS_CACHE_TTL);
+		dns_query_release_waiters(query_data);
+	}
+
 	if (query_data->callback != NULL)
 		query_data->callback(hosts, query_data->data, NULL);
 	else
@@ -140,6 +340,15 @@ static void
 purple_dnsquery_failed(PurpleDnsQueryData *query_data, const gchar *error_message)
 {
 	purple_debug_error("dnsquery", "%s\n", error_message);
+
+	if (query_data->cache_key != NULL)
+	{
+		if (query_data->cache_failure)
+			dns_cache_store(query_data->cache_key, NULL, error_message,
+					DNS_CACHE_NEGATIVE_TTL);
+		dns_query_release_waiters(query_data);
+	}
+
 	if (query_data->callback != NULL)
 		query_data->callback(NULL, query_data->data, error_message);
 	purple_dnsquery_destroy(query_data);
@@ -664,6 +873,7 @@ host_resolved(gpointer data, gint source, PurpleInputCondition cond)
 		/* Re-read resolv.conf and friends in case DNS servers have changed */
 		res_init();
 
+		query_data->cache_failure = TRUE;
 		purple_dnsquery_failed(query_data, message);
 	} else if (rc > 0) {
 		/* Success! */
@@ -787,6 +997,7 @@ dns_thread(gpointer data)
 		freeaddrinfo(tmp);
 	} else {
 		query_data->error_message = g_strdup_printf(_("Error resolving %s:\n%s"), query_data->hostname, purple_gai_strerror(rc));
+		query_data->cache_failure = TRUE;
 	}
 #else
 	if ((hp = gethostbyname(hostname))) {
@@ -801,6 +1012,7 @@ dns_thread(gpointer data)
 				g_memdup2(&sin, sizeof(sin)));
 	} else {
 		query_data->error_message = g_strdup_printf(_("Error resolving %s: %d"), query_data->hostname, h_errno);
+		query_data->cache_failure = TRUE;
 	}
 #endif
 	g_free(hostname);
@@ -865,6 +1077,7 @@ resolve_host(PurpleDnsQueryData *query_data)
 		char message[1024];
 		g_snprintf(message, sizeof(message), _("Error resolving %s: %d"),
 				query_data->hostname, h_errno);
+		query_data->cache_failure = TRUE;
 		purple_dnsquery_failed(query_data, message);
 		g_free(hostname);
 		return;
@@ -883,6 +1096,57 @@ resolve_host(PurpleDnsQueryData *query_data)
 
 #endif /* not PURPLE_DNSQUERY_USE_FORK or _WIN32 */
 
+/*
+ * Answer the query from the cache, or queue it behind an identical
+ * lookup that is already running.  Returns TRUE if the query was taken
+ * care of; otherwise it becomes the query that resolves this name.
+ */
+static gboolean
+dns_query_try_cache(PurpleDnsQueryData *query_data)
+{
+	PurpleDnsCacheEntry *entry;
+	PurpleDnsQueryData *leader;
+	gchar *key;
+
+	key = dns_cache_key(query_data);
+
+	entry = dns_cache_lookup(key);
+	if (entry != NULL)
+	{
+		purple_debug_info("dnsquery", "Using cached result for %s\n",
+				query_data->hostname);
+		g_free(key);
+		if (entry->error_message != NULL)
+		{
+			gchar *message = g_strdup(entry->error_message);
+			purple_dnsquery_failed(query_data, message);
+			g_free(message);
+		}
+		else
+			purple_dnsquery_resolved(query_data, dns_hosts_copy(entry->hosts));
+		return TRUE;
+	}
+
+	if (dns_in_flight == NULL)
+		dns_in_flight = g_hash_table_new(g_str_hash, g_str_equal);
+
+	leader = g_hash_table_lookup(dns_in_flight, key);
+	if (leader != NULL)
+	{
+		purple_debug_info("dnsquery", "Waiting for lookup of %s already in "
+				"progress\n", query_data->hostname);
+		g_free(key);
+		query_data->leader = leader;
+		leader->waiters = g_slist_append(leader->waiters, query_data);
+		return TRUE;
+	}
+
+	query_data->cache_key = key;
+	g_hash_table_insert(dns_in_flight, key, query_data);
+
+	return FALSE;
+}
+
 static gboolean
 initiate_resolving(gpointer data)
 {
@@ -904,6 +1168,10 @@ initiate_resolving(gpointer data)
 		return FALSE;
 	}
 
+	if (dns_query_try_cache(query_data))
+		/* Answered from the cache, or waiting on an identical lookup */
+		return FALSE;
+
 	if (purple_dnsquery_ui_resolve(query_data))
 		/* The UI is handling the resolve; we're done */
 		return FALSE;
@@ -959,6 +1227,16 @@ purple_dnsquery_destroy(PurpleDnsQueryData *query_data)
 	if (ops && ops->destroy)
 		ops->destroy(query_data);
 
+	if (query_data->leader != NULL)
+	{
+		query_data->leader->waiters = g_slist_remove(query_data->leader->waiters,
+				query_data);
+		query_data->leader = NULL;
+	}
+
+	/* Don't strand anyone who was waiting on this lookup */
+	dns_query_release_waiters(query_data);
+
 #if defined(PURPLE_DNSQUERY_USE_FORK)
 	queued_requests = g_slist_remove(queued_requests, query_data);
 
@@ -1034,9 +1312,20 @@ purple_dnsquery_get_ui_ops(void)
 	return dns_query_ui_ops;
 }
 
+static void
+network_config_changed_cb(void *data)
+{
+	/* Names may well resolve differently on the new network */
+	dns_cache_clear();
+	_purple_srv_txt_cache_clear();
+}
+
 void
 purple_dnsquery_init(void)
 {
+	purple_signal_connect(purple_network_get_handle(),
+			"network-configuration-changed", dnsquery_get_handle(),
+			PURPLE_CALLBACK(network_config_changed_cb), NULL);
 }
 
 void
@@ -1049,4 +1338,18 @@ purple_dnsquery_uninit(void)
 		free_dns_children = g_slist_remove(free_dns_children, free_dns_children->data);
 	}
 #endif /* end PURPLE_DNSQUERY_USE_FORK */
+
+	purple_signals_disconnect_by_handle(dnsquery_get_handle());
+
+	if (dns_cache != NULL)
+	{
+		g_hash_table_destroy(dns_cache);
+		dns_cache = NULL;
+	}
+	if (dns_in_flight != NULL)
+	{
+		g_hash_table_destroy(dns_in_flight);
+		dns_in_flight = NULL;
+	}
+	_purple_srv_txt_cache_clear();
 }
@@ -66,6 +66,8 @@ typedef union {
 } queryans;
 #endif
 
+typedef struct _PurpleSrvTxtLookup PurpleSrvTxtLookup;
+
 struct _PurpleSrvTxtQueryData {
 	union {
 		PurpleSrvCallback srv;
@@ -76,6 +78,20 @@ struct _PurpleSrvTxtQueryData {
 	guint handle;
 	int type;
 	char *query;
+
+	/*
+	 * The queries handed out to callers don't resolve anything
+	 * themselves; they wait on a PurpleSrvTxtLookup shared by every
+	 * identical query and are answered from the cache.
+	 */
+	char *cache_key;
+	PurpleSrvTxtLookup *lookup;
+	guint deliver;
+	gboolean failed;
+
+	/* Set on the query doing the actual resolving for a lookup */
+	PurpleSrvTxtLookup *owner;
+	int ttl;
 #ifdef _WIN32
 	GThread *resolver;
 	char *error_message;
@@ -96,6 +112,37 @@ typedef struct _PurpleSrvResponseContainer {
 	int sum;
 } PurpleSrvResponseContainer;
 
+/*
+ * A lookup in progress, shared by every query for the same name and
+ * record type.
+ */
+struct _PurpleSrvTxtLookup {
+	char *key;
+	PurpleSrvTxtQueryData *resolver;
+	GSList *waiters;
+};
+
+/*
+ * Answers are cached for the TTL of the records, clamped to a sane
+ * range.  Lookups that fail or come back empty are cached for a short,
+ * fixed time since we don't get to see the SOA record.
+ */
+#define SRV_TXT_CACHE_DEFAULT_TTL  300
+#define SRV_TXT_CACHE_MIN_TTL      5
+#define SRV_TXT_CACHE_MAX_TTL      3600
+#define SRV_TXT_CACHE_NEGATIVE_TTL 30
+#define SRV_TXT_CACHE_MAX_ENTRIES  128
+
+typedef struct {
+	PurpleSrvResponse *srv;
+	int srv_count;
+	GList *txt;
+	time_t expires;
+} PurpleSrvTxtCacheEntry;
+
+static GHashTable *srv_txt_cache = NULL;
+static GHashTable *srv_txt_in_flight = NULL;
+
 static gboolean purple_srv_txt_query_ui_resolve(PurpleSrvTxtQueryData *query_data);
 
 /**
@@ -271,6 +318,7 @@ query_data_new(int type, gchar *query, gpointer extradata)
 	query_data->type = type;
 	query_data->extradata = extradata;
 	query_data->query = query;
+	query_data->ttl = -1;
 #ifndef _WIN32
 	query_data->fd_in = -1;
 	query_data->fd_out = -1;
@@ -278,11 +326,45 @@ query_data_new(int type, gchar *query, gpointer extradata)
 	return query_data;
 }
 
+static void srv_txt_lookup_finish(PurpleSrvTxtLookup *lookup,
+		PurpleSrvTxtCacheEntry *entry);
+
 void
 purple_srv_txt_query_destroy(PurpleSrvTxtQueryData *query_data)
 {
 	PurpleSrvTxtQueryUiOps *ops = purple_srv_txt_query_get_ui_ops();
 
+	if (query_data->cache_key != NULL) {
+		/* One of the queries we handed out; the UI never saw it */
+		PurpleSrvTxtLookup *lookup = query_data->lookup;
+
+		if (query_data->deliver > 0)
+			purple_timeout_remove(query_data->deliver);
+
+		if (lookup != NULL) {
+			lookup->waiters = g_slist_remove(lookup->waiters, query_data);
+			if (lookup->waiters == NULL) {
+				/* Nobody wants the answer any more */
+				PurpleSrvTxtQueryData *resolver = lookup->resolver;
+				resolver->owner = NULL;
+				srv_txt_lookup_finish(lookup, NULL);
+				purple_srv_txt_query_destroy(resolver);
+			}
+		}
+
+		g_free(query_data->cache_key);
+		g_free(query_data->query);
+		g_free(query_data);
+		return;
+	}
+
+	if (query_data->owner != NULL) {
+		/* The resolver went away without answering */
+		PurpleSrvTxtLookup *lookup = query_data->owner;
+		query_data->owner = NULL;
+		srv_txt_lookup_finish(lookup, NULL);
+	}
+
 	if (ops && ops->destroy)
 		ops->destroy(query_data);
 
@@ -388,6 +470,8 @@ resolve(int in, int out)
 	guchar *end, *cp;
 	gchar name[256];
 	guint16 type, dlen, pref, weight, port;
+	guint32 rttl;
+	int ttl = -1;
 	PurpleSrvInternalQuery query;
 
 #ifdef HAVE_SIGNAL_H
@@ -400,6 +484,7 @@ resolve(int in, int out)
 	if (size == -1) {
 		write_to_parent(in, out, &(query.type), sizeof(query.type));
 		write_to_parent(in, out, &size, sizeof(size));
+		write_to_parent(in, out, &ttl, sizeof(ttl));
 		close(out);
 		close(in);
 		_exit(0);
@@ -424,8 +509,12 @@ resolve(int in, int out)
 		cp += size;
 		GETSHORT(type,cp);
 
-		/* skip ttl and class since we already know it */
-		cp += 6;
+		/* skip class since we already know it */
+		cp += 2;
+
+		GETLONG(rttl,cp);
+		if (type == query.type && (ttl < 0 || rttl < (guint32)ttl))
+			ttl = (int)MIN(rttl, (guint32)G_MAXINT);
 
 		GETSHORT(dlen,cp);
 		if (type == T_SRV) {
@@ -470,6 +559,7 @@ end:
 
 	write_to_parent(in, out, &(query.type), sizeof(query.type));
 	write_to_parent(in, out, &size, sizeof(size));
+	write_to_parent(in, out, &ttl, sizeof(ttl));
 	while (ret != NULL)
 	{
 		if (query.type == T_SRV)
@@ -501,7 +591,8 @@ resolved(gpointer data, gint source, PurpleInputCondition cond)
 	int status;
 
 	if (read(source, &type, sizeof(type)) == sizeof(type)) {
-		if (read(source, &size, sizeof(size)) == sizeof(size)) {
+		if (read(source, &size, sizeof(size)) == sizeof(size) &&
+				read(source, &query_data->ttl, sizeof(query_data->ttl)) == sizeof(query_data->ttl)) {
 			if (size < -1 || size > MAX_ADDR_RESPONSE_LEN) {
 				purple_debug_warning("dnssrv", "res_query returned invalid number\n");
 				size = 0;
@@ -694,6 +785,9 @@ res_thread(gpointer data)
 					continue;
 				}
 
+				if (query_data->ttl < 0 || dr_tmp->dwTtl < (DWORD)query_data->ttl)
+					query_data->ttl = (int)MIN(dr_tmp->dwTtl, (DWORD)G_MAXINT);
+
 				srv_data = &dr_tmp->Data.SRV;
 				srvres = g_new0(PurpleSrvResponse, 1);
 				strncpy(srvres->hostname, srv_data->pNameTarget, 255);
@@ -722,6 +816,9 @@ res_thread(gpointer data)
 					continue;
 				}
 
+				if (query_data->ttl < 0 || dr_tmp->dwTtl < (DWORD)query_data->ttl)
+					query_data->ttl = (int)MIN(dr_tmp->dwTtl, (DWORD)G_MAXINT);
+
 				txt_data = &dr_tmp->Data.TXT;
 				txtres = g_new0(PurpleTxtResponse, 1);
 
@@ -750,6 +847,351 @@ res_thread(gpointer data)
 
 #endif
 
+static void
+srv_txt_cache_entry_free(PurpleSrvTxtCacheEntry *entry)
+{
+	g_free(entry->srv);
+	g_list_free_full(entry->txt, (GDestroyNotify)purple_txt_response_destroy);
+	g_free(entry);
+}
+
+static PurpleSrvTxtCacheEntry *
+srv_txt_cache_lookup(const char *key)
+{
+	PurpleSrvTxtCacheEntry *entry;
+
+	if (srv_txt_cache == NULL)
+		return NULL;
+
+	entry = g_hash_table_lookup(srv_txt_cache, key);
+	if (entry != NULL && entry->expires <= time(NULL)) {
+		g_hash_table_remove(srv_txt_cache, key);
+		entry = NULL;
+	}
+
+	return entry;
+}
+
+static gboolean
+srv_txt_cache_entry_expired(gpointer key, gpointer value, gpointer now)
+{
+	PurpleSrvTxtCacheEntry *entry = value;
+
+	return entry->expires <= *(time_t *)now;
+}
+
+static void
+srv_txt_cache_store(const char *key, PurpleSrvTxtCacheEntry *entry, int ttl)
+{
+	time_t now = time(NULL);
+
+	if (srv_txt_cache == NULL)
+		srv_txt_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+				(GDestroyNotify)srv_txt_cache_entry_free);
+
+	if (g_hash_table_size(srv_txt_cache) >= SRV_TXT_CACHE_MAX_ENTRIES)
+		g_hash_table_foreach_remove(srv_txt_cache, srv_txt_cache_entry_expired, &now);
+
+	if (g_hash_table_size(srv_txt_cache) >= SRV_TXT_CACHE_MAX_ENTRIES) {
+		/* Still full of live entries; drop the one closest to expiring */
+		GHashTableIter iter;
+		gpointer k, v;
+		gpointer oldest = NULL;
+		time_t oldest_expires = 0;
+
+		g_hash_table_iter_init(&iter, srv_txt_cache);
+		while (g_hash_table_iter_next(&iter, &k, &v)) {
+			PurpleSrvTxtCacheEntry *e = v;
+			if (oldest == NULL || e->expires < oldest_expires) {
+				oldest = k;
+				oldest_expires = e->expires;
+			}
+		}
+		g_hash_table_remove(srv_txt_cache, oldest);
+	}
+
+	entry->expires = now + CLAMP(ttl, SRV_TXT_CACHE_MIN_TTL, SRV_TXT_CACHE_MAX_TTL);
+	g_hash_table_replace(srv_txt_cache, g_strdup(key), entry);
+}
+
+void
+_purple_srv_txt_cache_clear(void)
+{
+	if (srv_txt_cache != NULL) {
+		g_hash_table_destroy(srv_txt_cache);
+		srv_txt_cache = NULL;
+	}
+}
+
+static gboolean srv_txt_deliver_cb(gpointer data);
+
+/*
+ * The lookup is over: cache its answer, if it got one, and wake up
+ * everyone who was waiting for it.
+ */
+static void
+srv_txt_lookup_finish(PurpleSrvTxtLookup *lookup, PurpleSrvTxtCacheEntry *entry)
+{
+	int ttl;
+
+	g_hash_table_remove(srv_txt_in_flight, lookup->key);
+
+	if (entry != NULL) {
+		if (entry->srv_count == 0 && entry->txt == NULL)
+			ttl = SRV_TXT_CACHE_NEGATIVE_TTL;
+		else if (lookup->resolver->ttl >= 0)
+			ttl = lookup->resolver->ttl;
+		else
+			ttl = SRV_TXT_CACHE_DEFAULT_TTL;
+		srv_txt_cache_store(lookup->key, entry, ttl);
+	}
+
+	while (lookup->waiters != NULL) {
+		PurpleSrvTxtQueryData *waiter = lookup->waiters->data;
+
+		lookup->waiters = g_slist_delete_link(lookup->waiters, lookup->waiters);
+		waiter->lookup = NULL;
+		waiter->failed = (entry == NULL);
+		waiter->deliver = purple_timeout_add(0, srv_txt_deliver_cb, waiter);
+	}
+
+	g_free(lookup->key);
+	g_free(lookup);
+}
+
+static void
+srv_lookup_done(PurpleSrvResponse *resp, int results, gpointer data)
+{
+	PurpleSrvTxtLookup *lookup = data;
+	PurpleSrvTxtCacheEntry *entry = g_new0(PurpleSrvTxtCacheEntry, 1);
+
+	entry->srv = resp;
+	entry->srv_count = resp != NULL ? results : 0;
+
+	lookup->resolver->owner = NULL;
+	srv_txt_lookup_finish(lookup, entry);
+}
+
+static void
+txt_lookup_done(GList *responses, gpointer data)
+{
+	PurpleSrvTxtLookup *lookup = data;
+	PurpleSrvTxtCacheEntry *entry = g_new0(PurpleSrvTxtCacheEntry, 1);
+
+	entry->txt = responses;
+
+	lookup->resolver->owner = NULL;
+	srv_txt_lookup_finish(lookup, entry);
+}
+
+/*
+ * Start resolving query_data in a child process (or thread, or the UI).
+ * Returns FALSE if that wasn't possible.
+ */
+static gboolean
+srv_txt_query_start(PurpleSrvTxtQueryData *query_data)
+{
+#ifndef _WIN32
+	PurpleSrvInternalQuery internal_query;
+	int in[2], out[2];
+	int pid;
+#else
+	GError* err = NULL;
+#endif
+	const char *type = query_data->type == T_SRV ? "SRV" : "TXT";
+
+	if (purple_srv_txt_query_ui_resolve(query_data))
+		return TRUE;
+
+#ifndef _WIN32
+	if (pipe(in)) {
+		purple_debug_error("dnssrv", "Could not create pipe\n");
+		return FALSE;
+	}
+	if (pipe(out)) {
+		purple_debug_error("dnssrv", "Could not create pipe\n");
+		close(in[0]);
+		close(in[1]);
+		return FALSE;
+	}
+
+	pid = fork();
+	if (pid == -1) {
+		purple_debug_error("dnssrv", "Could not create process!\n");
+		close(in[0]);
+		close(in[1]);
+		close(out[0]);
+		close(out[1]);
+		return FALSE;
+	}
+
+	/* Child */
+	if (pid == 0)
+	{
+		close(out[0]);
+		close(in[1]);
+		resolve(in[0], out[1]);
+		/* resolve() does not return */
+	}
+
+	close(out[1]);
+	close(in[0]);
+
+	internal_query.type = query_data->type;
+	strncpy(internal_query.query, query_data->query, 255);
+	internal_query.query[255] = '\0';
+
+	if (write(in[1], &internal_query, sizeof(internal_query)) < 0)
+		purple_debug_error("dnssrv", "Could not write to %s resolver\n", type);
+
+	query_data->pid = pid;
+	query_data->fd_out = out[0];
+	query_data->fd_in = in[1];
+	query_data->handle = purple_input_add(out[0], PURPLE_INPUT_READ, resolved, query_data);
+
+	return TRUE;
+#else
+	query_data->resolver = g_thread_create(res_thread, query_data, FALSE, &err);
+	if (query_data->resolver == NULL) {
+		query_data->error_message = g_strdup_printf("%s thread create failure: %s\n", type, (err && err->message) ? err->message : "");
+		g_error_free(err);
+	}
+
+	/* The query isn't going to happen, so finish the lookup now.
+	 * Asynchronously call the callback since stuff may not expect
+	 * the callback to be called before this returns */
+	if (query_data->error_message != NULL)
+		query_data->handle = purple_timeout_add(0, res_main_thread_cb, query_data);
+
+	return TRUE;
+#endif
+}
+
+/*
+ * Answer query_data from the cache, or have it wait on the lookup for
+ * the same name that's already running, or start that lookup.  The
+ * answer is always delivered from the main loop.  Returns FALSE if no
+ * lookup could be started.
+ */
+static gboolean
+srv_txt_lookup(PurpleSrvTxtQueryData *query_data)
+{
+	PurpleSrvTxtLookup *lookup;
+	PurpleSrvTxtQueryData *resolver;
+
+	if (query_data->cache_key == NULL) {
+		char *query = g_ascii_strdown(query_data->query, -1);
+		query_data->cache_key = g_strdup_printf("%d:%s", query_data->type, query);
+		g_free(query);
+	}
+
+	if (srv_txt_cache_lookup(query_data->cache_key) != NULL) {
+		purple_debug_info("dnssrv", "using cached result for %s\n",
+				query_data->query);
+		query_data->deliver = purple_timeout_add(0, srv_txt_deliver_cb, query_data);
+		return TRUE;
+	}
+
+	if (srv_txt_in_flight == NULL)
+		srv_txt_in_flight = g_hash_table_new(g_str_hash, g_str_equal);
+
+	lookup = g_hash_table_lookup(srv_txt_in_flight, query_data->cache_key);
+	if (lookup != NULL) {
+		purple_debug_info("dnssrv", "waiting for lookup of %s already in progress\n",
+				query_data->query);
+		query_data->lookup = lookup;
+		lookup->waiters = g_slist_append(lookup->waiters, query_data);
+		return TRUE;
+	}
+
+	lookup = g_new0(PurpleSrvTxtLookup, 1);
+	lookup->key = g_strdup(query_data->cache_key);
+
+	resolver = query_data_new(query_data->type, g_strdup(query_data->query), lookup);
+	if (query_data->type == T_SRV)
+		resolver->cb.srv = srv_lookup_done;
+	else
+		resolver->cb.txt = txt_lookup_done;
+	resolver->owner = lookup;
+	lookup->resolver = resolver;
+
+	query_data->lookup = lookup;
+	lookup->waiters = g_slist_append(lookup->waiters, query_data);
+	g_hash_table_insert(srv_txt_in_flight, lookup->key, lookup);
+
+	if (!srv_txt_query_start(resolver)) {
+		query_data->lookup = NULL;
+		g_slist_free(lookup->waiters);
+		lookup->waiters = NULL;
+		resolver->owner = NULL;
+		srv_txt_lookup_finish(lookup, NULL);
+		purple_srv_txt_query_destroy(resolver);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+srv_txt_deliver_cb(gpointer data)
+{
+	PurpleSrvTxtQueryData *query_data = data;
+	PurpleSrvTxtCacheEntry *entry = NULL;
+
+	query_data->deliver = 0;
+
+	if (!query_data->failed) {
+		entry = srv_txt_cache_lookup(query_data->cache_key);
+		if (entry == NULL) {
+			/* The cache was flushed since the lookup finished; ask again */
+			if (srv_txt_lookup(query_data))
+				return FALSE;
+		}
+	}
+
+	if (query_data->type == T_SRV) {
+		PurpleSrvResponse *records = NULL;
+		int count = 0;
+
+		if (entry != NULL && entry->srv_count > 0) {
+			GList *list = NULL, *l;
+			int i;
+
+			/* Re-sort every time, so that the weights still spread
+			 * connections across servers while the answer is cached. */
+			for (i = 0; i < entry->srv_count; i++)
+				list = g_list_prepend(list, &entry->srv[i]);
+			list = purple_srv_sort(list);
+
+			records = g_new(PurpleSrvResponse, entry->srv_count);
+			for (l = list; l != NULL; l = l->next)
+				records[count++] = *(PurpleSrvResponse *)l->data;
+			g_list_free(list);
+		}
+
+		purple_debug_info("dnssrv", "found %d SRV entries\n", count);
+		query_data->cb.srv(records, count, query_data->extradata);
+	} else {
+		GList *responses = NULL, *l;
+
+		if (entry != NULL) {
+			for (l = entry->txt; l != NULL; l = l->next) {
+				PurpleTxtResponse *res = g_new0(PurpleTxtResponse, 1);
+				res->content = g_strdup(((PurpleTxtResponse *)l->data)->content);
+				responses = g_list_prepend(responses, res);
+			}
+			responses = g_list_reverse(responses);
+		}
+
+		purple_debug_info("dnssrv", "found %d TXT entries\n", g_list_length(responses));
+		query_data->cb.txt(responses, query_data->extradata);
+	}
+
+	purple_srv_txt_query_destroy(query_data);
+
+	return FALSE;
+}
+
 PurpleSrvTxtQueryData *
 purple_srv_resolve(const char *protocol, const char *transport,
 	const char *domain, PurpleSrvCallback cb, gpointer extradata)
@@ -767,13 +1209,6 @@ purple_srv_resolve_account(PurpleAccount *account, const char *protocol,
 	char *hostname;
 	PurpleSrvTxtQueryData *query_data;
 	PurpleProxyType proxy_type;
-#ifndef _WIN32
-	PurpleSrvInternalQuery internal_query;
-	int in[2], out[2];
-	int pid;
-#else
-	GError* err = NULL;
-#endif
 
 	if (!protocol || !*protocol || !transport || !*transport || !domain || !*domain) {
 		purple_debug_error("dnssrv", "Wrong arguments\n");
@@ -809,72 +1244,13 @@ purple_srv_resolve_account(PurpleAccount *account, const char *protocol,
 	query_data = query_data_new(PurpleDnsTypeSrv, query, extradata);
 	query_data->cb.srv = cb;
 
-	if (purple_srv_txt_query_ui_resolve(query_data))
-	{
-		return query_data;
-	}
-
-#ifndef _WIN32
-	if(pipe(in) || pipe(out)) {
-		purple_debug_error("dnssrv", "Could not create pipe\n");
-		g_free(query);
-		g_free(query_data);
-		cb(NULL, 0, extradata);
-		return NULL;
-	}
-
-	pid = fork();
-	if (pid == -1) {
-		purple_debug_error("dnssrv", "Could not create process!\n");
-		g_free(query);
-		g_free(query_data);
+	if (!srv_txt_lookup(query_data)) {
+		purple_srv_txt_query_destroy(query_data);
 		cb(NULL, 0, extradata);
 		return NULL;
 	}
 
-	/* Child */
-	if (pid == 0)
-	{
-		g_free(query);
-		g_free(query_data);
-
-		close(out[0]);
-		close(in[1]);
-		resolve(in[0], out[1]);
-		/* resolve() does not return */
-	}
-
-	close(out[1]);
-	close(in[0]);
-
-	internal_query.type = T_SRV;
-	strncpy(internal_query.query, query, 255);
-	internal_query.query[255] = '\0';
-
-	if (write(in[1], &internal_query, sizeof(internal_query)) < 0)
-		purple_debug_error("dnssrv", "Could not write to SRV resolver\n");
-
-	query_data->pid = pid;
-	query_data->fd_out = out[0];
-	query_data->fd_in = in[1];
-	query_data->handle = purple_input_add(out[0], PURPLE_INPUT_READ, resolved, query_data);
-
-	return query_data;
-#else
-	query_data->resolver = g_thread_create(res_thread, query_data, FALSE, &err);
-	if (query_data->resolver == NULL) {
-		query_data->error_message = g_strdup_printf("SRV thread create failure: %s\n", (err && err->message) ? err->message : "");
-		g_error_free(err);
-	}
-
-	/* The query isn't going to happen, so finish the SRV lookup now.
-	 * Asynchronously call the callback since stuff may not expect
-	 * the callback to be called before this returns */
-	if (query_data->error_message != NULL)
-		query_data->handle = purple_timeout_add(0, res_main_thread_cb, query_data);
-
 	return query_data;
-#endif
 }
 
 PurpleSrvTxtQueryData *purple_txt_resolve(const char *owner,
@@ -891,13 +1267,6 @@ PurpleSrvTxtQueryData *purple_txt_resolve_account(PurpleAccount *account,
 	char *hostname;
 	PurpleSrvTxtQueryData *query_data;
 	PurpleProxyType proxy_type;
-#ifndef _WIN32
-	PurpleSrvInternalQuery internal_query;
-	int in[2], out[2];
-	int pid;
-#else
-	GError* err = NULL;
-#endif
 
 	proxy_type = purple_proxy_info_get_type(
 		purple_proxy_get_setup(account));
@@ -927,73 +1296,13 @@ PurpleSrvTxtQueryData *purple_txt_resolve_account(PurpleAccount *account,
 	query_data = query_data_new(PurpleDnsTypeTxt, query, extradata);
 	query_data->cb.txt = cb;
 
-	if (purple_srv_txt_query_ui_resolve(query_data)) {
-		/* query intentionally not freed
-		 */
-		return query_data;
-	}
-
-#ifndef _WIN32
-	if(pipe(in) || pipe(out)) {
-		purple_debug_error("dnssrv", "Could not create pipe\n");
-		g_free(query);
-		g_free(query_data);
-		cb(NULL, extradata);
-		return NULL;
-	}
-
-	pid = fork();
-	if (pid == -1) {
-		purple_debug_error("dnssrv", "Could not create process!\n");
-		g_free(query);
-		g_free(query_data);
+	if (!srv_txt_lookup(query_data)) {
+		purple_srv_txt_query_destroy(query_data);
 		cb(NULL, extradata);
 		return NULL;
 	}
 
-	/* Child */
-	if (pid == 0)
-	{
-		g_free(query);
-		g_free(query_data);
-
-		close(out[0]);
-		close(in[1]);
-		resolve(in[0], out[1]);
-		/* resolve() does not return */
-	}
-
-	close(out[1]);
-	close(in[0]);
-
-	internal_query.type = T_TXT;
-	strncpy(internal_query.query, query, 255);
-	internal_query.query[255] = '\0';
-
-	if (write(in[1], &internal_query, sizeof(internal_query)) < 0)
-		purple_debug_error("dnssrv", "Could not write to TXT resolver\n");
-
-	query_data->pid = pid;
-	query_data->fd_out = out[0];
-	query_data->fd_in = in[1];
-	query_data->handle = purple_input_add(out[0], PURPLE_INPUT_READ, resolved, query_data);
-
-	return query_data;
-#else
-	query_data->resolver = g_thread_create(res_thread, query_data, FALSE, &err);
-	if (query_data->resolver == NULL) {
-		query_data->error_message = g_strdup_printf("TXT thread create failure: %s\n", (err && err->message) ? err->message : "");
-		g_error_free(err);
-	}
-
-	/* The query isn't going to happen, so finish the TXT lookup now.
-	 * Asynchronously call the callback since stuff may not expect
-	 * the callback to be called before this returns */
-	if (query_data->error_message != NULL)
-		query_data->handle = purple_timeout_add(0, res_main_thread_cb, query_data);
-
 	return query_data;
-#endif
 }
 
 void
@@ -1096,7 +1405,10 @@ purple_srv_query_failed(PurpleSrvTxtQueryData *query_data, const gchar *error_me
 {
 	purple_debug_error("dnssrv", "%s\n", error_message);
 
-	if (query_data->cb.srv != NULL)
+	if (query_data->type == T_TXT) {
+		if (query_data->cb.txt != NULL)
+			query_data->cb.txt(NULL, query_data->extradata);
+	} else if (query_data->cb.srv != NULL)
 		query_data->cb.srv(NULL, 0, query_data->extradata);
 
 	purple_srv_txt_query_destroy(query_data);
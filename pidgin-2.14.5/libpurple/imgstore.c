@@ -200,6 +200,630 @@ purple_imgstore_unref(PurpleStoredImage *img)
 	return img;
 }
 
+/**************************************************************************
+ * Image packs
+ **************************************************************************/
+
+/*
+ * An image pack is a read-only copy of the images in a cache directory
+ * (buddy icons, custom smileys) in one file, which we map instead of
+ * opening every image on its own.  All integers are in network byte order:
+ *
+ *   "PURPLEPK"   magic
+ *   guint32      format version
+ *   guint32      number of entries
+ *   entries      guint16 name length, name, guint32 offset, guint32 length
+ *   image data
+ *
+ * The names are filenames from purple_util_get_image_filename(), so they
+ * are content addressed: an entry never goes stale, it is only dropped
+ * when the pack is rebuilt without it.
+ *
+ * Windows can't replace a file while it is mapped, so there a rebuilt
+ * pack is written next to the old one, with IMAGE_PACK_NEW_SUFFIX, and
+ * takes its place the next time the pack is opened.
+ */
+#define IMAGE_PACK_MAGIC         "PURPLEPK"
+#define IMAGE_PACK_MAGIC_LEN     8
+#define IMAGE_PACK_VERSION       1
+#define IMAGE_PACK_HEADER_LEN    (IMAGE_PACK_MAGIC_LEN + 8)
+#define IMAGE_PACK_NEW_SUFFIX    ".new"
+
+struct _PurpleImagePack
+{
+	volatile gint refcount;
+	GMappedFile *file;
+	GHashTable *entries;   /**< name -> PurpleImagePackEntry */
+};
+
+typedef struct
+{
+	const guchar *data;
+	gsize len;
+} PurpleImagePackEntry;
+
+typedef enum
+{
+	IMAGE_JOB_READ,
+	IMAGE_JOB_BUILD_PACK,
+	IMAGE_JOB_QUIT
+} PurpleImageJobType;
+
+typedef struct
+{
+	PurpleImageJobType type;
+	PurpleImagePack *pack;  /**< Consulted before the directory, or NULL. */
+	char *dir;
+	char *filename;         /**< The image to read, or the pack to write. */
+	GList *filenames;       /**< The images to put into the pack. */
+
+	/* Filled in by the loader thread. */
+	guchar *data;
+	gsize len;
+	gboolean success;
+	char *error;
+
+	/* Only touched on the main thread. */
+	GCallback cb;
+	gpointer user_data;
+} PurpleImageJob;
+
+/** Jobs waiting for the loader thread, or NULL before the first one. */
+static GAsyncQueue *image_jobs = NULL;
+
+/** Jobs whose callbacks have not run yet, for _purple_image_jobs_cancel(). */
+static GHashTable *image_jobs_outstanding = NULL;
+
+static guint32
+image_pack_get_uint32(const guchar *p)
+{
+	return ((guint32)p[0] << 24) | ((guint32)p[1] << 16) |
+	       ((guint32)p[2] << 8) | (guint32)p[3];
+}
+
+static void
+image_pack_put_uint32(GString *str, guint32 value)
+{
+	value = g_htonl(value);
+	g_string_append_len(str, (const char *)&value, 4);
+}
+
+static void
+image_pack_free_file(GMappedFile *file)
+{
+#if GLIB_CHECK_VERSION(2, 22, 0)
+	g_mapped_file_unref(file);
+#else
+	g_mapped_file_free(file);
+#endif
+}
+
+PurpleImagePack *
+_purple_image_pack_open(const char *path)
+{
+	PurpleImagePack *pack;
+	GMappedFile *file;
+	GError *err = NULL;
+	const guchar *data, *p, *end;
+	gsize size;
+	guint32 count, i;
+
+	g_return_val_if_fail(path != NULL, NULL);
+
+#ifdef _WIN32
+	{
+		char *new_path = g_strconcat(path, IMAGE_PACK_NEW_SUFFIX, NULL);
+
+		/* This fails, and is tried again next time, while the old
+		 * pack is still mapped somewhere. */
+		if (g_file_test(new_path, G_FILE_TEST_EXISTS))
+		{
+			g_unlink(path);
+			if (g_rename(new_path, path) != 0)
+				purple_debug_warning("imgstore", "Unable to rename %s to %s: %s\n",
+				                     new_path, path, g_strerror(errno));
+		}
+		g_free(new_path);
+	}
+#endif
+
+	file = g_mapped_file_new(path, FALSE, &err);
+	if (file == NULL) {
+		if (err->code != G_FILE_ERROR_NOENT)
+			purple_debug_warning("imgstore", "Unable to map %s: %s\n",
+			                     path, err->message);
+		g_error_free(err);
+		return NULL;
+	}
+
+	data = (const guchar *)g_mapped_file_get_contents(file);
+	size = g_mapped_file_get_length(file);
+
+	if (size < IMAGE_PACK_HEADER_LEN ||
+	    memcmp(data, IMAGE_PACK_MAGIC, IMAGE_PACK_MAGIC_LEN) != 0 ||
+	    image_pack_get_uint32(data + IMAGE_PACK_MAGIC_LEN) != IMAGE_PACK_VERSION)
+	{
+		purple_debug_warning("imgstore", "Ignoring invalid image pack %s\n", path);
+		image_pack_free_file(file);
+		return NULL;
+	}
+
+	pack = g_new(PurpleImagePack, 1);
+	pack->refcount = 1;
+	pack->file = file;
+	pack->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                      g_free, g_free);
+
+	count = image_pack_get_uint32(data + IMAGE_PACK_MAGIC_LEN + 4);
+	p = data + IMAGE_PACK_HEADER_LEN;
+	end = data + size;
+
+	for (i = 0; i < count; i++)
+	{
+		PurpleImagePackEntry *entry;
+		guint16 name_len;
+		guint32 offset, len;
+
+		if (end - p < 2)
+			break;
+		name_len = (p[0] << 8) | p[1];
+		p += 2;
+
+		if ((gsize)(end - p) < (gsize)name_len + 8)
+			break;
+		offset = image_pack_get_uint32(p + name_len);
+		len = image_pack_get_uint32(p + name_len + 4);
+
+		if (name_len == 0 || len == 0 || offset > size || len > size - offset)
+			break;
+
+		entry = g_new(PurpleImagePackEntry, 1);
+		entry->data = data + offset;
+		entry->len = len;
+		g_hash_table_replace(pack->entries,
+		                     g_strndup((const char *)p, name_len), entry);
+		p += name_len + 8;
+	}
+
+	if (i < count)
+	{
+		purple_debug_warning("imgstore", "Ignoring corrupt image pack %s\n", path);
+		_purple_image_pack_unref(pack);
+		return NULL;
+	}
+
+	purple_debug_info("imgstore", "Mapped %u images from %s\n", count, path);
+
+	return pack;
+}
+
+PurpleImagePack *
+_purple_image_pack_ref(PurpleImagePack *pack)
+{
+	g_return_val_if_fail(pack != NULL, NULL);
+
+	g_atomic_int_inc(&pack->refcount);
+
+	return pack;
+}
+
+void
+_purple_image_pack_unref(PurpleImagePack *pack)
+{
+	if (pack == NULL)
+		return;
+
+	if (!g_atomic_int_dec_and_test(&pack->refcount))
+		return;
+
+	g_hash_table_destroy(pack->entries);
+	image_pack_free_file(pack->file);
+	g_free(pack);
+}
+
+gconstpointer
+_purple_image_pack_lookup(PurpleImagePack *pack, const char *filename, gsize *len)
+{
+	PurpleImagePackEntry *entry;
+
+	if (pack == NULL || filename == NULL)
+		return NULL;
+
+	entry = g_hash_table_lookup(pack->entries, filename);
+	if (entry == NULL)
+		return NULL;
+
+	if (len != NULL)
+		*len = entry->len;
+
+	return entry->data;
+}
+
+guint
+_purple_image_pack_get_count(PurpleImagePack *pack)
+{
+	return pack ? g_hash_table_size(pack->entries) : 0;
+}
+
+gboolean
+_purple_image_pack_read(PurpleImagePack *pack, const char *dir,
+                        const char *filename, guchar **data, gsize *len,
+                        GError **error)
+{
+	gconstpointer packed;
+	char *path;
+	gboolean ret;
+
+	g_return_val_if_fail(filename != NULL, FALSE);
+	g_return_val_if_fail(data != NULL, FALSE);
+	g_return_val_if_fail(len != NULL, FALSE);
+
+	if ((packed = _purple_image_pack_lookup(pack, filename, len)) != NULL)
+	{
+		*data = g_memdup2(packed, *len);
+		return TRUE;
+	}
+
+	path = g_build_filename(dir, filename, NULL);
+	ret = g_file_get_contents(path, (gchar **)data, len, error);
+	g_free(path);
+
+	return ret;
+}
+
+/*
+ * Runs in the loader thread, so it must not use anything but glib.
+ */
+static gboolean
+image_job_build_pack(PurpleImageJob *job)
+{
+	GString *header;
+	GList *images = NULL, *l;
+	GSList *owned = NULL;
+	guint64 offset;
+	guint32 count = 0;
+	char *tmp_path;
+	char *new_path;
+	FILE *file;
+	gboolean ret = FALSE;
+
+	/* Gather the data first so the header can carry the offsets. */
+	offset = IMAGE_PACK_HEADER_LEN;
+	for (l = job->filenames; l != NULL; l = l->next)
+	{
+		const char *filename = l->data;
+		gconstpointer data;
+		gsize len = 0;
+
+		if (strlen(filename) > G_MAXUINT16)
+			continue;
+
+		data = _purple_image_pack_lookup(job->pack, filename, &len);
+		if (data == NULL)
+		{
+			guchar *read;
+
+			if (!_purple_image_pack_read(NULL, job->dir, filename,
+			                             &read, &len, NULL) || len == 0)
+			{
+				/* Deleted since it was referenced; leave it out. */
+				continue;
+			}
+			owned = g_slist_prepend(owned, read);
+			data = read;
+		}
+
+		images = g_list_prepend(images, (gpointer)data);
+		images = g_list_prepend(images, GSIZE_TO_POINTER(len));
+		images = g_list_prepend(images, (gpointer)filename);
+		offset += 2 + strlen(filename) + 8;
+		count++;
+	}
+	images = g_list_reverse(images);
+
+	header = g_string_new(NULL);
+	g_string_append_len(header, IMAGE_PACK_MAGIC, IMAGE_PACK_MAGIC_LEN);
+	image_pack_put_uint32(header, IMAGE_PACK_VERSION);
+	image_pack_put_uint32(header, count);
+
+	for (l = images; l != NULL; l = l->next->next->next)
+	{
+		const char *filename = l->data;
+		gsize len = GPOINTER_TO_SIZE(l->next->data);
+		guint16 name_len = GUINT16_TO_BE(strlen(filename));
+
+		if (offset + len > G_MAXUINT32)
+		{
+			job->error = g_strdup("The pack would be larger than 4 GiB");
+			goto out;
+		}
+
+		g_string_append_len(header, (const char *)&name_len, 2);
+		g_string_append(header, filename);
+		image_pack_put_uint32(header, (guint32)offset);
+		image_pack_put_uint32(header, (guint32)len);
+		offset += len;
+	}
+
+	tmp_path = g_strdup_printf("%s.save", job->filename);
+	if ((file = g_fopen(tmp_path, "wb")) == NULL)
+	{
+		job->error = g_strdup_printf("Unable to create %s: %s",
+		                             tmp_path, g_strerror(errno));
+		g_free(tmp_path);
+		goto out;
+	}
+
+	ret = (fwrite(header->str, header->len, 1, file) == 1);
+	for (l = images; ret && l != NULL; l = l->next->next->next)
+	{
+		gsize len = GPOINTER_TO_SIZE(l->next->data);
+		ret = (fwrite(l->next->next->data, len, 1, file) == 1);
+	}
+	if (fclose(file) != 0)
+		ret = FALSE;
+
+	if (!ret)
+		job->error = g_strdup_printf("Error writing %s: %s",
+		                             tmp_path, g_strerror(errno));
+
+#ifdef _WIN32
+	/* Windows won't rename over an existing file; this one is never
+	 * mapped, see _purple_image_pack_open(). */
+	new_path = g_strconcat(job->filename, IMAGE_PACK_NEW_SUFFIX, NULL);
+	if (ret)
+		g_unlink(new_path);
+#else
+	new_path = g_strdup(job->filename);
+#endif
+	if (ret && g_rename(tmp_path, new_path) != 0)
+	{
+		job->error = g_strdup_printf("Error renaming %s to %s: %s",
+		                             tmp_path, new_path, g_strerror(errno));
+		ret = FALSE;
+	}
+	if (!ret)
+		g_unlink(tmp_path);
+	g_free(tmp_path);
+	g_free(new_path);
+
+out:
+	g_string_free(header, TRUE);
+	g_list_free(images);
+	g_slist_foreach(owned, (GFunc)g_free, NULL);
+	g_slist_free(owned);
+
+	return ret;
+}
+
+static void
+image_job_free(PurpleImageJob *job)
+{
+	_purple_image_pack_unref(job->pack);
+	g_free(job->dir);
+	g_free(job->filename);
+	g_list_foreach(job->filenames, (GFunc)g_free, NULL);
+	g_list_free(job->filenames);
+	g_free(job->data);
+	g_free(job->error);
+	g_free(job);
+}
+
+static gboolean
+image_job_done_cb(gpointer data)
+{
+	PurpleImageJob *job = data;
+
+	if (image_jobs_outstanding != NULL)
+		g_hash_table_remove(image_jobs_outstanding, job);
+
+	if (job->error != NULL)
+		purple_debug_error("imgstore", "%s\n", job->error);
+
+	if (job->cb != NULL)
+	{
+		if (job->type == IMAGE_JOB_READ)
+		{
+			PurpleImageReadCallback cb = (PurpleImageReadCallback)job->cb;
+
+			cb(job->filename, job->data, job->len, job->user_data);
+			/* The callback took the data. */
+			job->data = NULL;
+		}
+		else
+		{
+			PurpleImagePackCallback cb = (PurpleImagePackCallback)job->cb;
+
+			cb(job->filename, job->success, job->user_data);
+		}
+	}
+
+	image_job_free(job);
+
+	return FALSE;
+}
+
+/*
+ * Does the work of a job, on the loader thread or, failing that, the main
+ * thread.
+ */
+static void
+image_job_run(PurpleImageJob *job)
+{
+	if (job->type == IMAGE_JOB_READ)
+	{
+		GError *err = NULL;
+
+		job->success = _purple_image_pack_read(job->pack, job->dir,
+		                                       job->filename, &job->data,
+		                                       &job->len, &err);
+		if (!job->success)
+		{
+			job->error = g_strdup_printf("Error reading %s: %s",
+			                             job->filename, err->message);
+			g_error_free(err);
+			job->data = NULL;
+			job->len = 0;
+		}
+	}
+	else
+		job->success = image_job_build_pack(job);
+
+	/* Let go of the mapping right away rather than on the main thread,
+	 * so it doesn't keep a rebuilt pack from replacing it on Windows. */
+	_purple_image_pack_unref(job->pack);
+	job->pack = NULL;
+}
+
+static gpointer
+image_loader_thread(gpointer data)
+{
+	GAsyncQueue *queue = data;
+	PurpleImageJob *job;
+
+	while ((job = g_async_queue_pop(queue))->type != IMAGE_JOB_QUIT)
+	{
+		image_job_run(job);
+
+		/* back to main thread */
+		purple_timeout_add(0, image_job_done_cb, job);
+	}
+
+	image_job_free(job);
+	g_async_queue_unref(queue);
+
+	return NULL;
+}
+
+static gboolean
+image_loader_start(GAsyncQueue *queue, GError **err)
+{
+#if GLIB_CHECK_VERSION(2, 32, 0)
+	GThread *thread = g_thread_try_new("image loader", image_loader_thread,
+	                                   queue, err);
+
+	if (thread == NULL)
+		return FALSE;
+
+	g_thread_unref(thread);
+	return TRUE;
+#else
+	return g_thread_create(image_loader_thread, queue, FALSE, err) != NULL;
+#endif
+}
+
+static void
+image_job_push(PurpleImageJob *job)
+{
+#if !GLIB_CHECK_VERSION(2, 32, 0)
+	/* Without threads the work is done right here, see below. */
+	if (!g_thread_supported())
+	{
+		image_job_run(job);
+		purple_timeout_add(0, image_job_done_cb, job);
+		return;
+	}
+#endif
+
+	if (image_jobs == NULL)
+	{
+		GError *err = NULL;
+
+		image_jobs = g_async_queue_new();
+		g_async_queue_ref(image_jobs);
+		if (!image_loader_start(image_jobs, &err))
+		{
+			purple_debug_error("imgstore", "Unable to start the image loader: %s\n",
+			                   (err && err->message) ? err->message : "Unknown reason");
+			if (err)
+				g_error_free(err);
+			g_async_queue_unref(image_jobs);
+			g_async_queue_unref(image_jobs);
+			image_jobs = NULL;
+
+			/* Do the work here instead, but still call back later. */
+			image_job_run(job);
+			purple_timeout_add(0, image_job_done_cb, job);
+			return;
+		}
+	}
+
+	g_async_queue_push(image_jobs, job);
+}
+
+static PurpleImageJob *
+image_job_new(PurpleImageJobType type, PurpleImagePack *pack, const char *dir,
+              const char *filename, GCallback cb, gpointer user_data)
+{
+	PurpleImageJob *job = g_new0(PurpleImageJob, 1);
+
+	job->type = type;
+	job->pack = pack ? _purple_image_pack_ref(pack) : NULL;
+	job->dir = g_strdup(dir);
+	job->filename = g_strdup(filename);
+	job->cb = cb;
+	job->user_data = user_data;
+
+	g_hash_table_insert(image_jobs_outstanding, job, job);
+
+	return job;
+}
+
+void
+_purple_image_read_async(PurpleImagePack *pack, const char *dir,
+                         const char *filename, PurpleImageReadCallback cb,
+                         gpointer user_data)
+{
+	g_return_if_fail(dir != NULL);
+	g_return_if_fail(filename != NULL);
+	g_return_if_fail(cb != NULL);
+
+	image_job_push(image_job_new(IMAGE_JOB_READ, pack, dir, filename,
+	                             G_CALLBACK(cb), user_data));
+}
+
+void
+_purple_image_pack_build_async(const char *path, PurpleImagePack *old_pack,
+                               const char *dir, GList *filenames,
+                               PurpleImagePackCallback cb, gpointer user_data)
+{
+	PurpleImageJob *job;
+
+	g_return_if_fail(path != NULL);
+	g_return_if_fail(dir != NULL);
+
+	job = image_job_new(IMAGE_JOB_BUILD_PACK, old_pack, dir, path,
+	                    G_CALLBACK(cb), user_data);
+	for (; filenames != NULL; filenames = filenames->next)
+		job->filenames = g_list_prepend(job->filenames, g_strdup(filenames->data));
+	job->filenames = g_list_reverse(job->filenames);
+
+	image_job_push(job);
+}
+
+static void
+image_job_cancel(gpointer key, gpointer value, gpointer user_data)
+{
+	PurpleImageJob *job = value;
+
+	if (job->user_data == user_data)
+		job->cb = NULL;
+}
+
+static void
+image_job_cancel_all(gpointer key, gpointer value, gpointer user_data)
+{
+	PurpleImageJob *job = value;
+
+	job->cb = NULL;
+}
+
+void
+_purple_image_jobs_cancel(gpointer user_data)
+{
+	g_hash_table_foreach(image_jobs_outstanding, image_job_cancel, user_data);
+}
+
 void *
 purple_imgstore_get_handle()
 {
@@ -220,6 +844,7 @@ purple_imgstore_init()
 	                                        PURPLE_SUBTYPE_STORED_IMAGE));
 
 	imgstore = g_hash_table_new(g_int_hash, g_int_equal);
+	image_jobs_outstanding = g_hash_table_new(g_direct_hash, g_direct_equal);
 }
 
 void
@@ -227,5 +852,19 @@ purple_imgstore_uninit()
 {
 	g_hash_table_destroy(imgstore);
 
+	if (image_jobs != NULL)
+	{
+		/* The thread finishes what it has and quits on its own. */
+		PurpleImageJob *job = g_new0(PurpleImageJob, 1);
+		job->type = IMAGE_JOB_QUIT;
+		g_async_queue_push(image_jobs, job);
+		g_async_queue_unref(image_jobs);
+		image_jobs = NULL;
+	}
+	/* Jobs still in flight would call back into a dead core. */
+	g_hash_table_foreach(image_jobs_outstanding, image_job_cancel_all, NULL);
+	g_hash_table_destroy(image_jobs_outstanding);
+	image_jobs_outstanding = NULL;
+
 	purple_signals_unregister_by_instance(purple_imgstore_get_handle());
 }
@@ -174,6 +174,7 @@ typedef union
 
 #include "account.h"
 #include "connection.h"
+#include "signals.h"
 
 /* This is for the accounts code to notify the buddy icon code that
  * it's done loading.  We may want to replace this with a signal. */
@@ -245,4 +246,191 @@ void _purple_connection_destroy(PurpleConnection *gc);
 gboolean
 _purple_network_set_common_socket_flags(int fd);
 
+/**
+ * Closes the connections kept open by purple_util_fetch_url_request()
+ * for later requests.  This must happen before SSL is uninitialized.
+ */
+void
+_purple_util_fetch_url_close_idle(void);
+
+/**
+ * Calls @a func with the name and the signal of every registered signal
+ * exported over D-Bus, until it returns @c TRUE.
+ *
+ * @return @c TRUE if @a func returned @c TRUE for a signal.
+ */
+gboolean
+_purple_signals_find_dbus_exported(GHRFunc func, gpointer user_data);
+
+/**
+ * Conversation signals emitted for every message or typing notification.
+ * The core emits them through the signals resolved by
+ * purple_conversations_init().
+ */
+typedef enum
+{
+	PURPLE_CONV_SIGNAL_WRITING_IM_MSG,
+	PURPLE_CONV_SIGNAL_WROTE_IM_MSG,
+	PURPLE_CONV_SIGNAL_SENDING_IM_MSG,
+	PURPLE_CONV_SIGNAL_SENT_IM_MSG,
+	PURPLE_CONV_SIGNAL_RECEIVING_IM_MSG,
+	PURPLE_CONV_SIGNAL_RECEIVED_IM_MSG,
+	PURPLE_CONV_SIGNAL_WRITING_CHAT_MSG,
+	PURPLE_CONV_SIGNAL_WROTE_CHAT_MSG,
+	PURPLE_CONV_SIGNAL_SENDING_CHAT_MSG,
+	PURPLE_CONV_SIGNAL_SENT_CHAT_MSG,
+	PURPLE_CONV_SIGNAL_RECEIVING_CHAT_MSG,
+	PURPLE_CONV_SIGNAL_RECEIVED_CHAT_MSG,
+	PURPLE_CONV_SIGNAL_BUDDY_TYPING,
+	PURPLE_CONV_SIGNAL_BUDDY_TYPED,
+	PURPLE_CONV_SIGNAL_BUDDY_TYPING_STOPPED,
+	PURPLE_CONV_SIGNAL_CONVERSATION_UPDATED,
+	PURPLE_CONV_SIGNAL_LAST
+} PurpleConvSignal;
+
+/**
+ * Returns one of the conversation signals resolved at initialization.
+ *
+ * @param which The signal.
+ *
+ * @return The signal, for use with purple_signal_emit_resolved().
+ */
+PurpleSignal *
+_purple_conversations_get_signal(PurpleConvSignal which);
+
+/**
+ * Invalidates every cached presence score, because the score preferences
+ * or an account's "score" setting changed.  This also makes every contact
+ * pick its priority buddy again.
+ */
+void
+_purple_presence_scores_changed(void);
+
+/**
+ * Marks the priority buddy of every contact as needing to be recomputed,
+ * in one walk of the buddy list.
+ */
+void
+_purple_blist_invalidate_priorities(void);
+
+/**
+ * Forgets every cached SRV and TXT answer.
+ */
+void
+_purple_srv_txt_cache_clear(void);
+
+/**
+ * A mapped, read-only pack of the images in a cache directory, keyed by
+ * their content-addressed filenames.  See imgstore.c for the layout.
+ */
+typedef struct _PurpleImagePack PurpleImagePack;
+
+/**
+ * Called on the main thread once an image has been read.
+ *
+ * @param filename  The image's filename.
+ * @param data      The image data, which the callback takes ownership
+ *                  of, or @c NULL if it could not be read.
+ * @param len       The length of @a data.
+ * @param user_data The data passed to _purple_image_read_async().
+ */
+typedef void (*PurpleImageReadCallback)(const char *filename, guchar *data,
+                                        gsize len, gpointer user_data);
+
+/**
+ * Called on the main thread once a pack has been written.
+ *
+ * @param path      The pack's path.
+ * @param success   Whether the pack was written.
+ * @param user_data The data passed to _purple_image_pack_build_async().
+ */
+typedef void (*PurpleImagePackCallback)(const char *path, gboolean success,
+                                        gpointer user_data);
+
+/**
+ * Maps an image pack.
+ *
+ * @param path The pack's path.
+ *
+ * @return The pack, or @c NULL if it does not exist or is invalid.
+ */
+PurpleImagePack *
+_purple_image_pack_open(const char *path);
+
+PurpleImagePack *
+_purple_image_pack_ref(PurpleImagePack *pack);
+
+void
+_purple_image_pack_unref(PurpleImagePack *pack);
+
+/**
+ * Looks up an image in a pack.
+ *
+ * @param pack     The pack, which may be @c NULL.
+ * @param filename The image's filename.
+ * @param len      Return location for the image's length.
+ *
+ * @return The image data inside the mapping, or @c NULL if the pack does
+ *         not have it.
+ */
+gconstpointer
+_purple_image_pack_lookup(PurpleImagePack *pack, const char *filename, gsize *len);
+
+/**
+ * Returns the number of images in a pack, which may be @c NULL.
+ */
+guint
+_purple_image_pack_get_count(PurpleImagePack *pack);
+
+/**
+ * Reads an image from a pack, falling back to the file of the same name
+ * in @a dir.  This is safe to call from any thread.
+ *
+ * @param pack     The pack, which may be @c NULL.
+ * @param dir      The directory the pack was built from.
+ * @param filename The image's filename.
+ * @param data     Return location for a copy of the image data.
+ * @param len      Return location for the image's length.
+ * @param error    Return location for an error, or @c NULL.
+ *
+ * @return @c TRUE if the image was read.
+ */
+gboolean
+_purple_image_pack_read(PurpleImagePack *pack, const char *dir,
+                        const char *filename, guchar **data, gsize *len,
+                        GError **error);
+
+/**
+ * Reads an image like _purple_image_pack_read(), but on the image loader
+ * thread, and hands it to @a cb on the main thread.
+ */
+void
+_purple_image_read_async(PurpleImagePack *pack, const char *dir,
+                         const char *filename, PurpleImageReadCallback cb,
+                         gpointer user_data);
+
+/**
+ * Writes a new pack of the named images on the image loader thread.  The
+ * images are copied from @a old_pack when it has them, and read from
+ * @a dir otherwise.  Images that cannot be read are left out.
+ *
+ * @param path      Where to write the pack.
+ * @param old_pack  The pack currently mapped from @a path, or @c NULL.
+ * @param dir       The directory holding the images.
+ * @param filenames The filenames of the images to pack.
+ * @param cb        Called on the main thread when done, or @c NULL.
+ * @param user_data Data to pass to @a cb.
+ */
+void
+_purple_image_pack_build_async(const char *path, PurpleImagePack *old_pack,
+                               const char *dir, GList *filenames,
+                               PurpleImagePackCallback cb, gpointer user_data);
+
+/**
+ * Keeps the callbacks of outstanding image reads and pack builds started
+ * with @a user_data from being called.
+ */
+void
+_purple_image_jobs_cancel(gpointer user_data);
+
 #endif /* _PURPLE_INTERNAL_H_ */
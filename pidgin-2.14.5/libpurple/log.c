@@ -49,8 +49,79 @@ struct _purple_logsize_user {
 static GHashTable *logsize_users = NULL;
 static GHashTable *logsize_users_decayed = NULL;
 
+/*
+ * With /purple/logging/flush_delay set, the html and txt loggers leave
+ * written messages in the stdio buffer of the log file and flush every
+ * log in this set at most that many seconds later, instead of calling
+ * fflush() after each message.  A full buffer or finalizing the log
+ * flushes it earlier.
+ */
+#define LOG_FILE_BUFFER_SIZE (32 * 1024)
+static GHashTable *unflushed_logs = NULL;
+static guint flush_timer = 0;
+
+/*
+ * The log index remembers the size of every file in each log directory
+ * the common loggers have listed, so listing and sizing logs does not
+ * need a stat() per file.  It is keyed by the directory's path, and a
+ * directory is only scanned again when its mtime changes.  Appends made
+ * through purple_log_write() update the sizes directly.  The index is
+ * kept in logs/index.xml between sessions.
+ */
+#define LOG_INDEX_FILE "logs" G_DIR_SEPARATOR_S "index.xml"
+
+typedef struct {
+	time_t mtime;
+	time_t scanned;
+	GHashTable *sizes; /* filename -> gint64 size */
+} PurpleLogIndexDir;
+
+static GHashTable *log_index = NULL;
+static guint log_index_save_timer = 0;
+
+/*
+ * The search index maps every trigram in the plain text of a log file to
+ * the files containing it, so purple_log_search() only reads the logs
+ * that could match.  There is one index per log directory, saved under
+ * logsearch/ in the user directory.  Trigrams are taken over bytes with
+ * ASCII letters lowercased, matching purple_strcasestr().  Whatever
+ * purple_log_write() appends to a log is indexed by the next search
+ * covering it, from the bytes actually written; a log that changed in
+ * any other way is read and indexed again in full.
+ */
+#define LOG_SEARCH_MAGIC "PLS2"
+
+typedef struct {
+	char *name;
+	gint64 size;            /* bytes of the file indexed, -1 if unknown */
+	gint64 end;             /* size reached by our own appends, -1 if unknown */
+} PurpleLogSearchFile;
+
+typedef struct {
+	char *index_path;       /* NULL if the index is not saved */
+	GPtrArray *files;       /* id -> PurpleLogSearchFile, NULL if dropped */
+	GHashTable *ids;        /* filename -> id + 1 */
+	GHashTable *postings;   /* trigram -> GArray of ascending guint32 ids */
+	gboolean dirty;
+} PurpleLogSearchDir;
+
+static GHashTable *log_search_dirs = NULL;
+static guint log_search_save_timer = 0;
+
 static void log_get_log_sets_common(GHashTable *sets);
 
+static void log_index_load(void);
+static void log_index_sync(void);
+static PurpleLogIndexDir *log_index_lookup(const char *path);
+static gboolean log_index_get_size(const char *path, gint64 *size);
+static void log_index_grow(PurpleLogCommonLoggerData *data, gsize written);
+static void log_index_forget(const char *path);
+
+static void log_search_dir_free(PurpleLogSearchDir *dir);
+static void log_search_sync(void);
+static void log_search_append(PurpleLog *log, gsize written);
+static void log_search_forget(const char *path);
+
 static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
 							  const char *from, time_t time, const char *message);
 static void html_logger_finalize(PurpleLog *log);
@@ -157,6 +228,12 @@ void purple_log_write(PurpleLog *log, PurpleMessageFlags type,
 
 	written = (log->logger->write)(log, type, from, time, message);
 
+	/* Only loggers built on the common functions have files to index */
+	if (log->logger->size == purple_log_common_sizer) {
+		log_index_grow(log->logger_data, written);
+		log_search_append(log, written);
+	}
+
 	lu = g_new(struct _purple_logsize_user, 1);
 
 	lu->name = g_strdup(purple_normalize(log->account, log->name));
@@ -651,6 +728,7 @@ void purple_log_init(void)
 	purple_prefs_add_bool("/purple/logging/log_system", FALSE);
 
 	purple_prefs_add_string("/purple/logging/format", "html");
+	purple_prefs_add_int("/purple/logging/flush_delay", 0);
 
 	html_logger = purple_log_logger_new("html", _("HTML"), 11,
 									  NULL,
@@ -722,6 +800,56 @@ void purple_log_init(void)
 	logsize_users_decayed = g_hash_table_new_full((GHashFunc)_purple_logsize_user_hash,
 				(GEqualFunc)_purple_logsize_user_equal,
 				(GDestroyNotify)_purple_logsize_user_free_key, NULL);
+	unflushed_logs = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	log_index_load();
+	log_search_dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)log_search_dir_free);
+}
+
+static void
+log_flush_file(gpointer key, gpointer value, gpointer user_data)
+{
+	PurpleLog *log = key;
+	PurpleLogCommonLoggerData *data = log->logger_data;
+
+	if (data != NULL && data->file != NULL)
+		fflush(data->file);
+}
+
+static gboolean
+log_flush_all(gpointer unused)
+{
+	g_hash_table_foreach(unflushed_logs, log_flush_file, NULL);
+	g_hash_table_remove_all(unflushed_logs);
+	flush_timer = 0;
+
+	return FALSE;
+}
+
+/* Called by the html and txt loggers after each message */
+static void
+log_common_flush(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	int delay = purple_prefs_get_int("/purple/logging/flush_delay");
+
+	if (delay <= 0) {
+		fflush(data->file);
+		return;
+	}
+
+	g_hash_table_insert(unflushed_logs, log, log);
+	if (flush_timer == 0)
+		flush_timer = purple_timeout_add_seconds(delay, log_flush_all, NULL);
+}
+
+/* Called by the html and txt loggers before closing the log file */
+static void
+log_common_forget(PurpleLog *log)
+{
+	if (unflushed_logs != NULL)
+		g_hash_table_remove(unflushed_logs, log);
 }
 
 void
@@ -741,10 +869,955 @@ purple_log_uninit(void)
 	purple_log_logger_free(old_logger);
 	old_logger = NULL;
 
+	if (flush_timer != 0) {
+		purple_timeout_remove(flush_timer);
+		flush_timer = 0;
+	}
+	log_flush_all(NULL);
+	g_hash_table_destroy(unflushed_logs);
+	unflushed_logs = NULL;
+
+	log_index_sync();
+	g_hash_table_destroy(log_index);
+	log_index = NULL;
+
+	log_search_sync();
+	g_hash_table_destroy(log_search_dirs);
+	log_search_dirs = NULL;
+
 	g_hash_table_destroy(logsize_users);
 	g_hash_table_destroy(logsize_users_decayed);
 }
 
+/****************************************************************************
+ * LOG INDEX ****************************************************************
+ ****************************************************************************/
+
+static void
+log_index_dir_free(PurpleLogIndexDir *dir)
+{
+	g_hash_table_destroy(dir->sizes);
+	g_free(dir);
+}
+
+static PurpleLogIndexDir *
+log_index_dir_new(time_t mtime, time_t scanned)
+{
+	PurpleLogIndexDir *dir = g_new0(PurpleLogIndexDir, 1);
+
+	dir->mtime = mtime;
+	dir->scanned = scanned;
+	dir->sizes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+	return dir;
+}
+
+/* Takes ownership of filename. */
+static void
+log_index_set_size(PurpleLogIndexDir *dir, char *filename, gint64 size)
+{
+	gint64 *value = g_new(gint64, 1);
+
+	*value = size;
+	g_hash_table_replace(dir->sizes, filename, value);
+}
+
+static xmlnode *
+log_index_dir_to_xmlnode(const char *name, PurpleLogIndexDir *dir)
+{
+	xmlnode *node;
+	GHashTableIter iter;
+	gpointer filename, size;
+	char *tmp;
+
+	node = xmlnode_new("dir");
+	xmlnode_set_attrib(node, "name", name);
+	tmp = g_strdup_printf("%" G_GINT64_FORMAT, (gint64)dir->mtime);
+	xmlnode_set_attrib(node, "mtime", tmp);
+	g_free(tmp);
+	tmp = g_strdup_printf("%" G_GINT64_FORMAT, (gint64)dir->scanned);
+	xmlnode_set_attrib(node, "scanned", tmp);
+	g_free(tmp);
+
+	g_hash_table_iter_init(&iter, dir->sizes);
+	while (g_hash_table_iter_next(&iter, &filename, &size)) {
+		xmlnode *child = xmlnode_new_child(node, "log");
+
+		xmlnode_set_attrib(child, "name", filename);
+		tmp = g_strdup_printf("%" G_GINT64_FORMAT, *(gint64 *)size);
+		xmlnode_set_attrib(child, "size", tmp);
+		g_free(tmp);
+	}
+
+	return node;
+}
+
+static void
+log_index_sync(void)
+{
+	xmlnode *root;
+	GHashTableIter iter;
+	gpointer key, value;
+	char *logs_dir;
+	size_t len;
+
+	if (log_index_save_timer == 0)
+		return;
+
+	purple_timeout_remove(log_index_save_timer);
+	log_index_save_timer = 0;
+
+	/* Nothing to write about if no log directory was ever created */
+	logs_dir = g_build_filename(purple_user_dir(), "logs", NULL);
+	if (!g_file_test(logs_dir, G_FILE_TEST_IS_DIR)) {
+		g_free(logs_dir);
+		return;
+	}
+	len = strlen(logs_dir);
+
+	root = xmlnode_new("logindex");
+	xmlnode_set_attrib(root, "version", "1.0");
+
+	/* Directories are stored relative to the logs directory */
+	g_hash_table_iter_init(&iter, log_index);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		const char *path = key;
+
+		if (strncmp(path, logs_dir, len) == 0 && path[len] == G_DIR_SEPARATOR)
+			xmlnode_insert_child(root,
+					log_index_dir_to_xmlnode(path + len + 1, value));
+	}
+	g_free(logs_dir);
+
+	purple_util_write_xml_to_file(LOG_INDEX_FILE, root);
+	xmlnode_free(root);
+}
+
+static gboolean
+log_index_save_cb(gpointer data)
+{
+	/* log_index_sync() removes the timer itself */
+	log_index_sync();
+	return FALSE;
+}
+
+static void
+log_index_schedule_save(void)
+{
+	if (log_index_save_timer == 0)
+		log_index_save_timer = purple_timeout_add_seconds(5, log_index_save_cb, NULL);
+}
+
+static void
+log_index_load(void)
+{
+	xmlnode *root, *node;
+	char *logs_dir;
+
+	log_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)log_index_dir_free);
+
+	root = purple_util_read_xml_from_file(LOG_INDEX_FILE, _("log index"));
+	if (root == NULL)
+		return;
+
+	logs_dir = g_build_filename(purple_user_dir(), "logs", NULL);
+
+	for (node = xmlnode_get_child(root, "dir"); node != NULL;
+			node = xmlnode_get_next_twin(node)) {
+		const char *name = xmlnode_get_attrib(node, "name");
+		const char *mtime = xmlnode_get_attrib(node, "mtime");
+		const char *scanned = xmlnode_get_attrib(node, "scanned");
+		PurpleLogIndexDir *dir;
+		xmlnode *child;
+
+		if (name == NULL || mtime == NULL || scanned == NULL)
+			continue;
+
+		dir = log_index_dir_new((time_t)g_ascii_strtoll(mtime, NULL, 10),
+				(time_t)g_ascii_strtoll(scanned, NULL, 10));
+
+		for (child = xmlnode_get_child(node, "log"); child != NULL;
+				child = xmlnode_get_next_twin(child)) {
+			const char *filename = xmlnode_get_attrib(child, "name");
+			const char *size = xmlnode_get_attrib(child, "size");
+
+			if (filename != NULL && size != NULL)
+				log_index_set_size(dir, g_strdup(filename),
+						g_ascii_strtoll(size, NULL, 10));
+		}
+
+		g_hash_table_replace(log_index,
+				g_build_filename(logs_dir, name, NULL), dir);
+	}
+
+	g_free(logs_dir);
+	xmlnode_free(root);
+}
+
+/*
+ * Returns the index entry of the log directory at path, scanning the
+ * directory first if it changed since it was last indexed.  Returns NULL
+ * if the directory does not exist.
+ */
+static PurpleLogIndexDir *
+log_index_lookup(const char *path)
+{
+	PurpleLogIndexDir *dir;
+	struct stat st;
+	GDir *gdir;
+	const char *filename;
+
+	if (g_stat(path, &st) != 0) {
+		if (g_hash_table_remove(log_index, path))
+			log_index_schedule_save();
+		return NULL;
+	}
+
+	/* A change within the second of the last scan would not have moved
+	 * the mtime, so such an entry is not trusted. */
+	dir = g_hash_table_lookup(log_index, path);
+	if (dir != NULL && dir->mtime == st.st_mtime && dir->mtime < dir->scanned)
+		return dir;
+
+	if (!(gdir = g_dir_open(path, 0, NULL)))
+		return NULL;
+
+	/* Make sure the sizes we read include everything written so far */
+	if (flush_timer != 0) {
+		purple_timeout_remove(flush_timer);
+		log_flush_all(NULL);
+	}
+
+	dir = log_index_dir_new(st.st_mtime, time(NULL));
+	g_hash_table_replace(log_index, g_strdup(path), dir);
+
+	while ((filename = g_dir_read_name(gdir)))
+	{
+		char *tmp = g_build_filename(path, filename, NULL);
+
+		if (g_stat(tmp, &st))
+			purple_debug_error("log", "Error stating log file: %s\n", tmp);
+		else
+			log_index_set_size(dir, g_strdup(filename), (gint64)st.st_size);
+		g_free(tmp);
+	}
+	g_dir_close(gdir);
+
+	log_index_schedule_save();
+	return dir;
+}
+
+/*
+ * Looks up the size of the log file at path in the index without
+ * checking the directory for changes; the caller is expected to have
+ * just listed it.
+ */
+static gboolean
+log_index_get_size(const char *path, gint64 *size)
+{
+	PurpleLogIndexDir *dir;
+	char *dirname, *basename;
+	gpointer value;
+	gboolean found = FALSE;
+
+	dirname = g_path_get_dirname(path);
+	dir = g_hash_table_lookup(log_index, dirname);
+	g_free(dirname);
+	if (dir == NULL)
+		return FALSE;
+
+	basename = g_path_get_basename(path);
+	if (g_hash_table_lookup_extended(dir->sizes, basename, NULL, &value)) {
+		*size = *(gint64 *)value;
+		found = TRUE;
+	}
+	g_free(basename);
+
+	return found;
+}
+
+static void
+log_index_grow(PurpleLogCommonLoggerData *data, gsize written)
+{
+	PurpleLogIndexDir *dir;
+	char *dirname;
+
+	if (log_index == NULL || data == NULL || data->path == NULL || written == 0)
+		return;
+
+	dirname = g_path_get_dirname(data->path);
+	dir = g_hash_table_lookup(log_index, dirname);
+	g_free(dirname);
+
+	if (dir != NULL) {
+		char *basename = g_path_get_basename(data->path);
+		gint64 *size = g_hash_table_lookup(dir->sizes, basename);
+
+		log_index_set_size(dir, basename, (size ? *size : 0) + (gint64)written);
+		log_index_schedule_save();
+	}
+}
+
+static void
+log_index_forget(const char *path)
+{
+	PurpleLogIndexDir *dir;
+	char *dirname;
+
+	dirname = g_path_get_dirname(path);
+	dir = g_hash_table_lookup(log_index, dirname);
+	g_free(dirname);
+
+	if (dir != NULL) {
+		char *basename = g_path_get_basename(path);
+
+		if (g_hash_table_remove(dir->sizes, basename))
+			log_index_schedule_save();
+		g_free(basename);
+	}
+}
+
+/****************************************************************************
+ * LOG SEARCH ***************************************************************
+ ****************************************************************************/
+
+#define LOG_SEARCH_TRIGRAM(p) \
+	(((guint32)(guchar)g_ascii_tolower((p)[0]) << 16) | \
+	 ((guint32)(guchar)g_ascii_tolower((p)[1]) << 8) | \
+	 (guint32)(guchar)g_ascii_tolower((p)[2]))
+
+static void
+log_search_file_free(PurpleLogSearchFile *file)
+{
+	if (file == NULL)
+		return;
+
+	g_free(file->name);
+	g_free(file);
+}
+
+static void
+log_search_posting_free(GArray *posting)
+{
+	g_array_free(posting, TRUE);
+}
+
+static void
+log_search_dir_free(PurpleLogSearchDir *dir)
+{
+	g_free(dir->index_path);
+	g_ptr_array_foreach(dir->files, (GFunc)log_search_file_free, NULL);
+	g_ptr_array_free(dir->files, TRUE);
+	g_hash_table_destroy(dir->ids);
+	g_hash_table_destroy(dir->postings);
+	g_free(dir);
+}
+
+static void
+log_search_dir_clear(PurpleLogSearchDir *dir)
+{
+	g_ptr_array_foreach(dir->files, (GFunc)log_search_file_free, NULL);
+	g_ptr_array_set_size(dir->files, 0);
+	g_hash_table_remove_all(dir->ids);
+	g_hash_table_remove_all(dir->postings);
+}
+
+static guint32
+log_search_file_add(PurpleLogSearchDir *dir, const char *name, gint64 size)
+{
+	PurpleLogSearchFile *file = g_new(PurpleLogSearchFile, 1);
+	guint32 id = dir->files->len;
+
+	file->name = g_strdup(name);
+	file->size = size;
+	file->end = size;
+	g_ptr_array_add(dir->files, file);
+	g_hash_table_replace(dir->ids, file->name, GUINT_TO_POINTER(id + 1));
+
+	return id;
+}
+
+static PurpleLogSearchFile *
+log_search_file_lookup(PurpleLogSearchDir *dir, const char *name, guint32 *id)
+{
+	gpointer value = g_hash_table_lookup(dir->ids, name);
+
+	if (value == NULL)
+		return NULL;
+
+	*id = GPOINTER_TO_UINT(value) - 1;
+	return g_ptr_array_index(dir->files, *id);
+}
+
+/* The postings of a dropped file are skipped by searches and left out
+ * the next time the index is saved. */
+static void
+log_search_file_drop(PurpleLogSearchDir *dir, guint32 id)
+{
+	PurpleLogSearchFile *file = g_ptr_array_index(dir->files, id);
+
+	g_hash_table_remove(dir->ids, file->name);
+	log_search_file_free(file);
+	g_ptr_array_index(dir->files, id) = NULL;
+	dir->dirty = TRUE;
+}
+
+static gboolean
+log_search_posting_find(GArray *posting, guint32 id, guint *index)
+{
+	guint low = 0, high = posting->len;
+
+	while (low < high) {
+		guint mid = (low + high) / 2;
+		guint32 value = g_array_index(posting, guint32, mid);
+
+		if (value == id) {
+			*index = mid;
+			return TRUE;
+		}
+		if (value < id)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	*index = low;
+	return FALSE;
+}
+
+static void
+log_search_add_text(PurpleLogSearchDir *dir, guint32 id, const char *text)
+{
+	size_t len = strlen(text);
+	size_t i;
+
+	for (i = 0; i + 3 <= len; i++) {
+		gpointer trigram = GUINT_TO_POINTER(LOG_SEARCH_TRIGRAM(text + i));
+		GArray *posting = g_hash_table_lookup(dir->postings, trigram);
+		guint index;
+
+		if (posting == NULL) {
+			posting = g_array_new(FALSE, FALSE, sizeof(guint32));
+			g_hash_table_insert(dir->postings, trigram, posting);
+		}
+
+		/* Text is nearly always added to the newest file */
+		if (posting->len > 0 && g_array_index(posting, guint32, posting->len - 1) == id)
+			continue;
+
+		if (!log_search_posting_find(posting, id, &index))
+			g_array_insert_val(posting, index, id);
+	}
+
+	dir->dirty = TRUE;
+}
+
+static void
+log_search_put_uint32(GString *buf, guint32 value)
+{
+	value = GUINT32_TO_LE(value);
+	g_string_append_len(buf, (const char *)&value, sizeof(value));
+}
+
+static void
+log_search_put_uint64(GString *buf, guint64 value)
+{
+	value = GUINT64_TO_LE(value);
+	g_string_append_len(buf, (const char *)&value, sizeof(value));
+}
+
+static gboolean
+log_search_get_uint32(const char **cur, const char *end, guint32 *value)
+{
+	if (end - *cur < (gssize)sizeof(*value))
+		return FALSE;
+
+	memcpy(value, *cur, sizeof(*value));
+	*value = GUINT32_FROM_LE(*value);
+	*cur += sizeof(*value);
+
+	return TRUE;
+}
+
+static gboolean
+log_search_get_uint64(const char **cur, const char *end, guint64 *value)
+{
+	if (end - *cur < (gssize)sizeof(*value))
+		return FALSE;
+
+	memcpy(value, *cur, sizeof(*value));
+	*value = GUINT64_FROM_LE(*value);
+	*cur += sizeof(*value);
+
+	return TRUE;
+}
+
+static gboolean
+log_search_dir_parse(PurpleLogSearchDir *dir, const char *cur, const char *end)
+{
+	guint32 nfiles, ntrigrams, i, j;
+
+	if (end - cur < 4 || memcmp(cur, LOG_SEARCH_MAGIC, 4) != 0)
+		return FALSE;
+	cur += 4;
+
+	if (!log_search_get_uint32(&cur, end, &nfiles))
+		return FALSE;
+
+	for (i = 0; i < nfiles; i++) {
+		guint32 len;
+		guint64 size;
+		char *name;
+
+		if (!log_search_get_uint32(&cur, end, &len) || (guint32)(end - cur) < len)
+			return FALSE;
+		name = g_strndup(cur, len);
+		cur += len;
+
+		if (!log_search_get_uint64(&cur, end, &size) ||
+				(size > G_MAXINT64 && size != G_MAXUINT64)) {
+			g_free(name);
+			return FALSE;
+		}
+
+		log_search_file_add(dir, name, size == G_MAXUINT64 ? -1 : (gint64)size);
+		g_free(name);
+	}
+
+	if (!log_search_get_uint32(&cur, end, &ntrigrams))
+		return FALSE;
+
+	for (i = 0; i < ntrigrams; i++) {
+		guint32 trigram, count;
+		GArray *posting;
+
+		if (!log_search_get_uint32(&cur, end, &trigram) ||
+				!log_search_get_uint32(&cur, end, &count) ||
+				(guint32)(end - cur) / sizeof(guint32) < count)
+			return FALSE;
+
+		posting = g_array_sized_new(FALSE, FALSE, sizeof(guint32), count);
+		g_hash_table_replace(dir->postings, GUINT_TO_POINTER(trigram), posting);
+
+		for (j = 0; j < count; j++) {
+			guint32 id;
+
+			log_search_get_uint32(&cur, end, &id);
+			if (id >= nfiles)
+				return FALSE;
+			g_array_append_val(posting, id);
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+log_search_dir_save(PurpleLogSearchDir *dir)
+{
+	GString *buf;
+	GHashTableIter iter;
+	gpointer key, value;
+	guint32 *remap;
+	guint32 nfiles = 0, ntrigrams = 0, i;
+	gsize ntrigrams_offset;
+	char *dirname;
+
+	dir->dirty = FALSE;
+	if (dir->index_path == NULL)
+		return;
+
+	/* Dropped files are left out, and the ids of the others renumbered */
+	remap = g_new(guint32, dir->files->len);
+	for (i = 0; i < dir->files->len; i++)
+		remap[i] = g_ptr_array_index(dir->files, i) ? nfiles++ : G_MAXUINT32;
+
+	buf = g_string_new(LOG_SEARCH_MAGIC);
+	log_search_put_uint32(buf, nfiles);
+	for (i = 0; i < dir->files->len; i++) {
+		PurpleLogSearchFile *file = g_ptr_array_index(dir->files, i);
+
+		if (file == NULL)
+			continue;
+
+		log_search_put_uint32(buf, strlen(file->name));
+		g_string_append(buf, file->name);
+		log_search_put_uint64(buf, file->size < 0 ? G_MAXUINT64 : (guint64)file->size);
+	}
+
+	ntrigrams_offset = buf->len;
+	log_search_put_uint32(buf, 0);
+
+	g_hash_table_iter_init(&iter, dir->postings);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		GArray *posting = value;
+		gsize count_offset;
+		guint32 count = 0;
+
+		log_search_put_uint32(buf, GPOINTER_TO_UINT(key));
+		count_offset = buf->len;
+		log_search_put_uint32(buf, 0);
+
+		for (i = 0; i < posting->len; i++) {
+			guint32 id = remap[g_array_index(posting, guint32, i)];
+
+			if (id != G_MAXUINT32) {
+				log_search_put_uint32(buf, id);
+				count++;
+			}
+		}
+
+		if (count == 0) {
+			g_string_truncate(buf, count_offset - sizeof(guint32));
+			continue;
+		}
+
+		count = GUINT32_TO_LE(count);
+		memcpy(buf->str + count_offset, &count, sizeof(count));
+		ntrigrams++;
+	}
+
+	ntrigrams = GUINT32_TO_LE(ntrigrams);
+	memcpy(buf->str + ntrigrams_offset, &ntrigrams, sizeof(ntrigrams));
+	g_free(remap);
+
+	dirname = g_path_get_dirname(dir->index_path);
+	purple_build_dir(dirname, S_IRUSR | S_IWUSR | S_IXUSR);
+	g_free(dirname);
+
+	purple_util_write_data_to_file_absolute(dir->index_path, buf->str, buf->len);
+	g_string_free(buf, TRUE);
+}
+
+static void
+log_search_save_dirty(gpointer key, gpointer value, gpointer user_data)
+{
+	PurpleLogSearchDir *dir = value;
+
+	if (dir->dirty)
+		log_search_dir_save(dir);
+}
+
+static void
+log_search_sync(void)
+{
+	if (log_search_save_timer == 0)
+		return;
+
+	purple_timeout_remove(log_search_save_timer);
+	log_search_save_timer = 0;
+
+	g_hash_table_foreach(log_search_dirs, log_search_save_dirty, NULL);
+}
+
+static gboolean
+log_search_save_cb(gpointer data)
+{
+	/* log_search_sync() removes the timer itself */
+	log_search_sync();
+	return FALSE;
+}
+
+static void
+log_search_schedule_save(void)
+{
+	if (log_search_save_timer == 0)
+		log_search_save_timer = purple_timeout_add_seconds(5, log_search_save_cb, NULL);
+}
+
+/* Returns the search index of the log directory at path, loading it if
+ * necessary. */
+static PurpleLogSearchDir *
+log_search_dir_get(const char *path)
+{
+	PurpleLogSearchDir *dir;
+	char *logs_dir;
+	size_t len;
+
+	dir = g_hash_table_lookup(log_search_dirs, path);
+	if (dir != NULL)
+		return dir;
+
+	dir = g_new0(PurpleLogSearchDir, 1);
+	dir->files = g_ptr_array_new();
+	dir->ids = g_hash_table_new(g_str_hash, g_str_equal);
+	dir->postings = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+			(GDestroyNotify)log_search_posting_free);
+	g_hash_table_insert(log_search_dirs, g_strdup(path), dir);
+
+	/* Indexes are saved in a tree mirroring the logs directory */
+	logs_dir = g_build_filename(purple_user_dir(), "logs", NULL);
+	len = strlen(logs_dir);
+	if (strncmp(path, logs_dir, len) == 0 && path[len] == G_DIR_SEPARATOR) {
+		char *contents;
+		gsize length;
+
+		dir->index_path = g_build_filename(purple_user_dir(), "logsearch",
+				path + len + 1, NULL);
+
+		if (g_file_get_contents(dir->index_path, &contents, &length, NULL)) {
+			if (!log_search_dir_parse(dir, contents, contents + length)) {
+				/* Indexes in an older format are quietly rebuilt */
+				if (length >= 4 && memcmp(contents, LOG_SEARCH_MAGIC, 4) == 0)
+					purple_debug_warning("log", "Discarding corrupt search index %s\n",
+							dir->index_path);
+				log_search_dir_clear(dir);
+			}
+			g_free(contents);
+		}
+	}
+	g_free(logs_dir);
+
+	return dir;
+}
+
+static PurpleLogSearchDir *
+log_search_dir_get_for_file(const char *path, char **basename)
+{
+	PurpleLogSearchDir *dir;
+	char *dirname = g_path_get_dirname(path);
+
+	dir = log_search_dir_get(dirname);
+	g_free(dirname);
+	*basename = g_path_get_basename(path);
+
+	return dir;
+}
+
+/* Notes that written bytes were appended to the file of a log.  They are
+ * indexed by the next search covering the log, see log_search_read_tail(). */
+static void
+log_search_append(PurpleLog *log, gsize written)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	PurpleLogSearchDir *dir;
+	PurpleLogSearchFile *file;
+	char *basename;
+	guint32 id;
+	long pos;
+
+	if (log_search_dirs == NULL || data == NULL || data->path == NULL ||
+			data->file == NULL || written == 0)
+		return;
+
+	if ((pos = ftell(data->file)) < 0)
+		return;
+
+	dir = log_search_dir_get_for_file(data->path, &basename);
+	file = log_search_file_lookup(dir, basename, &id);
+
+	if (file == NULL) {
+		/* Only a file we have seen from its start can be indexed here;
+		 * anything else is read by the next search covering it. */
+		if ((gsize)pos != written) {
+			g_free(basename);
+			return;
+		}
+		id = log_search_file_add(dir, basename, 0);
+		file = g_ptr_array_index(dir->files, id);
+	} else if (file->end < 0 || file->end != (gint64)(pos - written)) {
+		file->end = -1;
+		g_free(basename);
+		return;
+	}
+	g_free(basename);
+
+	file->end = pos;
+}
+
+static void
+log_search_forget(const char *path)
+{
+	PurpleLogSearchDir *dir;
+	char *dirname, *basename;
+	guint32 id;
+
+	dirname = g_path_get_dirname(path);
+	dir = g_hash_table_lookup(log_search_dirs, dirname);
+	g_free(dirname);
+	if (dir == NULL)
+		return;
+
+	basename = g_path_get_basename(path);
+	if (log_search_file_lookup(dir, basename, &id) != NULL) {
+		log_search_file_drop(dir, id);
+		log_search_schedule_save();
+	}
+	g_free(basename);
+}
+
+static char *
+log_search_read_plain(PurpleLog *log)
+{
+	char *read = purple_log_read(log, NULL);
+	char *plain = purple_markup_strip_html(read);
+
+	g_free(read);
+	return plain;
+}
+
+/*
+ * Indexes what was appended to the file of a log since its entry was last
+ * brought up to date, returning FALSE if that cannot be done without
+ * reading the whole log.  The appended bytes are made into text the way
+ * the logger's read function and purple_log_search() would make them.
+ */
+static gboolean
+log_search_read_tail(PurpleLog *log, PurpleLogSearchDir *dir, guint32 id, gint64 size)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	PurpleLogSearchFile *file = g_ptr_array_index(dir->files, id);
+	gint64 len = size - file->size;
+	char *tail;
+	FILE *fp;
+
+	/* The header skipped by the read functions is only indexed in full */
+	if (file->size <= 0 || file->end != size || len <= 0 || len > G_MAXINT ||
+			(log->logger != html_logger && log->logger != txt_logger))
+		return FALSE;
+
+	if ((fp = g_fopen(data->path, "rb")) == NULL)
+		return FALSE;
+
+	tail = g_malloc(len + 1);
+	if (fseek(fp, file->size, SEEK_SET) != 0 || fread(tail, 1, len, fp) != (size_t)len) {
+		g_free(tail);
+		fclose(fp);
+		return FALSE;
+	}
+	tail[len] = '\0';
+	fclose(fp);
+
+	if (log->logger == html_logger) {
+		char *plain = purple_markup_strip_html(tail);
+
+		log_search_add_text(dir, id, plain);
+		g_free(plain);
+	} else {
+		/* The text logger escapes and linkifies on reading, which
+		 * stripping the markup undoes again */
+		log_search_add_text(dir, id, tail);
+	}
+	g_free(tail);
+
+	file->size = size;
+	log_search_schedule_save();
+
+	return TRUE;
+}
+
+/* Whether the indexed file with the given id contains all the trigrams */
+static gboolean
+log_search_dir_match(PurpleLogSearchDir *dir, guint32 id, GArray *trigrams)
+{
+	guint i, index;
+
+	for (i = 0; i < trigrams->len; i++) {
+		GArray *posting = g_hash_table_lookup(dir->postings,
+				GUINT_TO_POINTER(g_array_index(trigrams, guint32, i)));
+
+		if (posting == NULL || !log_search_posting_find(posting, id, &index))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Returns the plain text of a log built on the common logger functions,
+ * or NULL if its index entry shows it cannot contain the trigrams.  Logs
+ * without an up to date entry are indexed on the way.
+ */
+static char *
+log_search_read_common(PurpleLog *log, GArray *trigrams)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	PurpleLogSearchDir *dir;
+	PurpleLogSearchFile *file;
+	struct stat st;
+	char *basename;
+	char *plain;
+	guint32 id;
+
+	if (g_stat(data->path, &st) != 0)
+		return log_search_read_plain(log);
+
+	dir = log_search_dir_get_for_file(data->path, &basename);
+	file = log_search_file_lookup(dir, basename, &id);
+
+	if (file != NULL && (file->size == (gint64)st.st_size ||
+			log_search_read_tail(log, dir, id, st.st_size))) {
+		g_free(basename);
+		if (!log_search_dir_match(dir, id, trigrams))
+			return NULL;
+		return log_search_read_plain(log);
+	}
+
+	if (file != NULL)
+		log_search_file_drop(dir, id);
+
+	plain = log_search_read_plain(log);
+	id = log_search_file_add(dir, basename, st.st_size);
+	log_search_add_text(dir, id, plain);
+	log_search_schedule_save();
+	g_free(basename);
+
+	return plain;
+}
+
+GList *
+purple_log_search(GList *logs, const char *text)
+{
+	GList *hits = NULL;
+	GArray *trigrams;
+	size_t len, i;
+
+	g_return_val_if_fail(text != NULL, NULL);
+
+	len = strlen(text);
+	if (len == 0)
+		return NULL;
+
+	trigrams = g_array_new(FALSE, FALSE, sizeof(guint32));
+	for (i = 0; i + 3 <= len; i++) {
+		guint32 trigram = LOG_SEARCH_TRIGRAM(text + i);
+		g_array_append_val(trigrams, trigram);
+	}
+
+	/* The sizes compared below must include everything written so far */
+	if (flush_timer != 0) {
+		purple_timeout_remove(flush_timer);
+		log_flush_all(NULL);
+	}
+
+	for (; logs != NULL; logs = logs->next) {
+		PurpleLog *log = logs->data;
+		PurpleLogCommonLoggerData *data = log->logger_data;
+		const char *match;
+		char *plain;
+
+		if (log->logger != NULL && log->logger->size == purple_log_common_sizer &&
+				data != NULL && data->path != NULL)
+			plain = log_search_read_common(log, trigrams);
+		else
+			plain = log_search_read_plain(log);
+
+		if (plain != NULL && *plain && (match = purple_strcasestr(plain, text))) {
+			PurpleLogSearchHit *hit = g_new(PurpleLogSearchHit, 1);
+
+			hit->log = log;
+			hit->offset = match - plain;
+			hits = g_list_prepend(hits, hit);
+		}
+		g_free(plain);
+	}
+
+	g_array_free(trigrams, TRUE);
+
+	return g_list_reverse(hits);
+}
+
 /****************************************************************************
  * LOGGERS ******************************************************************
  ****************************************************************************/
@@ -917,15 +1990,19 @@ void purple_log_common_writer(PurpleLog *log, const char *ext)
 			g_free(path);
 			return;
 		}
-		g_free(path);
+		data->path = path;
+
+		/* Messages may be kept here for a while, see log_common_flush() */
+		setvbuf(data->file, NULL, _IOFBF, LOG_FILE_BUFFER_SIZE);
 	}
 }
 
 GList *purple_log_common_lister(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext, PurpleLogLogger *logger)
 {
-	GDir *dir;
+	PurpleLogIndexDir *dir;
+	GHashTableIter iter;
 	GList *list = NULL;
-	const char *filename;
+	gpointer key;
 	char *path;
 
 	if(!account)
@@ -935,14 +2012,17 @@ GList *purple_log_common_lister(PurpleLogType type, const char *name, PurpleAcco
 	if (path == NULL)
 		return NULL;
 
-	if (!(dir = g_dir_open(path, 0, NULL)))
+	if (!(dir = log_index_lookup(path)))
 	{
 		g_free(path);
 		return NULL;
 	}
 
-	while ((filename = g_dir_read_name(dir)))
+	g_hash_table_iter_init(&iter, dir->sizes);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
 	{
+		const char *filename = key;
+
 		if (purple_str_has_suffix(filename, ext) &&
 		    strlen(filename) >= (17 + strlen(ext)))
 		{
@@ -983,16 +2063,16 @@ GList *purple_log_common_lister(PurpleLogType type, const char *name, PurpleAcco
 			list = g_list_prepend(list, log);
 		}
 	}
-	g_dir_close(dir);
 	g_free(path);
 	return list;
 }
 
 int purple_log_common_total_sizer(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext)
 {
-	GDir *dir;
-	int size = 0;
-	const char *filename;
+	PurpleLogIndexDir *dir;
+	GHashTableIter iter;
+	gpointer key, value;
+	gint64 size = 0;
 	char *path;
 
 	if(!account)
@@ -1002,45 +2082,45 @@ int purple_log_common_total_sizer(PurpleLogType type, const char *name, PurpleAc
 	if (path == NULL)
 		return 0;
 
-	if (!(dir = g_dir_open(path, 0, NULL)))
+	if (!(dir = log_index_lookup(path)))
 	{
 		g_free(path);
 		return 0;
 	}
 
-	while ((filename = g_dir_read_name(dir)))
+	g_hash_table_iter_init(&iter, dir->sizes);
+	while (g_hash_table_iter_next(&iter, &key, &value))
 	{
+		const char *filename = key;
+
 		if (purple_str_has_suffix(filename, ext) &&
 		    strlen(filename) >= (17 + strlen(ext)))
 		{
-			char *tmp = g_build_filename(path, filename, NULL);
-			struct stat st;
-			if (g_stat(tmp, &st))
-			{
-				purple_debug_error("log", "Error stating log file: %s\n", tmp);
-				g_free(tmp);
-				continue;
-			}
-			g_free(tmp);
-			size += st.st_size;
+			size += *(gint64 *)value;
 		}
 	}
-	g_dir_close(dir);
 	g_free(path);
-	return size;
+
+	/* The API can't report more than this */
+	return (int)MIN(size, (gint64)G_MAXINT);
 }
 
 int purple_log_common_sizer(PurpleLog *log)
 {
 	struct stat st;
 	PurpleLogCommonLoggerData *data = log->logger_data;
+	gint64 size;
 
 	g_return_val_if_fail(data != NULL, 0);
 
-	if (!data->path || g_stat(data->path, &st))
-		st.st_size = 0;
+	if (!data->path || !log_index_get_size(data->path, &size))
+	{
+		if (!data->path || g_stat(data->path, &st))
+			st.st_size = 0;
+		size = st.st_size;
+	}
 
-	return st.st_size;
+	return (int)MIN(size, (gint64)G_MAXINT);
 }
 
 /* This will build log sets for all loggers that use the common logger
@@ -1179,8 +2259,11 @@ gboolean purple_log_common_deleter(PurpleLog *log)
 		return FALSE;
 
 	ret = g_unlink(data->path);
-	if (ret == 0)
+	if (ret == 0) {
+		log_index_forget(data->path);
+		log_search_forget(data->path);
 		return TRUE;
+	}
 	else if (ret == -1)
 	{
 		purple_debug_error("log", "Failed to delete: %s - %s\n", data->path, g_strerror(errno));
@@ -1467,7 +2550,7 @@ static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
 	g_free(date);
 	g_free(msg_fixed);
 	g_free(escaped_from);
-	fflush(data->file);
+	log_common_flush(log);
 
 	return written;
 }
@@ -1475,9 +2558,14 @@ static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
 static void html_logger_finalize(PurpleLog *log)
 {
 	PurpleLogCommonLoggerData *data = log->logger_data;
+	log_common_forget(log);
 	if (data) {
 		if(data->file) {
-			fprintf(data->file, "</p>\n</body>\n</html>\n");
+			int written = fprintf(data->file, "</p>\n</body>\n</html>\n");
+			if (written > 0) {
+				log_index_grow(data, written);
+				log_search_append(log, written);
+			}
 			fclose(data->file);
 		}
 		g_free(data->path);
@@ -1602,7 +2690,7 @@ static gsize txt_logger_write(PurpleLog *log,
 	}
 	g_free(date);
 	g_free(stripped);
-	fflush(data->file);
+	log_common_flush(log);
 
 	return written;
 }
@@ -1610,6 +2698,7 @@ static gsize txt_logger_write(PurpleLog *log,
 static void txt_logger_finalize(PurpleLog *log)
 {
 	PurpleLogCommonLoggerData *data = log->logger_data;
+	log_common_forget(log);
 	if (data) {
 		if(data->file)
 			fclose(data->file);
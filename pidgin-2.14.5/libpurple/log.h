@@ -38,6 +38,7 @@ typedef struct _PurpleLog PurpleLog;
 typedef struct _PurpleLogLogger PurpleLogLogger;
 typedef struct _PurpleLogCommonLoggerData PurpleLogCommonLoggerData;
 typedef struct _PurpleLogSet PurpleLogSet;
+typedef struct _PurpleLogSearchHit PurpleLogSearchHit;
 
 typedef enum {
 	PURPLE_LOG_IM,
@@ -181,6 +182,20 @@ struct _PurpleLogSet {
 	 * IMPORTANT: Update that code if you add members here. */
 };
 
+/**
+ * A log found by purple_log_search().
+ *
+ * @since 2.14.6
+ */
+struct _PurpleLogSearchHit {
+	PurpleLog *log;                       /**< The log, one of those searched */
+	gsize offset;                         /**< The byte offset of the first
+	                                           match in the plain text of the
+	                                           log, i.e. in the result of
+	                                           purple_markup_strip_html() on
+	                                           purple_log_read() */
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -338,6 +353,24 @@ gboolean purple_log_delete(PurpleLog *log);
  */
 char *purple_log_get_log_dir(PurpleLogType type, const char *name, PurpleAccount *account);
 
+/**
+ * Searches logs for a piece of text, ignoring the case of ASCII letters.
+ *
+ * The text is matched against the plain text of each log, without its
+ * markup.  Logs written by the built-in loggers are looked up in a search
+ * index first, so only the logs that may contain the text are read.
+ *
+ * @param logs                A list of PurpleLogs to search
+ * @param text                The text to search for
+ * @return                    A list of PurpleLogSearchHits, in the order of
+ *                            @a logs, one for each log containing @a text.
+ *                            The hits must be freed with g_free() and the
+ *                            list with g_list_free().
+ *
+ * @since 2.14.6
+ */
+GList *purple_log_search(GList *logs, const char *text);
+
 /**
  * Implements GCompareFunc for PurpleLogs
  *
@@ -733,6 +733,7 @@ purple_plugin_unload(PurplePlugin *plugin)
 	purple_request_close_with_handle(plugin);
 	purple_notify_close_with_handle(plugin);
 
+	PURPLE_DBUS_UNREGISTER_BINDINGS(plugin);
 	purple_signals_disconnect_by_handle(plugin);
 	purple_plugin_ipc_unregister_all(plugin);
 
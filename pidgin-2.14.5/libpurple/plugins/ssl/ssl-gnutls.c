@@ -37,6 +37,8 @@ typedef struct
 	gnutls_session_t session;
 	guint handshake_handler;
 	guint handshake_timer;
+	/* Whether the session may be offered for resumption */
+	gboolean verified;
 } PurpleSslGnutlsData;
 
 #define PURPLE_SSL_GNUTLS_DATA(gsc) ((PurpleSslGnutlsData *)gsc->private_data)
@@ -191,6 +193,23 @@ ssl_gnutls_uninit(void)
 #endif
 }
 
+/* Puts the session in the libpurple session cache, so the next connection
+ * to this host and port can skip the full handshake. */
+static void
+ssl_gnutls_store_session(PurpleSslConnection *gsc)
+{
+	PurpleSslGnutlsData *gnutls_data = PURPLE_SSL_GNUTLS_DATA(gsc);
+	gnutls_datum_t data;
+
+	gnutls_data->verified = TRUE;
+
+	if (gnutls_session_get_data2(gnutls_data->session, &data) != GNUTLS_E_SUCCESS)
+		return;
+
+	purple_ssl_session_cache_store(gsc, data.data, data.size);
+	gnutls_free(data.data);
+}
+
 static void
 ssl_gnutls_verified_cb(PurpleCertificateVerificationStatus st,
 		       gpointer userdata)
@@ -198,9 +217,11 @@ ssl_gnutls_verified_cb(PurpleCertificateVerificationStatus st,
 	PurpleSslConnection *gsc = (PurpleSslConnection *) userdata;
 
 	if (st == PURPLE_CERTIFICATE_VALID) {
+		ssl_gnutls_store_session(gsc);
 		/* Certificate valid? Good! Do the connection! */
 		gsc->connect_cb(gsc->connect_cb_data, gsc, PURPLE_INPUT_READ);
 	} else {
+		purple_ssl_session_cache_remove(gsc);
 		/* Otherwise, signal an error */
 		if(gsc->error_cb != NULL)
 			gsc->error_cb(gsc, PURPLE_SSL_CERTIFICATE_INVALID,
@@ -231,6 +252,9 @@ static void ssl_gnutls_handshake_cb(gpointer data, gint source,
 		purple_debug_error("gnutls", "Handshake failed. Error %s\n",
 			gnutls_strerror(ret));
 
+		/* Don't offer a session the server may have choked on again */
+		purple_ssl_session_cache_remove(gsc);
+
 		if(gsc->error_cb != NULL)
 			gsc->error_cb(gsc, PURPLE_SSL_HANDSHAKE_FAILED,
 				gsc->connect_cb_data);
@@ -247,7 +271,9 @@ static void ssl_gnutls_handshake_cb(gpointer data, gint source,
 		GList * l;
 
 		/* TODO: Remove all this debugging babble */
-		purple_debug_info("gnutls", "Handshake complete\n");
+		purple_debug_info("gnutls", "Handshake complete%s\n",
+			gnutls_session_is_resumed(gnutls_data->session) ?
+			" (resumed session)" : "");
 
 		for (l=peers; l; l = l->next) {
 			PurpleCertificate *crt = l->data;
@@ -346,6 +372,7 @@ static void ssl_gnutls_handshake_cb(gpointer data, gint source,
 
 			purple_certificate_destroy_list(peers);
 		} else {
+			ssl_gnutls_store_session(gsc);
 			/* Otherwise, just call the "connection complete"
 			   callback */
 			gsc->connect_cb(gsc->connect_cb_data, gsc, cond);
@@ -403,6 +430,18 @@ ssl_gnutls_connect(PurpleSslConnection *gsc)
 
 	gnutls_transport_set_ptr(gnutls_data->session, GINT_TO_POINTER(gsc->fd));
 
+	/* Try to resume the last session with this host */
+	{
+		gconstpointer data;
+		gsize len;
+
+		data = purple_ssl_session_cache_lookup(gsc, &len);
+		if (data != NULL && len <= G_MAXUINT) {
+			if (gnutls_session_set_data(gnutls_data->session, data, len) != GNUTLS_E_SUCCESS)
+				purple_ssl_session_cache_remove(gsc);
+		}
+	}
+
 	/* SNI support. */
 	if (gsc->host && !g_hostname_is_ip_address(gsc->host))
 		gnutls_server_name_set(gnutls_data->session, GNUTLS_NAME_DNS, gsc->host, strlen(gsc->host));
@@ -439,6 +478,11 @@ ssl_gnutls_close(PurpleSslConnection *gsc)
 	if (gnutls_data->handshake_timer)
 		purple_timeout_remove(gnutls_data->handshake_timer);
 
+	/* With TLS 1.3 the ticket arrives after the handshake, so store the
+	   session again, by now it has most likely been received */
+	if (gnutls_data->verified)
+		ssl_gnutls_store_session(gsc);
+
 	gnutls_bye(gnutls_data->session, GNUTLS_SHUT_RDWR);
 
 	gnutls_deinit(gnutls_data->session);
@@ -236,6 +236,8 @@ ssl_nss_init(void)
 static void
 ssl_nss_uninit(void)
 {
+	/* Cached sessions hold references that keep NSS from shutting down */
+	SSL_ClearSessionCache();
 	NSS_Shutdown();
 	PR_Cleanup();
 
@@ -252,6 +254,9 @@ ssl_nss_verified_cb(PurpleCertificateVerificationStatus st,
 		/* Certificate valid? Good! Do the connection! */
 		gsc->connect_cb(gsc->connect_cb_data, gsc, PURPLE_INPUT_READ);
 	} else {
+		/* Never resume a session with a peer we didn't trust */
+		SSL_InvalidateSession(PURPLE_SSL_NSS_DATA(gsc)->in);
+
 		/* Otherwise, signal an error */
 		if(gsc->error_cb != NULL)
 			gsc->error_cb(gsc, PURPLE_SSL_CERTIFICATE_INVALID,
@@ -355,6 +360,10 @@ print_security_info(PRFileDesc *fd)
 					channel.compressionMethodName,
 					suite.cipherSuiteName);
 		}
+#if NSS_VMAJOR > 3 || ( NSS_VMAJOR == 3 && NSS_VMINOR >= 21 )
+		if (channel.resumed)
+			purple_debug_info("nss", "Resumed a cached session\n");
+#endif /* NSS >= 3.21 */
 	}
 }
 
@@ -480,9 +489,23 @@ ssl_nss_connect(PurpleSslConnection *gsc)
 	if (gsc->verifier != NULL)
 		SSL_AuthCertificateHook(nss_data->in, ssl_auth_cert, NULL);
 
-	if(gsc->host)
+	if(gsc->host) {
+		gchar *peer_id;
+
 		SSL_SetURL(nss_data->in, gsc->host);
 
+		/* NSS keeps its own client session cache, which can't be exported
+		 * to the libpurple one.  It is keyed on the peer address, which
+		 * is the proxy's when there is one, so also key it on the host and
+		 * port we were asked for, as the libpurple cache does. */
+		peer_id = g_strdup_printf("%s:%d", gsc->host, gsc->port);
+		SSL_SetSockPeerID(nss_data->in, peer_id);
+		g_free(peer_id);
+	}
+
+	/* Resume sessions from tickets too, not only from session IDs */
+	SSL_OptionSet(nss_data->in, SSL_ENABLE_SESSION_TICKETS, PR_TRUE);
+
 #if 0
 	/* This seems like it'd the be the correct way to implement the
 	nonblocking stuff, but it doesn't seem to work */
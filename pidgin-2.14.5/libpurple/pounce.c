@@ -71,16 +71,166 @@ typedef struct
 } PurplePounceHandler;
 
 
+/*
+ * The pounces on one buddy of one account, so that purple_pounce_execute
+ * doesn't have to go through all of them for every event.
+ */
+typedef struct
+{
+	PurplePounceEvent events;   /**< All the events they pounce on. */
+	GList *pounces;             /**< In the order they were created. */
+
+} PurplePounceIndexEntry;
+
 static GHashTable *pounce_handlers = NULL;
 static GList      *pounces = NULL;
 static guint       save_timer = 0;
 static gboolean    pounces_loaded = FALSE;
 
+/* PurpleAccount * => (folded, normalized pouncee => PurplePounceIndexEntry) */
+static GHashTable *pounce_index = NULL;
+/* PurplePounce * => the pouncee key it is indexed under */
+static GHashTable *pounce_index_keys = NULL;
+/*
+ * The pounces purple_pounce_execute() is going through, innermost call
+ * first.  Destroying a pounce clears it from these, so a new pounce that
+ * gets its address is not taken for it.
+ */
+static GSList     *pounce_executions = NULL;
+
 
 /*********************************************************************
  * Private utility functions                                         *
  *********************************************************************/
 
+static char *
+pounce_index_key(const PurpleAccount *pouncer, const char *pouncee)
+{
+	const char *norm = purple_normalize(pouncer, pouncee);
+
+	/* Two keys are equal when purple_utf8_strcasecmp() says they are */
+	if (norm == NULL || !g_utf8_validate(norm, -1, NULL))
+		return NULL;
+
+	return g_utf8_casefold(norm, -1);
+}
+
+static PurplePounceIndexEntry *
+pounce_index_lookup(const PurpleAccount *pouncer, const char *key)
+{
+	GHashTable *buddies;
+
+	if (pounce_index == NULL || key == NULL)
+		return NULL;
+
+	buddies = g_hash_table_lookup(pounce_index, pouncer);
+	if (buddies == NULL)
+		return NULL;
+
+	return g_hash_table_lookup(buddies, key);
+}
+
+static void
+pounce_index_entry_free(PurplePounceIndexEntry *entry)
+{
+	g_list_free(entry->pounces);
+	g_free(entry);
+}
+
+static void
+pounce_index_entry_update(PurplePounceIndexEntry *entry)
+{
+	GList *l;
+
+	entry->events = PURPLE_POUNCE_NONE;
+	for (l = entry->pounces; l != NULL; l = l->next)
+		entry->events |= ((PurplePounce *)l->data)->events;
+}
+
+static void
+pounce_index_add(PurplePounce *pounce)
+{
+	GHashTable *buddies;
+	PurplePounceIndexEntry *entry;
+	char *key;
+
+	if (pounce_index == NULL)
+		return;
+
+	key = pounce_index_key(pounce->pouncer, pounce->pouncee);
+	if (key == NULL) {
+		purple_debug_error("pounce", "Not indexing the pounce on %s, "
+				"its name is not valid UTF-8\n", pounce->pouncee);
+		return;
+	}
+
+	buddies = g_hash_table_lookup(pounce_index, pounce->pouncer);
+	if (buddies == NULL) {
+		buddies = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+				(GDestroyNotify)pounce_index_entry_free);
+		g_hash_table_insert(pounce_index, pounce->pouncer, buddies);
+	}
+
+	entry = g_hash_table_lookup(buddies, key);
+	if (entry == NULL) {
+		entry = g_new0(PurplePounceIndexEntry, 1);
+		g_hash_table_insert(buddies, g_strdup(key), entry);
+	}
+
+	entry->pounces = g_list_append(entry->pounces, pounce);
+	entry->events |= pounce->events;
+
+	g_hash_table_insert(pounce_index_keys, pounce, key);
+}
+
+/* Call this when the events of an indexed pounce change */
+static void
+pounce_index_update(PurplePounce *pounce)
+{
+	const char *key;
+	PurplePounceIndexEntry *entry;
+
+	if (pounce_index == NULL)
+		return;
+
+	key = g_hash_table_lookup(pounce_index_keys, pounce);
+	entry = pounce_index_lookup(pounce->pouncer, key);
+	if (entry != NULL)
+		pounce_index_entry_update(entry);
+}
+
+static void
+pounce_index_remove(PurplePounce *pounce)
+{
+	GHashTable *buddies;
+	PurplePounceIndexEntry *entry;
+	const char *key;
+
+	if (pounce_index == NULL)
+		return;
+
+	key = g_hash_table_lookup(pounce_index_keys, pounce);
+	if (key == NULL)
+		return;
+
+	buddies = g_hash_table_lookup(pounce_index, pounce->pouncer);
+	entry = buddies ? g_hash_table_lookup(buddies, key) : NULL;
+
+	if (entry != NULL) {
+		entry->pounces = g_list_remove(entry->pounces, pounce);
+
+		if (entry->pounces == NULL)
+			g_hash_table_remove(buddies, key);
+		else
+			pounce_index_entry_update(entry);
+
+		if (g_hash_table_size(buddies) == 0)
+			g_hash_table_remove(pounce_index, pounce->pouncer);
+	}
+
+	g_hash_table_remove(pounce_index_keys, pounce);
+}
+
 static PurplePounceActionData *
 find_action_data(const PurplePounce *pounce, const char *name)
 {
@@ -247,7 +397,6 @@ static void
 sync_pounces(void)
 {
 	xmlnode *node;
-	char *data;
 
 	if (!pounces_loaded)
 	{
@@ -257,9 +406,7 @@ sync_pounces(void)
 	}
 
 	node = pounces_to_xmlnode();
-	data = xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_file("pounces.xml", data, -1);
-	g_free(data);
+	purple_util_write_xml_to_file("pounces.xml", node);
 	xmlnode_free(node);
 }
 
@@ -644,6 +791,7 @@ purple_pounce_new(const char *ui_type, PurpleAccount *pouncer,
 		handler->new_pounce(pounce);
 
 	pounces = g_list_append(pounces, pounce);
+	pounce_index_add(pounce);
 
 	schedule_pounces_save();
 
@@ -654,12 +802,22 @@ void
 purple_pounce_destroy(PurplePounce *pounce)
 {
 	PurplePounceHandler *handler;
+	GSList *l;
 
 	g_return_if_fail(pounce != NULL);
 
 	handler = g_hash_table_lookup(pounce_handlers, pounce->ui_type);
 
 	pounces = g_list_remove(pounces, pounce);
+	pounce_index_remove(pounce);
+
+	for (l = pounce_executions; l != NULL; l = l->next)
+	{
+		GList *match = g_list_find(l->data, pounce);
+
+		if (match != NULL)
+			match->data = NULL;
+	}
 
 	g_free(pounce->ui_type);
 	g_free(pounce->pouncee);
@@ -727,6 +885,8 @@ purple_pounce_set_events(PurplePounce *pounce, PurplePounceEvent events)
 
 	pounce->events = events;
 
+	pounce_index_update(pounce);
+
 	schedule_pounces_save();
 }
 
@@ -746,7 +906,9 @@ purple_pounce_set_pouncer(PurplePounce *pounce, PurpleAccount *pouncer)
 	g_return_if_fail(pounce  != NULL);
 	g_return_if_fail(pouncer != NULL);
 
+	pounce_index_remove(pounce);
 	pounce->pouncer = pouncer;
+	pounce_index_add(pounce);
 
 	schedule_pounces_save();
 }
@@ -757,8 +919,10 @@ purple_pounce_set_pouncee(PurplePounce *pounce, const char *pouncee)
 	g_return_if_fail(pounce  != NULL);
 	g_return_if_fail(pouncee != NULL);
 
+	pounce_index_remove(pounce);
 	g_free(pounce->pouncee);
 	pounce->pouncee = g_strdup(pouncee);
+	pounce_index_add(pounce);
 
 	schedule_pounces_save();
 }
@@ -934,26 +1098,37 @@ purple_pounce_execute(const PurpleAccount *pouncer, const char *pouncee,
 	PurplePounce *pounce;
 	PurplePounceHandler *handler;
 	PurplePresence *presence;
-	GList *l, *l_next;
-	char *norm_pouncee;
+	PurplePounceIndexEntry *entry;
+	GList *matches, *l;
+	char *key;
 
 	g_return_if_fail(pouncer != NULL);
 	g_return_if_fail(pouncee != NULL);
 	g_return_if_fail(events  != PURPLE_POUNCE_NONE);
 
-	norm_pouncee = g_strdup(purple_normalize(pouncer, pouncee));
+	key = pounce_index_key(pouncer, pouncee);
+	entry = pounce_index_lookup(pouncer, key);
+	g_free(key);
 
-	for (l = purple_pounces_get_all(); l != NULL; l = l_next)
+	if (entry == NULL || !(entry->events & events))
+		return;
+
+	presence = purple_account_get_presence(pouncer);
+
+	/* The handlers may destroy pounces, so go through a copy, skipping
+	 * pounces that are gone by the time we get to them. */
+	matches = g_list_copy(entry->pounces);
+	pounce_executions = g_slist_prepend(pounce_executions, matches);
+
+	for (l = matches; l != NULL; l = l->next)
 	{
 		pounce = (PurplePounce *)l->data;
-		l_next = l->next;
 
-		presence = purple_account_get_presence(pouncer);
+		if (pounce == NULL)
+			continue;
 
 		if ((purple_pounce_get_events(pounce) & events) &&
 			(purple_pounce_get_pouncer(pounce) == pouncer) &&
-			!purple_utf8_strcasecmp(purple_normalize(pouncer, purple_pounce_get_pouncee(pounce)),
-								  norm_pouncee) &&
 			(pounce->options == PURPLE_POUNCE_OPTION_NONE ||
 			 (pounce->options & PURPLE_POUNCE_OPTION_AWAY &&
 			  !purple_presence_is_available(presence))))
@@ -964,47 +1139,46 @@ purple_pounce_execute(const PurpleAccount *pouncer, const char *pouncee,
 			{
 				handler->cb(pounce, events, purple_pounce_get_data(pounce));
 
-				if (!purple_pounce_get_save(pounce))
+				/* Unless the handler destroyed it already */
+				if (l->data != NULL && !purple_pounce_get_save(pounce))
 					purple_pounce_destroy(pounce);
 			}
 		}
 	}
 
-	g_free(norm_pouncee);
+	pounce_executions = g_slist_remove(pounce_executions, matches);
+	g_list_free(matches);
 }
 
 PurplePounce *
 purple_find_pounce(const PurpleAccount *pouncer, const char *pouncee,
 				 PurplePounceEvent events)
 {
-	PurplePounce *pounce = NULL;
+	PurplePounce *pounce;
+	PurplePounceIndexEntry *entry;
 	GList *l;
-	char *norm_pouncee;
+	char *key;
 
 	g_return_val_if_fail(pouncer != NULL, NULL);
 	g_return_val_if_fail(pouncee != NULL, NULL);
 	g_return_val_if_fail(events  != PURPLE_POUNCE_NONE, NULL);
 
-	norm_pouncee = g_strdup(purple_normalize(pouncer, pouncee));
+	key = pounce_index_key(pouncer, pouncee);
+	entry = pounce_index_lookup(pouncer, key);
+	g_free(key);
+
+	if (entry == NULL || !(entry->events & events))
+		return NULL;
 
-	for (l = purple_pounces_get_all(); l != NULL; l = l->next)
+	for (l = entry->pounces; l != NULL; l = l->next)
 	{
 		pounce = (PurplePounce *)l->data;
 
-		if ((purple_pounce_get_events(pounce) & events) &&
-			(purple_pounce_get_pouncer(pounce) == pouncer) &&
-			!purple_utf8_strcasecmp(purple_normalize(pouncer, purple_pounce_get_pouncee(pounce)),
-								  norm_pouncee))
-		{
-			break;
-		}
-
-		pounce = NULL;
+		if (purple_pounce_get_events(pounce) & events)
+			return pounce;
 	}
 
-	g_free(norm_pouncee);
-
-	return pounce;
+	return NULL;
 }
 
 void
@@ -1148,6 +1322,10 @@ purple_pounces_init(void)
 
 	pounce_handlers = g_hash_table_new_full(g_str_hash, g_str_equal,
 											g_free, free_pounce_handler);
+	pounce_index = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+										 NULL, (GDestroyNotify)g_hash_table_destroy);
+	pounce_index_keys = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+											  NULL, g_free);
 
 	purple_signal_connect(blist_handle, "buddy-idle-changed",
 	                    handle, PURPLE_CALLBACK(buddy_idle_changed_cb), NULL);
@@ -1185,4 +1363,9 @@ purple_pounces_uninit()
 
 	g_hash_table_destroy(pounce_handlers);
 	pounce_handlers = NULL;
+
+	g_hash_table_destroy(pounce_index);
+	pounce_index = NULL;
+	g_hash_table_destroy(pounce_index_keys);
+	pounce_index_keys = NULL;
 }
@@ -217,7 +217,6 @@ static void
 sync_prefs(void)
 {
 	xmlnode *node;
-	char *data;
 
 	if (!prefs_loaded)
 	{
@@ -233,9 +232,7 @@ sync_prefs(void)
 	PURPLE_PREFS_UI_OP_CALL(save);
 
 	node = prefs_to_xmlnode();
-	data = xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_file("prefs.xml", data, -1);
-	g_free(data);
+	purple_util_write_xml_to_file("prefs.xml", node);
 	xmlnode_free(node);
 }
 
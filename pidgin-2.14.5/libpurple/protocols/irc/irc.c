@@ -165,7 +165,8 @@ int irc_send_len(struct irc_conn *irc, const char *buf, int buflen)
 		buflen = strlen(tosend);
 	}
 
-	if (purple_debug_is_verbose()) {
+	if (purple_debug_is_verbose() &&
+			purple_debug_is_active(PURPLE_DEBUG_MISC, "irc")) {
 		char *clean = purple_utf8_salvage(tosend);
 		clean = g_strstrip(clean);
 		purple_debug_misc("irc", "<< %s\n", clean);
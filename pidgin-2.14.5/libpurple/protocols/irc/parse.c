@@ -681,7 +681,8 @@ void irc_parse_msg(struct irc_conn *irc, char *input)
 	 */
 	purple_signal_emit(_irc_plugin, "irc-receiving-text", gc, &input);
 
-	if (purple_debug_is_verbose()) {
+	if (purple_debug_is_verbose() &&
+			purple_debug_is_active(PURPLE_DEBUG_MISC, "irc")) {
 		char *clean = purple_utf8_salvage(input);
 		clean = g_strstrip(clean);
 		purple_debug_misc("irc", ">> %s\n", clean);
@@ -609,10 +609,12 @@ http_received_cb(const char *data, int len, PurpleBOSHConnection *conn)
 
 	node = xmlnode_from_str(data, len);
 
-	message = g_strndup(data, len);
-	purple_debug_info("jabber", "RecvBOSH %s(%d): %s\n",
-	                  conn->ssl ? "(ssl)" : "", len, message);
-	g_free(message);
+	if (purple_debug_is_active(PURPLE_DEBUG_INFO, "jabber")) {
+		message = g_strndup(data, len);
+		purple_debug_info("jabber", "RecvBOSH %s(%d): %s\n",
+		                  conn->ssl ? "(ssl)" : "", len, message);
+		g_free(message);
+	}
 
 	if (node) {
 		conn->receive_cb(conn, node);
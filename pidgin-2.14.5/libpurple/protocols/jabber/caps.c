@@ -204,14 +204,10 @@ static void jabber_caps_store_client(gpointer key, gpointer value, gpointer user
 static gboolean
 do_jabber_caps_store(gpointer data)
 {
-	char *str;
-	int length = 0;
 	xmlnode *root = xmlnode_new("capabilities");
 	g_hash_table_foreach(capstable, jabber_caps_store_client, root);
-	str = xmlnode_to_formatted_str(root, &length);
+	purple_util_write_xml_to_file(JABBER_CAPS_FILENAME, root);
 	xmlnode_free(root);
-	purple_util_write_data_to_file(JABBER_CAPS_FILENAME, str, length);
-	g_free(str);
 
 	save_timer = 0;
 	return FALSE;
@@ -486,7 +486,8 @@ void jabber_send_raw(JabberStream *js, const char *data, int len)
 	g_return_if_fail(data != NULL);
 
 	/* because printing a tab to debug every minute gets old */
-	if (data && !purple_strequal(data, "\t")) {
+	if (data && !purple_strequal(data, "\t") &&
+			purple_debug_is_active(PURPLE_DEBUG_MISC, "jabber")) {
 		const char *username;
 		char *text = NULL, *last_part = NULL, *tag_start = NULL;
 
@@ -691,7 +692,8 @@ jabber_recv_cb_ssl(gpointer data, PurpleSslConnection *gsc,
 	while((len = purple_ssl_read(gsc, buf, sizeof(buf) - 1)) > 0) {
 		gc->last_received = time(NULL);
 		buf[len] = '\0';
-		purple_debug_info("jabber", "Recv (ssl)(%d): %s\n", len, buf);
+		if (purple_debug_is_active(PURPLE_DEBUG_INFO, "jabber"))
+			purple_debug_info("jabber", "Recv (ssl)(%d): %s\n", len, buf);
 		jabber_parser_process(js, buf, len);
 		if(js->reinit)
 			jabber_stream_init(js);
@@ -742,7 +744,8 @@ jabber_recv_cb(gpointer data, gint source, PurpleInputCondition condition)
 					PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
 					error);
 			} else if (olen > 0) {
-				purple_debug_info("jabber", "RecvSASL (%u): %s\n", olen, out);
+				if (purple_debug_is_active(PURPLE_DEBUG_INFO, "jabber"))
+					purple_debug_info("jabber", "RecvSASL (%u): %s\n", olen, out);
 				jabber_parser_process(js, out, olen);
 				if (js->reinit)
 					jabber_stream_init(js);
@@ -751,7 +754,8 @@ jabber_recv_cb(gpointer data, gint source, PurpleInputCondition condition)
 		}
 #endif
 		buf[len] = '\0';
-		purple_debug_info("jabber", "Recv (%d): %s\n", len, buf);
+		if (purple_debug_is_active(PURPLE_DEBUG_INFO, "jabber"))
+			purple_debug_info("jabber", "Recv (%d): %s\n", len, buf);
 		jabber_parser_process(js, buf, len);
 		if(js->reinit)
 			jabber_stream_init(js);
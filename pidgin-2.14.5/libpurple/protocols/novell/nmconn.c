@@ -26,34 +26,46 @@
 #include <time.h>
 #include "nmconn.h"
 
-#ifdef _WIN32
-#include <windows.h>
-#endif
-
+#include "debug.h"
+#include "eventloop.h"
 #include "util.h"
 
 #define NO_ESCAPE(ch) ((ch == 0x20) || (ch >= 0x30 && ch <= 0x39) || \
 					(ch >= 0x41 && ch <= 0x5a) || (ch >= 0x61 && ch <= 0x7a))
 
+/* How much to read from the socket at a time */
+#define NM_READ_SIZE 4096
+
+/* Deeper nesting than this is taken to be garbage */
+#define NM_MAX_FIELD_DEPTH 32
+
 /* Read data from conn until the end of a line */
 static NMERR_T
 read_line(NMConn * conn, char *buff, int len)
 {
-	NMERR_T rc = NM_OK;
-	int total_bytes = 0;
+	const guint8 *start, *end;
+	gsize avail, total_bytes;
 
-	while ((rc == NM_OK) && (total_bytes < (len - 1))) {
-		rc = nm_read_all(conn, &buff[total_bytes], 1);
-		if (rc == NM_OK) {
-			total_bytes += 1;
-			if (buff[total_bytes - 1] == '\n') {
-				break;
-			}
-		}
-	}
+	if (conn->in_buf == NULL)
+		return NMERR_TCP_READ;
+
+	start = conn->in_buf->data + conn->in_pos;
+	avail = conn->in_buf->len - conn->in_pos;
+
+	/* Take up to the newline, or as much as fits */
+	end = memchr(start, '\n', MIN(avail, (gsize)(len - 1)));
+	if (end != NULL)
+		total_bytes = end - start + 1;
+	else if (avail >= (gsize)(len - 1))
+		total_bytes = len - 1;
+	else
+		return NMERR_TCP_READ;
+
+	memcpy(buff, start, total_bytes);
 	buff[total_bytes] = '\0';
+	conn->in_pos += total_bytes;
 
-	return rc;
+	return NM_OK;
 }
 
 static char *
@@ -176,6 +188,9 @@ nm_create_conn(const char *addr, int port)
 	NMConn *conn = 	g_new0(NMConn, 1);
 	conn->addr = g_strdup(addr);
 	conn->port = port;
+	conn->fd = -1;
+	conn->in_buf = g_byte_array_new();
+	conn->out_buf = g_byte_array_new();
 	return conn;
 }
 
@@ -193,6 +208,10 @@ void nm_release_conn(NMConn *conn)
 			g_free(conn->ssl_conn);
 			conn->ssl_conn = NULL;
 		}
+		if (conn->out_watch)
+			purple_input_remove(conn->out_watch);
+		g_byte_array_free(conn->in_buf, TRUE);
+		g_byte_array_free(conn->out_buf, TRUE);
 		g_free(conn->addr);
 		conn->addr = NULL;
 		g_free(conn);
@@ -228,41 +247,173 @@ nm_tcp_read(NMConn * conn, void *buff, int len)
 }
 
 NMERR_T
-nm_read_all(NMConn * conn, char *buff, int len)
+nm_conn_fill(NMConn * conn)
 {
-	NMERR_T rc = NM_OK;
-	int bytes_left = len;
+	guint8 buff[NM_READ_SIZE];
 	int bytes_read;
-	int total_bytes = 0;
-	int retry = 1000;
 
-	if (conn == NULL || buff == NULL)
+	if (conn == NULL)
 		return NMERR_BAD_PARM;
 
-	/* Keep reading until buffer is full */
-	while (bytes_left) {
-		bytes_read = nm_tcp_read(conn, &buff[total_bytes], bytes_left);
+	/* Read until the socket would block.  Stopping earlier could leave
+	 * data decrypted by the SSL layer behind, where no further read
+	 * event would announce it. */
+	for (;;) {
+		bytes_read = nm_tcp_read(conn, buff, sizeof(buff));
 		if (bytes_read > 0) {
-			bytes_left -= bytes_read;
-			total_bytes += bytes_read;
+			g_byte_array_append(conn->in_buf, buff, bytes_read);
+		} else if (bytes_read < 0 && errno == EAGAIN) {
+			return NM_OK;
 		} else {
-			if (errno == EAGAIN) {
-				if (--retry == 0) {
-					rc = NMERR_TCP_READ;
-					break;
-				}
-#ifdef _WIN32
-				Sleep(1);
-#else
-				usleep(1000);
-#endif
-			} else {
-				rc = NMERR_TCP_READ;
-				break;
+			return NMERR_TCP_READ;
+		}
+	}
+}
+
+void
+nm_conn_compact(NMConn * conn)
+{
+	if (conn == NULL || conn->in_pos == 0)
+		return;
+
+	g_byte_array_remove_range(conn->in_buf, 0, conn->in_pos);
+	conn->in_pos = 0;
+}
+
+gboolean
+nm_conn_skip(NMConn * conn, gsize * offset, gsize len)
+{
+	if (conn->in_buf->len - conn->in_pos < *offset + len)
+		return FALSE;
+
+	*offset += len;
+	return TRUE;
+}
+
+gboolean
+nm_conn_peek_uint32(NMConn * conn, gsize * offset, guint32 * val)
+{
+	gsize start = *offset;
+
+	if (!nm_conn_skip(conn, offset, sizeof(*val)))
+		return FALSE;
+
+	memcpy(val, conn->in_buf->data + conn->in_pos + start, sizeof(*val));
+	*val = GUINT32_FROM_LE(*val);
+	return TRUE;
+}
+
+/* Check that the field list nm_read_fields() would read is buffered */
+static NMERR_T
+scan_fields(NMConn * conn, gsize * offset, int count, int depth)
+{
+	guint8 type;
+	guint32 val;
+
+	if (depth > NM_MAX_FIELD_DEPTH)
+		return NMERR_PROTOCOL;
+
+	do {
+		if (count > 0) {
+			count--;
+		}
+
+		/* The field type, method, and tag */
+		if (!nm_conn_skip(conn, offset, 1))
+			return NMERR_INCOMPLETE;
+		type = conn->in_buf->data[conn->in_pos + *offset - 1];
+		if (type == 0)
+			break;
+
+		if (!nm_conn_skip(conn, offset, 1) ||
+				!nm_conn_peek_uint32(conn, offset, &val))
+			return NMERR_INCOMPLETE;
+		if (val > 64)
+			return NMERR_PROTOCOL;
+		if (!nm_conn_skip(conn, offset, val))
+			return NMERR_INCOMPLETE;
+
+		/* The value */
+		if (!nm_conn_peek_uint32(conn, offset, &val))
+			return NMERR_INCOMPLETE;
+
+		if (type == NMFIELD_TYPE_MV || type == NMFIELD_TYPE_ARRAY) {
+			if (val > 0) {
+				NMERR_T rc = scan_fields(conn, offset, val, depth + 1);
+				if (rc != NM_OK)
+					return rc;
 			}
+		} else if (type == NMFIELD_TYPE_UTF8 || type == NMFIELD_TYPE_DN) {
+			if (val >= NMFIELD_MAX_STR_LENGTH)
+				return NMERR_PROTOCOL;
+			if (!nm_conn_skip(conn, offset, val))
+				return NMERR_INCOMPLETE;
 		}
+
+	} while (count != 0);
+
+	return NM_OK;
+}
+
+/* Check the status line of a buffered response for a 301 code */
+static gboolean
+scan_is_redirect(const guint8 * start, const guint8 * end)
+{
+	const guint8 *eol, *p;
+
+	eol = memchr(start, '\n', end - start);
+	if (eol == NULL)
+		return FALSE;
+
+	p = memchr(start, ' ', eol - start);
+	return p != NULL && eol - p > 3 &&
+		p[1] == '3' && p[2] == '0' && p[3] == '1' && !isdigit(p[4]);
+}
+
+NMERR_T
+nm_conn_scan_response(NMConn * conn)
+{
+	const guint8 *start, *p, *end;
+	gsize offset;
+
+	if (conn == NULL)
+		return NMERR_BAD_PARM;
+
+	/* The header ends with an empty line */
+	start = conn->in_buf->data + conn->in_pos;
+	end = conn->in_buf->data + conn->in_buf->len;
+	for (p = start; ; p++) {
+		p = memchr(p, '\n', end - p);
+		if (p == NULL || end - p < 3)
+			return NMERR_INCOMPLETE;
+		if (p[1] == '\r' && p[2] == '\n')
+			break;
 	}
-	return rc;
+
+	offset = p + 3 - start;
+
+	/* A redirect may come without any fields, so an empty field list
+	 * ends it rather than leaving us waiting for one */
+	if (scan_is_redirect(start, end) &&
+			conn->in_buf->len - conn->in_pos == offset)
+		return NM_OK;
+
+	return scan_fields(conn, &offset, -1, 0);
+}
+
+NMERR_T
+nm_read_all(NMConn * conn, char *buff, int len)
+{
+	if (conn == NULL || buff == NULL)
+		return NMERR_BAD_PARM;
+
+	if (conn->in_buf->len - conn->in_pos < (gsize)len)
+		return NMERR_TCP_READ;
+
+	memcpy(buff, conn->in_buf->data + conn->in_pos, len);
+	conn->in_pos += len;
+
+	return NM_OK;
 }
 
 NMERR_T
@@ -291,6 +442,56 @@ nm_read_uint16(NMConn *conn, guint16 *val)
 	return rc;
 }
 
+static void
+nm_conn_write_cb(gpointer data, gint source, PurpleInputCondition cond)
+{
+	NMConn *conn = data;
+
+	if (nm_conn_flush(conn) != NM_OK) {
+		/* The read side will notice the connection is gone */
+		purple_debug_error("novell", "Writing to the server failed\n");
+		purple_input_remove(conn->out_watch);
+		conn->out_watch = 0;
+	}
+}
+
+NMERR_T
+nm_conn_flush(NMConn * conn)
+{
+	int ret;
+
+	if (conn == NULL)
+		return NMERR_BAD_PARM;
+
+	while (conn->out_buf->len > 0) {
+		ret = nm_tcp_write(conn, conn->out_buf->data, conn->out_buf->len);
+		if (ret > 0) {
+			g_byte_array_remove_range(conn->out_buf, 0, ret);
+		} else if (ret < 0 && errno == EAGAIN) {
+			/* Finish once the socket takes more */
+			if (conn->out_watch == 0 && conn->fd >= 0)
+				conn->out_watch = purple_input_add(conn->fd, PURPLE_INPUT_WRITE,
+												   nm_conn_write_cb, conn);
+			return NM_OK;
+		} else {
+			return NMERR_TCP_WRITE;
+		}
+	}
+
+	if (conn->out_watch) {
+		purple_input_remove(conn->out_watch);
+		conn->out_watch = 0;
+	}
+
+	return NM_OK;
+}
+
+static void
+nm_conn_append(NMConn * conn, const char *str)
+{
+	g_byte_array_append(conn->out_buf, (const guint8 *)str, strlen(str));
+}
+
 NMERR_T
 nm_write_fields(NMConn * conn, NMField * fields)
 {
@@ -298,16 +499,14 @@ nm_write_fields(NMConn * conn, NMField * fields)
 	NMField *field;
 	char *value = NULL;
 	char *method = NULL;
-	char buffer[4096];
-	int ret;
-	int bytes_to_send;
+	char buffer[64];
 	int val = 0;
 
 	if (conn == NULL || fields == NULL) {
 		return NMERR_BAD_PARM;
 	}
 
-	/* Format each field as valid "post" data and write it out */
+	/* Format each field as valid "post" data and queue it */
 	for (field = fields; (rc == NM_OK) && (field->tag); field++) {
 
 		/* We don't currently handle binary types */
@@ -316,84 +515,51 @@ nm_write_fields(NMConn * conn, NMField * fields)
 			continue;
 		}
 
-		/* Write the field tag */
-		bytes_to_send = g_snprintf(buffer, sizeof(buffer), "&tag=%s", field->tag);
-		ret = nm_tcp_write(conn, buffer, bytes_to_send);
-		if (ret < 0) {
-			rc = NMERR_TCP_WRITE;
-		}
-
-		/* Write the field method */
-		if (rc == NM_OK) {
-			method = encode_method(field->method);
-			bytes_to_send = g_snprintf(buffer, sizeof(buffer), "&cmd=%s", method);
-			ret = nm_tcp_write(conn, buffer, bytes_to_send);
-			if (ret < 0) {
-				rc = NMERR_TCP_WRITE;
-			}
-		}
-
-		/* Write the field value */
-		if (rc == NM_OK) {
-			switch (field->type) {
-				case NMFIELD_TYPE_UTF8:
-				case NMFIELD_TYPE_DN:
+		/* The field tag */
+		nm_conn_append(conn, "&tag=");
+		nm_conn_append(conn, field->tag);
 
-					value = url_escape_string((char *) field->ptr_value);
-					bytes_to_send = g_snprintf(buffer, sizeof(buffer),
-											   "&val=%s", value);
-					if (bytes_to_send > (int)sizeof(buffer)) {
-						ret = nm_tcp_write(conn, buffer, sizeof(buffer));
-					} else {
-						ret = nm_tcp_write(conn, buffer, bytes_to_send);
-					}
+		/* The field method */
+		method = encode_method(field->method);
+		nm_conn_append(conn, "&cmd=");
+		nm_conn_append(conn, method);
 
-					if (ret < 0) {
-						rc = NMERR_TCP_WRITE;
-					}
+		/* The field value */
+		switch (field->type) {
+			case NMFIELD_TYPE_UTF8:
+			case NMFIELD_TYPE_DN:
 
-					g_free(value);
+				value = url_escape_string((char *) field->ptr_value);
+				nm_conn_append(conn, "&val=");
+				if (value != NULL)
+					nm_conn_append(conn, value);
+				g_free(value);
 
-					break;
+				break;
 
-				case NMFIELD_TYPE_ARRAY:
-				case NMFIELD_TYPE_MV:
+			case NMFIELD_TYPE_ARRAY:
+			case NMFIELD_TYPE_MV:
 
-					val = nm_count_fields((NMField *) field->ptr_value);
-					bytes_to_send = g_snprintf(buffer, sizeof(buffer),
-											   "&val=%u", val);
-					ret = nm_tcp_write(conn, buffer, bytes_to_send);
-					if (ret < 0) {
-						rc = NMERR_TCP_WRITE;
-					}
+				val = nm_count_fields((NMField *) field->ptr_value);
+				g_snprintf(buffer, sizeof(buffer), "&val=%u", val);
+				nm_conn_append(conn, buffer);
 
-					break;
+				break;
 
-				default:
+			default:
 
-					bytes_to_send = g_snprintf(buffer, sizeof(buffer),
-											   "&val=%u", field->value);
-					ret = nm_tcp_write(conn, buffer, bytes_to_send);
-					if (ret < 0) {
-						rc = NMERR_TCP_WRITE;
-					}
+				g_snprintf(buffer, sizeof(buffer), "&val=%u", field->value);
+				nm_conn_append(conn, buffer);
 
-					break;
-			}
+				break;
 		}
 
-		/* Write the field type */
-		if (rc == NM_OK) {
-			bytes_to_send = g_snprintf(buffer, sizeof(buffer),
-									   "&type=%u", field->type);
-			ret = nm_tcp_write(conn, buffer, bytes_to_send);
-			if (ret < 0) {
-				rc = NMERR_TCP_WRITE;
-			}
-		}
+		/* The field type */
+		g_snprintf(buffer, sizeof(buffer), "&type=%u", field->type);
+		nm_conn_append(conn, buffer);
 
 		/* If the field is a sub array then post its fields */
-		if (rc == NM_OK && val > 0) {
+		if (val > 0) {
 			if (field->type == NMFIELD_TYPE_ARRAY ||
 				field->type == NMFIELD_TYPE_MV) {
 
@@ -411,63 +577,47 @@ nm_send_request(NMConn *conn, char *cmd, NMField *fields,
 				nm_response_cb cb, gpointer data, NMRequest **request)
 {
 	NMERR_T rc = NM_OK;
-	char buffer[512];
-	int bytes_to_send;
-	int ret;
-	NMField *request_fields = NULL;
 	char *str = NULL;
+	NMField *request_fields = NULL;
+	guint queued;
 
 	if (conn == NULL || cmd == NULL)
 		return NMERR_BAD_PARM;
 
-	/* Write the post */
-	bytes_to_send = g_snprintf(buffer, sizeof(buffer),
-							   "POST /%s HTTP/1.0\r\n", cmd);
-	ret = nm_tcp_write(conn, buffer, bytes_to_send);
-	if (ret < 0) {
-		rc = NMERR_TCP_WRITE;
-	}
+	queued = conn->out_buf->len;
 
-	/* Write headers */
-	if (rc == NM_OK) {
-		if (purple_strequal("login", cmd)) {
-			bytes_to_send = g_snprintf(buffer, sizeof(buffer),
-									   "Host: %s:%d\r\n\r\n", conn->addr, conn->port);
-			ret = nm_tcp_write(conn, buffer, bytes_to_send);
-			if (ret < 0) {
-				rc = NMERR_TCP_WRITE;
-			}
-		} else {
-			bytes_to_send = g_snprintf(buffer, sizeof(buffer), "\r\n");
-			ret = nm_tcp_write(conn, buffer, bytes_to_send);
-			if (ret < 0) {
-				rc = NMERR_TCP_WRITE;
-			}
-		}
+	/* The post */
+	str = g_strdup_printf("POST /%s HTTP/1.0\r\n", cmd);
+	nm_conn_append(conn, str);
+	g_free(str);
+
+	/* Headers */
+	if (purple_strequal("login", cmd)) {
+		str = g_strdup_printf("Host: %s:%d\r\n\r\n", conn->addr, conn->port);
+		nm_conn_append(conn, str);
+		g_free(str);
+	} else {
+		nm_conn_append(conn, "\r\n");
 	}
 
 	/* Add the transaction id to the request fields */
-	if (rc == NM_OK) {
-		if (fields)
-			request_fields = nm_copy_field_array(fields);
+	if (fields)
+		request_fields = nm_copy_field_array(fields);
 
-		str = g_strdup_printf("%d", ++(conn->trans_id));
-		request_fields = nm_field_add_pointer(request_fields, NM_A_SZ_TRANSACTION_ID, 0,
-											  NMFIELD_METHOD_VALID, 0,
-											  str, NMFIELD_TYPE_UTF8);
-	}
+	str = g_strdup_printf("%d", ++(conn->trans_id));
+	request_fields = nm_field_add_pointer(request_fields, NM_A_SZ_TRANSACTION_ID, 0,
+										  NMFIELD_METHOD_VALID, 0,
+										  str, NMFIELD_TYPE_UTF8);
 
-	/* Send the request to the server */
+	/* The request itself, terminated by a CRLF */
+	rc = nm_write_fields(conn, request_fields);
 	if (rc == NM_OK) {
-		rc = nm_write_fields(conn, request_fields);
-	}
+		nm_conn_append(conn, "\r\n");
 
-	/* Write the CRLF to terminate the data */
-	if (rc == NM_OK) {
-		ret = nm_tcp_write(conn, "\r\n", strlen("\r\n"));
-		if (ret < 0) {
-			rc = NMERR_TCP_WRITE;
-		}
+		/* Send it all at once */
+		rc = nm_conn_flush(conn);
+	} else {
+		g_byte_array_set_size(conn->out_buf, queued);
 	}
 
 	/* Create a request struct, add it to our queue, and return it */
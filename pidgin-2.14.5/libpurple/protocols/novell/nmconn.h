@@ -60,6 +60,16 @@ struct _NMConn
 	/* SSL connection  */
 	NMSSLConn *ssl_conn;
 
+	/* Data received but not parsed yet, starting at in_pos. */
+	GByteArray *in_buf;
+	gsize in_pos;
+
+	/* Data waiting for the socket to become writable. */
+	GByteArray *out_buf;
+
+	/* The watch for the socket becoming writable, while out_buf isn't empty. */
+	guint out_watch;
+
 };
 
 struct _NMSSLConn
@@ -116,13 +126,69 @@ int nm_tcp_write(NMConn * conn, const void *buff, int len);
 int nm_tcp_read(NMConn * conn, void *buff, int len);
 
 /**
- * Read exactly len bytes into the given buffer.
+ * Read everything that can be read from the connection without blocking
+ * into its input buffer, for nm_read_all() and friends to parse.
+ *
+ * @param conn	The connection to read from.
+ *
+ * @return		NM_OK on success, even if nothing was available,
+ *				NMERR_TCP_READ if the connection was closed or failed.
+ */
+NMERR_T nm_conn_fill(NMConn * conn);
+
+/**
+ * Drop the data that has been parsed from the input buffer.
+ *
+ * @param conn	The connection.
+ */
+void nm_conn_compact(NMConn * conn);
+
+/**
+ * Check that len bytes are buffered at offset past the parse position,
+ * without consuming them, and advance offset past them.
+ *
+ * @param conn		The connection.
+ * @param offset	The offset from the parse position.
+ * @param len		The number of bytes.
+ *
+ * @return			TRUE if the bytes are buffered.
+ */
+gboolean nm_conn_skip(NMConn * conn, gsize * offset, gsize len);
+
+/**
+ * Get the 32 bit value buffered at offset past the parse position, in the
+ * host byte order, without consuming it, and advance offset past it.
+ *
+ * @param conn		The connection.
+ * @param offset	The offset from the parse position.
+ * @param val		A pointer to unsigned 32 bit integer
+ *
+ * @return			TRUE if the value is buffered.
+ */
+gboolean nm_conn_peek_uint32(NMConn * conn, gsize * offset, guint32 * val);
+
+/**
+ * Check whether a whole response (header and fields) is buffered, so that
+ * it can be read with nm_read_header() and nm_read_fields().  A 301
+ * redirect with nothing buffered after its header counts as complete.
+ *
+ * @param conn	The connection.
+ *
+ * @return		NM_OK if it is, NMERR_INCOMPLETE if more data is needed,
+ *				NMERR_PROTOCOL if it can't be a valid response.
+ */
+NMERR_T nm_conn_scan_response(NMConn * conn);
+
+/**
+ * Read exactly len bytes into the given buffer, from the data that
+ * nm_conn_fill() buffered.
  *
  * @param conn	The connection to read from.
  * @param buff	The buffer to write to.
  * @param len	The number of bytes to read.
  *
- * @return		NM_OK on success, NMERR_TCP_READ if read fails.
+ * @return		NM_OK on success, NMERR_TCP_READ if not enough data
+ *				is buffered.
  */
 NMERR_T nm_read_all(NMConn * conn, char *buf, int len);
 
@@ -165,7 +231,8 @@ nm_send_request(NMConn *conn, char *cmd, NMField *fields,
 				nm_response_cb cb, gpointer data, NMRequest **request);
 
 /**
- * Write out the given field list.
+ * Queue the given field list for writing.  It is sent by the next
+ * nm_conn_flush().
  *
  * @param conn		The connection to write to.
  * @param fields	The field list to write.
@@ -174,6 +241,16 @@ nm_send_request(NMConn *conn, char *cmd, NMField *fields,
  */
 NMERR_T nm_write_fields(NMConn * conn, NMField * fields);
 
+/**
+ * Write as much of the queued data as the socket takes without blocking.
+ * Whatever is left is written once the socket becomes writable again.
+ *
+ * @param conn		The connection to write to.
+ *
+ * @return			NM_OK on success, NMERR_TCP_WRITE if the write failed.
+ */
+NMERR_T nm_conn_flush(NMConn * conn);
+
 /**
  * Read the headers for a response.
  *
@@ -683,6 +683,37 @@ handle_undeliverable_status(NMUser * user, NMEvent * event)
 	return rc;
 }
 
+/* What the handlers above read after the event source, one letter per
+ * item: 's' a string (32 bit length and the data), 'u' a 32 bit value,
+ * 'h' a 16 bit value.  Keep it in sync with them.
+ */
+static const char *
+event_layout(int type)
+{
+	switch (type) {
+		case NMEVT_STATUS_CHANGE:
+			return "hs";
+		case NMEVT_RECEIVE_MESSAGE:
+		case NMEVT_RECEIVE_AUTOREPLY:
+			return "sus";
+		case NMEVT_CONFERENCE_LEFT:
+		case NMEVT_CONFERENCE_JOINED:
+			return "su";
+		case NMEVT_CONFERENCE_INVITE:
+			return "ss";
+		case NMEVT_USER_TYPING:
+		case NMEVT_USER_NOT_TYPING:
+		case NMEVT_CONFERENCE_CLOSED:
+		case NMEVT_CONFERENCE_REJECT:
+		case NMEVT_CONFERENCE_INVITE_NOTIFY:
+		case NMEVT_UNDELIVERABLE_STATUS:
+			return "s";
+		default:
+			/* Nothing else to read, or nm_process_event rejects it */
+			return "";
+	}
+}
+
 /*******************************************************************************
  * Event API -- see header file for comments
  ******************************************************************************/
@@ -812,6 +843,51 @@ nm_event_get_gmt(NMEvent * event)
 		return (time_t)-1;
 }
 
+NMERR_T
+nm_event_scan(NMConn * conn, int type, gsize offset)
+{
+	const char *item;
+	guint32 size;
+
+	if (conn == NULL)
+		return NMERR_BAD_PARM;
+
+	if (type < NMEVT_START || type > NMEVT_STOP)
+		return NM_OK;
+
+	/* The event source */
+	if (!nm_conn_peek_uint32(conn, &offset, &size))
+		return NMERR_INCOMPLETE;
+	if (size > 1000000)
+		return NMERR_PROTOCOL;
+	if (!nm_conn_skip(conn, &offset, size))
+		return NMERR_INCOMPLETE;
+
+	for (item = event_layout(type); *item; item++) {
+		switch (*item) {
+			case 's':
+				if (!nm_conn_peek_uint32(conn, &offset, &size))
+					return NMERR_INCOMPLETE;
+				/* More than any handler accepts */
+				if (size > 100000)
+					return NMERR_PROTOCOL;
+				if (!nm_conn_skip(conn, &offset, size))
+					return NMERR_INCOMPLETE;
+				break;
+			case 'u':
+				if (!nm_conn_skip(conn, &offset, sizeof(guint32)))
+					return NMERR_INCOMPLETE;
+				break;
+			case 'h':
+				if (!nm_conn_skip(conn, &offset, sizeof(guint16)))
+					return NMERR_INCOMPLETE;
+				break;
+		}
+	}
+
+	return NM_OK;
+}
+
 NMERR_T
 nm_process_event(NMUser * user, int type)
 {
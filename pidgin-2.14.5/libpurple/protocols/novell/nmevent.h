@@ -61,6 +61,19 @@ typedef struct _NMEvent NMEvent;
  */
 NMERR_T nm_process_event(NMUser * user, int type);
 
+/**
+ * Check whether the whole event is buffered on the connection, so that
+ * nm_process_event() can read it without running out of data.
+ *
+ * @param conn		The connection.
+ * @param type		The type of the event.
+ * @param offset	Where the event data starts, past the parse position.
+ *
+ * @return			NM_OK if it is, NMERR_INCOMPLETE if more data is
+ *					needed, NMERR_PROTOCOL if it can't be a valid event.
+ */
+NMERR_T nm_event_scan(struct _NMConn * conn, int type, gsize offset);
+
 /**
  * Creates an NMEvent
  *
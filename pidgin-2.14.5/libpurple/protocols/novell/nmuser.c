@@ -995,7 +995,7 @@ NMERR_T
 nm_process_new_data(NMUser * user)
 {
 	NMConn *conn;
-	NMERR_T rc = NM_OK;
+	NMERR_T rc = NM_OK, fill_rc;
 	guint32 val;
 
 	if (user == NULL)
@@ -1003,21 +1003,41 @@ nm_process_new_data(NMUser * user)
 
 	conn = user->conn;
 
-	/* Check to see if this is an event or a response */
-	rc = nm_read_all(conn, (char *) &val, sizeof(val));
-	if (rc == NM_OK) {
-		if (strncmp((char *) &val, "HTTP", strlen("HTTP")) == 0)
-			rc = nm_process_response(user);
-		else
-			rc = nm_process_event(user, GUINT32_FROM_LE(val));
+	/* Take in all the data that arrived, then handle every complete
+	 * event or response in it.  The rest waits for more data, so that
+	 * no read ever has to wait for the server. */
+	fill_rc = nm_conn_fill(conn);
 
-	} else {
-		if (errno == EAGAIN)
-			rc = NM_OK;
-		else
-			rc = NMERR_PROTOCOL;
+	while (rc == NM_OK) {
+		gsize offset = 0;
+
+		if (!nm_conn_peek_uint32(conn, &offset, &val)) {
+			rc = NMERR_INCOMPLETE;
+			break;
+		}
+
+		/* Check to see if this is an event or a response */
+		if (strncmp((char *) conn->in_buf->data + conn->in_pos, "HTTP",
+					strlen("HTTP")) == 0) {
+			rc = nm_conn_scan_response(conn);
+			if (rc == NM_OK) {
+				nm_read_uint32(conn, &val);
+				rc = nm_process_response(user);
+			}
+		} else {
+			rc = nm_event_scan(conn, val, offset);
+			if (rc == NM_OK) {
+				nm_read_uint32(conn, &val);
+				rc = nm_process_event(user, val);
+			}
+		}
 	}
 
+	nm_conn_compact(conn);
+
+	if (rc == NMERR_INCOMPLETE)
+		rc = fill_rc;
+
 	return rc;
 }
 
@@ -1775,6 +1795,14 @@ nm_process_response(NMUser * user)
 	rc = nm_read_header(conn);
 	if (rc == NM_OK) {
 		rc = nm_read_fields(conn, -1, &fields);
+	} else if (rc == NMERR_SERVER_REDIRECT) {
+		gsize offset = 0;
+
+		/* Skip the fields of the redirect, if nm_conn_scan_response()
+		 * found any, so the next message starts in the right place */
+		if (nm_conn_skip(conn, &offset, 1) &&
+				nm_read_fields(conn, -1, &fields) != NM_OK)
+			rc = NMERR_PROTOCOL;
 	}
 
 	if (rc == NM_OK) {
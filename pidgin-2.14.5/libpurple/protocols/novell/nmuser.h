@@ -149,6 +149,7 @@ struct _NMUser
 #define NMERR_CONFERENCE_NOT_FOUND 			(NMERR_BASE + 0x0006)
 #define NMERR_CONFERENCE_NOT_INSTANTIATED 	(NMERR_BASE + 0x0007)
 #define NMERR_FOLDER_EXISTS					(NMERR_BASE + 0x0008)
+#define NMERR_INCOMPLETE					(NMERR_BASE + 0x0009)
 
 /* Errors that are returned from the server */
 #define NMERR_SERVER_BASE			 	0xD100L
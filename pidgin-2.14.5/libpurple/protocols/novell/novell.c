@@ -1729,6 +1729,9 @@ novell_ssl_connected_cb(gpointer data, PurpleSslConnection * gsc,
 	purple_connection_update_progress(gc, _("Authenticating..."),
 									2, NOVELL_CONNECT_STEPS);
 
+	/* Lets nm_conn_flush() wait for the socket to become writable */
+	conn->fd = gsc->fd;
+
 	my_addr = purple_network_get_my_ip(gsc->fd);
 	pwd = purple_connection_get_password(gc);
 	ua = _user_agent_string();
@@ -2227,6 +2230,10 @@ novell_close(PurpleConnection * gc)
 	user = gc->proto_data;
 	if (user) {
 		conn = user->conn;
+		if (conn && conn->out_watch) {
+			purple_input_remove(conn->out_watch);
+			conn->out_watch = 0;
+		}
 		if (conn && conn->ssl_conn) {
 			purple_ssl_close(user->conn->ssl_conn->data);
 		}
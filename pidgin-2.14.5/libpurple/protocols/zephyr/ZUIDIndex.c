@@ -0,0 +1,142 @@
+/* This file is part of the Project Athena Zephyr Notification System.
+ * It contains source for the indexes the client keeps by notice uid:
+ * the old uids filter, which drops notices already received, and the
+ * index of the input queue, which matches fragments to their notice.
+ *
+ *	For copying and distribution information, see the file
+ *	"mit-copyright.h".
+ */
+
+#include "internal.h"
+
+/* Hash and compare a (uid, kind) pair.  Both the old uids filter and the
+ * reassembly queue index key on this pair; the queue index stores the
+ * _Z_InputQ entries themselves, so the key types differ. */
+static guint Z_HashUID(const ZUnique_Id_t *uid, ZNotice_Kind_t kind)
+{
+    const unsigned char *p = (const unsigned char *)uid;
+    guint h = 5381;
+    size_t i;
+
+    for (i = 0; i < sizeof(*uid); i++)
+	h = (h << 5) + h + p[i];
+
+    return (h ^ (guint)kind);
+}
+
+struct _filter {
+    ZUnique_Id_t	uid;
+    ZNotice_Kind_t	kind;
+    time_t		t;
+};
+
+static guint filter_hash(gconstpointer key)
+{
+    const struct _filter *f = key;
+
+    return (Z_HashUID(&f->uid, f->kind));
+}
+
+static gboolean filter_equal(gconstpointer a, gconstpointer b)
+{
+    const struct _filter *fa = a, *fb = b;
+
+    return (fa->kind == fb->kind &&
+	    !memcmp(&fa->uid, &fb->uid, sizeof(fa->uid)));
+}
+
+/* Find or insert uid in the old uids filter, returning 1 if it was found.
+ * The filter is a hash table for the lookup plus a queue in arrival
+ * order, so that uids older than the clock skew can be aged out from the
+ * front without scanning. */
+int Z_FilterUID(uid, kind, now)
+    ZUnique_Id_t *uid;
+    ZNotice_Kind_t kind;
+    time_t now;
+{
+    static GHashTable *table;
+    static GQueue *order;
+
+    struct _filter key, *f;
+
+    /* Initialize the uid filter if it hasn't been done already. */
+    if (!table) {
+	table = g_hash_table_new(filter_hash, filter_equal);
+	order = g_queue_new();
+    }
+
+    /* Age the uid filter, discarding any uids older than the clock skew. */
+    while ((f = g_queue_peek_head(order)) && (now - f->t) > CLOCK_SKEW) {
+	g_queue_pop_head(order);
+	g_hash_table_remove(table, f);
+	g_free(f);
+    }
+
+    key.uid = *uid;
+    key.kind = kind;
+    if (g_hash_table_lookup(table, &key))
+	return 1;
+
+    /* We didn't find it; remember it. */
+    f = g_new(struct _filter, 1);
+    *f = key;
+    f->t = now;
+    g_hash_table_insert(table, f, f);
+    g_queue_push_tail(order, f);
+
+    return 0;
+}
+
+/* Index of the input queue by (multiuid, kind), so that fragments can be
+ * matched to their notice without walking the queue.  Only clients
+ * reassemble fragments, so the index is not maintained for servers. */
+static GHashTable *queue_index;
+
+static guint queue_hash(gconstpointer key)
+{
+    const struct _Z_InputQ *q = key;
+
+    return (Z_HashUID(&q->uid, q->kind));
+}
+
+static gboolean queue_equal(gconstpointer a, gconstpointer b)
+{
+    const struct _Z_InputQ *qa = a, *qb = b;
+
+    return (qa->kind == qb->kind &&
+	    !memcmp(&qa->uid, &qb->uid, sizeof(qa->uid)));
+}
+
+void Z_IndexQueue(qptr)
+    struct _Z_InputQ *qptr;
+{
+    if (!queue_index)
+	queue_index = g_hash_table_new(queue_hash, queue_equal);
+
+    /* The entry is the key as well, so an older entry for the same
+     * multiuid must not be left behind as the key when it is freed. */
+    g_hash_table_replace(queue_index, qptr, qptr);
+}
+
+void Z_UnindexQueue(qptr)
+    struct _Z_InputQ *qptr;
+{
+    /* Only if the entry is the one indexed, not another one for the same
+     * multiuid that replaced it. */
+    if (queue_index && g_hash_table_lookup(queue_index, qptr) == qptr)
+	g_hash_table_remove(queue_index, qptr);
+}
+
+struct _Z_InputQ *Z_LookupQueue(uid, kind)
+    ZUnique_Id_t *uid;
+    ZNotice_Kind_t kind;
+{
+    struct _Z_InputQ key;
+
+    if (!queue_index)
+	return (NULL);
+
+    key.uid = *uid;
+    key.kind = kind;
+    return (g_hash_table_lookup(queue_index, &key));
+}
@@ -64,79 +64,6 @@ void *__Z_debug_print_closure;
 #define min(a,b) ((a)<(b)?(a):(b))
 
 static int Z_AddField __P((char **ptr, const char *field, char *end));
-static int find_or_insert_uid __P((ZUnique_Id_t *uid, ZNotice_Kind_t kind));
-
-/* Find or insert uid in the old uids buffer.  The buffer is a sorted
- * circular queue.  We make the assumption that most packets arrive in
- * order, so we can usually search for a uid or insert it into the buffer
- * by looking back just a few entries from the end.  Since this code is
- * only executed by the client, the implementation isn't microoptimized. */
-static int find_or_insert_uid(uid, kind)
-    ZUnique_Id_t *uid;
-    ZNotice_Kind_t kind;
-{
-    static struct _filter {
-	ZUnique_Id_t	uid;
-	ZNotice_Kind_t	kind;
-	time_t		t;
-    } *buffer;
-    static long size;
-    static long start;
-    static long num;
-
-    time_t now;
-    struct _filter *new;
-    long i, j, new_size;
-    int result;
-
-    /* Initialize the uid buffer if it hasn't been done already. */
-    if (!buffer) {
-	size = Z_INITFILTERSIZE;
-	buffer = (struct _filter *) malloc(size * sizeof(*buffer));
-	if (!buffer)
-	    return 0;
-    }
-
-    /* Age the uid buffer, discarding any uids older than the clock skew. */
-    time(&now);
-    while (num && (now - buffer[start % size].t) > CLOCK_SKEW)
-	start++, num--;
-    start %= size;
-
-    /* Make room for a new uid, since we'll probably have to insert one. */
-    if (num == size) {
-	new_size = size * 2 + 2;
-	new = (struct _filter *) malloc(new_size * sizeof(*new));
-	if (!new)
-	    return 0;
-	for (i = 0; i < num; i++)
-	    new[i] = buffer[(start + i) % size];
-	free(buffer);
-	buffer = new;
-	size = new_size;
-	start = 0;
-    }
-
-    /* Search for this uid in the buffer, starting from the end. */
-    for (i = start + num - 1; i >= start; i--) {
-	result = memcmp(uid, &buffer[i % size].uid, sizeof(*uid));
-	if (result == 0 && buffer[i % size].kind == kind)
-	    return 1;
-	if (result > 0)
-	    break;
-    }
-
-    /* We didn't find it; insert the uid into the buffer after i. */
-    i++;
-    for (j = start + num; j > i; j--)
-	buffer[j % size] = buffer[(j - 1) % size];
-    buffer[i % size].uid = *uid;
-    buffer[i % size].kind = kind;
-    buffer[i % size].t = now;
-    num++;
-
-    return 0;
-}
 
 
 /* Return 1 if there is a packet waiting, 0 otherwise */
@@ -195,22 +122,30 @@ Code_t Z_ReadEnqueue()
 static struct _Z_InputQ *Z_SearchQueue(ZUnique_Id_t *uid, ZNotice_Kind_t kind)
 {
     register struct _Z_InputQ *qptr;
-    struct _Z_InputQ *next;
+    struct _Z_InputQ *next, *found;
     struct timeval tv;
+    static time_t last_expire;
 
     (void) gettimeofday(&tv, (struct timezone *)0);
 
-    qptr = __Q_Head;
-
-    while (qptr) {
-	if (ZCompareUID(uid, &qptr->uid) && qptr->kind == kind)
-	    return (qptr);
-	next = qptr->next;
-	if (qptr->timep && ((time_t)qptr->timep+Z_NOTICETIMELIMIT < tv.tv_sec))
-	    Z_RemQueue(qptr);
-	qptr = next;
+    found = Z_LookupQueue(uid, kind);
+
+    /* Expiring stale notices still needs a walk of the queue, but the
+     * time limit is in seconds, so there's no point doing it more than
+     * once a second. */
+    if (tv.tv_sec != last_expire) {
+	last_expire = tv.tv_sec;
+	qptr = __Q_Head;
+	while (qptr) {
+	    next = qptr->next;
+	    if (qptr != found && qptr->timep &&
+		((time_t)qptr->timep+Z_NOTICETIMELIMIT < tv.tv_sec))
+		Z_RemQueue(qptr);
+	    qptr = next;
+	}
     }
-    return (NULL);
+
+    return (found);
 }
 
 /*
@@ -295,7 +230,7 @@ Code_t Z_ReadWait()
 		return (retval);
 	    __HM_addr = olddest;
 	}
-	if (find_or_insert_uid(&notice.z_uid, notice.z_kind))
+	if (Z_FilterUID(&notice.z_uid, notice.z_kind, time(NULL)))
 	    return(ZERR_NONE);
 
 	/* Check authentication on the notice. */
@@ -401,6 +336,9 @@ Code_t Z_ReadWait()
     qptr->kind = notice.z_kind;
     qptr->auth = notice.z_checked_auth;
 
+    if (!__Zephyr_server)
+	Z_IndexQueue(qptr);
+
     /*
      * If this is the first part of the notice, we take the header
      * from it.  We only take it if this is the first fragment so that
@@ -819,6 +757,8 @@ void Z_RemQueue(qptr)
 
     __Q_Size -= qptr->msg_len;
 
+    Z_UnindexQueue(qptr);
+
     if (qptr->header)
 	free(qptr->header);
     if (qptr->msg)
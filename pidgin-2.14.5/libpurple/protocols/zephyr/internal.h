@@ -102,6 +102,10 @@ struct _Z_InputQ *Z_GetFirstComplete __P((void));
 struct _Z_InputQ *Z_GetNextComplete __P((struct _Z_InputQ *));
 Code_t Z_XmitFragment __P((ZNotice_t*, char *,int,int));
 void Z_RemQueue __P((struct _Z_InputQ *));
+int Z_FilterUID __P((ZUnique_Id_t *, ZNotice_Kind_t, time_t));
+void Z_IndexQueue __P((struct _Z_InputQ *));
+void Z_UnindexQueue __P((struct _Z_InputQ *));
+struct _Z_InputQ *Z_LookupQueue __P((ZUnique_Id_t *, ZNotice_Kind_t));
 Code_t Z_AddNoticeToEntry __P((struct _Z_InputQ*, ZNotice_t*, int));
 Code_t Z_FormatAuthHeader __P((ZNotice_t *, char *, int, int *, Z_AuthProc));
 Code_t Z_FormatHeader __P((ZNotice_t *, char *, int, int *, Z_AuthProc));
@@ -74,7 +74,8 @@ struct _zephyr_account {
 	char *encoding;
 	char* galaxy; /* not yet useful */
 	char* krbtkfile; /* not yet useful */
-	guint32 nottimer;
+	guint32 notwatch;
+	guint32 drain_timer;
 	guint32 loctimer;
 	GList *pending_zloc_names;
 	GSList *subscrips;
@@ -154,6 +155,8 @@ struct _zephyr_triple {
 extern const char *username;
 #endif
 
+static void zephyr_schedule_drain(zephyr_account *zephyr);
+
 static Code_t zephyr_subscribe_to(zephyr_account* zephyr, char* class, char *instance, char *recipient, char* galaxy) {
 	size_t result;
 	Code_t ret_val = -1;
@@ -177,6 +180,7 @@ static Code_t zephyr_subscribe_to(zephyr_account* zephyr, char* class, char *ins
 			sub.zsub_classinst = instance;
 			sub.zsub_recipient = recipient;
 			ret_val = ZSubscribeTo(&sub,1,0);
+			zephyr_schedule_drain(zephyr);
 		}
 	}
 	return ret_val;
@@ -1111,7 +1115,7 @@ static parse_tree  *read_from_tzc(zephyr_account* zephyr){
 	return incoming_msg;
 }
 
-static gint check_notify_tzc(gpointer data)
+static void check_notify_tzc(gpointer data, gint source, PurpleInputCondition cond)
 {
 	PurpleConnection *gc = (PurpleConnection *)data;
 	zephyr_account* zephyr = gc->proto_data;
@@ -1219,10 +1223,9 @@ static gint check_notify_tzc(gpointer data)
 
 	free_parse_tree(newparsetree);
 	g_free(newparsetree);
-	return TRUE;
 }
 
-static gint check_notify_zeph02(gpointer data)
+static void check_notify_zeph02(gpointer data, gint source, PurpleInputCondition cond)
 {
 	/* XXX add real error reporting */
 	PurpleConnection *gc = (PurpleConnection*) data;
@@ -1231,7 +1234,7 @@ static gint check_notify_zeph02(gpointer data)
 		struct sockaddr_in from;
 		/* XXX add real error reporting */
 
-		z_call_r(ZReceiveNotice(&notice, &from));
+		z_call(ZReceiveNotice(&notice, &from));
 
 		switch (notice.z_kind) {
 		case UNSAFE:
@@ -1257,8 +1260,38 @@ static gint check_notify_zeph02(gpointer data)
 		/* XXX add real error reporting */
 		ZFreeNotice(&notice);
 	}
+}
 
-	return TRUE;
+static gboolean zephyr_drain_cb(gpointer data)
+{
+	PurpleConnection *gc = data;
+	zephyr_account *zephyr = gc->proto_data;
+
+	zephyr->drain_timer = 0;
+	check_notify_zeph02(gc, ZGetFD(), PURPLE_INPUT_READ);
+
+	return FALSE;
+}
+
+/*
+ * While libzephyr waits for an acknowledgement (sending a notice,
+ * subscribing, locating a user) it reads and queues any other notices
+ * that arrive in the meantime.  Those have already been pulled off the
+ * socket, so the input watch will not fire for them; hand them to
+ * check_notify_zeph02() from the main loop instead.
+ */
+static void zephyr_schedule_drain(zephyr_account *zephyr)
+{
+	PurpleConnection *gc;
+
+	if (!use_zeph02(zephyr) || zephyr->drain_timer || ZQLength() <= 0)
+		return;
+
+	gc = purple_account_get_connection(zephyr->account);
+	if (gc == NULL)
+		return;
+
+	zephyr->drain_timer = purple_timeout_add(0, zephyr_drain_cb, gc);
 }
 
 #ifdef WIN32
@@ -1280,6 +1313,7 @@ static gint check_loc(gpointer data)
 		const char *bname = purple_buddy_get_name(b);
 		chk = local_zephyr_normalize(bname);
 		ZLocateUser(chk,&numlocs, ZAUTH);
+		zephyr_schedule_drain(zephyr);
 		if (numlocs) {
 			int i;
 			for(i=0;i<numlocs;i++) {
@@ -1324,6 +1358,7 @@ static gint check_loc(gpointer data)
 			int numlocs;
 			int one=1;
 			ZLocateUser(chk,&numlocs,ZAUTH);
+			zephyr_schedule_drain(zephyr);
 			if (numlocs) {
 				int i;
 				for(i=0;i<numlocs;i++) {
@@ -1336,6 +1371,7 @@ static gint check_loc(gpointer data)
 			}
 #else
 			ZRequestLocations(chk, &ald, UNACKED, ZAUTH);
+			zephyr_schedule_drain(zephyr);
 			g_free(ald.user);
 			g_free(ald.version);
 #endif /* WIN32 */
@@ -1860,9 +1896,12 @@ static void zephyr_login(PurpleAccount * account)
 		process_zsubs(zephyr);
 
 	if (use_zeph02(zephyr)) {
-		zephyr->nottimer = purple_timeout_add(100, check_notify_zeph02, gc);
+		zephyr->notwatch = purple_input_add(ZGetFD(), PURPLE_INPUT_READ,
+				check_notify_zeph02, gc);
+		zephyr_schedule_drain(zephyr);
 	} else if (use_tzc(zephyr)) {
-		zephyr->nottimer = purple_timeout_add(100, check_notify_tzc, gc);
+		zephyr->notwatch = purple_input_add(zephyr->fromtzc[ZEPHYR_FD_READ],
+				PURPLE_INPUT_READ, check_notify_tzc, gc);
 	}
 	zephyr->loctimer = purple_timeout_add_seconds(20, check_loc, gc);
 
@@ -1990,9 +2029,12 @@ static void zephyr_close(PurpleConnection * gc)
 	}
 	g_slist_free(zephyr->subscrips);
 
-	if (zephyr->nottimer)
-		purple_timeout_remove(zephyr->nottimer);
-	zephyr->nottimer = 0;
+	if (zephyr->notwatch)
+		purple_input_remove(zephyr->notwatch);
+	zephyr->notwatch = 0;
+	if (zephyr->drain_timer)
+		purple_timeout_remove(zephyr->drain_timer);
+	zephyr->drain_timer = 0;
 	if (zephyr->loctimer)
 		purple_timeout_remove(zephyr->loctimer);
 	zephyr->loctimer = 0;
@@ -2200,6 +2242,7 @@ static int zephyr_send_message(zephyr_account *zephyr,char* zclass, char* instan
 			return 0;
 		}
 		purple_debug_info("zephyr","notice sent\n");
+		zephyr_schedule_drain(zephyr);
 		g_free(buf);
 	}
 
@@ -2264,6 +2307,7 @@ static void zephyr_zloc(PurpleConnection *gc, const char *who)
 		} else {
 			/* XXX deal with errors somehow */
 		}
+		zephyr_schedule_drain(zephyr);
 	} else if (use_tzc(zephyr)) {
 		size_t len;
 		size_t result;
@@ -2295,6 +2339,7 @@ static void zephyr_set_status(PurpleAccount *account, PurpleStatus *status) {
 	else if (primitive == PURPLE_STATUS_AVAILABLE) {
 		if (use_zeph02(zephyr)) {
 			ZSetLocation(zephyr->exposure);
+			zephyr_schedule_drain(zephyr);
 		}
 		else {
 			char *zexpstr = g_strdup_printf("((tzcfodder . set-location) (hostname . \"%s\") (exposure . \"%s\"))\n",zephyr->ourhost,zephyr->exposure);
@@ -2310,6 +2355,7 @@ static void zephyr_set_status(PurpleAccount *account, PurpleStatus *status) {
 		/* XXX handle errors */
 		if (use_zeph02(zephyr)) {
 			ZSetLocation(EXPOSE_OPSTAFF);
+			zephyr_schedule_drain(zephyr);
 		} else {
 			char *zexpstr = g_strdup_printf("((tzcfodder . set-location) (hostname . \"%s\") (exposure . \"%s\"))\n",zephyr->ourhost,EXPOSE_OPSTAFF);
 			len = strlen(zexpstr);
@@ -2805,7 +2851,9 @@ static void zephyr_action_get_subs_from_server(PurplePluginAction *action)
 			purple_debug_error("zephyr", "error while retrieving port\n");
 			return;
 		}
-		if ((retval = ZRetrieveSubscriptions(zephyr->port,&nsubs)) != ZERR_NONE) {
+		retval = ZRetrieveSubscriptions(zephyr->port,&nsubs);
+		zephyr_schedule_drain(zephyr);
+		if (retval != ZERR_NONE) {
 			/* XXX better error handling */
 			purple_debug_error("zephyr", "error while retrieving subscriptions from server\n");
 			return;
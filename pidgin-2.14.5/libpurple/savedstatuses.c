@@ -336,7 +336,6 @@ static void
 sync_statuses(void)
 {
 	xmlnode *node;
-	char *data;
 
 	if (!statuses_loaded)
 	{
@@ -346,9 +345,7 @@ sync_statuses(void)
 	}
 
 	node = statuses_to_xmlnode();
-	data = xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_file("status.xml", data, -1);
-	g_free(data);
+	purple_util_write_xml_to_file("status.xml", node);
 	xmlnode_free(node);
 }
 
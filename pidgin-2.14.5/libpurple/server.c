@@ -600,9 +600,9 @@ void serv_got_im(PurpleConnection *gc, const char *who, const char *msg,
 	angel = g_strdup(who);
 
 	plugin_return = GPOINTER_TO_INT(
-		purple_signal_emit_return_1(purple_conversations_get_handle(),
-								  "receiving-im-msg", gc->account,
-								  &angel, &buffy, conv, &flags));
+		purple_signal_emit_resolved_return_1(
+			_purple_conversations_get_signal(PURPLE_CONV_SIGNAL_RECEIVING_IM_MSG),
+			gc->account, &angel, &buffy, conv, &flags));
 
 	if (!buffy || !angel || plugin_return) {
 		g_free(buffy);
@@ -613,8 +613,9 @@ void serv_got_im(PurpleConnection *gc, const char *who, const char *msg,
 	name = angel;
 	message = buffy;
 
-	purple_signal_emit(purple_conversations_get_handle(), "received-im-msg", gc->account,
-					 name, message, conv, flags);
+	purple_signal_emit_resolved(
+		_purple_conversations_get_signal(PURPLE_CONV_SIGNAL_RECEIVED_IM_MSG),
+		gc->account, name, message, conv, flags);
 
 	/* search for conversation again in case it was created by received-im-msg handler */
 	if (conv == NULL)
@@ -717,16 +718,19 @@ void serv_got_typing(PurpleConnection *gc, const char *name, int timeout,
 		switch (state)
 		{
 			case PURPLE_TYPING:
-				purple_signal_emit(purple_conversations_get_handle(),
-								   "buddy-typing", gc->account, name);
+				purple_signal_emit_resolved(
+					_purple_conversations_get_signal(PURPLE_CONV_SIGNAL_BUDDY_TYPING),
+					gc->account, name);
 				break;
 			case PURPLE_TYPED:
-				purple_signal_emit(purple_conversations_get_handle(),
-								   "buddy-typed", gc->account, name);
+				purple_signal_emit_resolved(
+					_purple_conversations_get_signal(PURPLE_CONV_SIGNAL_BUDDY_TYPED),
+					gc->account, name);
 				break;
 			case PURPLE_NOT_TYPING:
-				purple_signal_emit(purple_conversations_get_handle(),
-								   "buddy-typing-stopped", gc->account, name);
+				purple_signal_emit_resolved(
+					_purple_conversations_get_signal(PURPLE_CONV_SIGNAL_BUDDY_TYPING_STOPPED),
+					gc->account, name);
 				break;
 		}
 	}
@@ -753,8 +757,9 @@ void serv_got_typing_stopped(PurpleConnection *gc, const char *name) {
 	}
 	else
 	{
-		purple_signal_emit(purple_conversations_get_handle(),
-						 "buddy-typing-stopped", gc->account, name);
+		purple_signal_emit_resolved(
+			_purple_conversations_get_signal(PURPLE_CONV_SIGNAL_BUDDY_TYPING_STOPPED),
+			gc->account, name);
 	}
 }
 
@@ -955,9 +960,9 @@ void serv_got_chat_in(PurpleConnection *g, int id, const char *who,
 	angel = g_strdup(who);
 
 	plugin_return = GPOINTER_TO_INT(
-		purple_signal_emit_return_1(purple_conversations_get_handle(),
-								  "receiving-chat-msg", g->account,
-								  &angel, &buffy, conv, &flags));
+		purple_signal_emit_resolved_return_1(
+			_purple_conversations_get_signal(PURPLE_CONV_SIGNAL_RECEIVING_CHAT_MSG),
+			g->account, &angel, &buffy, conv, &flags));
 
 	if (!buffy || !angel || plugin_return) {
 		g_free(buffy);
@@ -968,8 +973,9 @@ void serv_got_chat_in(PurpleConnection *g, int id, const char *who,
 	who = angel;
 	message = buffy;
 
-	purple_signal_emit(purple_conversations_get_handle(), "received-chat-msg", g->account,
-					 who, message, conv, flags);
+	purple_signal_emit_resolved(
+		_purple_conversations_get_signal(PURPLE_CONV_SIGNAL_RECEIVED_CHAT_MSG),
+		g->account, who, message, conv, flags);
 
 	purple_conv_chat_write(chat, who, message, flags, mtime);
 
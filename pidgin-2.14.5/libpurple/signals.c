@@ -45,9 +45,16 @@ typedef struct
 
 } PurpleInstanceData;
 
+/*
+ * The handlers of a signal are kept in an array sorted by priority, so an
+ * emission is a walk over contiguous memory.  While the signal is being
+ * emitted the array is not reshuffled: disconnected handlers are only
+ * marked and new ones are held back until the outermost emission ends.
+ */
 typedef struct
 {
 	gulong id;
+	char *name;
 
 	PurpleSignalMarshalFunc marshal;
 
@@ -55,12 +62,33 @@ typedef struct
 	PurpleValue **values;
 	PurpleValue *ret_value;
 
-	GList *handlers;
+	GPtrArray *handlers;
+	GSList *pending_handlers;
 	size_t handler_count;
+	guint emitting;
+	gboolean has_dead_handlers;
 
 	gulong next_handler_id;
+
+	gboolean dbus_exported;
+
 } PurpleSignalData;
 
+/*
+ * A resolved signal is owned by the signals subsystem and outlives the
+ * registration it was resolved from.  Registering or unregistering any
+ * signal bumps signals_generation, and a resolved signal whose generation
+ * is behind is looked up again before it is emitted.
+ */
+struct _PurpleSignal
+{
+	void *instance;
+	char *name;
+
+	PurpleSignalData *signal_data;
+	guint generation;
+};
+
 typedef struct
 {
 	gulong id;
@@ -73,6 +101,8 @@ typedef struct
 } PurpleSignalHandlerData;
 
 static GHashTable *instance_table = NULL;
+static GHashTable *resolved_table = NULL;
+static guint signals_generation = 0;
 
 static void
 destroy_instance_data(PurpleInstanceData *instance_data)
@@ -85,7 +115,13 @@ destroy_instance_data(PurpleInstanceData *instance_data)
 static void
 destroy_signal_data(PurpleSignalData *signal_data)
 {
-	g_list_free_full(signal_data->handlers, (GDestroyNotify)g_free);
+	guint i;
+
+	for (i = 0; i < signal_data->handlers->len; i++)
+		g_free(g_ptr_array_index(signal_data->handlers, i));
+	g_ptr_array_free(signal_data->handlers, TRUE);
+	g_slist_free_full(signal_data->pending_handlers, (GDestroyNotify)g_free);
+	g_free(signal_data->name);
 
 	if (signal_data->values != NULL)
 	{
@@ -102,6 +138,13 @@ destroy_signal_data(PurpleSignalData *signal_data)
 	g_free(signal_data);
 }
 
+static void
+destroy_resolved_signal(PurpleSignal *signal)
+{
+	g_free(signal->name);
+	g_free(signal);
+}
+
 gulong
 purple_signal_register(void *instance, const char *signal,
 					 PurpleSignalMarshalFunc marshal,
@@ -126,7 +169,7 @@ purple_signal_register(void *instance, const char *signal,
 		instance_data->next_signal_id = 1;
 
 		instance_data->signals =
-			g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
 								  (GDestroyNotify)destroy_signal_data);
 
 		g_hash_table_insert(instance_table, instance, instance_data);
@@ -134,10 +177,13 @@ purple_signal_register(void *instance, const char *signal,
 
 	signal_data = g_new0(PurpleSignalData, 1);
 	signal_data->id              = instance_data->next_signal_id;
+	signal_data->name            = g_strdup(signal);
 	signal_data->marshal         = marshal;
+	signal_data->handlers        = g_ptr_array_new();
 	signal_data->next_handler_id = 1;
 	signal_data->ret_value       = ret_value;
 	signal_data->num_values      = num_values;
+	signal_data->dbus_exported   = TRUE;
 
 	if (num_values > 0)
 	{
@@ -153,8 +199,10 @@ purple_signal_register(void *instance, const char *signal,
 		va_end(args);
 	}
 
-	g_hash_table_insert(instance_data->signals,
-						g_strdup(signal), signal_data);
+	/* The key is owned by the signal data, so it must be replaced too */
+	g_hash_table_replace(instance_data->signals,
+						 signal_data->name, signal_data);
+	signals_generation++;
 
 	instance_data->next_signal_id++;
 	instance_data->signal_count++;
@@ -176,6 +224,7 @@ purple_signal_unregister(void *instance, const char *signal)
 	g_return_if_fail(instance_data != NULL);
 
 	g_hash_table_remove(instance_data->signals, signal);
+	signals_generation++;
 
 	instance_data->signal_count--;
 
@@ -194,6 +243,7 @@ purple_signals_unregister_by_instance(void *instance)
 	g_return_if_fail(instance != NULL);
 
 	found = g_hash_table_remove(instance_table, instance);
+	signals_generation++;
 
 	/*
 	 * Makes things easier (more annoying?) for developers who don't have
@@ -234,12 +284,243 @@ purple_signal_get_values(void *instance, const char *signal,
 		*ret_value = signal_data->ret_value;
 }
 
-static gint handler_priority(void * a, void * b) {
-	PurpleSignalHandlerData *ah = (PurpleSignalHandlerData*)a;
-	PurpleSignalHandlerData *bh = (PurpleSignalHandlerData*)b;
-	if (ah->priority > bh->priority) return 1;
-	if (ah->priority < bh->priority) return -1;
-	return 0;
+void
+purple_signal_set_dbus_exported(void *instance, const char *signal,
+							  gboolean exported)
+{
+	PurpleInstanceData *instance_data;
+	PurpleSignalData *signal_data;
+
+	g_return_if_fail(instance != NULL);
+	g_return_if_fail(signal   != NULL);
+
+	instance_data =
+		(PurpleInstanceData *)g_hash_table_lookup(instance_table, instance);
+
+	g_return_if_fail(instance_data != NULL);
+
+	signal_data =
+		(PurpleSignalData *)g_hash_table_lookup(instance_data->signals, signal);
+
+	g_return_if_fail(signal_data != NULL);
+
+	signal_data->dbus_exported = exported;
+}
+
+typedef struct
+{
+	GHRFunc func;
+	gpointer user_data;
+} PurpleSignalFind;
+
+static gboolean
+find_dbus_exported_signal(gpointer key, gpointer value, gpointer user_data)
+{
+	PurpleSignalData *signal_data = value;
+	PurpleSignalFind *find = user_data;
+
+	return signal_data->dbus_exported &&
+		find->func(signal_data->name, signal_data, find->user_data);
+}
+
+static gboolean
+find_dbus_exported_instance(gpointer key, gpointer value, gpointer user_data)
+{
+	PurpleInstanceData *instance_data = value;
+
+	return g_hash_table_find(instance_data->signals,
+			find_dbus_exported_signal, user_data) != NULL;
+}
+
+gboolean
+_purple_signals_find_dbus_exported(GHRFunc func, gpointer user_data)
+{
+	PurpleSignalFind find;
+
+	g_return_val_if_fail(func != NULL, FALSE);
+
+	find.func = func;
+	find.user_data = user_data;
+
+	return g_hash_table_find(instance_table,
+			find_dbus_exported_instance, &find) != NULL;
+}
+
+static PurpleSignalData *
+find_signal_data(void *instance, const char *signal)
+{
+	PurpleInstanceData *instance_data;
+	PurpleSignalData *signal_data;
+
+	instance_data =
+		(PurpleInstanceData *)g_hash_table_lookup(instance_table, instance);
+
+	g_return_val_if_fail(instance_data != NULL, NULL);
+
+	signal_data =
+		(PurpleSignalData *)g_hash_table_lookup(instance_data->signals, signal);
+
+	if (signal_data == NULL)
+	{
+		purple_debug(PURPLE_DEBUG_ERROR, "signals",
+				   "Signal data for %s not found!\n", signal);
+	}
+
+	return signal_data;
+}
+
+PurpleSignal *
+purple_signal_resolve(void *instance, const char *signal)
+{
+	GHashTable *signals;
+	PurpleSignal *resolved;
+	PurpleSignalData *signal_data;
+
+	g_return_val_if_fail(instance != NULL, NULL);
+	g_return_val_if_fail(signal   != NULL, NULL);
+
+	signal_data = find_signal_data(instance, signal);
+	if (signal_data == NULL)
+		return NULL;
+
+	signals = g_hash_table_lookup(resolved_table, instance);
+	if (signals == NULL)
+	{
+		signals = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+				(GDestroyNotify)destroy_resolved_signal);
+		g_hash_table_insert(resolved_table, instance, signals);
+	}
+
+	resolved = g_hash_table_lookup(signals, signal);
+	if (resolved == NULL)
+	{
+		resolved = g_new0(PurpleSignal, 1);
+		resolved->instance = instance;
+		resolved->name     = g_strdup(signal);
+		g_hash_table_insert(signals, resolved->name, resolved);
+	}
+
+	resolved->signal_data = signal_data;
+	resolved->generation  = signals_generation;
+
+	return resolved;
+}
+
+/*
+ * Returns the signal data behind a resolved signal, looking it up again if
+ * any signal was registered or unregistered since it was last used.
+ */
+static PurpleSignalData *
+resolved_signal_data(PurpleSignal *signal)
+{
+	if (signal->generation != signals_generation)
+	{
+		PurpleInstanceData *instance_data;
+
+		instance_data = (PurpleInstanceData *)g_hash_table_lookup(
+				instance_table, signal->instance);
+
+		signal->signal_data = (instance_data == NULL) ? NULL :
+			(PurpleSignalData *)g_hash_table_lookup(instance_data->signals,
+					signal->name);
+		signal->generation = signals_generation;
+
+		if (signal->signal_data == NULL)
+		{
+			purple_debug_warning("signals", "Emitting %s, which is "
+					"no longer registered\n", signal->name);
+		}
+	}
+
+	return signal->signal_data;
+}
+
+/*
+ * Inserts a handler after all handlers of the same or a smaller priority,
+ * which keeps handlers of equal priority in the order they connected.
+ */
+static void
+insert_handler(PurpleSignalData *signal_data,
+			   PurpleSignalHandlerData *handler_data)
+{
+	GPtrArray *handlers = signal_data->handlers;
+	guint i;
+
+	for (i = handlers->len; i > 0; i--)
+	{
+		PurpleSignalHandlerData *prev = g_ptr_array_index(handlers, i - 1);
+
+		if (prev->priority <= handler_data->priority)
+			break;
+	}
+
+	g_ptr_array_add(handlers, NULL);
+	memmove(handlers->pdata + i + 1, handlers->pdata + i,
+			(handlers->len - 1 - i) * sizeof(gpointer));
+	handlers->pdata[i] = handler_data;
+}
+
+static void
+remove_handler(PurpleSignalData *signal_data,
+			   PurpleSignalHandlerData *handler_data)
+{
+	signal_data->handler_count--;
+
+	if (signal_data->emitting > 0)
+	{
+		/* Someone may still be walking over it */
+		handler_data->cb = NULL;
+		signal_data->has_dead_handlers = TRUE;
+		return;
+	}
+
+	g_ptr_array_remove(signal_data->handlers, handler_data);
+	g_free(handler_data);
+}
+
+static void
+emission_begin(PurpleSignalData *signal_data)
+{
+	signal_data->emitting++;
+}
+
+static void
+emission_end(PurpleSignalData *signal_data)
+{
+	GSList *l;
+
+	if (--signal_data->emitting > 0)
+		return;
+
+	if (signal_data->has_dead_handlers)
+	{
+		GPtrArray *handlers = signal_data->handlers;
+		guint i, j;
+
+		for (i = j = 0; i < handlers->len; i++)
+		{
+			PurpleSignalHandlerData *handler_data =
+				g_ptr_array_index(handlers, i);
+
+			if (handler_data->cb == NULL)
+				g_free(handler_data);
+			else
+				handlers->pdata[j++] = handler_data;
+		}
+		g_ptr_array_set_size(handlers, j);
+
+		signal_data->has_dead_handlers = FALSE;
+	}
+
+	if (signal_data->pending_handlers != NULL)
+	{
+		signal_data->pending_handlers =
+			g_slist_reverse(signal_data->pending_handlers);
+		for (l = signal_data->pending_handlers; l != NULL; l = l->next)
+			insert_handler(signal_data, l->data);
+		g_slist_free(signal_data->pending_handlers);
+		signal_data->pending_handlers = NULL;
+	}
 }
 
 static gulong
@@ -287,7 +568,11 @@ signal_connect_common(void *instance, const char *signal, void *handle,
 	handler_data->use_vargs = use_vargs;
 	handler_data->priority = priority;
 
-	signal_data->handlers = g_list_insert_sorted(signal_data->handlers, handler_data, (GCompareFunc)handler_priority);
+	if (signal_data->emitting > 0)
+		signal_data->pending_handlers =
+			g_slist_prepend(signal_data->pending_handlers, handler_data);
+	else
+		insert_handler(signal_data, handler_data);
 	signal_data->handler_count++;
 	signal_data->next_handler_id++;
 
@@ -329,7 +614,8 @@ purple_signal_disconnect(void *instance, const char *signal,
 	PurpleInstanceData *instance_data;
 	PurpleSignalData *signal_data;
 	PurpleSignalHandlerData *handler_data;
-	GList *l;
+	GSList *l;
+	guint i;
 	gboolean found = FALSE;
 
 	g_return_if_fail(instance != NULL);
@@ -355,7 +641,21 @@ purple_signal_disconnect(void *instance, const char *signal,
 	}
 
 	/* Find the handler data. */
-	for (l = signal_data->handlers; l != NULL; l = l->next)
+	for (i = 0; i < signal_data->handlers->len; i++)
+	{
+		handler_data = g_ptr_array_index(signal_data->handlers, i);
+
+		if (handler_data->handle == handle && handler_data->cb == func)
+		{
+			remove_handler(signal_data, handler_data);
+
+			found = TRUE;
+
+			break;
+		}
+	}
+
+	for (l = signal_data->pending_handlers; !found && l != NULL; l = l->next)
 	{
 		handler_data = (PurpleSignalHandlerData *)l->data;
 
@@ -363,13 +663,11 @@ purple_signal_disconnect(void *instance, const char *signal,
 		{
 			g_free(handler_data);
 
-			signal_data->handlers = g_list_delete_link(signal_data->handlers,
-												       l);
+			signal_data->pending_handlers =
+				g_slist_delete_link(signal_data->pending_handlers, l);
 			signal_data->handler_count--;
 
 			found = TRUE;
-
-			break;
 		}
 	}
 
@@ -385,10 +683,19 @@ static void
 disconnect_handle_from_signals(const char *signal,
 							   PurpleSignalData *signal_data, void *handle)
 {
-	GList *l, *l_next;
+	GSList *l, *l_next;
 	PurpleSignalHandlerData *handler_data;
+	guint i;
+
+	for (i = signal_data->handlers->len; i > 0; i--)
+	{
+		handler_data = g_ptr_array_index(signal_data->handlers, i - 1);
+
+		if (handler_data->cb != NULL && handler_data->handle == handle)
+			remove_handler(signal_data, handler_data);
+	}
 
-	for (l = signal_data->handlers; l != NULL; l = l_next)
+	for (l = signal_data->pending_handlers; l != NULL; l = l_next)
 	{
 		handler_data = (PurpleSignalHandlerData *)l->data;
 		l_next = l->next;
@@ -398,8 +705,8 @@ disconnect_handle_from_signals(const char *signal,
 			g_free(handler_data);
 
 			signal_data->handler_count--;
-			signal_data->handlers = g_list_delete_link(signal_data->handlers,
-			                                           l);
+			signal_data->pending_handlers =
+				g_slist_delete_link(signal_data->pending_handlers, l);
 		}
 	}
 }
@@ -422,51 +729,22 @@ purple_signals_disconnect_by_handle(void *handle)
 						 (GHFunc)disconnect_handle_from_instance, handle);
 }
 
-void
-purple_signal_emit(void *instance, const char *signal, ...)
-{
-	va_list args;
-
-	g_return_if_fail(instance != NULL);
-	g_return_if_fail(signal   != NULL);
-
-	va_start(args, signal);
-	purple_signal_emit_vargs(instance, signal, args);
-	va_end(args);
-}
-
-void
-purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
+static void
+signal_emit(PurpleSignalData *signal_data, va_list args)
 {
-	PurpleInstanceData *instance_data;
-	PurpleSignalData *signal_data;
 	PurpleSignalHandlerData *handler_data;
-	GList *l, *l_next;
+	guint i;
 	va_list tmp;
 
-	g_return_if_fail(instance != NULL);
-	g_return_if_fail(signal   != NULL);
-
-	instance_data =
-		(PurpleInstanceData *)g_hash_table_lookup(instance_table, instance);
-
-	g_return_if_fail(instance_data != NULL);
-
-	signal_data =
-		(PurpleSignalData *)g_hash_table_lookup(instance_data->signals, signal);
-
-	if (signal_data == NULL)
-	{
-		purple_debug(PURPLE_DEBUG_ERROR, "signals",
-				   "Signal data for %s not found!\n", signal);
-		return;
-	}
+	emission_begin(signal_data);
 
-	for (l = signal_data->handlers; l != NULL; l = l_next)
+	for (i = 0; i < signal_data->handlers->len; i++)
 	{
-		l_next = l->next;
+		handler_data = g_ptr_array_index(signal_data->handlers, i);
 
-		handler_data = (PurpleSignalHandlerData *)l->data;
+		/* Disconnected during this emission */
+		if (handler_data->cb == NULL)
+			continue;
 
 		/* This is necessary because a va_list may only be
 		 * evaluated once */
@@ -486,11 +764,103 @@ purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
 		va_end(tmp);
 	}
 
+	emission_end(signal_data);
+
+#ifdef HAVE_DBUS
+	if (signal_data->dbus_exported)
+		purple_dbus_signal_emit_purple(signal_data->name,
+					   signal_data->num_values, signal_data->values, args);
+#endif	/* HAVE_DBUS */
+}
+
+static void *
+signal_emit_return_1(PurpleSignalData *signal_data, va_list args)
+{
+	PurpleSignalHandlerData *handler_data;
+	void *ret_val = NULL;
+	guint i;
+	va_list tmp;
+
 #ifdef HAVE_DBUS
-	purple_dbus_signal_emit_purple(signal, signal_data->num_values,
-				   signal_data->values, args);
+	if (signal_data->dbus_exported) {
+		G_VA_COPY(tmp, args);
+		purple_dbus_signal_emit_purple(signal_data->name,
+					   signal_data->num_values, signal_data->values, tmp);
+		va_end(tmp);
+	}
 #endif	/* HAVE_DBUS */
 
+	emission_begin(signal_data);
+
+	for (i = 0; ret_val == NULL && i < signal_data->handlers->len; i++)
+	{
+		handler_data = g_ptr_array_index(signal_data->handlers, i);
+
+		if (handler_data->cb == NULL)
+			continue;
+
+		G_VA_COPY(tmp, args);
+		if (handler_data->use_vargs)
+		{
+			ret_val = ((void *(*)(va_list, void *))handler_data->cb)(
+				tmp, handler_data->data);
+		}
+		else
+		{
+			signal_data->marshal(handler_data->cb, tmp,
+								 handler_data->data, &ret_val);
+		}
+		va_end(tmp);
+	}
+
+	emission_end(signal_data);
+
+	return ret_val;
+}
+
+void
+purple_signal_emit(void *instance, const char *signal, ...)
+{
+	va_list args;
+
+	g_return_if_fail(instance != NULL);
+	g_return_if_fail(signal   != NULL);
+
+	va_start(args, signal);
+	purple_signal_emit_vargs(instance, signal, args);
+	va_end(args);
+}
+
+void
+purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
+{
+	PurpleSignalData *signal_data;
+
+	g_return_if_fail(instance != NULL);
+	g_return_if_fail(signal   != NULL);
+
+	signal_data = find_signal_data(instance, signal);
+	if (signal_data == NULL)
+		return;
+
+	signal_emit(signal_data, args);
+}
+
+void
+purple_signal_emit_resolved(PurpleSignal *signal, ...)
+{
+	PurpleSignalData *signal_data;
+	va_list args;
+
+	g_return_if_fail(signal != NULL);
+
+	signal_data = resolved_signal_data(signal);
+	if (signal_data == NULL)
+		return;
+
+	va_start(args, signal);
+	signal_emit(signal_data, args);
+	va_end(args);
 }
 
 void *
@@ -513,63 +883,36 @@ void *
 purple_signal_emit_vargs_return_1(void *instance, const char *signal,
 								va_list args)
 {
-	PurpleInstanceData *instance_data;
 	PurpleSignalData *signal_data;
-	PurpleSignalHandlerData *handler_data;
-	GList *l, *l_next;
-	va_list tmp;
 
 	g_return_val_if_fail(instance != NULL, NULL);
 	g_return_val_if_fail(signal   != NULL, NULL);
 
-	instance_data =
-		(PurpleInstanceData *)g_hash_table_lookup(instance_table, instance);
-
-	g_return_val_if_fail(instance_data != NULL, NULL);
-
-	signal_data =
-		(PurpleSignalData *)g_hash_table_lookup(instance_data->signals, signal);
-
+	signal_data = find_signal_data(instance, signal);
 	if (signal_data == NULL)
-	{
-		purple_debug(PURPLE_DEBUG_ERROR, "signals",
-				   "Signal data for %s not found!\n", signal);
-		return 0;
-	}
-
-#ifdef HAVE_DBUS
-	G_VA_COPY(tmp, args);
-	purple_dbus_signal_emit_purple(signal, signal_data->num_values,
-				   signal_data->values, tmp);
-	va_end(tmp);
-#endif	/* HAVE_DBUS */
+		return NULL;
 
-	for (l = signal_data->handlers; l != NULL; l = l_next)
-	{
-		void *ret_val = NULL;
+	return signal_emit_return_1(signal_data, args);
+}
 
-		l_next = l->next;
+void *
+purple_signal_emit_resolved_return_1(PurpleSignal *signal, ...)
+{
+	PurpleSignalData *signal_data;
+	void *ret_val;
+	va_list args;
 
-		handler_data = (PurpleSignalHandlerData *)l->data;
+	g_return_val_if_fail(signal != NULL, NULL);
 
-		G_VA_COPY(tmp, args);
-		if (handler_data->use_vargs)
-		{
-			ret_val = ((void *(*)(va_list, void *))handler_data->cb)(
-				tmp, handler_data->data);
-		}
-		else
-		{
-			signal_data->marshal(handler_data->cb, tmp,
-								 handler_data->data, &ret_val);
-		}
-		va_end(tmp);
+	signal_data = resolved_signal_data(signal);
+	if (signal_data == NULL)
+		return NULL;
 
-		if (ret_val != NULL)
-			return ret_val;
-	}
+	va_start(args, signal);
+	ret_val = signal_emit_return_1(signal_data, args);
+	va_end(args);
 
-	return NULL;
+	return ret_val;
 }
 
 void
@@ -580,6 +923,9 @@ purple_signals_init()
 	instance_table =
 		g_hash_table_new_full(g_direct_hash, g_direct_equal,
 							  NULL, (GDestroyNotify)destroy_instance_data);
+	resolved_table =
+		g_hash_table_new_full(g_direct_hash, g_direct_equal,
+							  NULL, (GDestroyNotify)g_hash_table_destroy);
 }
 
 void
@@ -589,6 +935,9 @@ purple_signals_uninit()
 
 	g_hash_table_destroy(instance_table);
 	instance_table = NULL;
+
+	g_hash_table_destroy(resolved_table);
+	resolved_table = NULL;
 }
 
 /**************************************************************************
@@ -35,6 +35,13 @@ typedef void (*PurpleCallback)(void);
 typedef void (*PurpleSignalMarshalFunc)(PurpleCallback cb, va_list args,
 									  void *data, void **return_val);
 
+/**
+ * A signal resolved with purple_signal_resolve().
+ *
+ * @since 2.14.6
+ */
+typedef struct _PurpleSignal PurpleSignal;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -111,12 +118,51 @@ void purple_signal_get_values(void *instance, const char *signal,
 							PurpleValue **ret_value,
 							int *num_values, PurpleValue ***values);
 
+/**
+ * Looks up a signal once, for use with purple_signal_emit_resolved().
+ *
+ * Code that emits a signal often can resolve it when the signal is
+ * registered and skip the name lookups on every emission.  The returned
+ * signal is owned by the signals subsystem and remains valid until
+ * purple_signals_uninit().  If the signal is registered again, emitting it
+ * reaches the new registration; if it is unregistered, emitting it does
+ * nothing.
+ *
+ * @param instance The instance the signal is registered to.
+ * @param signal   The signal name.
+ *
+ * @return The signal, or @c NULL if it is not registered.
+ *
+ * @since 2.14.6
+ */
+PurpleSignal *purple_signal_resolve(void *instance, const char *signal);
+
+/**
+ * Sets whether emissions of a signal are forwarded to D-Bus.
+ *
+ * Signals are exported by default. Signals whose arguments are of no
+ * use to D-Bus clients can be kept off the bus, which also saves the
+ * cost of marshalling them on every emission.
+ *
+ * @param instance The instance the signal is registered to.
+ * @param signal   The signal name.
+ * @param exported Whether the signal is emitted on D-Bus.
+ *
+ * @since 2.14.6
+ */
+void purple_signal_set_dbus_exported(void *instance, const char *signal,
+									 gboolean exported);
+
 /**
  * Connects a signal handler to a signal for a particular object.
  *
  * Take care not to register a handler function twice. Purple will
  * not correct any mistakes for you in this area.
  *
+ * A handler connected while the signal is being emitted is first called
+ * on the next emission of the signal.  A handler disconnected while the
+ * signal is being emitted is not called again.
+ *
  * @param instance The instance to connect to.
  * @param signal   The name of the signal to connect.
  * @param handle   The handle of the receiver.
@@ -274,6 +320,29 @@ void *purple_signal_emit_return_1(void *instance, const char *signal, ...);
 void *purple_signal_emit_vargs_return_1(void *instance, const char *signal,
 									  va_list args);
 
+/**
+ * Emits a signal resolved with purple_signal_resolve().
+ *
+ * @param signal The signal being emitted.
+ *
+ * @see purple_signal_emit()
+ * @since 2.14.6
+ */
+void purple_signal_emit_resolved(PurpleSignal *signal, ...);
+
+/**
+ * Emits a signal resolved with purple_signal_resolve() and returns the
+ * first non-NULL return value.
+ *
+ * @param signal The signal being emitted.
+ *
+ * @return The first non-NULL return value
+ *
+ * @see purple_signal_emit_return_1()
+ * @since 2.14.6
+ */
+void *purple_signal_emit_resolved_return_1(PurpleSignal *signal, ...);
+
 /**
  * Initializes the signals subsystem.
  */
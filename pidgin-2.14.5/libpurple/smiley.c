@@ -59,7 +59,11 @@ static guint save_timer = 0;
 static gboolean smileys_loaded = FALSE;
 static char *smileys_dir = NULL;
 
+/* The pack of the files in smileys_dir, only mapped while loading. */
+static PurpleImagePack *smileys_pack = NULL;
+
 #define SMILEYS_DEFAULT_FOLDER			"custom_smiley"
+#define SMILEYS_PACK_FILENAME			"smileys.pack"
 #define SMILEYS_LOG_ID				"smileys"
 
 #define XML_FILE_NAME				"smileys.xml"
@@ -191,7 +195,6 @@ static void
 sync_smileys(void)
 {
 	xmlnode *root_node;
-	char *data;
 
 	if (!smileys_loaded) {
 		purple_debug_error(SMILEYS_LOG_ID, "Attempted to save smileys before it "
@@ -200,10 +203,8 @@ sync_smileys(void)
 	}
 
 	root_node = smileys_to_xmlnode();
-	data = xmlnode_to_formatted_str(root_node, NULL);
-	purple_util_write_data_to_file(XML_FILE_NAME, data, -1);
+	purple_util_write_xml_to_file(XML_FILE_NAME, root_node);
 
-	g_free(data);
 	xmlnode_free(root_node);
 }
 
@@ -244,20 +245,70 @@ parse_smiley(xmlnode *smiley_node)
 	purple_smiley_load_file(shortcut, checksum, filename);
 }
 
+/*
+ * Rewrites the smileys pack in the background when it is missing some of
+ * the loaded smileys or carries too many deleted ones.
+ */
+static void
+update_smileys_pack(void)
+{
+	GList *smileys, *l;
+	GList *filenames = NULL;
+	guint missing = 0, used = 0;
+
+	smileys = g_hash_table_get_values(smiley_shortcut_index);
+	for (l = smileys; l != NULL; l = l->next)
+	{
+		PurpleSmiley *smiley = l->data;
+		const char *filename;
+
+		if (smiley->img == NULL)
+			continue;
+
+		filename = purple_imgstore_get_filename(smiley->img);
+		if (_purple_image_pack_lookup(smileys_pack, filename, NULL) == NULL)
+			missing++;
+		filenames = g_list_prepend(filenames, (char *)filename);
+		used++;
+	}
+
+	if (missing > 0 || _purple_image_pack_get_count(smileys_pack) > used + used / 4)
+	{
+		char *path = g_build_filename(purple_smileys_get_storing_dir(),
+		                              SMILEYS_PACK_FILENAME, NULL);
+
+		purple_debug_info(SMILEYS_LOG_ID, "Rebuilding the smileys pack "
+		                  "(%u of %u smileys missing).\n", missing, used);
+		_purple_image_pack_build_async(path, smileys_pack,
+		                               purple_smileys_get_storing_dir(),
+		                               filenames, NULL, NULL);
+		g_free(path);
+	}
+
+	g_list_free(filenames);
+	g_list_free(smileys);
+}
+
 static void
 purple_smileys_load(void)
 {
 	xmlnode *root_node, *profile_node;
 	xmlnode *smileyset_node = NULL;
 	xmlnode *smiley_node;
-
-	smileys_loaded = TRUE;
+	char *pack_path;
 
 	root_node = purple_util_read_xml_from_file(XML_FILE_NAME,
 			_(SMILEYS_LOG_ID));
 
-	if (root_node == NULL)
+	if (root_node == NULL) {
+		smileys_loaded = TRUE;
 		return;
+	}
+
+	pack_path = g_build_filename(purple_smileys_get_storing_dir(),
+	                             SMILEYS_PACK_FILENAME, NULL);
+	smileys_pack = _purple_image_pack_open(pack_path);
+	g_free(pack_path);
 
 	/* See the top comments above to understand why initial tag elements
 	 * are not being considered by now. */
@@ -274,6 +325,13 @@ purple_smileys_load(void)
 	}
 
 	xmlnode_free(root_node);
+
+	/* Only now, so the files we just read aren't written back out. */
+	smileys_loaded = TRUE;
+
+	update_smileys_pack();
+	_purple_image_pack_unref(smileys_pack);
+	smileys_pack = NULL;
 }
 
 /*********************************************************************
@@ -473,35 +531,31 @@ purple_smiley_load_file(const char *shortcut, const char *checksum, const char *
 {
 	PurpleSmiley *smiley = NULL;
 	guchar *smiley_data;
-	size_t smiley_data_len;
-	char *fullpath = NULL;
+	gsize smiley_data_len;
+	GError *err = NULL;
 
 	g_return_if_fail(shortcut  != NULL);
 	g_return_if_fail(checksum  != NULL);
 	g_return_if_fail(filename != NULL);
 
-	fullpath = get_file_full_path(filename);
-	if (!fullpath) {
-		purple_debug_error(SMILEYS_LOG_ID, "Path for filename %s doesn't exist\n", filename);
+	/* The pack saves opening every smiley's file on its own. */
+	if (!_purple_image_pack_read(smileys_pack, purple_smileys_get_storing_dir(),
+	                             filename, &smiley_data, &smiley_data_len, &err)) {
+		purple_debug_error(SMILEYS_LOG_ID, "Error reading %s: %s\n",
+				filename, err->message);
+		g_error_free(err);
 		return;
 	}
 
 	smiley = purple_smiley_create(shortcut);
 	if (!smiley) {
-		g_free(fullpath);
+		g_free(smiley_data);
 		return;
 	}
 
 	smiley->checksum = g_strdup(checksum);
 
-	if (read_smiley_file(fullpath, &smiley_data, &smiley_data_len))
-		purple_smiley_set_data_impl(smiley, smiley_data,
-				smiley_data_len);
-	else
-		purple_smiley_delete(smiley);
-
-	g_free(fullpath);
-
+	purple_smiley_set_data_impl(smiley, smiley_data, smiley_data_len);
 }
 
 static void
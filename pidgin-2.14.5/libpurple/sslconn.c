@@ -35,6 +35,21 @@
 static gboolean _ssl_initialized = FALSE;
 static PurpleSslOps *_ssl_ops = NULL;
 
+/* Resumable TLS sessions, keyed by "host:port".  Servers rarely honour
+ * tickets for more than a few hours, and there are only ever a handful of
+ * hosts, so entries just expire and the oldest one is dropped when the
+ * cache is full. */
+#define SSL_SESSION_CACHE_LIFETIME (60 * 60)
+#define SSL_SESSION_CACHE_MAX      64
+
+typedef struct
+{
+	GByteArray *data;
+	time_t stored;
+} PurpleSslSession;
+
+static GHashTable *session_cache = NULL;
+
 static gboolean
 ssl_init(void)
 {
@@ -296,6 +311,128 @@ purple_ssl_get_peer_certificates(PurpleSslConnection *gsc)
 	return (ops->get_peer_certificates)(gsc);
 }
 
+static void
+ssl_session_free(PurpleSslSession *session)
+{
+	g_byte_array_free(session->data, TRUE);
+	g_free(session);
+}
+
+static gchar *
+ssl_session_key(PurpleSslConnection *gsc)
+{
+	if (gsc->host == NULL)
+		return NULL;
+
+	return g_strdup_printf("%s:%d", gsc->host, gsc->port);
+}
+
+static void
+ssl_session_cache_expire(time_t now)
+{
+	GHashTableIter iter;
+	PurpleSslSession *session, *oldest = NULL;
+	gpointer key, oldest_key = NULL;
+
+	g_hash_table_iter_init(&iter, session_cache);
+	while (g_hash_table_iter_next(&iter, &key, (gpointer *)&session)) {
+		if (now - session->stored > SSL_SESSION_CACHE_LIFETIME) {
+			g_hash_table_iter_remove(&iter);
+		} else if (oldest == NULL || session->stored < oldest->stored) {
+			oldest = session;
+			oldest_key = key;
+		}
+	}
+
+	if (oldest_key != NULL &&
+			g_hash_table_size(session_cache) >= SSL_SESSION_CACHE_MAX)
+		g_hash_table_remove(session_cache, oldest_key);
+}
+
+void
+purple_ssl_session_cache_store(PurpleSslConnection *gsc, gconstpointer data,
+                               gsize len)
+{
+	PurpleSslSession *session;
+	gchar *key;
+	time_t now;
+
+	g_return_if_fail(gsc != NULL);
+
+	if (data == NULL || len == 0)
+		return;
+
+	key = ssl_session_key(gsc);
+	if (key == NULL)
+		return;
+
+	if (session_cache == NULL)
+		session_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+				g_free, (GDestroyNotify)ssl_session_free);
+
+	now = time(NULL);
+	if (g_hash_table_lookup(session_cache, key) == NULL)
+		ssl_session_cache_expire(now);
+
+	session = g_new0(PurpleSslSession, 1);
+	session->data = g_byte_array_sized_new(len);
+	g_byte_array_append(session->data, data, len);
+	session->stored = now;
+
+	g_hash_table_replace(session_cache, key, session);
+}
+
+gconstpointer
+purple_ssl_session_cache_lookup(PurpleSslConnection *gsc, gsize *len)
+{
+	PurpleSslSession *session;
+	gchar *key;
+
+	g_return_val_if_fail(gsc != NULL, NULL);
+	g_return_val_if_fail(len != NULL, NULL);
+
+	*len = 0;
+
+	if (session_cache == NULL)
+		return NULL;
+
+	key = ssl_session_key(gsc);
+	if (key == NULL)
+		return NULL;
+
+	session = g_hash_table_lookup(session_cache, key);
+	if (session != NULL &&
+			time(NULL) - session->stored > SSL_SESSION_CACHE_LIFETIME) {
+		g_hash_table_remove(session_cache, key);
+		session = NULL;
+	}
+	g_free(key);
+
+	if (session == NULL)
+		return NULL;
+
+	*len = session->data->len;
+	return session->data->data;
+}
+
+void
+purple_ssl_session_cache_remove(PurpleSslConnection *gsc)
+{
+	gchar *key;
+
+	g_return_if_fail(gsc != NULL);
+
+	if (session_cache == NULL)
+		return;
+
+	key = ssl_session_key(gsc);
+	if (key == NULL)
+		return;
+
+	g_hash_table_remove(session_cache, key);
+	g_free(key);
+}
+
 void
 purple_ssl_set_ops(PurpleSslOps *ops)
 {
@@ -324,6 +461,11 @@ purple_ssl_uninit(void)
 {
 	PurpleSslOps *ops;
 
+	if (session_cache != NULL) {
+		g_hash_table_destroy(session_cache);
+		session_cache = NULL;
+	}
+
 	if (!_ssl_initialized)
 		return;
 
@@ -305,6 +305,54 @@ GList * purple_ssl_get_peer_certificates(PurpleSslConnection *gsc);
 
 /*@}*/
 
+/**************************************************************************/
+/** @name Session Cache API                                               */
+/**************************************************************************/
+/*@{*/
+
+/**
+ * Remembers the data an SSL backend needs to resume the TLS session of a
+ * connection (a session ticket or session ID, in whatever form the backend
+ * serializes it) for the next connection to the same host and port.  This
+ * should only be called once the peer has been verified.
+ *
+ * @param gsc  The SSL connection handle.
+ * @param data The session data, which is copied.
+ * @param len  The length of @a data.
+ *
+ * @since 2.14.6
+ */
+void purple_ssl_session_cache_store(PurpleSslConnection *gsc,
+                                    gconstpointer data, gsize len);
+
+/**
+ * Looks up the session data stored for the host and port of a connection,
+ * so that the backend can try to resume that session.
+ *
+ * @param gsc  The SSL connection handle.
+ * @param len  Return location for the length of the data.
+ *
+ * @return The session data, owned by the cache and valid until the next
+ *         call to a session cache function, or @a NULL if nothing usable
+ *         is cached.
+ *
+ * @since 2.14.6
+ */
+gconstpointer purple_ssl_session_cache_lookup(PurpleSslConnection *gsc,
+                                              gsize *len);
+
+/**
+ * Forgets the session data stored for the host and port of a connection,
+ * for example because resuming it failed or the peer did not verify.
+ *
+ * @param gsc  The SSL connection handle.
+ *
+ * @since 2.14.6
+ */
+void purple_ssl_session_cache_remove(PurpleSslConnection *gsc);
+
+/*@}*/
+
 /**************************************************************************/
 /** @name Subsystem API                                                   */
 /**************************************************************************/
@@ -80,6 +80,11 @@ struct _PurplePresence
 
 	PurpleStatus *active_status;
 
+	/* Cached result of purple_presence_compute_score(), valid when
+	 * score_serial matches the global one. */
+	int score;
+	guint score_serial;
+
 	union
 	{
 		PurpleAccount *account;
@@ -148,6 +153,17 @@ static int primitive_scores[] =
 #define SCORE_IDLE_TIME 10
 #define SCORE_OFFLINE_MESSAGE 11
 
+/* Bumped whenever the scores change, which invalidates every cached
+ * presence score at once.  Never 0, which marks a score as not cached. */
+static guint score_serial = 1;
+
+static void
+presence_invalidate_score(PurplePresence *presence)
+{
+	if (presence != NULL)
+		presence->score_serial = 0;
+}
+
 /**************************************************************************
  * PurpleStatusPrimitive API
  **************************************************************************/
@@ -704,6 +720,8 @@ status_has_changed(PurpleStatus *status)
 	else
 		old_status = NULL;
 
+	presence_invalidate_score(presence);
+
 	notify_status_update(presence, old_status, status);
 }
 
@@ -758,6 +776,7 @@ purple_status_set_active_with_attrs_list(PurpleStatus *status, gboolean active,
 	if (status->active != active)
 	{
 		changed = TRUE;
+		presence_invalidate_score(purple_status_get_presence(status));
 	}
 
 	status->active = active;
@@ -1190,6 +1209,7 @@ purple_presence_add_status(PurplePresence *presence, PurpleStatus *status)
 	g_return_if_fail(status   != NULL);
 
 	presence->statuses = g_list_append(presence->statuses, status);
+	presence_invalidate_score(presence);
 
 	g_hash_table_insert(presence->status_table,
 	g_strdup(purple_status_get_id(status)), status);
@@ -1320,6 +1340,7 @@ purple_presence_set_idle(PurplePresence *presence, gboolean idle, time_t idle_ti
 	old_idle            = presence->idle;
 	presence->idle      = idle;
 	presence->idle_time = (idle ? idle_time : 0);
+	presence_invalidate_score(presence);
 
 	current_time = time(NULL);
 
@@ -1572,9 +1593,13 @@ purple_presence_get_login_time(const PurplePresence *presence)
 static int
 purple_presence_compute_score(const PurplePresence *presence)
 {
+	PurplePresence *cache = (PurplePresence *)presence;
 	GList *l;
 	int score = 0;
 
+	if (presence->score_serial == score_serial)
+		return presence->score;
+
 	for (l = purple_presence_get_statuses(presence); l != NULL; l = l->next) {
 		PurpleStatus *status = (PurpleStatus *)l->data;
 		PurpleStatusType *type = purple_status_get_type(status);
@@ -1591,6 +1616,10 @@ purple_presence_compute_score(const PurplePresence *presence)
 	score += purple_account_get_int(purple_presence_get_account(presence), "score", 0);
 	if (purple_presence_is_idle(presence))
 		score += primitive_scores[SCORE_IDLE];
+
+	cache->score = score;
+	cache->score_serial = score_serial;
+
 	return score;
 }
 
@@ -1598,7 +1627,6 @@ gint
 purple_presence_compare(const PurplePresence *presence1,
 		const PurplePresence *presence2)
 {
-	time_t idle_time_1, idle_time_2;
 	int score1 = 0, score2 = 0;
 
 	if (presence1 == presence2)
@@ -1621,12 +1649,14 @@ purple_presence_compare(const PurplePresence *presence1,
 	/* Compute the score of the second set of statuses. */
 	score2 = purple_presence_compute_score(presence2);
 
-	idle_time_1 = time(NULL) - purple_presence_get_idle_time(presence1);
-	idle_time_2 = time(NULL) - purple_presence_get_idle_time(presence2);
-
-	if (idle_time_1 > idle_time_2)
+	/* Whoever has been idle for longer, i.e. went idle earlier, loses a
+	 * bit.  Comparing the idle timestamps is the same as comparing how
+	 * long ago they were, without asking for the time. */
+	if (purple_presence_get_idle_time(presence1) <
+			purple_presence_get_idle_time(presence2))
 		score1 += primitive_scores[SCORE_IDLE_TIME];
-	else if (idle_time_1 < idle_time_2)
+	else if (purple_presence_get_idle_time(presence1) >
+			purple_presence_get_idle_time(presence2))
 		score2 += primitive_scores[SCORE_IDLE_TIME];
 
 	if (score1 < score2)
@@ -1648,6 +1678,18 @@ score_pref_changed_cb(const char *name, PurplePrefType type,
 	int index = GPOINTER_TO_INT(data);
 
 	primitive_scores[index] = GPOINTER_TO_INT(value);
+
+	_purple_presence_scores_changed();
+}
+
+void
+_purple_presence_scores_changed(void)
+{
+	if (++score_serial == 0)
+		score_serial = 1;
+
+	/* Contacts picked their priority buddy with the old scores */
+	_purple_blist_invalidate_priorities();
 }
 
 void *
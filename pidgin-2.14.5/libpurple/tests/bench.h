@@ -0,0 +1,30 @@
+#ifndef BENCH_H
+#  define BENCH_H
+
+#include "../purple.h"
+
+/* define the benchmarks here */
+/* remember to add the benchmark to the table in bench_libpurple.c */
+int bench_blist_load(int argc, char **argv);
+int bench_dbus_dispatch(int argc, char **argv);
+int bench_dbus_signals(int argc, char **argv);
+int bench_log_write(int argc, char **argv);
+int bench_markup(int argc, char **argv);
+int bench_pounce_execute(int argc, char **argv);
+int bench_ssl_handshake(int argc, char **argv);
+
+/* helpers */
+
+/**
+ * Creates and adds an account of the "prpl-bench" protocol plugin, which
+ * has a prpl but does not connect anywhere.
+ */
+PurpleAccount *bench_account_new(const char *username);
+
+/**
+ * Prints one line of results: what was timed, how many times it was done
+ * and how long that took in all.
+ */
+void bench_report(const char *what, guint count, gdouble seconds);
+
+#endif /* ifndef BENCH_H */
@@ -0,0 +1,120 @@
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+#ifdef HAVE_DBUS
+#include "../dbus-server.h"
+
+#define HANDLE_ROUNDS 100
+#endif
+
+#define BLIST_BUDDIES 10000
+#define BLIST_GROUP_SIZE 100
+
+static void
+bench_blist_write(guint buddies)
+{
+	GString *xml;
+	char *filename;
+	guint i;
+
+	xml = g_string_new("<purple version='1.0'><blist>");
+	for (i = 0; i < buddies; i++) {
+		if (i % BLIST_GROUP_SIZE == 0) {
+			if (i > 0)
+				g_string_append(xml, "</group>");
+			g_string_append_printf(xml, "<group name='Group %u'>",
+			                       i / BLIST_GROUP_SIZE);
+		}
+		g_string_append_printf(xml, "<contact><buddy account='bench' "
+		                       "proto='prpl-bench'><name>buddy%u</name>"
+		                       "<alias>Buddy %u</alias></buddy></contact>",
+		                       i, i);
+	}
+	if (buddies > 0)
+		g_string_append(xml, "</group>");
+	g_string_append(xml, "</blist></purple>");
+
+	filename = g_build_filename(purple_user_dir(), "blist.xml", NULL);
+	g_file_set_contents(filename, xml->str, xml->len, NULL);
+
+	g_free(filename);
+	g_string_free(xml, TRUE);
+}
+
+/*
+ * Times loading a buddy list of BLIST_BUDDIES buddies, or as many as the
+ * argument says, and removing them again.  Every node registers a D-Bus
+ * handle when D-Bus is built in, so comparing with a --disable-dbus build
+ * gives the cost of the handles; resolving them is timed on its own.
+ * No bus is needed, the handles are kept whether or not there is one.
+ */
+int
+bench_blist_load(int argc, char **argv)
+{
+	PurpleAccount *account;
+	GSList *buddies, *l;
+	GTimer *timer;
+	guint count = BLIST_BUDDIES;
+
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 10);
+
+	account = bench_account_new("bench");
+	bench_blist_write(count);
+
+	timer = g_timer_new();
+	purple_blist_load();
+	g_timer_stop(timer);
+	bench_report("blist load, buddies", count, g_timer_elapsed(timer, NULL));
+
+	buddies = purple_find_buddies(account, NULL);
+	if (g_slist_length(buddies) != count) {
+		fprintf(stderr, "Loaded %u buddies instead of %u\n",
+		        g_slist_length(buddies), count);
+		g_slist_free(buddies);
+		g_timer_destroy(timer);
+		return 1;
+	}
+
+#ifdef HAVE_DBUS
+	{
+		guint i;
+
+		/* What a D-Bus client listing the buddies makes us do */
+		g_timer_start(timer);
+		for (i = 0; i < HANDLE_ROUNDS; i++) {
+			for (l = buddies; l != NULL; l = l->next) {
+				gint id = purple_dbus_pointer_to_id(l->data);
+
+				if (purple_dbus_id_to_pointer(id,
+						PURPLE_DBUS_TYPE(PurpleBuddy)) != l->data) {
+					fprintf(stderr, "Handle %d does not resolve\n", id);
+					g_slist_free(buddies);
+					g_timer_destroy(timer);
+					return 1;
+				}
+			}
+		}
+		g_timer_stop(timer);
+		bench_report("buddy handle round trips", count * HANDLE_ROUNDS,
+		             g_timer_elapsed(timer, NULL));
+	}
+#endif
+
+	g_timer_start(timer);
+	for (l = buddies; l != NULL; l = l->next)
+		purple_blist_remove_buddy(l->data);
+	g_timer_stop(timer);
+	bench_report("blist remove, buddies", count, g_timer_elapsed(timer, NULL));
+
+	g_slist_free(buddies);
+	g_timer_destroy(timer);
+
+	return 0;
+}
@@ -0,0 +1,176 @@
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+#ifdef HAVE_DBUS
+#include "../dbus-server.h"
+
+#define DISPATCH_CALLS 200000
+
+static DBusMessage *
+bench_dbus_noop(DBusMessage *message, DBusError *error)
+{
+	/* No reply and no error, so nothing is sent on the bus */
+	return NULL;
+}
+
+static void
+bench_dbus_dispatch_method(PurpleDBusBinding *binding, guint methods,
+                           const char *which)
+{
+	DBusMessage *message;
+	GTimer *timer;
+	char *what;
+	guint i;
+
+	message = dbus_message_new_method_call(DBUS_SERVICE_PURPLE,
+			DBUS_PATH_PURPLE, DBUS_INTERFACE_PURPLE, binding->name);
+
+	/* The same emission purple_dbus_dispatch makes for a call from the bus,
+	 * so every registered binding set gets to look the method up */
+	timer = g_timer_new();
+	for (i = 0; i < DISPATCH_CALLS; i++)
+		purple_signal_emit_return_1(purple_dbus_get_handle(),
+				"dbus-method-called", purple_dbus_get_connection(), message);
+	g_timer_stop(timer);
+
+	what = g_strdup_printf("dispatch, %u methods, %s", methods, which);
+	bench_report(what, DISPATCH_CALLS, g_timer_elapsed(timer, NULL));
+
+	g_free(what);
+	g_timer_destroy(timer);
+	dbus_message_unref(message);
+}
+#endif /* HAVE_DBUS */
+
+#define SIGNAL_EMISSIONS 1000000
+
+static void
+bench_dbus_signal_cb(PurpleAccount *account, const char *sender,
+                     const char *message, void *data)
+{
+}
+
+static void
+bench_dbus_signal_emit(void *instance, PurpleAccount *account, guint count,
+                       const char *what)
+{
+	GTimer *timer;
+	guint i;
+
+	timer = g_timer_new();
+	for (i = 0; i < count; i++)
+		purple_signal_emit(instance, "bench-signal", account, "buddy",
+		                   "A message that nobody on the bus reads");
+#ifdef HAVE_DBUS
+	/* Sent on the bus is what counts, not queued for it */
+	if (purple_dbus_get_connection() != NULL)
+		dbus_connection_flush(purple_dbus_get_connection());
+#endif
+	g_timer_stop(timer);
+
+	bench_report(what, count, g_timer_elapsed(timer, NULL));
+
+	g_timer_destroy(timer);
+}
+
+/*
+ * Times emitting a signal with the arguments of an incoming message, to
+ * one connected handler: not exported to D-Bus, exported and marshalled
+ * on every emission, and exported with /purple/dbus/signals_on_demand
+ * set and nobody subscribed.  Without a bus nothing is marshalled, so
+ * run it under dbus-run-session.
+ */
+int
+bench_dbus_signals(int argc, char **argv)
+{
+	static int instance;
+	PurpleAccount *account;
+	guint count = SIGNAL_EMISSIONS;
+
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 10);
+
+	account = bench_account_new("bench");
+	purple_signal_register(&instance, "bench-signal",
+			purple_marshal_VOID__POINTER_POINTER_POINTER, NULL, 3,
+			purple_value_new(PURPLE_TYPE_SUBTYPE, PURPLE_SUBTYPE_ACCOUNT),
+			purple_value_new(PURPLE_TYPE_STRING),
+			purple_value_new(PURPLE_TYPE_STRING));
+	purple_signal_connect(&instance, "bench-signal", &instance,
+			PURPLE_CALLBACK(bench_dbus_signal_cb), NULL);
+
+	purple_signal_set_dbus_exported(&instance, "bench-signal", FALSE);
+	bench_dbus_signal_emit(&instance, account, count,
+	                       "emit, not exported");
+
+#ifdef HAVE_DBUS
+	if (purple_dbus_get_init_error() != NULL)
+		fprintf(stderr, "D-Bus is not available, nothing is marshalled: %s\n",
+		        purple_dbus_get_init_error());
+
+	purple_signal_set_dbus_exported(&instance, "bench-signal", TRUE);
+	purple_prefs_set_bool("/purple/dbus/signals_on_demand", FALSE);
+	bench_dbus_signal_emit(&instance, account, count, "emit, exported");
+
+	purple_prefs_set_bool("/purple/dbus/signals_on_demand", TRUE);
+	bench_dbus_signal_emit(&instance, account, count,
+	                       "emit, exported, on demand");
+#else
+	fprintf(stderr, "libpurple was built without D-Bus\n");
+#endif
+
+	purple_signals_unregister_by_instance(&instance);
+
+	return 0;
+}
+
+/*
+ * Times the dispatch of a method call with an extra binding set of a
+ * growing number of methods registered, calling its first and its last
+ * method.  Needs a session bus, e.g. run it under dbus-run-session.
+ */
+int
+bench_dbus_dispatch(int argc, char **argv)
+{
+#ifdef HAVE_DBUS
+	static const guint sizes[] = { 10, 100, 1000, 10000 };
+	static int handle;
+	guint i, j;
+
+	if (purple_dbus_get_init_error() != NULL) {
+		fprintf(stderr, "D-Bus is not available: %s\n",
+		        purple_dbus_get_init_error());
+		return 1;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(sizes); i++) {
+		PurpleDBusBinding *bindings = g_new0(PurpleDBusBinding, sizes[i] + 1);
+
+		for (j = 0; j < sizes[i]; j++) {
+			bindings[j].name = g_strdup_printf("BenchMethod%u", j);
+			bindings[j].parameters = "";
+			bindings[j].handler = bench_dbus_noop;
+		}
+
+		purple_dbus_register_bindings(&handle, bindings);
+		bench_dbus_dispatch_method(&bindings[0], sizes[i], "first");
+		bench_dbus_dispatch_method(&bindings[sizes[i] - 1], sizes[i], "last");
+		purple_dbus_unregister_bindings(&handle);
+
+		for (j = 0; j < sizes[i]; j++)
+			g_free((char *)bindings[j].name);
+		g_free(bindings);
+	}
+
+	return 0;
+#else
+	fprintf(stderr, "libpurple was built without D-Bus\n");
+	return 1;
+#endif
+}
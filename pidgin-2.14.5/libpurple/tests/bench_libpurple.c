@@ -0,0 +1,285 @@
+/*
+ * bench_libpurple runs one of the timing benchmarks below against the
+ * libpurple in the build tree and prints what it measured:
+ *
+ *   bench_libpurple <benchmark> [arguments]
+ *
+ * It is built by "make check" but not run by it, as the numbers only mean
+ * something when compared between builds on the same machine.
+ */
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#include "../core.h"
+#include "../eventloop.h"
+#include "../util.h"
+
+static const struct {
+	const char *name;
+	const char *arguments;
+	int (*run)(int argc, char **argv);
+} benchmarks[] = {
+	{ "blist-load", "[buddies]", bench_blist_load },
+	{ "dbus-dispatch", "", bench_dbus_dispatch },
+	{ "dbus-signals", "[emissions]", bench_dbus_signals },
+	{ "log-write", "[messages]", bench_log_write },
+	{ "markup", "[passes] [corpus file]", bench_markup },
+	{ "pounce-execute", "[pounces]", bench_pounce_execute },
+	{ "ssl-handshake", "<host> <port> [connections] [plugin dir]",
+	  bench_ssl_handshake },
+	{ NULL, NULL, NULL }
+};
+
+/******************************************************************************
+ * libpurple goodies
+ *****************************************************************************/
+#define PURPLE_GLIB_READ_COND  (G_IO_IN | G_IO_HUP | G_IO_ERR)
+#define PURPLE_GLIB_WRITE_COND (G_IO_OUT | G_IO_HUP | G_IO_ERR | G_IO_NVAL)
+
+typedef struct {
+	PurpleInputFunction function;
+	gpointer data;
+} PurpleBenchIOClosure;
+
+static gboolean
+purple_bench_io_invoke(GIOChannel *source, GIOCondition condition,
+                       gpointer data)
+{
+	PurpleBenchIOClosure *closure = data;
+	PurpleInputCondition purple_cond = 0;
+
+	if (condition & PURPLE_GLIB_READ_COND)
+		purple_cond |= PURPLE_INPUT_READ;
+	if (condition & PURPLE_GLIB_WRITE_COND)
+		purple_cond |= PURPLE_INPUT_WRITE;
+
+	closure->function(closure->data, g_io_channel_unix_get_fd(source),
+	                  purple_cond);
+
+	return TRUE;
+}
+
+/* The network benchmarks need real input watches, unlike the tests */
+static guint
+purple_bench_input_add(gint fd, PurpleInputCondition condition,
+                       PurpleInputFunction function, gpointer data)
+{
+	PurpleBenchIOClosure *closure = g_new0(PurpleBenchIOClosure, 1);
+	GIOChannel *channel;
+	GIOCondition cond = 0;
+	guint result;
+
+	closure->function = function;
+	closure->data = data;
+
+	if (condition & PURPLE_INPUT_READ)
+		cond |= PURPLE_GLIB_READ_COND;
+	if (condition & PURPLE_INPUT_WRITE)
+		cond |= PURPLE_GLIB_WRITE_COND;
+
+	channel = g_io_channel_unix_new(fd);
+	result = g_io_add_watch_full(channel, G_PRIORITY_DEFAULT, cond,
+	                             purple_bench_io_invoke, closure, g_free);
+	g_io_channel_unref(channel);
+
+	return result;
+}
+
+static PurpleEventLoopUiOps eventloop_ui_ops = {
+	g_timeout_add,
+	g_source_remove,
+	purple_bench_input_add,
+	g_source_remove,
+	NULL, /* input_get_error */
+#if GLIB_CHECK_VERSION(2,14,0)
+	g_timeout_add_seconds,
+#else
+	NULL,
+#endif
+	NULL,
+	NULL,
+	NULL
+};
+
+/* Just enough of a protocol plugin for the accounts of the benchmarks to
+ * have one, as the loggers and others look theirs up */
+static PurplePluginProtocolInfo bench_prpl_info;
+
+static PurplePluginInfo bench_prpl_plugin_info =
+{
+	PURPLE_PLUGIN_MAGIC,
+	PURPLE_MAJOR_VERSION,
+	PURPLE_MINOR_VERSION,
+	PURPLE_PLUGIN_PROTOCOL,                           /**< type           */
+	NULL,                                             /**< ui_requirement */
+	0,                                                /**< flags          */
+	NULL,                                             /**< dependencies   */
+	PURPLE_PRIORITY_DEFAULT,                          /**< priority       */
+
+	"prpl-bench",                                     /**< id             */
+	"Bench",                                          /**< name           */
+	DISPLAY_VERSION,                                  /**< version        */
+	"Benchmark Protocol Plugin",                      /**  summary        */
+	"A protocol plugin that does not connect",        /**  description    */
+	NULL,                                             /**< author         */
+	NULL,                                             /**< homepage       */
+
+	NULL,                                             /**< load           */
+	NULL,                                             /**< unload         */
+	NULL,                                             /**< destroy        */
+
+	NULL,                                             /**< ui_info        */
+	&bench_prpl_info,                                 /**< extra_info     */
+	NULL,
+	NULL,
+
+	/* padding */
+	NULL,
+	NULL,
+	NULL,
+	NULL
+};
+
+static const char *
+bench_prpl_list_icon(PurpleAccount *account, PurpleBuddy *buddy)
+{
+	return "bench";
+}
+
+static void
+purple_bench_register_prpl(void)
+{
+	PurplePlugin *plugin;
+
+	bench_prpl_info.struct_size = sizeof(PurplePluginProtocolInfo);
+	bench_prpl_info.list_icon = bench_prpl_list_icon;
+
+	/* Registered the way a static protocol plugin is */
+	plugin = purple_plugin_new(TRUE, NULL);
+	plugin->info = &bench_prpl_plugin_info;
+	purple_plugin_register(plugin);
+	purple_plugins_probe(G_MODULE_SUFFIX);
+}
+
+static void
+purple_bench_init(const char *user_dir) {
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+	/* GLib type system is automaticaly initialized since 2.36. */
+	g_type_init();
+#endif
+
+	purple_eventloop_set_ui_ops(&eventloop_ui_ops);
+
+	/* Some benchmarks write logs and caches, so give them a home of their
+	 * own rather than the /dev/null of the tests */
+	purple_util_set_user_dir(user_dir);
+
+	purple_core_init("bench");
+	purple_bench_register_prpl();
+}
+
+static void
+purple_bench_remove_tree(const char *path)
+{
+	GDir *dir;
+	const char *name;
+
+	if ((dir = g_dir_open(path, 0, NULL)) != NULL) {
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			char *child = g_build_filename(path, name, NULL);
+			purple_bench_remove_tree(child);
+			g_free(child);
+		}
+		g_dir_close(dir);
+	}
+
+	g_remove(path);
+}
+
+/******************************************************************************
+ * Benchmark helpers
+ *****************************************************************************/
+void
+bench_report(const char *what, guint count, gdouble seconds)
+{
+	printf("%-44s %8u in %8.3f s  %12.0f/s  %10.3f us each\n",
+	       what, count, seconds,
+	       seconds > 0 ? count / seconds : 0.0,
+	       count > 0 ? seconds * 1000000 / count : 0.0);
+	fflush(stdout);
+}
+
+PurpleAccount *
+bench_account_new(const char *username)
+{
+	PurpleAccount *account = purple_account_new(username, "prpl-bench");
+
+	purple_accounts_add(account);
+
+	return account;
+}
+
+static void
+usage(const char *program)
+{
+	int i;
+
+	fprintf(stderr, "Usage: %s <benchmark> [arguments]\n\n", program);
+	fprintf(stderr, "Benchmarks:\n");
+	for (i = 0; benchmarks[i].name; i++)
+		fprintf(stderr, "  %s %s\n", benchmarks[i].name, benchmarks[i].arguments);
+}
+
+int main(int argc, char **argv)
+{
+	char *user_dir;
+	int i, result;
+
+	if (argc < 2) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; benchmarks[i].name; i++)
+		if (purple_strequal(benchmarks[i].name, argv[1]))
+			break;
+
+	if (benchmarks[i].name == NULL) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (g_getenv("PURPLE_BENCH_DEBUG"))
+		purple_debug_set_enabled(TRUE);
+
+	user_dir = g_strdup_printf("%s%sbench-libpurple-%d", g_get_tmp_dir(),
+	                           G_DIR_SEPARATOR_S, getpid());
+	if (g_mkdir(user_dir, S_IRUSR | S_IWUSR | S_IXUSR) != 0) {
+		fprintf(stderr, "Could not create %s\n", user_dir);
+		g_free(user_dir);
+		return EXIT_FAILURE;
+	}
+
+	purple_bench_init(user_dir);
+
+	/* The benchmark sees its own name as argv[0], like a program would */
+	result = benchmarks[i].run(argc - 1, argv + 1);
+
+	purple_core_quit();
+
+	purple_bench_remove_tree(user_dir);
+	g_free(user_dir);
+
+	return result;
+}
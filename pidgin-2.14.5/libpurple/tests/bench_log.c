@@ -0,0 +1,71 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define LOG_MESSAGES 100000
+
+/* Long enough to need escaping and stripping, like real incoming IMs */
+#define LOG_MESSAGE \
+	"Did you see <b>this</b>? <a href=\"http://pidgin.im/\">pidgin.im</a> " \
+	"has the release notes &amp; the tarballs up now :-)"
+
+static void
+bench_log_write_format(PurpleAccount *account, const char *format,
+                       int flush_delay, guint count)
+{
+	PurpleLog *log;
+	GTimer *timer;
+	char *name, *what;
+	time_t when = time(NULL);
+	guint i;
+
+	purple_prefs_set_string("/purple/logging/format", format);
+	purple_prefs_set_int("/purple/logging/flush_delay", flush_delay);
+
+	/* A log of its own for each run, so they do not append to each other */
+	name = g_strdup_printf("buddy-%s-%d", format, flush_delay);
+
+	timer = g_timer_new();
+	log = purple_log_new(PURPLE_LOG_IM, name, account, NULL, when, NULL);
+	for (i = 0; i < count; i++)
+		purple_log_write(log, PURPLE_MESSAGE_RECV, name, when + i / 10,
+		                 LOG_MESSAGE);
+	/* Finalizing closes the file, so whatever was held back is written */
+	purple_log_free(log);
+	g_timer_stop(timer);
+
+	what = g_strdup_printf("log write, %s, flush delay %d s", format,
+	                       flush_delay);
+	bench_report(what, count, g_timer_elapsed(timer, NULL));
+
+	g_free(what);
+	g_free(name);
+	g_timer_destroy(timer);
+}
+
+/*
+ * Times writing LOG_MESSAGES messages, or as many as the argument says,
+ * to an IM log with the html and txt loggers, flushing after every
+ * message and with the flush held back by /purple/logging/flush_delay.
+ * The main loop does not run meanwhile, so with a delay only full
+ * buffers and the final close reach the file.
+ */
+int
+bench_log_write(int argc, char **argv)
+{
+	static const char *formats[] = { "html", "txt" };
+	PurpleAccount *account;
+	guint count = LOG_MESSAGES, i;
+
+	if (argc > 1)
+		count = strtoul(argv[1], NULL, 10);
+
+	account = bench_account_new("bench");
+
+	for (i = 0; i < G_N_ELEMENTS(formats); i++) {
+		bench_log_write_format(account, formats[i], 0, count);
+		bench_log_write_format(account, formats[i], 5, count);
+	}
+
+	return 0;
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define MARKUP_PASSES 10000
+
+/* Used without a corpus file; a mix of what prpls hand to the core */
+static const char *default_corpus[] = {
+	"hi",
+	"are you there?",
+	"<b>lunch</b> at noon?",
+	"I &lt;3 this song, http://www.example.com/watch?v=abc&amp;t=42",
+	"no, it broke again, see the log at &lt;/tmp/build.log&gt;",
+	"<FONT COLOR=\"#ff0000\" SIZE=3>ok</FONT> brb",
+	"<HTML><BODY BGCOLOR=\"#ffffff\">So the thing is that the server kept "
+	"dropping us every couple of minutes, and after I turned off the "
+	"keepalive it got better, but then the file transfers started failing "
+	"halfway, which makes me think it is the proxy after all.  Can you try "
+	"from your side?  Anyway, thanks for the help, I owe you one.</BODY></HTML>",
+	"<a href=\"http://pidgin.im/\">pidgin.im</a> has the release notes "
+	"&amp; the tarballs up now",
+	"mail me at someone@example.com or see www.example.org/notes",
+	"line one<br>line two<BR>line three",
+	NULL
+};
+
+static char **
+bench_markup_corpus_load(const char *filename)
+{
+	char *contents;
+	char **corpus;
+
+	if (filename == NULL)
+		return g_strdupv((char **)default_corpus);
+
+	/* One message per line, in HTML, like a received IM */
+	if (!g_file_get_contents(filename, &contents, NULL, NULL)) {
+		fprintf(stderr, "Could not read %s\n", filename);
+		return NULL;
+	}
+
+	corpus = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+
+	return corpus;
+}
+
+static void
+markup_html_to_xhtml(const char *message)
+{
+	char *xhtml, *plaintext;
+
+	purple_markup_html_to_xhtml(message, &xhtml, &plaintext);
+	g_free(xhtml);
+	g_free(plaintext);
+}
+
+static void
+markup_strip_html(const char *message)
+{
+	g_free(purple_markup_strip_html(message));
+}
+
+static void
+markup_linkify(const char *message)
+{
+	g_free(purple_markup_linkify(message));
+}
+
+static void
+markup_unescape_html(const char *message)
+{
+	g_free(purple_unescape_html(message));
+}
+
+/* Roughly what a received IM goes through before it is displayed */
+static void
+markup_received(const char *message)
+{
+	char *xhtml, *plaintext, *linked;
+
+	purple_markup_html_to_xhtml(message, &xhtml, &plaintext);
+	linked = purple_markup_linkify(xhtml);
+	g_free(purple_markup_strip_html(linked));
+
+	g_free(linked);
+	g_free(xhtml);
+	g_free(plaintext);
+}
+
+static void
+bench_markup_run(char **corpus, guint passes, void (*run)(const char *),
+                 const char *what)
+{
+	GTimer *timer;
+	guint messages = 0, pass, i;
+
+	timer = g_timer_new();
+	for (pass = 0; pass < passes; pass++) {
+		for (i = 0; corpus[i] != NULL; i++)
+			run(corpus[i]);
+		messages += i;
+	}
+	g_timer_stop(timer);
+
+	bench_report(what, messages, g_timer_elapsed(timer, NULL));
+
+	g_timer_destroy(timer);
+}
+
+/*
+ * Times each of the markup functions a received message goes through,
+ * and all of them in a row, over a corpus of messages: MARKUP_PASSES
+ * times over a built-in one, or as many times as the argument says over
+ * the given file of one message per line.
+ */
+int
+bench_markup(int argc, char **argv)
+{
+	char **corpus;
+	guint passes = MARKUP_PASSES, i;
+	gsize bytes = 0;
+
+	if (argc > 1)
+		passes = strtoul(argv[1], NULL, 10);
+
+	corpus = bench_markup_corpus_load(argc > 2 ? argv[2] : NULL);
+	if (corpus == NULL)
+		return 1;
+
+	for (i = 0; corpus[i] != NULL; i++)
+		bytes += strlen(corpus[i]);
+	printf("Corpus of %u messages, %" G_GSIZE_FORMAT " bytes, %u passes\n",
+	       i, bytes, passes);
+
+	bench_markup_run(corpus, passes, markup_html_to_xhtml,
+	                 "markup, html_to_xhtml");
+	bench_markup_run(corpus, passes, markup_strip_html,
+	                 "markup, strip_html");
+	bench_markup_run(corpus, passes, markup_linkify, "markup, linkify");
+	bench_markup_run(corpus, passes, markup_unescape_html,
+	                 "markup, unescape_html");
+	bench_markup_run(corpus, passes, markup_received,
+	                 "markup, received message");
+
+	g_strfreev(corpus);
+
+	return 0;
+}
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define POUNCE_EXECUTIONS 100000
+
+static guint pounces_fired;
+
+static void
+bench_pounce_cb(PurplePounce *pounce, PurplePounceEvent events, void *data)
+{
+	pounces_fired++;
+}
+
+static void
+bench_pounce_execute_names(PurpleAccount *account, char **names, guint count,
+                           const char *what)
+{
+	GTimer *timer;
+	guint i;
+
+	timer = g_timer_new();
+	for (i = 0; i < POUNCE_EXECUTIONS; i++)
+		purple_pounce_execute(account, names[i % count], PURPLE_POUNCE_SIGNON);
+	g_timer_stop(timer);
+
+	bench_report(what, POUNCE_EXECUTIONS, g_timer_elapsed(timer, NULL));
+
+	g_timer_destroy(timer);
+}
+
+static void
+bench_pounce_execute_size(PurpleAccount *account, guint count)
+{
+	PurplePounce **pounces;
+	char **buddies, **strangers, *what;
+	guint i;
+
+	pounces = g_new(PurplePounce *, count);
+	buddies = g_new0(char *, count + 1);
+	strangers = g_new0(char *, count + 1);
+
+	for (i = 0; i < count; i++) {
+		buddies[i] = g_strdup_printf("buddy%u", i);
+		strangers[i] = g_strdup_printf("stranger%u", i);
+
+		pounces[i] = purple_pounce_new("bench", account, buddies[i],
+				PURPLE_POUNCE_SIGNON | PURPLE_POUNCE_AWAY,
+				PURPLE_POUNCE_OPTION_NONE);
+		purple_pounce_set_save(pounces[i], TRUE);
+	}
+
+	/* Most status changes are of buddies nobody pounces on */
+	what = g_strdup_printf("execute, %u pounces, no match", count);
+	bench_pounce_execute_names(account, strangers, count, what);
+	g_free(what);
+
+	pounces_fired = 0;
+	what = g_strdup_printf("execute, %u pounces, match", count);
+	bench_pounce_execute_names(account, buddies, count, what);
+	g_free(what);
+	g_warn_if_fail(pounces_fired == POUNCE_EXECUTIONS);
+
+	for (i = 0; i < count; i++)
+		purple_pounce_destroy(pounces[i]);
+
+	g_free(pounces);
+	g_strfreev(buddies);
+	g_strfreev(strangers);
+}
+
+/*
+ * Times purple_pounce_execute() for a signon, of buddies with a pounce
+ * and of buddies without one, with 10, 100, 1000 and 10000 pounces on
+ * the account, or up to as many as the argument says.
+ */
+int
+bench_pounce_execute(int argc, char **argv)
+{
+	PurpleAccount *account;
+	guint max = 10000, count;
+
+	if (argc > 1)
+		max = strtoul(argv[1], NULL, 10);
+
+	account = bench_account_new("bench");
+	purple_pounces_register_handler("bench", bench_pounce_cb, NULL, NULL);
+
+	for (count = 10; count <= max; count *= 10)
+		bench_pounce_execute_size(account, count);
+
+	purple_pounces_unregister_handler("bench");
+
+	return 0;
+}
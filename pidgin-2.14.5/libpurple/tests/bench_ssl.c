@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define SSL_CONNECTIONS 100
+
+typedef struct {
+	gboolean done;
+	PurpleSslErrorType error;
+} BenchSslConnect;
+
+static void
+bench_ssl_connect_cb(gpointer data, PurpleSslConnection *gsc,
+                     PurpleInputCondition cond)
+{
+	BenchSslConnect *connect = data;
+
+	connect->done = TRUE;
+}
+
+static void
+bench_ssl_error_cb(PurpleSslConnection *gsc, PurpleSslErrorType error,
+                   gpointer data)
+{
+	BenchSslConnect *connect = data;
+
+	/* The connection is closed for us after this */
+	connect->done = TRUE;
+	connect->error = error;
+}
+
+static gboolean
+bench_ssl_connect(PurpleAccount *account, const char *host, int port,
+                  guint count, gboolean resume)
+{
+	GTimer *timer;
+	gdouble elapsed = 0;
+	guint i;
+
+	timer = g_timer_new();
+	for (i = 0; i < count; i++) {
+		BenchSslConnect connect = { FALSE, 0 };
+		PurpleSslConnection *gsc;
+
+		g_timer_start(timer);
+		gsc = purple_ssl_connect(account, host, port, bench_ssl_connect_cb,
+		                         bench_ssl_error_cb, &connect);
+		if (gsc != NULL) {
+			/* The test server is ours, so a self-signed certificate does;
+			 * the handshake itself is what is timed */
+			gsc->verifier = NULL;
+
+			/* The backend looks the session up once the socket is
+			 * connected, so it is not there to offer yet */
+			if (!resume)
+				purple_ssl_session_cache_remove(gsc);
+
+			while (!connect.done)
+				g_main_context_iteration(NULL, TRUE);
+		}
+		g_timer_stop(timer);
+		elapsed += g_timer_elapsed(timer, NULL);
+
+		if (gsc == NULL || connect.error != 0) {
+			fprintf(stderr, "Could not connect to %s:%d: %s\n", host, port,
+			        purple_ssl_strerror(connect.error));
+			g_timer_destroy(timer);
+			return FALSE;
+		}
+
+		purple_ssl_close(gsc);
+	}
+
+	bench_report(resume ? "connect, resumed handshake" :
+	             "connect, full handshake", count, elapsed);
+
+	g_timer_destroy(timer);
+
+	return TRUE;
+}
+
+/*
+ * Times SSL_CONNECTIONS connections, or as many as the argument says, to
+ * a TLS server, first dropping the cached session before each handshake
+ * and then resuming it.  The SSL plugins are looked for in the plugin
+ * directory given, e.g. libpurple/plugins/ssl/.libs of the build tree,
+ * besides the installed ones.  A local test server will do, such as
+ *
+ *   openssl s_server -accept 4433 -cert cert.pem -key key.pem -www
+ *
+ * ssl-nss keeps its own session cache rather than the shared one, so
+ * with it both passes resume.
+ */
+int
+bench_ssl_handshake(int argc, char **argv)
+{
+	PurpleAccount *account;
+	const char *host;
+	guint count = SSL_CONNECTIONS;
+	int port;
+
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <host> <port> [connections] [plugin dir]\n",
+		        argv[0]);
+		return 1;
+	}
+
+	host = argv[1];
+	port = atoi(argv[2]);
+	if (argc > 3)
+		count = strtoul(argv[3], NULL, 10);
+
+	if (argc > 4) {
+		purple_plugins_add_search_path(argv[4]);
+		purple_plugins_probe(G_MODULE_SUFFIX);
+	}
+
+	if (!purple_ssl_is_supported()) {
+		fprintf(stderr, "No SSL plugin could be loaded\n");
+		return 1;
+	}
+
+	account = bench_account_new("bench");
+
+	if (!bench_ssl_connect(account, host, port, count, FALSE) ||
+			!bench_ssl_connect(account, host, port, count, TRUE))
+		return 1;
+
+	return 0;
+}
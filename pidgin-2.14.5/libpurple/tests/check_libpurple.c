@@ -87,12 +87,17 @@ int main(void)
 	sr = srunner_create (master_suite());
 
 	srunner_add_suite(sr, cipher_suite());
+	srunner_add_suite(sr, dbus_server_suite());
+	srunner_add_suite(sr, dnsquery_suite());
 	srunner_add_suite(sr, jabber_caps_suite());
 	srunner_add_suite(sr, jabber_digest_md5_suite());
 	srunner_add_suite(sr, jabber_jutil_suite());
 	srunner_add_suite(sr, jabber_scram_suite());
+	srunner_add_suite(sr, log_suite());
+	srunner_add_suite(sr, pounce_suite());
 	srunner_add_suite(sr, util_suite());
 	srunner_add_suite(sr, xmlnode_suite());
+	srunner_add_suite(sr, zephyr_suite());
 
 	/* make this a libpurple "ui" */
 	purple_check_init();
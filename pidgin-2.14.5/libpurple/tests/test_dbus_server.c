@@ -0,0 +1,130 @@
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <string.h>
+
+#include "tests.h"
+
+#ifdef HAVE_DBUS
+#include "../dbus-server.h"
+
+#define OBJECT_COUNT 5000
+
+static PurpleDBusType check_parent_type = { NULL };
+static PurpleDBusType check_child_type = { &check_parent_type };
+static PurpleDBusType check_other_type = { NULL };
+
+static char objects[OBJECT_COUNT];
+
+START_TEST(test_dbus_ids_register)
+{
+	gint id, other_id;
+
+	purple_dbus_register_pointer(&objects[0], &check_child_type);
+	purple_dbus_register_pointer(&objects[1], &check_other_type);
+
+	id = purple_dbus_pointer_to_id(&objects[0]);
+	other_id = purple_dbus_pointer_to_id(&objects[1]);
+	fail_unless(id > 0);
+	fail_unless(other_id > 0);
+	fail_unless(id != other_id);
+
+	/* Resolved as its own type or a parent, not as an unrelated type */
+	fail_unless(purple_dbus_id_to_pointer(id, &check_child_type) == &objects[0]);
+	fail_unless(purple_dbus_id_to_pointer(id, &check_parent_type) == &objects[0]);
+	fail_unless(purple_dbus_id_to_pointer(id, &check_other_type) == NULL);
+	fail_unless(purple_dbus_id_to_pointer(other_id, &check_other_type) == &objects[1]);
+	fail_unless(purple_dbus_id_to_pointer(other_id, &check_parent_type) == NULL);
+
+	/* Handles that were never issued */
+	assert_int_equal(0, purple_dbus_pointer_to_id(NULL));
+	assert_int_equal(0, purple_dbus_pointer_to_id(&objects[2]));
+	fail_unless(purple_dbus_id_to_pointer(0, &check_child_type) == NULL);
+	fail_unless(purple_dbus_id_to_pointer(-1, &check_child_type) == NULL);
+	fail_unless(purple_dbus_id_to_pointer(G_MAXINT, &check_child_type) == NULL);
+
+	purple_dbus_unregister_pointer(&objects[0]);
+	purple_dbus_unregister_pointer(&objects[1]);
+	assert_int_equal(0, purple_dbus_pointer_to_id(&objects[0]));
+	fail_unless(purple_dbus_id_to_pointer(id, &check_child_type) == NULL);
+	fail_unless(purple_dbus_id_to_pointer(other_id, &check_other_type) == NULL);
+}
+END_TEST
+
+START_TEST(test_dbus_ids_stale)
+{
+	gint id, new_id;
+
+	purple_dbus_register_pointer(&objects[0], &check_child_type);
+	id = purple_dbus_pointer_to_id(&objects[0]);
+	purple_dbus_unregister_pointer(&objects[0]);
+
+	/* Whatever reuses the slot must not answer to the old handle */
+	purple_dbus_register_pointer(&objects[1], &check_child_type);
+	new_id = purple_dbus_pointer_to_id(&objects[1]);
+	fail_unless(new_id != id);
+	fail_unless(purple_dbus_id_to_pointer(id, &check_child_type) == NULL);
+	fail_unless(purple_dbus_id_to_pointer(new_id, &check_child_type) == &objects[1]);
+
+	/* Nor must the same object registered again */
+	purple_dbus_unregister_pointer(&objects[1]);
+	purple_dbus_register_pointer(&objects[0], &check_child_type);
+	fail_unless(purple_dbus_id_to_pointer(id, &check_child_type) == NULL);
+	fail_unless(purple_dbus_id_to_pointer(new_id, &check_child_type) == NULL);
+	fail_unless(purple_dbus_id_to_pointer(purple_dbus_pointer_to_id(&objects[0]),
+			&check_child_type) == &objects[0]);
+
+	purple_dbus_unregister_pointer(&objects[0]);
+}
+END_TEST
+
+START_TEST(test_dbus_ids_many)
+{
+	static gint ids[OBJECT_COUNT];
+	int i;
+
+	for (i = 0; i < OBJECT_COUNT; i++) {
+		purple_dbus_register_pointer(&objects[i], &check_child_type);
+		ids[i] = purple_dbus_pointer_to_id(&objects[i]);
+	}
+
+	/* Release every other slot and fill them again */
+	for (i = 0; i < OBJECT_COUNT; i += 2)
+		purple_dbus_unregister_pointer(&objects[i]);
+	for (i = 0; i < OBJECT_COUNT; i += 2)
+		fail_unless(purple_dbus_id_to_pointer(ids[i], &check_child_type) == NULL);
+	for (i = 0; i < OBJECT_COUNT; i += 2)
+		purple_dbus_register_pointer(&objects[i], &check_child_type);
+
+	for (i = 0; i < OBJECT_COUNT; i++) {
+		gint id = purple_dbus_pointer_to_id(&objects[i]);
+
+		fail_unless(purple_dbus_id_to_pointer(id, &check_child_type) == &objects[i]);
+		if (i % 2 == 0)
+			fail_unless(id != ids[i]);
+		else
+			assert_int_equal(ids[i], id);
+	}
+
+	for (i = 0; i < OBJECT_COUNT; i++)
+		purple_dbus_unregister_pointer(&objects[i]);
+}
+END_TEST
+#endif /* HAVE_DBUS */
+
+Suite *
+dbus_server_suite(void)
+{
+	Suite *s = suite_create("D-Bus Server");
+
+#ifdef HAVE_DBUS
+	TCase *tc = tcase_create("Handles");
+	tcase_add_test(tc, test_dbus_ids_register);
+	tcase_add_test(tc, test_dbus_ids_stale);
+	tcase_add_test(tc, test_dbus_ids_many);
+	suite_add_tcase(s, tc);
+#endif
+
+	return s;
+}
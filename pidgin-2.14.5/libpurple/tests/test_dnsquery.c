@@ -0,0 +1,513 @@
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "tests.h"
+#include "../dnsquery.h"
+#include "../dnssrv.h"
+#include "../network.h"
+
+/******************************************************************************
+ * A stub resolver, plugged in through the UI ops, that answers when told to
+ *****************************************************************************/
+typedef struct {
+	gpointer query;
+	gpointer resolved_cb;
+	gpointer failed_cb;
+} StubQuery;
+
+static GList *stub_queries = NULL;
+static int stub_resolves = 0;
+
+static void
+stub_add(gpointer query, gpointer resolved_cb, gpointer failed_cb)
+{
+	StubQuery *stub = g_new0(StubQuery, 1);
+
+	stub->query = query;
+	stub->resolved_cb = resolved_cb;
+	stub->failed_cb = failed_cb;
+	stub_queries = g_list_append(stub_queries, stub);
+	stub_resolves++;
+}
+
+static void
+stub_remove(gpointer query)
+{
+	GList *l;
+
+	for (l = stub_queries; l != NULL; l = l->next) {
+		StubQuery *stub = l->data;
+
+		if (stub->query == query) {
+			stub_queries = g_list_delete_link(stub_queries, l);
+			g_free(stub);
+			return;
+		}
+	}
+}
+
+/* Takes the oldest query the stub was asked, to be answered by the caller */
+static StubQuery *
+stub_pop(void)
+{
+	StubQuery *stub;
+
+	fail_unless(stub_queries != NULL);
+	stub = stub_queries->data;
+	stub_queries = g_list_delete_link(stub_queries, stub_queries);
+
+	return stub;
+}
+
+static gboolean
+stub_resolve_host(PurpleDnsQueryData *query_data,
+                  PurpleDnsQueryResolvedCallback resolved_cb,
+                  PurpleDnsQueryFailedCallback failed_cb)
+{
+	stub_add(query_data, resolved_cb, failed_cb);
+	return TRUE;
+}
+
+static void
+stub_destroy_host(PurpleDnsQueryData *query_data)
+{
+	stub_remove(query_data);
+}
+
+static PurpleDnsQueryUiOps stub_dns_ops = {
+	stub_resolve_host,
+	stub_destroy_host,
+	NULL,
+	NULL,
+	NULL,
+	NULL
+};
+
+static gboolean
+stub_resolve_srv_txt(PurpleSrvTxtQueryData *query_data,
+                     PurpleSrvTxtQueryResolvedCallback resolved_cb,
+                     PurpleSrvTxtQueryFailedCallback failed_cb)
+{
+	stub_add(query_data, resolved_cb, failed_cb);
+	return TRUE;
+}
+
+static void
+stub_destroy_srv_txt(PurpleSrvTxtQueryData *query_data)
+{
+	stub_remove(query_data);
+}
+
+static PurpleSrvTxtQueryUiOps stub_srv_txt_ops = {
+	stub_resolve_srv_txt,
+	stub_destroy_srv_txt,
+	NULL,
+	NULL,
+	NULL,
+	NULL
+};
+
+static void
+stub_answer_host(const char *address)
+{
+	StubQuery *stub = stub_pop();
+	PurpleDnsQueryData *query_data = stub->query;
+	struct sockaddr_in *sin = g_new0(struct sockaddr_in, 1);
+	GSList *hosts;
+
+	sin->sin_family = AF_INET;
+	sin->sin_port = htons(purple_dnsquery_get_port(query_data));
+	inet_pton(AF_INET, address, &sin->sin_addr);
+
+	hosts = g_slist_append(NULL, GSIZE_TO_POINTER(sizeof(*sin)));
+	hosts = g_slist_append(hosts, sin);
+	((PurpleDnsQueryResolvedCallback)stub->resolved_cb)(query_data, hosts);
+	g_free(stub);
+}
+
+static void
+stub_fail_host(void)
+{
+	StubQuery *stub = stub_pop();
+
+	((PurpleDnsQueryFailedCallback)stub->failed_cb)(stub->query,
+			"No answer from the stub");
+	g_free(stub);
+}
+
+static void
+stub_answer_srv(void)
+{
+	StubQuery *stub = stub_pop();
+	PurpleSrvResponse *first = g_new0(PurpleSrvResponse, 1);
+	PurpleSrvResponse *second = g_new0(PurpleSrvResponse, 1);
+	GList *records;
+
+	assert_string_equal("_xmpp-client._tcp.example.test",
+			purple_srv_txt_query_get_query(stub->query));
+
+	strcpy(first->hostname, "backup.example.test");
+	first->port = 5223;
+	first->pref = 20;
+	strcpy(second->hostname, "xmpp.example.test");
+	second->port = 5222;
+	second->pref = 10;
+
+	records = g_list_append(NULL, first);
+	records = g_list_append(records, second);
+	((PurpleSrvTxtQueryResolvedCallback)stub->resolved_cb)(stub->query, records);
+	g_free(stub);
+}
+
+static void
+stub_answer_txt(const char *content)
+{
+	StubQuery *stub = stub_pop();
+	PurpleTxtResponse *response = g_new0(PurpleTxtResponse, 1);
+
+	response->content = g_strdup(content);
+	((PurpleSrvTxtQueryResolvedCallback)stub->resolved_cb)(stub->query,
+			g_list_append(NULL, response));
+	g_free(stub);
+}
+
+static void
+stub_fail_srv_txt(void)
+{
+	StubQuery *stub = stub_pop();
+
+	((PurpleSrvTxtQueryFailedCallback)stub->failed_cb)(stub->query,
+			"No answer from the stub");
+	g_free(stub);
+}
+
+/* The cache answers, and restarts waiters, from the main loop */
+static void
+run_main_loop(void)
+{
+	while (g_main_context_iteration(NULL, FALSE))
+		;
+}
+
+static void
+setup_stub(void)
+{
+	stub_resolves = 0;
+	purple_dnsquery_set_ui_ops(&stub_dns_ops);
+	purple_srv_txt_query_set_ui_ops(&stub_srv_txt_ops);
+}
+
+static void
+teardown_stub(void)
+{
+	purple_dnsquery_set_ui_ops(NULL);
+	purple_srv_txt_query_set_ui_ops(NULL);
+	while (stub_queries != NULL)
+		g_free(stub_pop());
+}
+
+/******************************************************************************
+ * What the callers get
+ *****************************************************************************/
+typedef struct {
+	int answers;
+	int port;
+	gboolean failed;
+} HostResult;
+
+static void
+host_cb(GSList *hosts, gpointer data, const char *error_message)
+{
+	HostResult *result = data;
+
+	result->answers++;
+	result->failed = (error_message != NULL);
+	if (hosts != NULL)
+		result->port = ntohs(((struct sockaddr_in *)hosts->next->data)->sin_port);
+
+	while (hosts != NULL) {
+		hosts = g_slist_delete_link(hosts, hosts);
+		g_free(hosts->data);
+		hosts = g_slist_delete_link(hosts, hosts);
+	}
+}
+
+typedef struct {
+	int answers;
+	int results;
+	char *first;
+} RecordResult;
+
+static void
+srv_cb(PurpleSrvResponse *resp, int results, gpointer data)
+{
+	RecordResult *result = data;
+
+	result->answers++;
+	result->results = results;
+	g_free(result->first);
+	result->first = results > 0 ? g_strdup(resp[0].hostname) : NULL;
+	g_free(resp);
+}
+
+static void
+txt_cb(GList *responses, gpointer data)
+{
+	RecordResult *result = data;
+
+	result->answers++;
+	result->results = g_list_length(responses);
+	g_free(result->first);
+	result->first = responses != NULL ?
+		g_strdup(purple_txt_response_get_content(responses->data)) : NULL;
+
+	while (responses != NULL) {
+		purple_txt_response_destroy(responses->data);
+		responses = g_list_delete_link(responses, responses);
+	}
+}
+
+/******************************************************************************
+ * A/AAAA
+ *****************************************************************************/
+START_TEST(test_dnsquery_coalesce)
+{
+	HostResult first = { 0 }, second = { 0 }, other_port = { 0 }, later = { 0 };
+
+	purple_dnsquery_a("host.example.test", 5222, host_cb, &first);
+	purple_dnsquery_a("HOST.example.test", 5222, host_cb, &second);
+	purple_dnsquery_a("host.example.test", 443, host_cb, &other_port);
+	run_main_loop();
+
+	/* The same name and port is only resolved once, in any case */
+	assert_int_equal(2, stub_resolves);
+
+	stub_answer_host("192.0.2.1");
+	assert_int_equal(1, first.answers);
+	assert_int_equal(5222, first.port);
+	assert_int_equal(0, second.answers);
+	run_main_loop();
+	assert_int_equal(1, second.answers);
+	assert_int_equal(5222, second.port);
+	assert_int_equal(0, other_port.answers);
+
+	/* Answered from the cache */
+	purple_dnsquery_a("host.example.test", 5222, host_cb, &later);
+	run_main_loop();
+	assert_int_equal(1, later.answers);
+	assert_int_equal(5222, later.port);
+	assert_int_equal(2, stub_resolves);
+
+	stub_answer_host("192.0.2.1");
+	assert_int_equal(1, other_port.answers);
+	assert_int_equal(443, other_port.port);
+}
+END_TEST
+
+START_TEST(test_dnsquery_leader_cancelled)
+{
+	HostResult first = { 0 }, second = { 0 };
+	PurpleDnsQueryData *query_data;
+
+	query_data = purple_dnsquery_a("cancel.example.test", 5222, host_cb, &first);
+	purple_dnsquery_a("cancel.example.test", 5222, host_cb, &second);
+	run_main_loop();
+	assert_int_equal(1, stub_resolves);
+
+	/* The query waiting on it takes the lookup over */
+	purple_dnsquery_destroy(query_data);
+	run_main_loop();
+	assert_int_equal(2, stub_resolves);
+
+	stub_answer_host("192.0.2.2");
+	assert_int_equal(0, first.answers);
+	assert_int_equal(1, second.answers);
+	fail_if(second.failed);
+}
+END_TEST
+
+START_TEST(test_dnsquery_failed)
+{
+	HostResult first = { 0 }, second = { 0 };
+
+	purple_dnsquery_a("fail.example.test", 5222, host_cb, &first);
+	purple_dnsquery_a("fail.example.test", 5222, host_cb, &second);
+	run_main_loop();
+	assert_int_equal(1, stub_resolves);
+
+	/* A resolver other than ours may have failed for a local reason, so
+	 * the failure is not cached and the waiter asks again */
+	stub_fail_host();
+	assert_int_equal(1, first.answers);
+	fail_unless(first.failed);
+	run_main_loop();
+	assert_int_equal(2, stub_resolves);
+	assert_int_equal(0, second.answers);
+
+	stub_answer_host("192.0.2.3");
+	assert_int_equal(1, second.answers);
+	fail_if(second.failed);
+}
+END_TEST
+
+START_TEST(test_dnsquery_network_changed)
+{
+	HostResult first = { 0 }, second = { 0 };
+
+	purple_dnsquery_a("moved.example.test", 5222, host_cb, &first);
+	run_main_loop();
+	stub_answer_host("192.0.2.4");
+	assert_int_equal(1, first.answers);
+
+	/* A new network may resolve names differently */
+	purple_signal_emit(purple_network_get_handle(),
+			"network-configuration-changed", NULL);
+	purple_dnsquery_a("moved.example.test", 5222, host_cb, &second);
+	run_main_loop();
+	assert_int_equal(2, stub_resolves);
+	stub_answer_host("198.51.100.4");
+	assert_int_equal(1, second.answers);
+}
+END_TEST
+
+/******************************************************************************
+ * SRV/TXT
+ *****************************************************************************/
+START_TEST(test_dnssrv_coalesce)
+{
+	RecordResult first = { 0 }, second = { 0 }, later = { 0 };
+
+	purple_srv_resolve_account(NULL, "xmpp-client", "tcp", "example.test",
+			srv_cb, &first);
+	purple_srv_resolve_account(NULL, "xmpp-client", "tcp", "EXAMPLE.test",
+			srv_cb, &second);
+	assert_int_equal(1, stub_resolves);
+
+	/* Both are answered from the main loop, sorted by preference */
+	stub_answer_srv();
+	assert_int_equal(0, first.answers);
+	run_main_loop();
+	assert_int_equal(1, first.answers);
+	assert_int_equal(2, first.results);
+	assert_string_equal("xmpp.example.test", first.first);
+	assert_int_equal(1, second.answers);
+	assert_int_equal(2, second.results);
+	assert_string_equal("xmpp.example.test", second.first);
+
+	/* Answered from the cache */
+	purple_srv_resolve_account(NULL, "xmpp-client", "tcp", "example.test",
+			srv_cb, &later);
+	run_main_loop();
+	assert_int_equal(1, stub_resolves);
+	assert_int_equal(1, later.answers);
+	assert_int_equal(2, later.results);
+
+	g_free(first.first);
+	g_free(second.first);
+	g_free(later.first);
+}
+END_TEST
+
+START_TEST(test_dnssrv_cancelled)
+{
+	RecordResult first = { 0 }, second = { 0 };
+	PurpleSrvTxtQueryData *query_data;
+
+	query_data = purple_txt_resolve_account(NULL, "_xmppconnect",
+			"example.test", txt_cb, &first);
+	purple_txt_resolve_account(NULL, "_xmppconnect", "example.test",
+			txt_cb, &second);
+	assert_int_equal(1, stub_resolves);
+
+	/* The lookup goes on for the query still waiting */
+	purple_txt_cancel(query_data);
+	stub_answer_txt("_xmpp-client-xbosh=https://example.test/bosh");
+	run_main_loop();
+	assert_int_equal(0, first.answers);
+	assert_int_equal(1, second.answers);
+	assert_int_equal(1, second.results);
+	assert_string_equal("_xmpp-client-xbosh=https://example.test/bosh",
+			second.first);
+
+	g_free(second.first);
+}
+END_TEST
+
+START_TEST(test_dnssrv_failed)
+{
+	RecordResult first = { 0 }, second = { 0 }, srv = { 0 };
+
+	purple_txt_resolve_account(NULL, "_xmppconnect", "missing.test",
+			txt_cb, &first);
+	stub_fail_srv_txt();
+	run_main_loop();
+	assert_int_equal(1, first.answers);
+	assert_int_equal(0, first.results);
+
+	/* The failure is remembered for a while */
+	purple_txt_resolve_account(NULL, "_xmppconnect", "missing.test",
+			txt_cb, &second);
+	run_main_loop();
+	assert_int_equal(1, stub_resolves);
+	assert_int_equal(1, second.answers);
+	assert_int_equal(0, second.results);
+
+	/* Not for the other record type of the same name, though */
+	purple_srv_resolve_account(NULL, "xmppconnect", "tcp", "missing.test",
+			srv_cb, &srv);
+	assert_int_equal(2, stub_resolves);
+	stub_fail_srv_txt();
+	run_main_loop();
+	assert_int_equal(1, srv.answers);
+	assert_int_equal(0, srv.results);
+}
+END_TEST
+
+START_TEST(test_dnssrv_network_changed)
+{
+	RecordResult first = { 0 }, second = { 0 };
+
+	purple_srv_resolve_account(NULL, "xmpp-client", "tcp", "example.test",
+			srv_cb, &first);
+	stub_answer_srv();
+	run_main_loop();
+	assert_int_equal(1, first.answers);
+
+	purple_signal_emit(purple_network_get_handle(),
+			"network-configuration-changed", NULL);
+	purple_srv_resolve_account(NULL, "xmpp-client", "tcp", "example.test",
+			srv_cb, &second);
+	assert_int_equal(2, stub_resolves);
+	stub_answer_srv();
+	run_main_loop();
+	assert_int_equal(1, second.answers);
+
+	g_free(first.first);
+	g_free(second.first);
+}
+END_TEST
+
+Suite *
+dnsquery_suite(void)
+{
+	Suite *s = suite_create("DNS Query");
+
+	TCase *tc = tcase_create("A");
+	tcase_add_checked_fixture(tc, setup_stub, teardown_stub);
+	tcase_add_test(tc, test_dnsquery_coalesce);
+	tcase_add_test(tc, test_dnsquery_leader_cancelled);
+	tcase_add_test(tc, test_dnsquery_failed);
+	tcase_add_test(tc, test_dnsquery_network_changed);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("SRV/TXT");
+	tcase_add_checked_fixture(tc, setup_stub, teardown_stub);
+	tcase_add_test(tc, test_dnssrv_coalesce);
+	tcase_add_test(tc, test_dnssrv_cancelled);
+	tcase_add_test(tc, test_dnssrv_failed);
+	tcase_add_test(tc, test_dnssrv_network_changed);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,200 @@
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "tests.h"
+#include "../account.h"
+#include "../log.h"
+#include "../prefs.h"
+#include "../util.h"
+
+#define HEADER "Conversation with buddy at today on tester (check)\n"
+
+static PurpleAccount *account = NULL;
+static char *log_dir = NULL;
+
+static void
+setup_log_search(void)
+{
+	account = purple_account_new("tester", "prpl-check");
+	purple_prefs_set_string("/purple/logging/format", "txt");
+
+	log_dir = g_strdup_printf("%s" G_DIR_SEPARATOR_S "check-log-search-%d",
+			g_get_tmp_dir(), (int)getpid());
+	purple_build_dir(log_dir, S_IRUSR | S_IWUSR | S_IXUSR);
+}
+
+static void
+teardown_log_search(void)
+{
+	const char *name;
+	GDir *dir;
+
+	if ((dir = g_dir_open(log_dir, 0, NULL)) != NULL) {
+		while ((name = g_dir_read_name(dir)) != NULL) {
+			char *path = g_build_filename(log_dir, name, NULL);
+			g_unlink(path);
+			g_free(path);
+		}
+		g_dir_close(dir);
+	}
+	g_rmdir(log_dir);
+	g_free(log_dir);
+	log_dir = NULL;
+
+	purple_prefs_set_string("/purple/logging/format", "html");
+}
+
+/* Replaces the contents of a log file without replacing the file, the way
+ * an editor saving in place would. */
+static char *
+write_log_file(const char *name, const char *text)
+{
+	char *path = g_build_filename(log_dir, name, NULL);
+	FILE *fp = g_fopen(path, "w");
+
+	fail_unless(fp != NULL);
+	fputs(HEADER, fp);
+	fputs(text, fp);
+	fclose(fp);
+
+	return path;
+}
+
+/* A txt log of an existing file, open for appending like one being written */
+static PurpleLog *
+open_log(char *path)
+{
+	PurpleLog *log = purple_log_new(PURPLE_LOG_IM, "buddy", account, NULL,
+			time(NULL), NULL);
+	PurpleLogCommonLoggerData *data = g_slice_new0(PurpleLogCommonLoggerData);
+
+	data->path = path;
+	data->file = g_fopen(path, "a");
+	log->logger_data = data;
+
+	return log;
+}
+
+static int
+count_hits(GList *logs, const char *text, PurpleLog *first)
+{
+	GList *hits = purple_log_search(logs, text);
+	int count = g_list_length(hits);
+
+	if (hits != NULL)
+		fail_unless(((PurpleLogSearchHit *)hits->data)->log == first);
+
+	g_list_foreach(hits, (GFunc)g_free, NULL);
+	g_list_free(hits);
+
+	return count;
+}
+
+static gboolean
+log_contains(PurpleLog *log, const char *text)
+{
+	GList *logs = g_list_prepend(NULL, log);
+	int count = count_hits(logs, text, log);
+
+	g_list_free(logs);
+	return count > 0;
+}
+
+START_TEST(test_log_search_index)
+{
+	PurpleLog *sunny, *snowy;
+	GList *logs = NULL;
+
+	sunny = open_log(write_log_file("sunny.txt", "(12:00:00) buddy: sunny weather\n"));
+	snowy = open_log(write_log_file("snowy.txt", "(12:00:00) buddy: snowy weather\n"));
+	logs = g_list_append(logs, sunny);
+	logs = g_list_append(logs, snowy);
+
+	/* Indexed by the first search, then answered from the index */
+	assert_int_equal(1, count_hits(logs, "SUNNY", sunny));
+	assert_int_equal(1, count_hits(logs, "snowy", snowy));
+	assert_int_equal(2, count_hits(logs, "Weather", sunny));
+	assert_int_equal(0, count_hits(logs, "rain", NULL));
+	/* The header is not part of the text searched */
+	assert_int_equal(0, count_hits(logs, "tester", NULL));
+
+	/* What is written afterwards is indexed from the appended bytes */
+	purple_log_write(snowy, PURPLE_MESSAGE_RECV, "buddy", time(NULL), "rain later");
+	assert_int_equal(1, count_hits(logs, "rain later", snowy));
+	purple_log_write(snowy, PURPLE_MESSAGE_SEND, "tester", time(NULL), "<b>hail</b> too");
+	assert_int_equal(1, count_hits(logs, "hail too", snowy));
+	assert_int_equal(1, count_hits(logs, "rain", snowy));
+	assert_int_equal(2, count_hits(logs, "weather", sunny));
+
+	g_list_free(logs);
+	purple_log_free(sunny);
+	purple_log_free(snowy);
+}
+END_TEST
+
+START_TEST(test_log_search_stale)
+{
+	PurpleLog *log;
+	FILE *fp;
+
+	log = open_log(write_log_file("stale.txt", "(12:00:00) buddy: sunny weather\n"));
+	fail_unless(log_contains(log, "sunny"));
+
+	/* Changed by someone else, so the entry is stale and indexed again */
+	g_free(write_log_file("stale.txt", "(12:00:00) buddy: cloudy weather\n"));
+	fail_unless(log_contains(log, "cloudy"));
+	fail_if(log_contains(log, "sunny"));
+
+	/* Our own appends after someone else's: the tail cannot be trusted */
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy", time(NULL), "windy");
+	fail_unless(log_contains(log, "windy"));
+	g_free(write_log_file("stale.txt",
+			"(12:00:00) buddy: a foggy and much, much longer day than before\n"));
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy", time(NULL), "stormy");
+	fail_unless(log_contains(log, "foggy"));
+	fail_unless(log_contains(log, "stormy"));
+	fail_if(log_contains(log, "windy"));
+
+	/* Appended to by someone else only */
+	fp = g_fopen(((PurpleLogCommonLoggerData *)log->logger_data)->path, "a");
+	fputs("(12:01:00) buddy: misty\n", fp);
+	fclose(fp);
+	fail_unless(log_contains(log, "misty"));
+	fail_unless(log_contains(log, "stormy"));
+
+	purple_log_free(log);
+}
+END_TEST
+
+START_TEST(test_log_search_removed)
+{
+	PurpleLog *log;
+
+	log = open_log(write_log_file("removed.txt", "(12:00:00) buddy: sunny weather\n"));
+	fail_unless(log_contains(log, "sunny"));
+	fail_unless(purple_log_delete(log));
+	purple_log_free(log);
+
+	/* A new file of the same name and size must not be taken for the old */
+	log = open_log(write_log_file("removed.txt", "(12:00:00) buddy: rainy weather\n"));
+	fail_unless(log_contains(log, "rainy"));
+	fail_if(log_contains(log, "sunny"));
+	purple_log_free(log);
+}
+END_TEST
+
+Suite *
+log_suite(void)
+{
+	Suite *s = suite_create("Log");
+
+	TCase *tc = tcase_create("Search");
+	tcase_add_checked_fixture(tc, setup_log_search, teardown_log_search);
+	tcase_add_test(tc, test_log_search_index);
+	tcase_add_test(tc, test_log_search_stale);
+	tcase_add_test(tc, test_log_search_removed);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
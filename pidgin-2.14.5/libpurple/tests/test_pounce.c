@@ -0,0 +1,130 @@
+#include <string.h>
+
+#include "tests.h"
+#include "../account.h"
+#include "../pounce.h"
+
+static int pounces_fired = 0;
+static PurplePounce *pounce_to_replace = NULL;
+
+static void
+count_pounce_cb(PurplePounce *pounce, PurplePounceEvent events, void *data)
+{
+	pounces_fired++;
+}
+
+/*
+ * Destroys another pounce on the same buddy and creates a new one in its
+ * place, which may well get the address of the one destroyed.
+ */
+static void
+replace_pounce_cb(PurplePounce *pounce, PurplePounceEvent events, void *data)
+{
+	PurplePounce *replacement;
+
+	pounces_fired++;
+
+	if (pounce_to_replace == NULL)
+		return;
+
+	purple_pounce_destroy(pounce_to_replace);
+	pounce_to_replace = NULL;
+
+	replacement = purple_pounce_new("check", purple_pounce_get_pouncer(pounce),
+			purple_pounce_get_pouncee(pounce), PURPLE_POUNCE_SIGNON,
+			PURPLE_POUNCE_OPTION_NONE);
+	purple_pounce_set_save(replacement, TRUE);
+}
+
+START_TEST(test_pounce_index)
+{
+	PurpleAccount *account, *other;
+	PurplePounce *pounce;
+
+	account = purple_account_new("pouncer", "prpl-check");
+	other = purple_account_new("other", "prpl-check");
+	purple_pounces_register_handler("check", count_pounce_cb, NULL, NULL);
+	pounces_fired = 0;
+
+	pounce = purple_pounce_new("check", account, "Buddy",
+			PURPLE_POUNCE_SIGNON | PURPLE_POUNCE_AWAY,
+			PURPLE_POUNCE_OPTION_NONE);
+	purple_pounce_set_save(pounce, TRUE);
+
+	/* Found under any case of the name, on its account and events only */
+	fail_unless(purple_find_pounce(account, "BUDDY", PURPLE_POUNCE_SIGNON) == pounce);
+	fail_unless(purple_find_pounce(account, "buddy", PURPLE_POUNCE_AWAY) == pounce);
+	fail_unless(purple_find_pounce(account, "buddy", PURPLE_POUNCE_IDLE) == NULL);
+	fail_unless(purple_find_pounce(other, "buddy", PURPLE_POUNCE_SIGNON) == NULL);
+
+	purple_pounce_execute(account, "buddy", PURPLE_POUNCE_SIGNON);
+	assert_int_equal(1, pounces_fired);
+	purple_pounce_execute(account, "buddy", PURPLE_POUNCE_IDLE);
+	purple_pounce_execute(other, "buddy", PURPLE_POUNCE_SIGNON);
+	assert_int_equal(1, pounces_fired);
+
+	/* The buddy was renamed */
+	purple_pounce_set_pouncee(pounce, "Friend");
+	fail_unless(purple_find_pounce(account, "buddy", PURPLE_POUNCE_SIGNON) == NULL);
+	fail_unless(purple_find_pounce(account, "friend", PURPLE_POUNCE_SIGNON) == pounce);
+	purple_pounce_execute(account, "buddy", PURPLE_POUNCE_SIGNON);
+	assert_int_equal(1, pounces_fired);
+	purple_pounce_execute(account, "friend", PURPLE_POUNCE_SIGNON);
+	assert_int_equal(2, pounces_fired);
+
+	/* Moved to the other account, with other events */
+	purple_pounce_set_pouncer(pounce, other);
+	purple_pounce_set_events(pounce, PURPLE_POUNCE_IDLE);
+	fail_unless(purple_find_pounce(account, "friend", PURPLE_POUNCE_IDLE) == NULL);
+	fail_unless(purple_find_pounce(other, "friend", PURPLE_POUNCE_SIGNON) == NULL);
+	fail_unless(purple_find_pounce(other, "friend", PURPLE_POUNCE_IDLE) == pounce);
+
+	/* Removed */
+	purple_pounce_destroy(pounce);
+	fail_unless(purple_find_pounce(other, "friend", PURPLE_POUNCE_IDLE) == NULL);
+	purple_pounce_execute(other, "friend", PURPLE_POUNCE_IDLE);
+	assert_int_equal(2, pounces_fired);
+
+	purple_pounces_unregister_handler("check");
+}
+END_TEST
+
+START_TEST(test_pounce_execute_replaced)
+{
+	PurpleAccount *account;
+	PurplePounce *pounce;
+
+	account = purple_account_new("pouncer", "prpl-check");
+	purple_pounces_register_handler("check", replace_pounce_cb, NULL, NULL);
+	pounces_fired = 0;
+
+	pounce = purple_pounce_new("check", account, "buddy",
+			PURPLE_POUNCE_SIGNON, PURPLE_POUNCE_OPTION_NONE);
+	purple_pounce_set_save(pounce, TRUE);
+	pounce_to_replace = purple_pounce_new("check", account, "buddy",
+			PURPLE_POUNCE_SIGNON, PURPLE_POUNCE_OPTION_NONE);
+	purple_pounce_set_save(pounce_to_replace, TRUE);
+
+	/* Neither the destroyed pounce nor its replacement fire this time */
+	purple_pounce_execute(account, "buddy", PURPLE_POUNCE_SIGNON);
+	assert_int_equal(1, pounces_fired);
+
+	purple_pounce_execute(account, "buddy", PURPLE_POUNCE_SIGNON);
+	assert_int_equal(3, pounces_fired);
+
+	purple_pounces_unregister_handler("check");
+}
+END_TEST
+
+Suite *
+pounce_suite(void)
+{
+	Suite *s = suite_create("Buddy Pounces");
+
+	TCase *tc = tcase_create("Index");
+	tcase_add_test(tc, test_pounce_index);
+	tcase_add_test(tc, test_pounce_execute_replaced);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
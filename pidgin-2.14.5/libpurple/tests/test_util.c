@@ -184,6 +184,42 @@ START_TEST(test_markup_html_to_xhtml)
 	purple_markup_html_to_xhtml("<FONT>x</FONT>", &xhtml, &plaintext);
 	assert_string_equal_free("x", xhtml);
 	assert_string_equal_free("x", plaintext);
+
+	purple_markup_html_to_xhtml("a &amp; b<br>c", &xhtml, &plaintext);
+	assert_string_equal_free("a &amp; b<br/>c", xhtml);
+	assert_string_equal_free("a & b\nc", plaintext);
+}
+END_TEST
+
+START_TEST(test_markup_strip_html)
+{
+	assert_string_equal_free("bold and plain text",
+		purple_markup_strip_html("<b>bold</b> and <i>plain</i> text"));
+	assert_string_equal_free("a&b<c", purple_markup_strip_html("a&amp;b&lt;c"));
+	assert_string_equal_free("line\ntwo", purple_markup_strip_html("line<br>two"));
+	assert_string_equal_free("z",
+		purple_markup_strip_html("<script>x<y</script>z"));
+	assert_string_equal_free("Pidgin (http://pidgin.im/)",
+		purple_markup_strip_html("<a href=\"http://pidgin.im/\">Pidgin</a>"));
+	/* Every kind of whitespace becomes a space */
+	assert_string_equal_free("a b c d e",
+		purple_markup_strip_html("a\tb\vc\fd\re"));
+}
+END_TEST
+
+START_TEST(test_markup_linkify)
+{
+	assert_string_equal_free("see <A HREF=\"http://pidgin.im/\">http://pidgin.im/</A> now",
+		purple_markup_linkify("see http://pidgin.im/ now"));
+	assert_string_equal_free("(<A HREF=\"http://pidgin.im\">http://pidgin.im</A>)",
+		purple_markup_linkify("(http://pidgin.im)"));
+	assert_string_equal_free("mail <A HREF=\"mailto:me@example.com\">me@example.com</A>.",
+		purple_markup_linkify("mail me@example.com."));
+	/* Links and URLs inside tags are left alone */
+	assert_string_equal_free("<a href='http://x.y/'>http://x.y/</a>",
+		purple_markup_linkify("<a href='http://x.y/'>http://x.y/</a>"));
+	assert_string_equal_free("<img src=\"http://x.y/\">",
+		purple_markup_linkify("<img src=\"http://x.y/\">"));
 }
 END_TEST
 
@@ -288,6 +324,8 @@ util_suite(void)
 
 	tc = tcase_create("Markup");
 	tcase_add_test(tc, test_markup_html_to_xhtml);
+	tcase_add_test(tc, test_markup_strip_html);
+	tcase_add_test(tc, test_markup_linkify);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("Stripping Unparseables");
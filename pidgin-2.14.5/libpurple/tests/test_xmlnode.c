@@ -21,6 +21,71 @@ START_TEST(test_xmlnode_billion_laughs_attack)
 }
 END_TEST
 
+static gboolean
+write_to_gstring(const char *data, gsize len, gpointer user_data)
+{
+	g_string_append_len(user_data, data, len);
+	return TRUE;
+}
+
+START_TEST(test_xmlnode_to_str_escaping)
+{
+	xmlnode *node = xmlnode_new("foo");
+	xmlnode_set_attrib(node, "attr", "<&'\">\x01");
+	xmlnode_insert_data(xmlnode_new_child(node, "bar"), "x & y \xc2\x80", -1);
+	xmlnode_new_child(node, "baz");
+
+	assert_string_equal_free("<foo attr='&lt;&amp;&apos;&quot;&gt;&#x1;'>"
+			"<bar>x &amp; y &#x80;</bar><baz/></foo>",
+			xmlnode_to_str(node, NULL));
+
+	xmlnode_free(node);
+}
+END_TEST
+
+START_TEST(test_xmlnode_write_formatted)
+{
+	xmlnode *node = xmlnode_new("purple");
+	xmlnode *child, *group;
+	GString *str = g_string_new(NULL);
+	char *big, *expected;
+	int len;
+
+	xmlnode_set_attrib(node, "version", "1.0");
+	child = xmlnode_new_child(node, "blist");
+	xmlnode_insert_data(xmlnode_new_child(child, "alias"), "Me & You", -1);
+	group = xmlnode_new_child(child, "group");
+	xmlnode_set_attrib(group, "name", "A<B");
+	xmlnode_new_child(group, "empty");
+
+	/* Larger than the internal buffer of the writer */
+	big = g_strnfill(10000, 'a');
+	xmlnode_insert_data(xmlnode_new_child(group, "big"), big, -1);
+
+	expected = g_strconcat("<?xml version='1.0' encoding='UTF-8' ?>\n\n"
+			"<purple version='1.0'>\n"
+			"\t<blist>\n"
+			"\t\t<alias>Me &amp; You</alias>\n"
+			"\t\t<group name='A&lt;B'>\n"
+			"\t\t\t<empty/>\n"
+			"\t\t\t<big>", big, "</big>\n"
+			"\t\t</group>\n"
+			"\t</blist>\n"
+			"</purple>\n", NULL);
+	g_free(big);
+
+	fail_unless(xmlnode_write(node, TRUE, write_to_gstring, str));
+	assert_string_equal(expected, str->str);
+
+	assert_string_equal_free(expected, xmlnode_to_formatted_str(node, &len));
+	assert_int_equal((int)strlen(expected), len);
+
+	g_free(expected);
+	g_string_free(str, TRUE);
+	xmlnode_free(node);
+}
+END_TEST
+
 Suite *
 xmlnode_suite(void)
 {
@@ -28,6 +93,8 @@ xmlnode_suite(void)
 
 	TCase *tc = tcase_create("xmlnode");
 	tcase_add_test(tc, test_xmlnode_billion_laughs_attack);
+	tcase_add_test(tc, test_xmlnode_to_str_escaping);
+	tcase_add_test(tc, test_xmlnode_write_formatted);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -0,0 +1,153 @@
+#include <string.h>
+
+#include "tests.h"
+#include "../protocols/zephyr/internal.h"
+
+#define QUEUE_COUNT 1000
+
+static void
+make_uid(ZUnique_Id_t *uid, long usec)
+{
+	memset(uid, 0, sizeof(*uid));
+	uid->zuid_addr.s_addr = htonl(0x7f000001);
+	uid->tv.tv_sec = 1000000000;
+	uid->tv.tv_usec = usec;
+}
+
+static void
+make_entry(struct _Z_InputQ *qptr, long usec, ZNotice_Kind_t kind)
+{
+	memset(qptr, 0, sizeof(*qptr));
+	make_uid(&qptr->uid, usec);
+	qptr->kind = kind;
+}
+
+START_TEST(test_zephyr_filter_uid)
+{
+	ZUnique_Id_t uid, other;
+	time_t now = 1000;
+
+	make_uid(&uid, 1);
+	make_uid(&other, 2);
+
+	/* Inserted the first time, found after that */
+	assert_int_equal(0, Z_FilterUID(&uid, ACKED, now));
+	assert_int_equal(1, Z_FilterUID(&uid, ACKED, now));
+	assert_int_equal(0, Z_FilterUID(&uid, UNACKED, now));
+	assert_int_equal(0, Z_FilterUID(&other, ACKED, now + 10));
+	assert_int_equal(1, Z_FilterUID(&other, ACKED, now + 10));
+
+	/* Kept for the clock skew, and aged out in arrival order after it */
+	assert_int_equal(1, Z_FilterUID(&uid, ACKED, now + CLOCK_SKEW));
+	assert_int_equal(0, Z_FilterUID(&uid, ACKED, now + CLOCK_SKEW + 1));
+	assert_int_equal(1, Z_FilterUID(&other, ACKED, now + CLOCK_SKEW + 1));
+	assert_int_equal(0, Z_FilterUID(&other, ACKED, now + CLOCK_SKEW + 11));
+
+	/* The uid inserted again is aged from its new arrival */
+	assert_int_equal(1, Z_FilterUID(&uid, ACKED, now + 2 * CLOCK_SKEW + 1));
+	assert_int_equal(0, Z_FilterUID(&uid, UNACKED, now + 2 * CLOCK_SKEW + 1));
+}
+END_TEST
+
+START_TEST(test_zephyr_queue_index)
+{
+	struct _Z_InputQ entry, other;
+	ZUnique_Id_t uid;
+
+	make_entry(&entry, 1, UNACKED);
+	make_entry(&other, 2, UNACKED);
+	make_uid(&uid, 1);
+
+	fail_unless(Z_LookupQueue(&uid, UNACKED) == NULL);
+
+	Z_IndexQueue(&entry);
+	Z_IndexQueue(&other);
+	fail_unless(Z_LookupQueue(&uid, UNACKED) == &entry);
+	fail_unless(Z_LookupQueue(&uid, ACKED) == NULL);
+	fail_unless(Z_LookupQueue(&other.uid, UNACKED) == &other);
+
+	Z_UnindexQueue(&entry);
+	fail_unless(Z_LookupQueue(&uid, UNACKED) == NULL);
+	fail_unless(Z_LookupQueue(&other.uid, UNACKED) == &other);
+
+	/* Removing an entry twice leaves the index alone */
+	Z_UnindexQueue(&entry);
+	fail_unless(Z_LookupQueue(&other.uid, UNACKED) == &other);
+
+	Z_UnindexQueue(&other);
+	fail_unless(Z_LookupQueue(&other.uid, UNACKED) == NULL);
+}
+END_TEST
+
+START_TEST(test_zephyr_queue_index_stale)
+{
+	struct _Z_InputQ *stale, *entry;
+	ZUnique_Id_t uid;
+
+	stale = g_new(struct _Z_InputQ, 1);
+	entry = g_new(struct _Z_InputQ, 1);
+	make_entry(stale, 1, UNACKED);
+	make_entry(entry, 1, UNACKED);
+	make_uid(&uid, 1);
+
+	/* A newer entry for the same multiuid takes over the index, and the
+	 * older one can be removed and freed without disturbing it */
+	Z_IndexQueue(stale);
+	Z_IndexQueue(entry);
+	fail_unless(Z_LookupQueue(&uid, UNACKED) == entry);
+	Z_UnindexQueue(stale);
+	g_free(stale);
+	fail_unless(Z_LookupQueue(&uid, UNACKED) == entry);
+
+	Z_UnindexQueue(entry);
+	fail_unless(Z_LookupQueue(&uid, UNACKED) == NULL);
+	g_free(entry);
+}
+END_TEST
+
+START_TEST(test_zephyr_queue_index_many)
+{
+	static struct _Z_InputQ entries[QUEUE_COUNT];
+	int i;
+
+	for (i = 0; i < QUEUE_COUNT; i++) {
+		make_entry(&entries[i], i, i % 2 ? ACKED : UNACKED);
+		Z_IndexQueue(&entries[i]);
+	}
+
+	for (i = 0; i < QUEUE_COUNT; i += 2)
+		Z_UnindexQueue(&entries[i]);
+
+	for (i = 0; i < QUEUE_COUNT; i++) {
+		ZUnique_Id_t uid;
+
+		make_uid(&uid, i);
+		if (i % 2) {
+			fail_unless(Z_LookupQueue(&uid, ACKED) == &entries[i]);
+			fail_unless(Z_LookupQueue(&uid, UNACKED) == NULL);
+		} else
+			fail_unless(Z_LookupQueue(&uid, UNACKED) == NULL);
+	}
+
+	for (i = 1; i < QUEUE_COUNT; i += 2)
+		Z_UnindexQueue(&entries[i]);
+}
+END_TEST
+
+Suite *
+zephyr_suite(void)
+{
+	Suite *s = suite_create("Zephyr");
+
+	TCase *tc = tcase_create("UID Filter");
+	tcase_add_test(tc, test_zephyr_filter_uid);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("Queue Index");
+	tcase_add_test(tc, test_zephyr_queue_index);
+	tcase_add_test(tc, test_zephyr_queue_index_stale);
+	tcase_add_test(tc, test_zephyr_queue_index_many);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
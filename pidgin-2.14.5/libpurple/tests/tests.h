@@ -9,13 +9,18 @@
 /* remember to add the suite to the runner in check_libpurple.c */
 Suite * master_suite(void);
 Suite * cipher_suite(void);
+Suite * dbus_server_suite(void);
+Suite * dnsquery_suite(void);
 Suite * jabber_caps_suite(void);
 Suite * jabber_digest_md5_suite(void);
 Suite * jabber_jutil_suite(void);
 Suite * jabber_scram_suite(void);
+Suite * log_suite(void);
 Suite * oscar_util_suite(void);
+Suite * pounce_suite(void);
 Suite * util_suite(void);
 Suite * xmlnode_suite(void);
+Suite * zephyr_suite(void);
 
 /* helper macros */
 #define assert_int_equal(expected, actual) { \
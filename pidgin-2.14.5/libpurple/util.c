@@ -39,10 +39,14 @@
 #define DEFAULT_MAX_HTTP_DOWNLOAD (512 * 1024)
 
 #define MAX_HTTP_CHUNK_SIZE (10 * 1024 * 1024)
+#define URL_FETCH_READ_SIZE 4096
+#define URL_FETCH_IDLE_TIMEOUT 30
+#define URL_FETCH_MAX_IDLE 4
 
 struct _PurpleUtilFetchUrlData
 {
 	PurpleUtilFetchUrlCallback callback;
+	PurpleUtilFetchUrlStreamCallback stream_callback;
 	void *user_data;
 
 	struct
@@ -70,17 +74,41 @@ struct _PurpleUtilFetchUrlData
 	PurpleProxyConnectData *connect_data;
 	int fd;
 	guint inpa;
+	char *pool_key;         /* NULL if the connection is not kept alive */
+	gboolean reused;        /* the connection came from the idle pool */
+	gboolean keepalive;     /* the connection can go back to the pool */
 
 	gboolean got_headers;
+	gsize header_scan;      /* where to look for the end of the headers */
 	gboolean has_explicit_data_len;
 	char *webdata;
+	gsize webdata_size;     /* allocated size of webdata */
 	gsize len;
+	gsize streamed;         /* body bytes already given to stream_callback */
 	unsigned long data_len;
 	gsize max_len;
 	gboolean chunked;
+	gsize chunk_scan;       /* start of the first chunk not yet seen whole */
 	PurpleAccount *account;
 };
 
+/*
+ * Connections that served a complete response to an HTTP/1.1 GET are
+ * kept open for a while and picked up by the next request to the same
+ * server.  They are keyed by everything deciding how a connection is
+ * made: scheme, host, port, account and proxy.
+ */
+typedef struct
+{
+	char *key;
+	int fd;
+	PurpleSslConnection *ssl_connection;
+	guint inpa;
+	guint timeout;
+} PurpleUtilFetchUrlIdle;
+
+static GHashTable *url_fetch_idle = NULL; /* key -> GList of PurpleUtilFetchUrlIdle */
+
 static char *custom_user_dir = NULL;
 static char *user_dir = NULL;
 
@@ -947,6 +975,19 @@ gchar *purple_markup_escape_text(const gchar *text, gssize length)
 	return g_string_free(str, FALSE);
 }
 
+/*
+ * The markup functions below spend most of their time on ordinary text,
+ * which they copy a byte at a time while checking it for tags, entities
+ * and the like.  Instead, they find the next byte which needs a closer
+ * look with strcspn() over these sets and copy everything before it in
+ * one go.  The C libraries we build against vectorize strcspn(), so this
+ * gets SIMD scanning where the CPU has it without any code of our own.
+ */
+#define MARKUP_SPECIAL_CHARS        "<&"
+#define MARKUP_STRIP_SPECIAL_CHARS  "<& \t\n\v\f\r"
+/* The first bytes of everything purple_markup_linkify() looks for. */
+#define MARKUP_LINKIFY_SPECIAL_CHARS "<()@hHfFsSwWxXmM"
+
 const char *
 purple_markup_unescape_entity(const char *text, int *length)
 {
@@ -1856,13 +1897,16 @@ purple_markup_html_to_xhtml(const char *html, char **xhtml_out,
 				cdata = g_string_append_len(cdata, c, len);
 			c += len;
 		} else {
+			/* Everything up to the next tag or entity is copied as is. */
+			gsize len = strcspn(c, MARKUP_SPECIAL_CHARS);
+
 			if(xhtml)
-				xhtml = g_string_append_c(xhtml, *c);
+				xhtml = g_string_append_len(xhtml, c, len);
 			if(plain)
-				plain = g_string_append_c(plain, *c);
+				plain = g_string_append_len(plain, c, len);
 			if(cdata)
-				cdata = g_string_append_c(cdata, *c);
-			c++;
+				cdata = g_string_append_len(cdata, c, len);
+			c += len;
 		}
 	}
 	if(xhtml) {
@@ -1911,6 +1955,21 @@ purple_markup_strip_html(const char *str)
 
 	for (i = 0, j = 0; str2[i]; i++)
 	{
+		int run = strcspn(str2 + i, cdata_close_tag ? "<" : MARKUP_STRIP_SPECIAL_CHARS);
+
+		if (run > 0)
+		{
+			/* Plain visible text, or the insides of a CDATA element. */
+			if (!cdata_close_tag)
+			{
+				memmove(str2 + j, str2 + i, run);
+				j += run;
+				visible = TRUE;
+			}
+			i += run - 1;
+			continue;
+		}
+
 		if (str2[i] == '<')
 		{
 			if (cdata_close_tag)
@@ -2164,6 +2223,15 @@ purple_markup_linkify(const char *text)
 
 	c = text;
 	while (*c) {
+		/* Skip ahead to the next byte that could start a tag or a link,
+		 * or end a tag or quoted attribute. */
+		gsize run = strcspn(c, inside_html ? ">\"'" : MARKUP_LINKIFY_SPECIAL_CHARS);
+
+		if (run > 0) {
+			ret = g_string_append_len(ret, c, run);
+			c += run;
+			continue;
+		}
 
 		if(*c == '(' && !inside_html) {
 			inside_paren++;
@@ -2342,8 +2410,9 @@ char *purple_unescape_text(const char *in)
             g_string_append(ret, ent);
             c += len;
         } else {
-            g_string_append_c(ret, *c);
-            c++;
+            len = strcspn(c + 1, "&") + 1;
+            g_string_append_len(ret, c, len);
+            c += len;
         }
     }
 
@@ -2370,8 +2439,9 @@ char *purple_unescape_html(const char *html)
 			g_string_append_c(ret, '\n');
 			c += 4;
 		} else {
-			g_string_append_c(ret, *c);
-			c++;
+			len = strcspn(c + 1, MARKUP_SPECIAL_CHARS) + 1;
+			g_string_append_len(ret, c, len);
+			c += len;
 		}
 	}
 
@@ -2542,18 +2612,15 @@ int purple_build_dir (const char *path, int mode)
 }
 
 /*
- * This function is long and beautiful, like my--um, yeah.  Anyway,
- * it includes lots of error checking so as we don't overwrite
- * people's settings if there is a problem writing the new values.
+ * Returns the full path of a file in the user directory, creating the
+ * directory if needed, or NULL if that fails.
  */
-gboolean
-purple_util_write_data_to_file(const char *filename, const char *data, gssize size)
+static gchar *
+purple_util_user_file_path(const char *filename)
 {
 	const char *user_dir = purple_user_dir();
-	gchar *filename_full;
-	gboolean ret = FALSE;
 
-	g_return_val_if_fail(user_dir != NULL, FALSE);
+	g_return_val_if_fail(user_dir != NULL, NULL);
 
 	purple_debug_info("util", "Writing file %s to directory %s\n",
 					filename, user_dir);
@@ -2565,11 +2632,22 @@ purple_util_write_data_to_file(const char *filename, const char *data, gssize si
 		{
 			purple_debug_error("util", "Error creating directory %s: %s\n",
 							 user_dir, g_strerror(errno));
-			return FALSE;
+			return NULL;
 		}
 	}
 
-	filename_full = g_strdup_printf("%s" G_DIR_SEPARATOR_S "%s", user_dir, filename);
+	return g_strdup_printf("%s" G_DIR_SEPARATOR_S "%s", user_dir, filename);
+}
+
+gboolean
+purple_util_write_data_to_file(const char *filename, const char *data, gssize size)
+{
+	gchar *filename_full;
+	gboolean ret = FALSE;
+
+	filename_full = purple_util_user_file_path(filename);
+	if (filename_full == NULL)
+		return FALSE;
 
 	ret = purple_util_write_data_to_file_absolute(filename_full, data, size);
 
@@ -2577,12 +2655,26 @@ purple_util_write_data_to_file(const char *filename, const char *data, gssize si
 	return ret;
 }
 
-gboolean
-purple_util_write_data_to_file_absolute(const char *filename_full, const char *data, gssize size)
+/*
+ * Writes the contents of a file.  Returns FALSE if not everything could
+ * be written; *written is set to the number of bytes actually written.
+ */
+typedef gboolean (*PurpleUtilFileWriteFunc)(FILE *file, gpointer user_data,
+		size_t *written);
+
+/*
+ * This function is long and beautiful, like my--um, yeah.  Anyway,
+ * it includes lots of error checking so as we don't overwrite
+ * people's settings if there is a problem writing the new values.
+ */
+static gboolean
+purple_util_write_file_absolute(const char *filename_full,
+		PurpleUtilFileWriteFunc write_func, gpointer user_data)
 {
 	gchar *filename_temp;
 	FILE *file;
-	size_t real_size, byteswritten;
+	size_t byteswritten = 0;
+	gboolean complete;
 	struct stat st;
 #ifndef HAVE_FILENO
 	int fd;
@@ -2591,8 +2683,6 @@ purple_util_write_data_to_file_absolute(const char *filename_full, const char *d
 	purple_debug_info("util", "Writing file %s\n",
 					filename_full);
 
-	g_return_val_if_fail((size >= -1), FALSE);
-
 	filename_temp = g_strdup_printf("%s.save", filename_full);
 
 	/* Remove an old temporary file, if one exists */
@@ -2618,8 +2708,7 @@ purple_util_write_data_to_file_absolute(const char *filename_full, const char *d
 	}
 
 	/* Write to file */
-	real_size = (size == -1) ? strlen(data) : (size_t) size;
-	byteswritten = fwrite(data, 1, real_size, file);
+	complete = write_func(file, user_data, &byteswritten);
 
 #ifdef HAVE_FILENO
 #ifndef _WIN32
@@ -2692,13 +2781,11 @@ purple_util_write_data_to_file_absolute(const char *filename_full, const char *d
 #endif
 
 	/* Ensure the file is the correct size */
-	if (byteswritten != real_size)
+	if (!complete)
 	{
-		purple_debug_error("util", "Error writing to file %s: Wrote %"
-				   G_GSIZE_FORMAT " bytes "
-				   "but should have written %" G_GSIZE_FORMAT
-				   "; is your disk full?\n",
-				   filename_temp, byteswritten, real_size);
+		purple_debug_error("util", "Error writing to file %s: Wrote only %"
+				   G_GSIZE_FORMAT " bytes; is your disk full?\n",
+				   filename_temp, byteswritten);
 		g_free(filename_temp);
 		return FALSE;
 	}
@@ -2707,7 +2794,7 @@ purple_util_write_data_to_file_absolute(const char *filename_full, const char *d
 	 * It causes TOCTOU coverity warning (against g_rename below),
 	 * but it's not a threat for us.
 	 */
-	if ((g_stat(filename_temp, &st) == -1) || ((gsize)st.st_size != real_size))
+	if ((g_stat(filename_temp, &st) == -1) || ((gsize)st.st_size != byteswritten))
 	{
 		purple_debug_error("util", "Error writing data to file %s: "
 				   "Incomplete file written; is your disk "
@@ -2731,6 +2818,85 @@ purple_util_write_data_to_file_absolute(const char *filename_full, const char *d
 	return TRUE;
 }
 
+struct _purple_util_data {
+	const char *data;
+	size_t size;
+};
+
+static gboolean
+purple_util_write_data_cb(FILE *file, gpointer user_data, size_t *written)
+{
+	struct _purple_util_data *data = user_data;
+
+	*written = fwrite(data->data, 1, data->size, file);
+
+	return *written == data->size;
+}
+
+gboolean
+purple_util_write_data_to_file_absolute(const char *filename_full, const char *data, gssize size)
+{
+	struct _purple_util_data file_data;
+
+	g_return_val_if_fail((size >= -1), FALSE);
+
+	file_data.data = data;
+	file_data.size = (size == -1) ? strlen(data) : (size_t) size;
+
+	return purple_util_write_file_absolute(filename_full,
+			purple_util_write_data_cb, &file_data);
+}
+
+struct _purple_util_xml_sink {
+	FILE *file;
+	size_t written;
+};
+
+static gboolean
+purple_util_xml_sink_write(const char *data, gsize len, gpointer user_data)
+{
+	struct _purple_util_xml_sink *sink = user_data;
+	size_t written = fwrite(data, 1, len, sink->file);
+
+	sink->written += written;
+
+	return written == len;
+}
+
+static gboolean
+purple_util_write_xml_cb(FILE *file, gpointer user_data, size_t *written)
+{
+	struct _purple_util_xml_sink sink;
+	gboolean ret;
+
+	sink.file = file;
+	sink.written = 0;
+
+	ret = xmlnode_write(user_data, TRUE, purple_util_xml_sink_write, &sink);
+	*written = sink.written;
+
+	return ret;
+}
+
+gboolean
+purple_util_write_xml_to_file(const char *filename, const xmlnode *node)
+{
+	gchar *filename_full;
+	gboolean ret;
+
+	g_return_val_if_fail(node != NULL, FALSE);
+
+	filename_full = purple_util_user_file_path(filename);
+	if (filename_full == NULL)
+		return FALSE;
+
+	ret = purple_util_write_file_absolute(filename_full,
+			purple_util_write_xml_cb, (gpointer)node);
+
+	g_free(filename_full);
+	return ret;
+}
+
 xmlnode *
 purple_util_read_xml_from_file(const char *filename, const char *description)
 {
@@ -3609,6 +3775,254 @@ purple_util_fetch_url_error(PurpleUtilFetchUrlData *gfud, const char *format, ..
 static void url_fetch_connect_cb(gpointer url_data, gint source, const gchar *error_message);
 static void ssl_url_fetch_connect_cb(gpointer data, PurpleSslConnection *ssl_connection, PurpleInputCondition cond);
 static void ssl_url_fetch_error_cb(PurpleSslConnection *ssl_connection, PurpleSslErrorType error, gpointer data);
+static void url_fetch_send_cb(gpointer data, gint source, PurpleInputCondition cond);
+
+static char *
+url_fetch_pool_key(PurpleUtilFetchUrlData *gfud)
+{
+	PurpleProxyInfo *gpi = purple_proxy_get_setup(gfud->account);
+
+	return g_strdup_printf("%s://%s:%d %p %d %s:%d",
+			gfud->is_ssl ? "https" : "http",
+			gfud->website.address ? gfud->website.address : "",
+			gfud->website.port, (void *)gfud->account,
+			gpi ? purple_proxy_info_get_type(gpi) : PURPLE_PROXY_NONE,
+			(gpi && purple_proxy_info_get_host(gpi)) ? purple_proxy_info_get_host(gpi) : "",
+			gpi ? purple_proxy_info_get_port(gpi) : 0);
+}
+
+static void
+url_fetch_idle_free(PurpleUtilFetchUrlIdle *idle, gboolean close_connection)
+{
+	if (idle->timeout > 0)
+		purple_timeout_remove(idle->timeout);
+
+	if (idle->ssl_connection != NULL) {
+		if (idle->ssl_connection->inpa > 0) {
+			purple_input_remove(idle->ssl_connection->inpa);
+			idle->ssl_connection->inpa = 0;
+		}
+		if (close_connection)
+			purple_ssl_close(idle->ssl_connection);
+	} else {
+		if (idle->inpa > 0)
+			purple_input_remove(idle->inpa);
+		if (close_connection)
+			close(idle->fd);
+	}
+
+	g_free(idle->key);
+	g_free(idle);
+}
+
+static void
+url_fetch_idle_remove(PurpleUtilFetchUrlIdle *idle)
+{
+	GList *idles = g_hash_table_lookup(url_fetch_idle, idle->key);
+
+	idles = g_list_remove(idles, idle);
+	if (idles != NULL)
+		g_hash_table_replace(url_fetch_idle, g_strdup(idle->key), idles);
+	else
+		g_hash_table_remove(url_fetch_idle, idle->key);
+
+	url_fetch_idle_free(idle, TRUE);
+}
+
+static gboolean
+url_fetch_idle_timeout_cb(gpointer data)
+{
+	PurpleUtilFetchUrlIdle *idle = data;
+
+	idle->timeout = 0;
+	url_fetch_idle_remove(idle);
+
+	return FALSE;
+}
+
+/* An idle connection only becomes readable when the server closes it
+ * (or misbehaves), either way it can't be used any more. */
+static void
+url_fetch_idle_input_cb(gpointer data, gint source, PurpleInputCondition cond)
+{
+	url_fetch_idle_remove(data);
+}
+
+static void
+url_fetch_idle_ssl_input_cb(gpointer data, PurpleSslConnection *ssl_connection,
+		PurpleInputCondition cond)
+{
+	url_fetch_idle_remove(data);
+}
+
+/* Hands the connection of a finished request over to the idle pool */
+static void
+url_fetch_release_connection(PurpleUtilFetchUrlData *gfud)
+{
+	PurpleUtilFetchUrlIdle *idle;
+	GList *idles;
+
+	if (url_fetch_idle == NULL)
+		url_fetch_idle = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	idles = g_hash_table_lookup(url_fetch_idle, gfud->pool_key);
+	if (g_list_length(idles) >= URL_FETCH_MAX_IDLE)
+		return;
+
+	if (gfud->inpa > 0) {
+		purple_input_remove(gfud->inpa);
+		gfud->inpa = 0;
+	}
+
+	idle = g_new0(PurpleUtilFetchUrlIdle, 1);
+	idle->key = g_strdup(gfud->pool_key);
+	idle->fd = -1;
+
+	if (gfud->is_ssl) {
+		idle->ssl_connection = gfud->ssl_connection;
+		gfud->ssl_connection = NULL;
+		if (idle->ssl_connection->inpa > 0) {
+			purple_input_remove(idle->ssl_connection->inpa);
+			idle->ssl_connection->inpa = 0;
+		}
+		purple_ssl_input_add(idle->ssl_connection, url_fetch_idle_ssl_input_cb, idle);
+	} else {
+		idle->fd = gfud->fd;
+		gfud->fd = -1;
+		idle->inpa = purple_input_add(idle->fd, PURPLE_INPUT_READ,
+				url_fetch_idle_input_cb, idle);
+	}
+	idle->timeout = purple_timeout_add_seconds(URL_FETCH_IDLE_TIMEOUT,
+			url_fetch_idle_timeout_cb, idle);
+
+	g_hash_table_replace(url_fetch_idle, g_strdup(gfud->pool_key),
+			g_list_prepend(idles, idle));
+}
+
+/* Takes the most recently used idle connection for key out of the pool */
+static PurpleUtilFetchUrlIdle *
+url_fetch_take_connection(const char *key)
+{
+	PurpleUtilFetchUrlIdle *idle;
+	GList *idles;
+
+	if (url_fetch_idle == NULL ||
+			(idles = g_hash_table_lookup(url_fetch_idle, key)) == NULL)
+		return NULL;
+
+	idle = idles->data;
+	idles = g_list_delete_link(idles, idles);
+	if (idles != NULL)
+		g_hash_table_replace(url_fetch_idle, g_strdup(key), idles);
+	else
+		g_hash_table_remove(url_fetch_idle, key);
+
+	return idle;
+}
+
+void
+_purple_util_fetch_url_close_idle(void)
+{
+	GHashTableIter iter;
+	gpointer idles;
+
+	if (url_fetch_idle == NULL)
+		return;
+
+	g_hash_table_iter_init(&iter, url_fetch_idle);
+	while (g_hash_table_iter_next(&iter, NULL, &idles)) {
+		GList *l;
+
+		for (l = idles; l != NULL; l = l->next)
+			url_fetch_idle_free(l->data, TRUE);
+		g_list_free(idles);
+	}
+
+	g_hash_table_destroy(url_fetch_idle);
+	url_fetch_idle = NULL;
+}
+
+/*
+ * Starts connecting to gfud->website, or with reuse set, takes a
+ * connection to it from the idle pool if there is one.  Returns FALSE
+ * if no connection attempt could be started.
+ */
+static gboolean
+url_fetch_connect(PurpleUtilFetchUrlData *gfud, gboolean reuse)
+{
+	gfud->reused = FALSE;
+
+	if (reuse) {
+		PurpleUtilFetchUrlIdle *idle;
+
+		/* Only requests we build ourselves ask to keep the connection */
+		g_free(gfud->pool_key);
+		gfud->pool_key = (gfud->request == NULL && gfud->http11) ?
+				url_fetch_pool_key(gfud) : NULL;
+
+		if (gfud->pool_key != NULL &&
+				(idle = url_fetch_take_connection(gfud->pool_key)) != NULL) {
+			int fd;
+
+			purple_debug_misc("util", "Reusing a connection to %s\n",
+					gfud->website.address);
+
+			gfud->reused = TRUE;
+			gfud->ssl_connection = idle->ssl_connection;
+			gfud->fd = idle->fd;
+			url_fetch_idle_free(idle, FALSE);
+
+			/* Errors on the connection still go to the request that
+			 * opened it, which is long gone */
+			if (gfud->ssl_connection != NULL)
+				gfud->ssl_connection->connect_cb_data = gfud;
+
+			fd = gfud->is_ssl ? gfud->ssl_connection->fd : gfud->fd;
+			gfud->inpa = purple_input_add(fd, PURPLE_INPUT_WRITE,
+					url_fetch_send_cb, gfud);
+			return TRUE;
+		}
+	}
+
+	if (gfud->is_ssl) {
+		gfud->ssl_connection = purple_ssl_connect(gfud->account,
+				gfud->website.address, gfud->website.port,
+				ssl_url_fetch_connect_cb, ssl_url_fetch_error_cb, gfud);
+	} else {
+		gfud->connect_data = purple_proxy_connect(NULL, gfud->account,
+				gfud->website.address, gfud->website.port,
+				url_fetch_connect_cb, gfud);
+	}
+
+	return gfud->ssl_connection != NULL || gfud->connect_data != NULL;
+}
+
+/* A pooled connection may have been closed by the server just as we
+ * started using it, in which case the request is made again on a new one. */
+static void
+url_fetch_reconnect(PurpleUtilFetchUrlData *gfud)
+{
+	purple_debug_info("util", "Reused connection to %s failed, reconnecting\n",
+			gfud->website.address);
+
+	if (gfud->inpa > 0) {
+		purple_input_remove(gfud->inpa);
+		gfud->inpa = 0;
+	}
+
+	if (gfud->is_ssl) {
+		purple_ssl_close(gfud->ssl_connection);
+		gfud->ssl_connection = NULL;
+	} else {
+		close(gfud->fd);
+		gfud->fd = -1;
+	}
+	gfud->request_written = 0;
+
+	if (!url_fetch_connect(gfud, FALSE))
+		purple_util_fetch_url_error(gfud, _("Unable to connect to %s"),
+				gfud->website.address);
+}
 
 static gboolean
 parse_redirect(const char *data, gsize data_len,
@@ -3687,8 +4101,10 @@ parse_redirect(const char *data, gsize data_len,
 		gfud->fd = -1;
 	}
 	gfud->request_written = 0;
+	gfud->header_scan = 0;
 	gfud->len = 0;
 	gfud->data_len = 0;
+	gfud->keepalive = FALSE;
 
 	g_free(gfud->website.user);
 	g_free(gfud->website.passwd);
@@ -3697,18 +4113,10 @@ parse_redirect(const char *data, gsize data_len,
 	purple_url_parse(new_url, &gfud->website.address, &gfud->website.port,
 				   &gfud->website.page, &gfud->website.user, &gfud->website.passwd);
 
-	if (purple_strcasestr(new_url, "https://") != NULL) {
+	if (purple_strcasestr(new_url, "https://") != NULL)
 		gfud->is_ssl = TRUE;
-		gfud->ssl_connection = purple_ssl_connect(gfud->account,
-				gfud->website.address, gfud->website.port,
-				ssl_url_fetch_connect_cb, ssl_url_fetch_error_cb, gfud);
-	} else {
-		gfud->connect_data = purple_proxy_connect(NULL, gfud->account,
-				gfud->website.address, gfud->website.port,
-				url_fetch_connect_cb, gfud);
-	}
 
-	if (gfud->ssl_connection == NULL && gfud->connect_data == NULL)
+	if (!url_fetch_connect(gfud, TRUE))
 	{
 		purple_util_fetch_url_error(gfud, _("Unable to connect to %s"),
 				gfud->website.address);
@@ -3747,22 +4155,43 @@ find_header_content(const char *data, gsize data_len, const char *header)
 	return NULL;
 }
 
-static gsize
-parse_content_len(const char *data, gsize data_len)
+/* Returns FALSE if there is no valid Content-Length header, an explicit
+ * length of zero still being a length. */
+static gboolean
+parse_content_len(const char *data, gsize data_len, gsize *content_len)
 {
-	gsize content_len = 0;
 	const char *p = NULL;
 
+	*content_len = 0;
+
 	p = find_header_content(data, data_len, "\nContent-Length: ");
 	if (p) {
-		if (sscanf(p, "%" G_GSIZE_FORMAT, &content_len) != 1) {
+		if (sscanf(p, "%" G_GSIZE_FORMAT, content_len) != 1) {
 			purple_debug_warning("util", "invalid number format\n");
-			content_len = 0;
+			*content_len = 0;
+			return FALSE;
 		}
-		purple_debug_misc("util", "parsed %" G_GSIZE_FORMAT "\n", content_len);
+		purple_debug_misc("util", "parsed %" G_GSIZE_FORMAT "\n", *content_len);
+		return TRUE;
 	}
 
-	return content_len;
+	return FALSE;
+}
+
+/* Whether the response to our request has no body, whatever its headers
+ * say: responses to HEAD requests, and 204 and 304 responses. */
+static gboolean
+response_has_no_body(PurpleUtilFetchUrlData *gfud, const char *data)
+{
+	int status;
+
+	if (gfud->request != NULL && g_ascii_strncasecmp(gfud->request, "HEAD ", 5) == 0)
+		return TRUE;
+
+	if (sscanf(data, "HTTP/%*d.%*d %d", &status) != 1)
+		return FALSE;
+
+	return status == 204 || status == 304;
 }
 
 static gboolean
@@ -3775,6 +4204,62 @@ content_is_chunked(const char *data, gsize data_len)
 	return FALSE;
 }
 
+static gboolean
+connection_is_kept_alive(const char *data, gsize data_len)
+{
+	const char *p;
+
+	if (data_len < 8 || strncmp(data, "HTTP/1.1", 8) != 0)
+		return FALSE;
+
+	p = find_header_content(data, data_len, "\nConnection: ");
+	if (p && g_ascii_strncasecmp(p, "close", 5) == 0)
+		return FALSE;
+
+	return TRUE;
+}
+
+/*
+ * Returns TRUE once a chunked body has been received up to and including
+ * its last chunk.  Whole chunks are skipped for the next call.  This is
+ * only needed when the server keeps the connection open afterwards.
+ */
+static gboolean
+url_fetch_chunked_complete(PurpleUtilFetchUrlData *gfud)
+{
+	while (TRUE) {
+		char *line = gfud->webdata + gfud->chunk_scan;
+		gsize avail = gfud->len - gfud->chunk_scan;
+		char *eol = g_strstr_len(line, avail, "\r\n");
+		char *end;
+		gsize sz;
+
+		if (eol == NULL)
+			return FALSE;
+
+		if (sscanf(line, "%" G_GSIZE_MODIFIER "x", &sz) != 1 ||
+				sz > MAX_HTTP_CHUNK_SIZE) {
+			/* Let process_chunked_data() complain about it */
+			gfud->keepalive = FALSE;
+			return TRUE;
+		}
+
+		if (sz == 0) {
+			/* The last chunk may be followed by trailers */
+			end = g_strstr_len(eol, gfud->len - (eol - gfud->webdata), "\r\n\r\n");
+			if (end == NULL)
+				return FALSE;
+			if (end + 4 != gfud->webdata + gfud->len)
+				gfud->keepalive = FALSE;
+			return TRUE;
+		}
+
+		if (avail < (gsize)(eol + 2 - line) + sz + 2)
+			return FALSE;
+		gfud->chunk_scan += (eol + 2 - line) + sz + 2;
+	}
+}
+
 /* Process in-place */
 static void
 process_chunked_data(char *data, gsize *len)
@@ -3835,13 +4320,57 @@ process_chunked_data(char *data, gsize *len)
 	*len = newlen;
 }
 
+/*
+ * Resizes gfud->webdata to hold size bytes.  On failure the fetch is
+ * cancelled with an error and FALSE is returned.
+ */
+static gboolean
+url_fetch_resize(PurpleUtilFetchUrlData *gfud, gsize size)
+{
+	char *new_data = g_try_realloc(gfud->webdata, size);
+
+	if (new_data == NULL) {
+		purple_debug_error("util",
+				"Failed to allocate %" G_GSIZE_FORMAT " bytes: %s\n",
+				size, g_strerror(errno));
+		purple_util_fetch_url_error(gfud,
+				_("Unable to allocate enough memory to hold "
+				  "the contents from %s.  The web server may "
+				  "be trying something malicious."),
+				gfud->website.address);
+		return FALSE;
+	}
+
+	gfud->webdata = new_data;
+	gfud->webdata_size = size;
+	return TRUE;
+}
+
+/*
+ * Makes room for at least need more bytes and a terminating NUL in
+ * gfud->webdata.  The buffer is doubled when it grows, so a response of
+ * unknown length is not reallocated for every read.
+ */
+static gboolean
+url_fetch_reserve(PurpleUtilFetchUrlData *gfud, gsize need)
+{
+	gsize size;
+
+	if (gfud->len + need < gfud->webdata_size)
+		return TRUE;
+
+	size = MAX(gfud->webdata_size, URL_FETCH_READ_SIZE);
+	while (size <= gfud->len + need)
+		size *= 2;
+
+	return url_fetch_resize(gfud, size);
+}
+
 static void
 url_fetch_recv_cb(gpointer url_data, gint source, PurpleInputCondition cond)
 {
 	PurpleUtilFetchUrlData *gfud = url_data;
-	int len;
-	char buf[4096];
-	char *data_cursor;
+	int len = 0;
 	gboolean got_eof = FALSE;
 
 	if (!gfud->is_ssl && source < 0) {
@@ -3853,44 +4382,55 @@ url_fetch_recv_cb(gpointer url_data, gint source, PurpleInputCondition cond)
 	/*
 	 * Read data in a loop until we can't read any more!  This is a
 	 * little confusing because we read using a different function
-	 * depending on whether the socket is ssl or cleartext.
+	 * depending on whether the socket is ssl or cleartext.  The data
+	 * is read straight into the end of gfud->webdata.
 	 */
-	while ((gfud->is_ssl && ((len = purple_ssl_read(gfud->ssl_connection, buf, sizeof(buf))) > 0)) ||
-		(!gfud->is_ssl && source >= 0 && (len = read(source, buf, sizeof(buf))) > 0))
+	while (gfud->is_ssl || source >= 0)
 	{
-		if((gfud->len + len) > gfud->max_len) {
-			purple_util_fetch_url_error(gfud, _("Error reading from %s: response too long (%d bytes limit)"),
-						    gfud->website.address, gfud->max_len);
+		gsize room;
+
+		/* With an explicit length the buffer already has room for
+		 * exactly the rest of the response. */
+		if (!gfud->has_explicit_data_len &&
+				!url_fetch_reserve(gfud, URL_FETCH_READ_SIZE))
 			return;
-		}
+		room = gfud->webdata_size - gfud->len - 1;
 
-		/* If we've filled up our buffer, make it bigger */
-		if((gfud->len + len) >= gfud->data_len) {
-			while((gfud->len + len) >= gfud->data_len)
-				gfud->data_len += sizeof(buf);
+		if (gfud->is_ssl)
+			len = purple_ssl_read(gfud->ssl_connection, gfud->webdata + gfud->len, room);
+		else
+			len = read(source, gfud->webdata + gfud->len, room);
 
-			gfud->webdata = g_realloc(gfud->webdata, gfud->data_len);
-		}
+		if (len <= 0)
+			break;
 
-		data_cursor = gfud->webdata + gfud->len;
+		if((gfud->streamed + gfud->len + len) > gfud->max_len) {
+			purple_util_fetch_url_error(gfud, _("Error reading from %s: response too long (%d bytes limit)"),
+						    gfud->website.address, gfud->max_len);
+			return;
+		}
 
 		gfud->len += len;
-
-		memcpy(data_cursor, buf, len);
-
 		gfud->webdata[gfud->len] = '\0';
 
 		if(!gfud->got_headers) {
 			char *end_of_headers;
 
-			/* See if we've reached the end of the headers yet */
-			end_of_headers = strstr(gfud->webdata, "\r\n\r\n");
-			if (end_of_headers) {
+			/* See if we've reached the end of the headers yet.  Only
+			 * the new data (and the three bytes before it, in case the
+			 * terminator was split across reads) needs to be looked at. */
+			end_of_headers = g_strstr_len(gfud->webdata + gfud->header_scan,
+					gfud->len - gfud->header_scan, "\r\n\r\n");
+			if (end_of_headers == NULL)
+				gfud->header_scan = gfud->len > 3 ? gfud->len - 3 : 0;
+			else {
 				guint header_len = (end_of_headers + 4 - gfud->webdata);
 				gsize content_len;
+				gboolean has_content_len;
 
-				purple_debug_misc("util", "Response headers: '%.*s'\n",
-					header_len, gfud->webdata);
+				if (purple_debug_is_active(PURPLE_DEBUG_MISC, "util"))
+					purple_debug_misc("util", "Response headers: '%.*s'\n",
+						header_len, gfud->webdata);
 
 				/* See if we can find a redirect. */
 				if(parse_redirect(gfud->webdata, header_len, gfud))
@@ -3899,83 +4439,96 @@ url_fetch_recv_cb(gpointer url_data, gint source, PurpleInputCondition cond)
 				gfud->got_headers = TRUE;
 
 				/* No redirect. See if we can find a content length. */
-				content_len = parse_content_len(gfud->webdata, header_len);
-				gfud->chunked = content_is_chunked(gfud->webdata, header_len);
-
-				if (content_len == 0) {
-					/* We'll stick with an initial 8192 */
-					content_len = 8192;
+				if (response_has_no_body(gfud, gfud->webdata)) {
+					content_len = 0;
+					has_content_len = TRUE;
+					gfud->chunked = FALSE;
 				} else {
+					has_content_len = parse_content_len(gfud->webdata,
+							header_len, &content_len);
+					gfud->chunked = content_is_chunked(gfud->webdata, header_len);
+				}
+				gfud->chunk_scan = gfud->include_headers ? header_len : 0;
+
+				/* The connection can only be used again if we know
+				 * where the body ends without the server closing it. */
+				gfud->keepalive = gfud->pool_key != NULL &&
+						(has_content_len || gfud->chunked) &&
+						connection_is_kept_alive(gfud->webdata, header_len);
+
+				if (gfud->chunked && gfud->stream_callback != NULL) {
+					purple_util_fetch_url_error(gfud,
+							_("Error reading from %s: %s"),
+							gfud->website.address,
+							_("chunked transfer encoding is not supported here"));
+					return;
+				}
+
+				/* A body that is both chunked and of zero length can
+				 * only be a chunked one */
+				if (has_content_len && (content_len != 0 || !gfud->chunked)) {
 					gfud->has_explicit_data_len = TRUE;
 					if (content_len > gfud->max_len) {
 						purple_debug_error("util",
 								"Overriding explicit Content-Length of %" G_GSIZE_FORMAT " with max of %" G_GSSIZE_FORMAT "\n",
 								content_len, gfud->max_len);
 						content_len = gfud->max_len;
+						gfud->keepalive = FALSE;
 					}
 				}
 
-
 				/* If we're returning the headers too, we don't need to clean them out */
 				if (gfud->include_headers) {
-					char *new_data;
 					gfud->data_len = content_len + header_len;
-					new_data = g_try_realloc(gfud->webdata, gfud->data_len);
-					if (new_data == NULL) {
-						purple_debug_error("util",
-								"Failed to allocate %" G_GSIZE_FORMAT " bytes: %s\n",
-								content_len, g_strerror(errno));
-						purple_util_fetch_url_error(gfud,
-								_("Unable to allocate enough memory to hold "
-								  "the contents from %s.  The web server may "
-								  "be trying something malicious."),
-								gfud->website.address);
-
-						return;
-					}
-					gfud->webdata = new_data;
 				} else {
-					char *new_data;
 					gsize body_len = gfud->len - header_len;
 
-					content_len = MAX(content_len, body_len);
-
-					new_data = g_try_malloc(content_len);
-					if (new_data == NULL) {
-						purple_debug_error("util",
-								"Failed to allocate %" G_GSIZE_FORMAT " bytes: %s\n",
-								content_len, g_strerror(errno));
-						purple_util_fetch_url_error(gfud,
-								_("Unable to allocate enough memory to hold "
-								  "the contents from %s.  The web server may "
-								  "be trying something malicious."),
-								gfud->website.address);
-
-						return;
-					}
+					/* We may have read part of the body when reading the
+					 * headers, don't lose it */
+					memmove(gfud->webdata, gfud->webdata + header_len, body_len + 1);
+					gfud->len = body_len;
+					gfud->data_len = content_len = MAX(content_len, body_len);
+				}
 
-					/* We may have read part of the body when reading the headers, don't lose it */
-					if (body_len > 0) {
-						memcpy(new_data, end_of_headers + 4, body_len);
-					}
+				/* Allocate the whole body at once, unless it is
+				 * handed to the caller piece by piece anyway. */
+				if (gfud->has_explicit_data_len && gfud->stream_callback == NULL &&
+						!url_fetch_resize(gfud, MAX(gfud->data_len, gfud->len) + 1))
+					return;
+			}
+		}
 
-					/* Out with the old... */
-					g_free(gfud->webdata);
+		if (gfud->stream_callback != NULL && gfud->got_headers && gfud->len > 0) {
+			gsize chunk_len = gfud->len;
 
-					/* In with the new. */
-					gfud->len = body_len;
-					gfud->data_len = content_len;
-					gfud->webdata = new_data;
-				}
+			gfud->streamed += chunk_len;
+			gfud->len = 0;
+			if (!gfud->stream_callback(gfud, gfud->user_data, gfud->webdata, chunk_len)) {
+				purple_util_fetch_url_cancel(gfud);
+				return;
 			}
 		}
 
-		if(gfud->has_explicit_data_len && gfud->len >= gfud->data_len) {
+		if(gfud->has_explicit_data_len && (gfud->streamed + gfud->len) >= gfud->data_len) {
+			/* Anything past the body would be a response we never asked for */
+			if ((gfud->streamed + gfud->len) > gfud->data_len)
+				gfud->keepalive = FALSE;
+			got_eof = TRUE;
+			break;
+		}
+
+		if (gfud->chunked && gfud->pool_key != NULL && url_fetch_chunked_complete(gfud)) {
 			got_eof = TRUE;
 			break;
 		}
 	}
 
+	if (gfud->reused && !gfud->got_headers && gfud->len == 0 &&
+			(len == 0 || (len < 0 && errno != EAGAIN))) {
+		url_fetch_reconnect(gfud);
+		return;
+	}
+
 	if(len < 0) {
 		if(errno == EAGAIN) {
 			return;
@@ -3987,10 +4540,26 @@ url_fetch_recv_cb(gpointer url_data, gint source, PurpleInputCondition cond)
 	}
 
 	if((len == 0) || got_eof) {
-		gfud->webdata = g_realloc(gfud->webdata, gfud->len + 1);
+		if (!url_fetch_reserve(gfud, 0))
+			return;
 		gfud->webdata[gfud->len] = '\0';
 
-		if (!gfud->include_headers && gfud->chunked) {
+		/* Before the callback, which may well fetch another URL */
+		if (got_eof && gfud->keepalive)
+			url_fetch_release_connection(gfud);
+
+		if (gfud->stream_callback != NULL) {
+			/* The body has all been streamed by now, so there is
+			 * nothing left to hand over unless the headers never
+			 * ended */
+			if (!gfud->got_headers) {
+				purple_util_fetch_url_error(gfud,
+						_("Error reading from %s: %s"),
+						gfud->website.address,
+						_("response ended inside its headers"));
+				return;
+			}
+		} else if (!gfud->include_headers && gfud->chunked) {
 			/* Process only if we don't want the headers. */
 			process_chunked_data(gfud->webdata, &gfud->len);
 		}
@@ -4029,10 +4598,11 @@ url_fetch_send_cb(gpointer data, gint source, PurpleInputCondition cond)
 		GString *request_str = g_string_new(NULL);
 
 		g_string_append_printf(request_str, "GET %s%s HTTP/%s\r\n"
-						    "Connection: close\r\n",
+						    "Connection: %s\r\n",
 			(gfud->full ? "" : "/"),
 			(gfud->full ? (gfud->url ? gfud->url : "") : (gfud->website.page ? gfud->website.page : "")),
-			(gfud->http11 ? "1.1" : "1.0"));
+			(gfud->http11 ? "1.1" : "1.0"),
+			(gfud->pool_key ? "keep-alive" : "close"));
 
 		if (gfud->user_agent)
 			g_string_append_printf(request_str, "User-Agent: %s\r\n", gfud->user_agent);
@@ -4088,10 +4658,12 @@ url_fetch_send_cb(gpointer data, gint source, PurpleInputCondition cond)
 		gfud->request_len = strlen(gfud->request);
 	}
 
-	if(purple_debug_is_unsafe())
-		purple_debug_misc("util", "Request: '%.*s'\n", (int) gfud->request_len, gfud->request);
-	else
-		purple_debug_misc("util", "request constructed\n");
+	if (purple_debug_is_active(PURPLE_DEBUG_MISC, "util")) {
+		if(purple_debug_is_unsafe())
+			purple_debug_misc("util", "Request: '%.*s'\n", (int) gfud->request_len, gfud->request);
+		else
+			purple_debug_misc("util", "request constructed\n");
+	}
 
 	total_len = gfud->request_len;
 
@@ -4104,7 +4676,10 @@ url_fetch_send_cb(gpointer data, gint source, PurpleInputCondition cond)
 
 	if (len < 0 && errno == EAGAIN)
 		return;
-	else if (len < 0) {
+	else if (len < 0 && gfud->reused) {
+		url_fetch_reconnect(gfud);
+		return;
+	} else if (len < 0) {
 		purple_util_fetch_url_error(gfud, _("Error writing to %s: %s"),
 				gfud->website.address, g_strerror(errno));
 		return;
@@ -4255,16 +4830,9 @@ purple_util_fetch_url_request_data_len_with_account(PurpleAccount *account,
 		}
 
 		gfud->is_ssl = TRUE;
-		gfud->ssl_connection = purple_ssl_connect(account,
-				gfud->website.address, gfud->website.port,
-				ssl_url_fetch_connect_cb, ssl_url_fetch_error_cb, gfud);
-	} else {
-		gfud->connect_data = purple_proxy_connect(NULL, account,
-				gfud->website.address, gfud->website.port,
-				url_fetch_connect_cb, gfud);
 	}
 
-	if (gfud->ssl_connection == NULL && gfud->connect_data == NULL)
+	if (!url_fetch_connect(gfud, TRUE))
 	{
 		purple_util_fetch_url_error(gfud, _("Unable to connect to %s"),
 				gfud->website.address);
@@ -4274,6 +4842,27 @@ purple_util_fetch_url_request_data_len_with_account(PurpleAccount *account,
 	return gfud;
 }
 
+PurpleUtilFetchUrlData *
+purple_util_fetch_url_stream(PurpleAccount *account, const char *url,
+		gboolean full, const char *user_agent, gssize max_len,
+		PurpleUtilFetchUrlStreamCallback stream_callback,
+		PurpleUtilFetchUrlCallback callback, void *user_data)
+{
+	PurpleUtilFetchUrlData *gfud;
+
+	g_return_val_if_fail(stream_callback != NULL, NULL);
+
+	/* HTTP/1.0 keeps the server from using chunked transfer encoding,
+	 * which would have to be undone before handing out the body. */
+	gfud = purple_util_fetch_url_request_data_len_with_account(account, url,
+			full, user_agent, FALSE, NULL, 0, FALSE, max_len, callback,
+			user_data);
+	if (gfud != NULL)
+		gfud->stream_callback = stream_callback;
+
+	return gfud;
+}
+
 void
 purple_util_fetch_url_cancel(PurpleUtilFetchUrlData *gfud)
 {
@@ -4297,6 +4886,7 @@ purple_util_fetch_url_cancel(PurpleUtilFetchUrlData *gfud)
 	g_free(gfud->user_agent);
 	g_free(gfud->request);
 	g_free(gfud->webdata);
+	g_free(gfud->pool_key);
 
 	g_free(gfud);
 }
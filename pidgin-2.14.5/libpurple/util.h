@@ -712,6 +712,21 @@ gboolean purple_util_write_data_to_file(const char *filename, const char *data,
 gboolean
 purple_util_write_data_to_file_absolute(const char *filename_full, const char *data, gssize size);
 
+/**
+ * Write an xmlnode tree as a human readable XML document to a file of the
+ * given name in the Purple user directory, in the same safe way as
+ * purple_util_write_data_to_file().  The document is streamed to the
+ * file, so it is never held in memory as a whole.
+ *
+ * @param filename The basename of the file to write in the purple_user_dir.
+ * @param node     The root node of the document.
+ *
+ * @return TRUE if the file was written successfully.  FALSE otherwise.
+ *
+ * @since 2.14.6
+ */
+gboolean purple_util_write_xml_to_file(const char *filename, const xmlnode *node);
+
 /**
  * Read the contents of a given file and parse the results into an
  * xmlnode tree structure.  This is intended to be used to read
@@ -1109,6 +1124,25 @@ gboolean purple_url_parse(const char *url, char **ret_host, int *ret_port,
  */
 typedef void (*PurpleUtilFetchUrlCallback)(PurpleUtilFetchUrlData *url_data, gpointer user_data, const gchar *url_text, gsize len, const gchar *error_message);
 
+/**
+ * This is the signature used for functions that receive the body of a
+ * URL piece by piece from purple_util_fetch_url_stream().
+ *
+ * @param url_data      The same value that was returned when you called
+ *                      purple_util_fetch_url_stream().
+ * @param user_data     The user data that your code passed into
+ *                      purple_util_fetch_url_stream().
+ * @param data          The next piece of the body.  It is only valid
+ *                      until the function returns.
+ * @param len           The length of @a data, which is never 0.
+ *
+ * @return FALSE to cancel the transfer, in which case the completion
+ *         callback is not called.  TRUE to continue.
+ *
+ * @since 2.14.6
+ */
+typedef gboolean (*PurpleUtilFetchUrlStreamCallback)(PurpleUtilFetchUrlData *url_data, gpointer user_data, const gchar *data, gsize len);
+
 /**
  * Fetches the data from a URL, and passes it to a callback function.
  *
@@ -1234,6 +1268,35 @@ purple_util_fetch_url_request_data_len_with_account(PurpleAccount *account,
 		const char *url, gboolean full,	const char *user_agent, gboolean http11,
 		const char *request, gsize request_len, gboolean include_headers, gssize max_len,
 		PurpleUtilFetchUrlCallback callback, void *user_data);
+
+/**
+ * Fetches the data from a URL, handing the body to a function as it
+ * arrives instead of collecting all of it first.
+ *
+ * The request is made with HTTP/1.0, and the response headers are not
+ * passed on.  Once the whole body has been handed out, @a callback is
+ * called with a @a len of 0, or with an error message if the transfer
+ * failed.
+ *
+ * @param account         The account for which the request is needed, or NULL.
+ * @param url             The URL.
+ * @param full            TRUE if this is the full URL, or FALSE if it's a
+ *                        partial URL.
+ * @param user_agent      The user agent field to use, or NULL.
+ * @param max_len         The maximum number of bytes to retrieve, or a
+ *                        negative number to use the default max of 512 KiB.
+ * @param stream_callback The function receiving the body.
+ * @param callback        The function called when the transfer is over.
+ * @param data            The user data to pass to the callback functions.
+ *
+ * @since 2.14.6
+ */
+PurpleUtilFetchUrlData *
+purple_util_fetch_url_stream(PurpleAccount *account, const char *url,
+		gboolean full, const char *user_agent, gssize max_len,
+		PurpleUtilFetchUrlStreamCallback stream_callback,
+		PurpleUtilFetchUrlCallback callback, void *data);
+
 /**
  * Cancel a pending URL request started with either
  * purple_util_fetch_url_request() or purple_util_fetch_url().
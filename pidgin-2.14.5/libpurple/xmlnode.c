@@ -417,66 +417,181 @@ xmlnode_get_data_unescaped(const xmlnode *node)
 	return unescaped;
 }
 
+/*
+ * Output is collected in a small buffer and handed to the sink in chunks,
+ * so serializing a tree needs no allocation per node or per attribute.
+ */
+typedef struct {
+	XMLNodeWriteFunc func;
+	gpointer user_data;
+	gboolean error;
+	gsize len;
+	char buf[4096];
+} XMLNodeWriter;
+
+static void
+xmlnode_writer_flush(XMLNodeWriter *writer)
+{
+	if (writer->len > 0 && !writer->error &&
+			!writer->func(writer->buf, writer->len, writer->user_data))
+		writer->error = TRUE;
+
+	writer->len = 0;
+}
+
+static void
+xmlnode_writer_append_len(XMLNodeWriter *writer, const char *data, gsize len)
+{
+	if (writer->len + len > sizeof(writer->buf)) {
+		xmlnode_writer_flush(writer);
+
+		if (len > sizeof(writer->buf)) {
+			if (!writer->error && !writer->func(data, len, writer->user_data))
+				writer->error = TRUE;
+			return;
+		}
+	}
+
+	memcpy(writer->buf + writer->len, data, len);
+	writer->len += len;
+}
+
 static void
-xmlnode_to_str_foreach_append_ns(const char *key, const char *value,
-	GString *buf)
+xmlnode_writer_append(XMLNodeWriter *writer, const char *data)
+{
+	xmlnode_writer_append_len(writer, data, strlen(data));
+}
+
+/*
+ * Escapes the same characters as g_markup_escape_text(), but without
+ * building an intermediate string.
+ */
+static void
+xmlnode_writer_append_escaped(XMLNodeWriter *writer, const char *text, gssize length)
+{
+	const char *p, *end, *run;
+	char charref[8];
+
+	if (length < 0)
+		length = strlen(text);
+	end = text + length;
+
+	for (run = p = text; p < end; p++) {
+		const char *entity = NULL;
+		guchar c = *p;
+
+		switch (c) {
+			case '&':
+				entity = "&amp;";
+				break;
+			case '<':
+				entity = "&lt;";
+				break;
+			case '>':
+				entity = "&gt;";
+				break;
+			case '\'':
+				entity = "&apos;";
+				break;
+			case '"':
+				entity = "&quot;";
+				break;
+			default:
+				if ((c >= 0x1 && c <= 0x8) || (c >= 0xb && c <= 0xc) ||
+						(c >= 0xe && c <= 0x1f) || c == 0x7f) {
+					g_snprintf(charref, sizeof(charref), "&#x%x;", c);
+					entity = charref;
+				} else if (c == 0xc2 && p + 1 < end) {
+					/* C1 control characters, except NEL */
+					guchar c1 = p[1];
+
+					if (c1 >= 0x80 && c1 <= 0x9f && c1 != 0x85) {
+						xmlnode_writer_append_len(writer, run, p - run);
+						g_snprintf(charref, sizeof(charref), "&#x%x;", c1);
+						xmlnode_writer_append(writer, charref);
+						run = ++p + 1;
+					}
+				}
+				break;
+		}
+
+		if (entity != NULL) {
+			xmlnode_writer_append_len(writer, run, p - run);
+			xmlnode_writer_append(writer, entity);
+			run = p + 1;
+		}
+	}
+
+	xmlnode_writer_append_len(writer, run, end - run);
+}
+
+static void
+xmlnode_write_foreach_append_ns(const char *key, const char *value,
+	XMLNodeWriter *writer)
 {
 	if (*key) {
-		g_string_append_printf(buf, " xmlns:%s='%s'", key, value);
+		xmlnode_writer_append(writer, " xmlns:");
+		xmlnode_writer_append(writer, key);
+		xmlnode_writer_append(writer, "='");
 	} else {
-		g_string_append_printf(buf, " xmlns='%s'", value);
+		xmlnode_writer_append(writer, " xmlns='");
 	}
+	xmlnode_writer_append(writer, value);
+	xmlnode_writer_append(writer, "'");
 }
 
-static char *
-xmlnode_to_str_helper(const xmlnode *node, int *len, gboolean formatting, int depth)
+static void
+xmlnode_write_tag_name(XMLNodeWriter *writer, const char *prefix, const char *name)
+{
+	if (prefix) {
+		xmlnode_writer_append(writer, prefix);
+		xmlnode_writer_append(writer, ":");
+	}
+	xmlnode_writer_append_escaped(writer, name, -1);
+}
+
+static void
+xmlnode_write_helper(XMLNodeWriter *writer, const xmlnode *node,
+		gboolean formatting, int depth)
 {
-	GString *text = g_string_new("");
 	const char *prefix;
 	const xmlnode *c;
-	char *node_name, *esc, *esc2, *tab = NULL;
 	gboolean need_end = FALSE, pretty = formatting;
+	int i;
 
-	g_return_val_if_fail(node != NULL, NULL);
+	if (writer->error)
+		return;
 
-	if(pretty && depth) {
-		tab = g_strnfill(depth, '\t');
-		text = g_string_append(text, tab);
-	}
+	if (pretty)
+		for (i = 0; i < depth; i++)
+			xmlnode_writer_append(writer, "\t");
 
-	node_name = g_markup_escape_text(node->name, -1);
 	prefix = xmlnode_get_prefix(node);
 
-	if (prefix) {
-		g_string_append_printf(text, "<%s:%s", prefix, node_name);
-	} else {
-		g_string_append_printf(text, "<%s", node_name);
-	}
+	xmlnode_writer_append(writer, "<");
+	xmlnode_write_tag_name(writer, prefix, node->name);
 
 	if (node->namespace_map) {
 		g_hash_table_foreach(node->namespace_map,
-			(GHFunc)xmlnode_to_str_foreach_append_ns, text);
+			(GHFunc)xmlnode_write_foreach_append_ns, writer);
 	} else if (node->xmlns) {
 		if(!node->parent || !purple_strequal(node->xmlns, node->parent->xmlns))
 		{
-			char *xmlns = g_markup_escape_text(node->xmlns, -1);
-			g_string_append_printf(text, " xmlns='%s'", xmlns);
-			g_free(xmlns);
+			xmlnode_writer_append(writer, " xmlns='");
+			xmlnode_writer_append_escaped(writer, node->xmlns, -1);
+			xmlnode_writer_append(writer, "'");
 		}
 	}
 	for(c = node->child; c; c = c->next)
 	{
 		if(c->type == XMLNODE_TYPE_ATTRIB) {
 			const char *aprefix = xmlnode_get_prefix(c);
-			esc = g_markup_escape_text(c->name, -1);
-			esc2 = g_markup_escape_text(c->data, -1);
-			if (aprefix) {
-				g_string_append_printf(text, " %s:%s='%s'", aprefix, esc, esc2);
-			} else {
-				g_string_append_printf(text, " %s='%s'", esc, esc2);
-			}
-			g_free(esc);
-			g_free(esc2);
+
+			xmlnode_writer_append(writer, " ");
+			xmlnode_write_tag_name(writer, aprefix, c->name);
+			xmlnode_writer_append(writer, "='");
+			xmlnode_writer_append_escaped(writer, c->data, -1);
+			xmlnode_writer_append(writer, "'");
 		} else if(c->type == XMLNODE_TYPE_TAG || c->type == XMLNODE_TYPE_DATA) {
 			if(c->type == XMLNODE_TYPE_DATA)
 				pretty = FALSE;
@@ -485,36 +600,68 @@ xmlnode_to_str_helper(const xmlnode *node, int *len, gboolean formatting, int de
 	}
 
 	if(need_end) {
-		g_string_append_printf(text, ">%s", pretty ? NEWLINE_S : "");
+		xmlnode_writer_append(writer, pretty ? ">" NEWLINE_S : ">");
 
 		for(c = node->child; c; c = c->next)
 		{
 			if(c->type == XMLNODE_TYPE_TAG) {
-				int esc_len;
-				esc = xmlnode_to_str_helper(c, &esc_len, pretty, depth+1);
-				text = g_string_append_len(text, esc, esc_len);
-				g_free(esc);
+				xmlnode_write_helper(writer, c, pretty, depth+1);
 			} else if(c->type == XMLNODE_TYPE_DATA && c->data_sz > 0) {
-				esc = g_markup_escape_text(c->data, c->data_sz);
-				text = g_string_append(text, esc);
-				g_free(esc);
+				xmlnode_writer_append_escaped(writer, c->data, c->data_sz);
 			}
 		}
 
-		if(tab && pretty)
-			text = g_string_append(text, tab);
-		if (prefix) {
-			g_string_append_printf(text, "</%s:%s>%s", prefix, node_name, formatting ? NEWLINE_S : "");
-		} else {
-			g_string_append_printf(text, "</%s>%s", node_name, formatting ? NEWLINE_S : "");
-		}
+		if(formatting && pretty)
+			for (i = 0; i < depth; i++)
+				xmlnode_writer_append(writer, "\t");
+		xmlnode_writer_append(writer, "</");
+		xmlnode_write_tag_name(writer, prefix, node->name);
+		xmlnode_writer_append(writer, formatting ? ">" NEWLINE_S : ">");
 	} else {
-		g_string_append_printf(text, "/>%s", formatting ? NEWLINE_S : "");
+		xmlnode_writer_append(writer, formatting ? "/>" NEWLINE_S : "/>");
 	}
+}
+
+gboolean
+xmlnode_write(const xmlnode *node, gboolean formatting,
+		XMLNodeWriteFunc write_func, gpointer user_data)
+{
+	XMLNodeWriter writer;
+
+	g_return_val_if_fail(node != NULL, FALSE);
+	g_return_val_if_fail(write_func != NULL, FALSE);
 
-	g_free(node_name);
+	writer.func = write_func;
+	writer.user_data = user_data;
+	writer.error = FALSE;
+	writer.len = 0;
 
-	g_free(tab);
+	if (formatting)
+		xmlnode_writer_append(&writer,
+				"<?xml version='1.0' encoding='UTF-8' ?>" NEWLINE_S NEWLINE_S);
+
+	xmlnode_write_helper(&writer, node, formatting, 0);
+	xmlnode_writer_flush(&writer);
+
+	return !writer.error;
+}
+
+static gboolean
+xmlnode_write_gstring(const char *data, gsize len, gpointer user_data)
+{
+	g_string_append_len((GString *)user_data, data, len);
+	return TRUE;
+}
+
+static char *
+xmlnode_to_str_helper(const xmlnode *node, int *len, gboolean formatting)
+{
+	GString *text;
+
+	g_return_val_if_fail(node != NULL, NULL);
+
+	text = g_string_new(NULL);
+	xmlnode_write(node, formatting, xmlnode_write_gstring, text);
 
 	if(len)
 		*len = text->len;
@@ -525,25 +672,13 @@ xmlnode_to_str_helper(const xmlnode *node, int *len, gboolean formatting, int de
 char *
 xmlnode_to_str(const xmlnode *node, int *len)
 {
-	return xmlnode_to_str_helper(node, len, FALSE, 0);
+	return xmlnode_to_str_helper(node, len, FALSE);
 }
 
 char *
 xmlnode_to_formatted_str(const xmlnode *node, int *len)
 {
-	char *xml, *xml_with_declaration;
-
-	g_return_val_if_fail(node != NULL, NULL);
-
-	xml = xmlnode_to_str_helper(node, len, TRUE, 0);
-	xml_with_declaration =
-		g_strdup_printf("<?xml version='1.0' encoding='UTF-8' ?>" NEWLINE_S NEWLINE_S "%s", xml);
-	g_free(xml);
-
-	if (len)
-		*len += sizeof("<?xml version='1.0' encoding='UTF-8' ?>" NEWLINE_S NEWLINE_S) - 1;
-
-	return xml_with_declaration;
+	return xmlnode_to_str_helper(node, len, TRUE);
 }
 
 struct _xmlnode_parser_data {
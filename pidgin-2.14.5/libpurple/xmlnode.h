@@ -301,6 +301,40 @@ char *xmlnode_to_str(const xmlnode *node, int *len);
  */
 char *xmlnode_to_formatted_str(const xmlnode *node, int *len);
 
+/**
+ * A sink for xmlnode_write().
+ *
+ * @param data      The next chunk of serialized XML.  It is not
+ *                  NUL-terminated and is only valid during the call.
+ * @param len       The length of @a data.
+ * @param user_data The data passed to xmlnode_write().
+ *
+ * @return @c FALSE to stop writing, for example after an I/O error.
+ *
+ * @since 2.14.6
+ */
+typedef gboolean (*XMLNodeWriteFunc)(const char *data, gsize len, gpointer user_data);
+
+/**
+ * Serializes a node and its children into a sink, escaping the text as
+ * it goes, without building the whole document in memory.  The output
+ * is the same as that of xmlnode_to_str() or, when @a formatting is
+ * @c TRUE, xmlnode_to_formatted_str().
+ *
+ * @param node       The starting node to output.
+ * @param formatting Whether to output human readable xml, including the
+ *                   xml declaration.
+ * @param write_func The function that receives the output.
+ * @param user_data  Data passed to @a write_func.
+ *
+ * @return @c TRUE if everything was written, @c FALSE if @a write_func
+ *         stopped the serialization.
+ *
+ * @since 2.14.6
+ */
+gboolean xmlnode_write(const xmlnode *node, gboolean formatting,
+		XMLNodeWriteFunc write_func, gpointer user_data);
+
 /**
  * Creates a node from a string of XML.  Calling this on the
  * root node of an XML document will parse the entire document
@@ -2643,6 +2643,112 @@ do_alphashift(GdkPixbuf *pixbuf, int shift)
 }
 
 
+/*
+ * Decoded and scaled buddy icons, keyed by a checksum of the image data
+ * and the size and greying they were rendered with.  Rows get redrawn on
+ * every status change, and the icon rarely changes with them, so this
+ * saves decoding and scaling the same image over and over.  The least
+ * recently used icons are dropped once the cache reaches
+ * BUDDY_ICON_CACHE_MAX_BYTES of pixel data.
+ */
+#define BUDDY_ICON_CACHE_MAX_BYTES (4 * 1024 * 1024)
+
+typedef struct {
+	char *key;
+	GdkPixbuf *pixbuf;
+	gsize size;
+} PidginBuddyIconCacheEntry;
+
+/* Maps keys to their link in buddy_icon_lru, most recently used first */
+static GHashTable *buddy_icon_cache = NULL;
+static GQueue *buddy_icon_lru = NULL;
+static gsize buddy_icon_cache_size = 0;
+static guint buddy_icon_cache_hits = 0;
+static guint buddy_icon_cache_misses = 0;
+static guint buddy_icon_cache_evictions = 0;
+
+static void
+buddy_icon_cache_entry_free(PidginBuddyIconCacheEntry *entry)
+{
+	g_object_unref(G_OBJECT(entry->pixbuf));
+	g_free(entry->key);
+	g_free(entry);
+}
+
+static GdkPixbuf *
+buddy_icon_cache_lookup(const char *key)
+{
+	GList *link = g_hash_table_lookup(buddy_icon_cache, key);
+	PidginBuddyIconCacheEntry *entry;
+
+	if (link == NULL) {
+		buddy_icon_cache_misses++;
+		return NULL;
+	}
+
+	buddy_icon_cache_hits++;
+	g_queue_unlink(buddy_icon_lru, link);
+	g_queue_push_head_link(buddy_icon_lru, link);
+
+	entry = link->data;
+	/* The caller gets a reference */
+	return g_object_ref(entry->pixbuf);
+}
+
+static void
+buddy_icon_cache_store(const char *key, GdkPixbuf *pixbuf)
+{
+	PidginBuddyIconCacheEntry *entry;
+	gsize size;
+
+	size = (gsize)gdk_pixbuf_get_rowstride(pixbuf) * gdk_pixbuf_get_height(pixbuf);
+	if (size > BUDDY_ICON_CACHE_MAX_BYTES)
+		return;
+
+	entry = g_new(PidginBuddyIconCacheEntry, 1);
+	entry->key = g_strdup(key);
+	entry->pixbuf = g_object_ref(pixbuf);
+	entry->size = size;
+
+	g_queue_push_head(buddy_icon_lru, entry);
+	g_hash_table_insert(buddy_icon_cache, entry->key, buddy_icon_lru->head);
+	buddy_icon_cache_size += size;
+
+	while (buddy_icon_cache_size > BUDDY_ICON_CACHE_MAX_BYTES) {
+		PidginBuddyIconCacheEntry *old = g_queue_pop_tail(buddy_icon_lru);
+
+		g_hash_table_remove(buddy_icon_cache, old->key);
+		buddy_icon_cache_size -= old->size;
+		buddy_icon_cache_evictions++;
+		buddy_icon_cache_entry_free(old);
+	}
+}
+
+static void
+buddy_icon_cache_clear(void)
+{
+	PidginBuddyIconCacheEntry *entry;
+
+	while ((entry = g_queue_pop_head(buddy_icon_lru)) != NULL)
+		buddy_icon_cache_entry_free(entry);
+	g_hash_table_remove_all(buddy_icon_cache);
+	buddy_icon_cache_size = 0;
+}
+
+void
+pidgin_blist_get_buddy_icon_cache_stats(guint *hits, guint *misses,
+                                        guint *evictions, gsize *size)
+{
+	if (hits)
+		*hits = buddy_icon_cache_hits;
+	if (misses)
+		*misses = buddy_icon_cache_misses;
+	if (evictions)
+		*evictions = buddy_icon_cache_evictions;
+	if (size)
+		*size = buddy_icon_cache_size;
+}
+
 static GdkPixbuf *pidgin_blist_get_buddy_icon(PurpleBlistNode *node,
                                               gboolean scaled, gboolean greyed)
 {
@@ -2657,6 +2763,9 @@ static GdkPixbuf *pidgin_blist_get_buddy_icon(PurpleBlistNode *node,
 	PurpleStoredImage *custom_img;
 	PurplePluginProtocolInfo *prpl_info = NULL;
 	gint orig_width, orig_height, scale_width, scale_height;
+	gboolean offline = FALSE, idle = FALSE;
+	gboolean prpl_scale = FALSE;
+	char *checksum, *key;
 
 	if (PURPLE_BLIST_NODE_IS_CONTACT(node)) {
 		buddy = purple_contact_get_priority_buddy((PurpleContact*)node);
@@ -2704,7 +2813,7 @@ static GdkPixbuf *pidgin_blist_get_buddy_icon(PurpleBlistNode *node,
 	if (data == NULL) {
 		if (buddy) {
 			/* Not sure I like this...*/
-			if (!(icon = purple_buddy_icons_find(buddy->account, buddy->name)))
+			if (!(icon = purple_buddy_icons_find_async(buddy->account, buddy->name)))
 				return NULL;
 			data = purple_buddy_icon_get_data(icon, &len);
 		}
@@ -2713,6 +2822,40 @@ static GdkPixbuf *pidgin_blist_get_buddy_icon(PurpleBlistNode *node,
 			return NULL;
 	}
 
+	if (greyed) {
+		if (buddy) {
+			PurplePresence *presence = purple_buddy_get_presence(buddy);
+			if (!PURPLE_BUDDY_IS_ONLINE(buddy))
+				offline = TRUE;
+			if (purple_presence_is_idle(presence))
+				idle = TRUE;
+		} else if (group) {
+			if (purple_blist_get_group_online_count(group) == 0)
+				offline = TRUE;
+		}
+	}
+
+	prpl_scale = prpl_info && (prpl_info->icon_spec.scale_rules & PURPLE_ICON_SCALE_DISPLAY);
+
+	/* Stored images are named after the checksum of their data */
+	if (custom_img && purple_imgstore_get_filename(custom_img))
+		checksum = g_strdup(purple_imgstore_get_filename(custom_img));
+	else
+		checksum = purple_util_get_image_checksum(data, len);
+
+	key = g_strdup_printf("%s/%s/%c%c%c", checksum ? checksum : "",
+			prpl_scale ? purple_account_get_protocol_id(account) : "",
+			scaled ? 's' : 'f', offline ? 'o' : '-', idle ? 'i' : '-');
+	g_free(checksum);
+
+	ret = buddy_icon_cache_lookup(key);
+	if (ret != NULL) {
+		purple_buddy_icon_unref(icon);
+		purple_imgstore_unref(custom_img);
+		g_free(key);
+		return ret;
+	}
+
 	buf = pidgin_pixbuf_from_data(data, len);
 	purple_buddy_icon_unref(icon);
 	if (!buf) {
@@ -2724,37 +2867,23 @@ static GdkPixbuf *pidgin_blist_get_buddy_icon(PurpleBlistNode *node,
 				buddy ? purple_buddy_get_name(buddy) : "(no buddy)",
 				custom_img ? purple_imgstore_get_data(custom_img) : NULL);
 		purple_imgstore_unref(custom_img);
+		g_free(key);
 		return NULL;
 	}
 	purple_imgstore_unref(custom_img);
 
-	if (greyed) {
-		gboolean offline = FALSE, idle = FALSE;
-
-		if (buddy) {
-			PurplePresence *presence = purple_buddy_get_presence(buddy);
-			if (!PURPLE_BUDDY_IS_ONLINE(buddy))
-				offline = TRUE;
-			if (purple_presence_is_idle(presence))
-				idle = TRUE;
-		} else if (group) {
-			if (purple_blist_get_group_online_count(group) == 0)
-				offline = TRUE;
-		}
-
-		if (offline)
-			gdk_pixbuf_saturate_and_pixelate(buf, buf, 0.0, FALSE);
+	if (offline)
+		gdk_pixbuf_saturate_and_pixelate(buf, buf, 0.0, FALSE);
 
-		if (idle)
-			gdk_pixbuf_saturate_and_pixelate(buf, buf, 0.25, FALSE);
-	}
+	if (idle)
+		gdk_pixbuf_saturate_and_pixelate(buf, buf, 0.25, FALSE);
 
 	/* I'd use the pidgin_buddy_icon_get_scale_size() thing, but it won't
 	 * tell me the original size, which I need for scaling purposes. */
 	scale_width = orig_width = gdk_pixbuf_get_width(buf);
 	scale_height = orig_height = gdk_pixbuf_get_height(buf);
 
-	if (prpl_info && prpl_info->icon_spec.scale_rules & PURPLE_ICON_SCALE_DISPLAY)
+	if (prpl_scale)
 		purple_buddy_icon_get_scale_size(&prpl_info->icon_spec, &scale_width, &scale_height);
 
 	if (scaled || scale_height > 200 || scale_width > 200) {
@@ -2783,6 +2912,10 @@ static GdkPixbuf *pidgin_blist_get_buddy_icon(PurpleBlistNode *node,
 	}
 	g_object_unref(G_OBJECT(buf));
 
+	if (ret != NULL)
+		buddy_icon_cache_store(key, ret);
+	g_free(key);
+
 	return ret;
 }
 
@@ -6535,6 +6668,10 @@ static void buddy_node(PurpleBuddy *buddy, GtkTreeIter *iter, PurpleBlistNode *n
 		g_object_ref(G_OBJECT(gtkblist->empty_avatar));
 		avatar = gtkblist->empty_avatar;
 	} else if ((!PURPLE_BUDDY_IS_ONLINE(buddy) || purple_presence_is_idle(presence))) {
+		/* The icon is shared with the icon cache, so fade a copy */
+		GdkPixbuf *faded = gdk_pixbuf_copy(avatar);
+		g_object_unref(G_OBJECT(avatar));
+		avatar = faded;
 		do_alphashift(avatar, 77);
 	}
 
@@ -7559,6 +7696,8 @@ void pidgin_blist_init(void)
 	void *gtk_blist_handle = pidgin_blist_get_handle();
 
 	cached_emblems = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	buddy_icon_cache = g_hash_table_new(g_str_hash, g_str_equal);
+	buddy_icon_lru = g_queue_new();
 
 	/* Initialize prefs */
 	purple_prefs_add_none(PIDGIN_PREFS_ROOT "/blist");
@@ -7627,6 +7766,16 @@ void
 pidgin_blist_uninit(void) {
 	g_hash_table_destroy(cached_emblems);
 
+	purple_debug_info("gtkblist", "Buddy icon cache: %u hits, %u misses, "
+			"%u evictions, %" G_GSIZE_FORMAT " bytes\n",
+			buddy_icon_cache_hits, buddy_icon_cache_misses,
+			buddy_icon_cache_evictions, buddy_icon_cache_size);
+	buddy_icon_cache_clear();
+	g_hash_table_destroy(buddy_icon_cache);
+	buddy_icon_cache = NULL;
+	g_queue_free(buddy_icon_lru);
+	buddy_icon_lru = NULL;
+
 	purple_signals_unregister_by_instance(pidgin_blist_get_handle());
 	purple_signals_disconnect_by_handle(pidgin_blist_get_handle());
 }
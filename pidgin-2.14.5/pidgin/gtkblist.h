@@ -430,5 +430,23 @@ void pidgin_blist_draw_tooltip(PurpleBlistNode *node, GtkWidget *widget);
  */
 void pidgin_blist_tooltip_destroy(void);
 
+/**
+ * Returns the counters of the cache of decoded and scaled buddy icons
+ * used by the Buddy List and its tooltips.  Any argument may be @c NULL.
+ *
+ * @param hits      Return location for the number of lookups answered
+ *                  from the cache.
+ * @param misses    Return location for the number of icons that had to
+ *                  be decoded.
+ * @param evictions Return location for the number of icons dropped to
+ *                  stay within the memory limit.
+ * @param size      Return location for the bytes of pixel data currently
+ *                  cached.
+ *
+ * @since 2.14.6
+ */
+void pidgin_blist_get_buddy_icon_cache_stats(guint *hits, guint *misses,
+                                             guint *evictions, gsize *size);
+
 
 #endif /* _PIDGINBLIST_H_ */
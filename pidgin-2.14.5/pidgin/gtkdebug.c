@@ -48,12 +48,31 @@
 
 #include <gdk/gdkkeysyms.h>
 
+/*
+ * The debug window keeps the last lines of output in a ring of records, so
+ * that a long running session does not grow without bound.  The text view
+ * is trimmed to the same number of lines, and when the filter changes it is
+ * rebuilt from the ring a slice at a time from an idle callback.
+ */
+#define DEBUG_REFILTER_SLICE 200
+
+typedef struct
+{
+	PurpleDebugLevel level;
+	time_t time;
+	char *category;
+	char *text;
+} DebugRecord;
+
 typedef struct
 {
 	GtkWidget *window;
 	GtkWidget *text;
 
-	GtkListStore *store;
+	DebugRecord *records;
+	guint max_records;
+	guint64 first_record;  /* sequence number of the oldest record */
+	guint64 next_record;   /* sequence number of the next record */
 
 	gboolean paused;
 
@@ -65,6 +84,8 @@ typedef struct
 	gboolean highlight;
 
 	guint timer;
+	guint refilter;
+	guint64 refilter_pos;
 #	ifdef HAVE_REGEX_H
 	regex_t regex;
 #	else
@@ -89,10 +110,123 @@ static DebugWindow *debug_win = NULL;
 static guint debug_enabled_timer = 0;
 
 #ifdef USE_REGEX
-static void regex_filter_all(DebugWindow *win);
-static void regex_show_all(DebugWindow *win);
+static void regex_match(DebugWindow *win, const gchar *text);
+static void regex_refilter(DebugWindow *win);
 #endif /* USE_REGEX */
 
+static DebugRecord *
+debug_record_get(DebugWindow *win, guint64 seq)
+{
+	return &win->records[seq % win->max_records];
+}
+
+static void
+debug_record_free(DebugRecord *record)
+{
+	g_free(record->category);
+	g_free(record->text);
+	record->category = NULL;
+	record->text = NULL;
+}
+
+static DebugRecord *
+debug_record_add(DebugWindow *win, PurpleDebugLevel level,
+				 const char *category, const char *text)
+{
+	DebugRecord *record;
+
+	/* Drop the oldest record once the ring is full */
+	if (win->next_record - win->first_record == win->max_records) {
+		debug_record_free(debug_record_get(win, win->first_record));
+		win->first_record++;
+	}
+
+	record = debug_record_get(win, win->next_record++);
+	record->level = level;
+	record->time = time(NULL);
+	record->category = g_strdup(category);
+	record->text = g_strdup(text);
+
+	return record;
+}
+
+static void
+debug_records_clear(DebugWindow *win)
+{
+	for (; win->first_record < win->next_record; win->first_record++)
+		debug_record_free(debug_record_get(win, win->first_record));
+}
+
+static gchar *
+debug_record_markup(const DebugRecord *record)
+{
+	gchar *esc_s, *tmp, *s;
+	const char *mdate;
+
+	mdate = purple_utf8_strftime("%H:%M:%S", localtime(&record->time));
+	esc_s = g_markup_escape_text(record->text, -1);
+
+	s = g_strdup_printf("<font color=\"%s\">(%s) %s%s%s%s</font>",
+						debug_fg_colors[record->level], mdate,
+						record->category ? "<b>" : "",
+						record->category ? record->category : "",
+						record->category ? ":</b> " : "",
+						esc_s);
+	g_free(esc_s);
+
+	tmp = purple_utf8_try_convert(s);
+	g_free(s);
+	s = tmp;
+
+	if (record->level == PURPLE_DEBUG_FATAL) {
+		tmp = g_strdup_printf("<b>%s</b>", s);
+		g_free(s);
+		s = tmp;
+	}
+
+	return s;
+}
+
+/* Keeps the view from holding more lines than the ring holds records */
+static void
+debug_window_trim(DebugWindow *win)
+{
+	GtkTextBuffer *buffer = GTK_IMHTML(win->text)->text_buffer;
+	gint lines = gtk_text_buffer_get_line_count(buffer);
+
+	if (lines > (gint)win->max_records) {
+		GtkTextIter start, end;
+
+		gtk_text_buffer_get_start_iter(buffer, &start);
+		gtk_text_buffer_get_iter_at_line(buffer, &end,
+				lines - win->max_records);
+		gtk_text_buffer_delete(buffer, &start, &end);
+	}
+}
+
+static void
+debug_window_show_record(DebugWindow *win, const DebugRecord *record)
+{
+	gchar *s;
+
+	if (record->level < (PurpleDebugLevel)purple_prefs_get_int(PIDGIN_PREFS_ROOT "/debug/filterlevel"))
+		return;
+
+	s = debug_record_markup(record);
+
+#ifdef USE_REGEX
+	if (win->filter != NULL &&
+			gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(win->filter)))
+		regex_match(win, s);
+	else
+#endif /* USE_REGEX */
+		gtk_imhtml_append_text(GTK_IMHTML(win->text), s, 0);
+
+	g_free(s);
+
+	debug_window_trim(win);
+}
+
 static gint
 debug_window_destroy(GtkWidget *w, GdkEvent *event, void *unused)
 {
@@ -107,6 +241,8 @@ debug_window_destroy(GtkWidget *w, GdkEvent *event, void *unused)
 		text = gtk_entry_get_text(GTK_ENTRY(debug_win->expression));
 		purple_prefs_set_string(PIDGIN_PREFS_ROOT "/debug/regex", text);
 	}
+	if (debug_win->refilter != 0)
+		g_source_remove(debug_win->refilter);
 #ifdef HAVE_REGEX_H
 	regfree(&debug_win->regex);
 #else
@@ -117,6 +253,8 @@ debug_window_destroy(GtkWidget *w, GdkEvent *event, void *unused)
 	/* If the "Save Log" dialog is open then close it */
 	purple_request_close_with_handle(debug_win);
 
+	debug_records_clear(debug_win);
+	g_free(debug_win->records);
 	g_free(debug_win);
 	debug_win = NULL;
 
@@ -254,8 +392,13 @@ clear_cb(GtkWidget *w, DebugWindow *win)
 	gtk_imhtml_clear(GTK_IMHTML(win->text));
 
 #ifdef USE_REGEX
-	gtk_list_store_clear(win->store);
+	if (win->refilter != 0) {
+		g_source_remove(win->refilter);
+		win->refilter = 0;
+	}
 #endif /* USE_REGEX */
+
+	debug_records_clear(win);
 }
 
 static void
@@ -264,12 +407,8 @@ pause_cb(GtkWidget *w, DebugWindow *win)
 	win->paused = gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(w));
 
 #ifdef USE_REGEX
-	if(!win->paused) {
-		if(gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(win->filter)))
-			regex_filter_all(win);
-		else
-			regex_show_all(win);
-	}
+	if(!win->paused)
+		regex_refilter(win);
 #endif /* USE_REGEX */
 }
 
@@ -420,59 +559,42 @@ regex_match(DebugWindow *win, const gchar *text) {
 }
 
 static gboolean
-regex_filter_all_cb(GtkTreeModel *m, GtkTreePath *p, GtkTreeIter *iter,
-				    gpointer data)
+regex_refilter_cb(gpointer data)
 {
 	DebugWindow *win = (DebugWindow *)data;
-	gchar *text;
-	PurpleDebugLevel level;
-
-	gtk_tree_model_get(m, iter, 0, &text, 1, &level, -1);
-
-	if (level >= (PurpleDebugLevel)purple_prefs_get_int(PIDGIN_PREFS_ROOT "/debug/filterlevel"))
-		regex_match(win, text);
-
-	g_free(text);
-
-	return FALSE;
-}
-
-static void
-regex_filter_all(DebugWindow *win) {
-	gtk_imhtml_clear(GTK_IMHTML(win->text));
+	guint i;
 
-	if(win->highlight)
-		regex_highlight_clear(win);
+	/* Records may have been dropped from the ring in the meantime */
+	if (win->refilter_pos < win->first_record)
+		win->refilter_pos = win->first_record;
 
-	gtk_tree_model_foreach(GTK_TREE_MODEL(win->store), regex_filter_all_cb,
-						   win);
-}
+	for (i = 0; i < DEBUG_REFILTER_SLICE && win->refilter_pos < win->next_record; i++)
+		debug_window_show_record(win, debug_record_get(win, win->refilter_pos++));
 
-static gboolean
-regex_show_all_cb(GtkTreeModel *m, GtkTreePath *p, GtkTreeIter *iter,
-				  gpointer data)
-{
-	DebugWindow *win = (DebugWindow *)data;
-	gchar *text;
-	PurpleDebugLevel level;
+	if (win->refilter_pos < win->next_record)
+		return TRUE;
 
-	gtk_tree_model_get(m, iter, 0, &text, 1, &level, -1);
-	if (level >= (PurpleDebugLevel)purple_prefs_get_int(PIDGIN_PREFS_ROOT "/debug/filterlevel"))
-		gtk_imhtml_append_text(GTK_IMHTML(win->text), text, 0);
-	g_free(text);
+	win->refilter = 0;
 
 	return FALSE;
 }
 
+/*
+ * Rebuilds the view from the ring.  This happens in slices from an idle
+ * callback so that changing the filter never blocks the UI for long; lines
+ * printed in the meantime are picked up when the rebuild reaches them.
+ */
 static void
-regex_show_all(DebugWindow *win) {
+regex_refilter(DebugWindow *win) {
 	gtk_imhtml_clear(GTK_IMHTML(win->text));
 
 	if(win->highlight)
 		regex_highlight_clear(win);
 
-	gtk_tree_model_foreach(GTK_TREE_MODEL(win->store), regex_show_all_cb,
-						   win);
+	win->refilter_pos = win->first_record;
+
+	if (win->refilter == 0)
+		win->refilter = g_idle_add(regex_refilter_cb, win);
 }
 
 static void
@@ -509,7 +631,7 @@ regex_compile(DebugWindow *win) {
 	 * got changed, and not the expression.
 	 */
 	if(gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(win->filter)))
-		regex_filter_all(win);
+		regex_refilter(win);
 }
 
 static void
@@ -547,7 +669,7 @@ regex_pref_invert_cb(const gchar *name, PurplePrefType type,
 	win->invert = active;
 
 	if(gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(win->filter)))
-		regex_filter_all(win);
+		regex_refilter(win);
 }
 
 static void
@@ -560,39 +682,7 @@ regex_pref_highlight_cb(const gchar *name, PurplePrefType type,
 	win->highlight = active;
 
 	if(gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(win->filter)))
-		regex_filter_all(win);
-}
-
-static void
-regex_row_changed_cb(GtkTreeModel *model, GtkTreePath *path,
-					 GtkTreeIter *iter, DebugWindow *win)
-{
-	gchar *text;
-	PurpleDebugLevel level;
-
-	if(!win || !win->window)
-		return;
-
-	/* If the debug window is paused, we just return since it's in the store.
-	 * We don't call regex_match because it doesn't make sense to check the
-	 * string if it's paused.  When we unpause we clear the imhtml and
-	 * reiterate over the store to handle matches that were outputted when
-	 * we were paused.
-	 */
-	if(win->paused)
-		return;
-
-	gtk_tree_model_get(model, iter, 0, &text, 1, &level, -1);
-
-	if (level >= (PurpleDebugLevel)purple_prefs_get_int(PIDGIN_PREFS_ROOT "/debug/filterlevel")) {
-		if(gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(win->filter))) {
-			regex_match(win, text);
-		} else {
-			gtk_imhtml_append_text(GTK_IMHTML(win->text), text, 0);
-		}
-	}
-
-	g_free(text);
+		regex_refilter(win);
 }
 
 static gboolean
@@ -661,10 +751,7 @@ regex_filter_toggled_cb(GtkToggleToolButton *button, DebugWindow *win) {
 	if(!GTK_IS_IMHTML(win->text))
 		return;
 
-	if(active)
-		regex_filter_all(win);
-	else
-		regex_show_all(win);
+	regex_refilter(win);
 }
 
 static void
@@ -674,10 +761,7 @@ filter_level_pref_changed(const char *name, PurplePrefType type, gconstpointer v
 
 	if (GPOINTER_TO_INT(value) != gtk_combo_box_get_active(GTK_COMBO_BOX(win->filterlevel)))
 		gtk_combo_box_set_active(GTK_COMBO_BOX(win->filterlevel), GPOINTER_TO_INT(value));
-	if(gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(win->filter)))
-		regex_filter_all(win);
-	else
-		regex_show_all(win);
+	regex_refilter(win);
 }
 #endif /* USE_REGEX */
 
@@ -765,19 +849,9 @@ debug_window_new(void)
 
 	handle = pidgin_debug_get_handle();
 
-#ifdef USE_REGEX
-	/* the list store for all the messages */
-	win->store = gtk_list_store_new(2, G_TYPE_STRING, G_TYPE_INT);
-
-	/* row-changed gets called when we do gtk_list_store_set, and row-inserted
-	 * gets called with gtk_list_store_append, which is a
-	 * completely empty row. So we just ignore row-inserted, and deal with row
-	 * changed. -Gary
-	 */
-	g_signal_connect(G_OBJECT(win->store), "row-changed",
-					 G_CALLBACK(regex_row_changed_cb), win);
-
-#endif /* USE_REGEX */
+	/* the ring for the last messages */
+	win->max_records = MAX(purple_prefs_get_int(PIDGIN_PREFS_ROOT "/debug/max_lines"), 1);
+	win->records = g_new0(DebugRecord, win->max_records);
 
 	/* Setup the vbox */
 	vbox = gtk_vbox_new(FALSE, 0);
@@ -1064,6 +1138,7 @@ pidgin_debug_init(void)
 	purple_prefs_add_bool(PIDGIN_PREFS_ROOT "/debug/toolbar", TRUE);
 	purple_prefs_add_int(PIDGIN_PREFS_ROOT "/debug/width",  450);
 	purple_prefs_add_int(PIDGIN_PREFS_ROOT "/debug/height", 250);
+	purple_prefs_add_int(PIDGIN_PREFS_ROOT "/debug/max_lines", 10000);
 
 #ifdef USE_REGEX
 	purple_prefs_add_string(PIDGIN_PREFS_ROOT "/debug/regex", "");
@@ -1133,13 +1208,7 @@ static void
 pidgin_debug_print(PurpleDebugLevel level, const char *category,
 					 const char *arg_s)
 {
-#ifdef USE_REGEX
-	GtkTreeIter iter;
-#endif /* USE_REGEX */
-	gchar *ts_s;
-	gchar *esc_s, *cat_s, *tmp, *s;
-	const char *mdate;
-	time_t mtime;
+	DebugRecord *record;
 
 	if (debug_win == NULL ||
 		!purple_prefs_get_bool(PIDGIN_PREFS_ROOT "/debug/enabled"))
@@ -1147,43 +1216,18 @@ pidgin_debug_print(PurpleDebugLevel level, const char *category,
 		return;
 	}
 
-	mtime = time(NULL);
-	mdate = purple_utf8_strftime("%H:%M:%S", localtime(&mtime));
-	ts_s = g_strdup_printf("(%s) ", mdate);
-	if (category == NULL)
-		cat_s = g_strdup("");
-	else
-		cat_s = g_strdup_printf("<b>%s:</b> ", category);
-
-	esc_s = g_markup_escape_text(arg_s, -1);
-
-	s = g_strdup_printf("<font color=\"%s\">%s%s%s</font>",
-						debug_fg_colors[level], ts_s, cat_s, esc_s);
-
-	g_free(ts_s);
-	g_free(cat_s);
-	g_free(esc_s);
-
-	tmp = purple_utf8_try_convert(s);
-	g_free(s);
-	s = tmp;
-
-	if (level == PURPLE_DEBUG_FATAL) {
-		tmp = g_strdup_printf("<b>%s</b>", s);
-		g_free(s);
-		s = tmp;
-	}
+	record = debug_record_add(debug_win, level, category, arg_s);
 
+	/* While paused or rebuilding the view, the record just waits in the
+	 * ring; unpausing or the rebuild shows it */
+	if (debug_win->paused)
+		return;
 #ifdef USE_REGEX
-	/* add the text to the list store */
-	gtk_list_store_append(debug_win->store, &iter);
-	gtk_list_store_set(debug_win->store, &iter, 0, s, 1, level, -1);
-#else /* USE_REGEX */
-	if(!debug_win->paused && level >= purple_prefs_get_int(PIDGIN_PREFS_ROOT "/debug/filterlevel"))
-		gtk_imhtml_append_text(GTK_IMHTML(debug_win->text), s, 0);
-#endif /* !USE_REGEX */
+	if (debug_win->refilter != 0)
+		return;
+#endif /* USE_REGEX */
 
-	g_free(s);
+	debug_window_show_record(debug_win, record);
 }
 
 static gboolean
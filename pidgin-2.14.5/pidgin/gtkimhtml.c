@@ -322,6 +322,116 @@ static gboolean clipboard_paste_html_win32(GtkIMHtml *imhtml) {
 }
 #endif
 
+/*
+ * The smileys of a tree, compiled into a table-driven automaton: every trie
+ * node becomes a state, and each state has a dense row of transitions, so
+ * a lookup step is two array reads instead of a strchr() over the node's
+ * children.  Bytes which occur in no smiley share input class 0, which has
+ * no transitions, so the columns only cover the bytes actually used.
+ *
+ * The tree stays around for removals and gtk_imhtml_smiley_get(); the
+ * automaton is thrown away when the tree changes and rebuilt on the next
+ * lookup.
+ */
+typedef struct {
+	guint8 classes[256];        /* byte => input class */
+	guint n_classes;
+	guint16 *next;              /* state * n_classes + class => state, 0 for none */
+	GtkIMHtmlSmiley **accept;   /* state => the smiley ending there, if any */
+} GtkSmileyAutomaton;
+
+/* State 0 is the root, which is never the target of a transition. */
+#define SMILEY_AUTOMATON_MAX_STATES G_MAXUINT16
+
+static void
+gtk_smiley_automaton_free (GtkSmileyAutomaton *automaton)
+{
+	if (automaton == NULL)
+		return;
+
+	g_free (automaton->next);
+	g_free (automaton->accept);
+	g_free (automaton);
+}
+
+static GtkSmileyAutomaton *
+gtk_smiley_automaton_new (GtkSmileyTree *tree)
+{
+	GtkSmileyAutomaton *automaton;
+	GQueue *queue;
+	GPtrArray *nodes;
+	guint i, n_states;
+
+	automaton = g_new0 (GtkSmileyAutomaton, 1);
+	automaton->n_classes = 1;
+
+	/* Number the nodes breadth first and find the bytes in use. */
+	nodes = g_ptr_array_new ();
+	queue = g_queue_new ();
+	g_queue_push_tail (queue, tree);
+	while (!g_queue_is_empty (queue)) {
+		GtkSmileyTree *t = g_queue_pop_head (queue);
+
+		g_ptr_array_add (nodes, t);
+		if (!t->values)
+			continue;
+
+		for (i = 0; i < t->values->len; i++) {
+			guchar c = t->values->str[i];
+
+			if (automaton->classes[c] == 0)
+				automaton->classes[c] = automaton->n_classes++;
+			g_queue_push_tail (queue, t->children[i]);
+		}
+	}
+	g_queue_free (queue);
+
+	n_states = nodes->len;
+	if (n_states > SMILEY_AUTOMATON_MAX_STATES) {
+		g_ptr_array_free (nodes, TRUE);
+		g_free (automaton);
+		return NULL;
+	}
+
+	automaton->next = g_new0 (guint16, n_states * automaton->n_classes);
+	automaton->accept = g_new0 (GtkIMHtmlSmiley *, n_states);
+
+	/* Children were queued in order, so they were numbered in order too. */
+	{
+		guint child = 1;
+
+		for (i = 0; i < n_states; i++) {
+			GtkSmileyTree *t = g_ptr_array_index (nodes, i);
+			guint16 *row = automaton->next + i * automaton->n_classes;
+			gsize j;
+
+			automaton->accept[i] = t->image;
+			if (!t->values)
+				continue;
+
+			for (j = 0; j < t->values->len; j++)
+				row[automaton->classes[(guchar)t->values->str[j]]] = child++;
+		}
+	}
+
+	g_ptr_array_free (nodes, TRUE);
+
+	return automaton;
+}
+
+static inline guint
+gtk_smiley_automaton_step (GtkSmileyAutomaton *automaton, guint state, guchar c)
+{
+	return automaton->next[state * automaton->n_classes + automaton->classes[c]];
+}
+
+static void
+gtk_smiley_tree_changed (GtkSmileyTree *tree)
+{
+	gtk_smiley_automaton_free (tree->automaton);
+	tree->automaton = NULL;
+}
+
 static GtkSmileyTree*
 gtk_smiley_tree_new (void)
 {
@@ -362,6 +472,7 @@ gtk_smiley_tree_insert (GtkSmileyTree *tree,
 	} while (*x);
 
 	t->image = smiley;
+	gtk_smiley_tree_changed (tree);
 }
 
 
@@ -370,6 +481,8 @@ gtk_smiley_tree_destroy (GtkSmileyTree *tree)
 {
 	GSList *list = g_slist_prepend (NULL, tree);
 
+	gtk_smiley_tree_changed (tree);
+
 	while (list) {
 		GtkSmileyTree *t = list->data;
 		gsize i;
@@ -2046,9 +2159,48 @@ static void gtk_smiley_tree_remove (GtkSmileyTree     *tree,
 
 	if (t->image) {
 		t->image = NULL;
+		gtk_smiley_tree_changed (tree);
 	}
 }
 
+/* Returns the length of the longest smiley at the start of text, like
+ * gtk_smiley_tree_lookup(). */
+static gint
+gtk_smiley_automaton_lookup (GtkSmileyAutomaton *automaton,
+			     const gchar        *text)
+{
+	const gchar *x = text;
+	const gchar *amp;
+	gint alen;
+	gint len = 0;
+	gint lastlen = 0;
+	guint state = 0;
+
+	while (*x) {
+		if (*x == '&' && (amp = purple_markup_unescape_entity(x, &alen))) {
+			/* Make sure all chars of the unescaped value match */
+			while (*amp && (state = gtk_smiley_automaton_step (automaton, state, *amp)) != 0)
+				amp++;
+			if (*amp)
+				break;
+		} else if (*x == '<') /* See gtk_smiley_tree_lookup() */
+			break;
+		else {
+			alen = 1;
+			if ((state = gtk_smiley_automaton_step (automaton, state, *x)) == 0)
+				break;
+		}
+
+		if (automaton->accept[state])
+			lastlen = len + alen;
+
+		x += alen;
+		len += alen;
+	}
+
+	return lastlen;
+}
+
 static gint
 gtk_smiley_tree_lookup (GtkSmileyTree *tree,
 			const gchar   *text)
@@ -2195,7 +2347,13 @@ gtk_imhtml_is_smiley (GtkIMHtml   *imhtml,
 	if (tree == NULL)
 		return FALSE;
 
-	*len = gtk_smiley_tree_lookup (tree, text);
+	if (tree->automaton == NULL)
+		tree->automaton = gtk_smiley_automaton_new (tree);
+
+	if (tree->automaton != NULL)
+		*len = gtk_smiley_automaton_lookup (tree->automaton, text);
+	else
+		*len = gtk_smiley_tree_lookup (tree, text);
 	return (*len > 0);
 }
 
@@ -182,6 +182,8 @@ struct _GtkSmileyTree {
 	GString *values;
 	GtkSmileyTree **children;
 	GtkIMHtmlSmiley *image;
+	gpointer automaton;  /**< Private: the lookup table compiled from a
+	                          root, or NULL.  @since 2.14.6 */
 };
 
 struct _GtkIMHtmlSmiley {
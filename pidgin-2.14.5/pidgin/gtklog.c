@@ -123,7 +123,7 @@ static const char *log_get_date(PurpleLog *log)
 static void search_cb(GtkWidget *button, PidginLogViewer *lv)
 {
 	const char *search_term = gtk_entry_get_text(GTK_ENTRY(lv->entry));
-	GList *logs;
+	GList *hits, *l;
 
 	if (!(*search_term)) {
 		/* reset the tree */
@@ -151,19 +151,17 @@ static void search_cb(GtkWidget *button, PidginLogViewer *lv)
 	gtk_tree_store_clear(lv->treestore);
 	gtk_imhtml_clear(GTK_IMHTML(lv->imhtml));
 
-	for (logs = lv->logs; logs != NULL; logs = logs->next) {
-		char *read = purple_log_read((PurpleLog*)logs->data, NULL);
-		if (read && *read && purple_strcasestr(read, search_term)) {
-			GtkTreeIter iter;
-			PurpleLog *log = logs->data;
+	hits = purple_log_search(lv->logs, search_term);
+	for (l = hits; l != NULL; l = l->next) {
+		GtkTreeIter iter;
+		PurpleLog *log = ((PurpleLogSearchHit *)l->data)->log;
 
-			gtk_tree_store_append (lv->treestore, &iter, NULL);
-			gtk_tree_store_set(lv->treestore, &iter,
-					   0, log_get_date(log),
-					   1, log, -1);
-		}
-		g_free(read);
+		gtk_tree_store_append (lv->treestore, &iter, NULL);
+		gtk_tree_store_set(lv->treestore, &iter,
+				   0, log_get_date(log),
+				   1, log, -1);
 	}
+	g_list_free_full(hits, g_free);
 
 	select_first_log(lv);
 	pidgin_clear_cursor(lv->window);
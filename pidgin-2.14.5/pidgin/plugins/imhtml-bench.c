@@ -0,0 +1,217 @@
+/*
+ * Times GtkIMHtml message insertion with smiley themes of growing size.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02111-1301, USA.
+ */
+#define IMHTML_BENCH_PLUGIN_ID "gtk-imhtml-bench"
+
+#include "internal.h"
+
+#include <gtk/gtk.h>
+
+#include "debug.h"
+#include "glibcompat.h"
+#include "util.h"
+#include "version.h"
+
+#include "gtkimhtml.h"
+#include "gtkplugin.h"
+#include "gtkthemes.h"
+
+/* How many times the corpus is inserted for each measurement */
+#define CORPUS_PASSES 20
+
+/* Used when there is no imhtml-bench-corpus.txt in the user dir */
+static const char *default_corpus[] = {
+	"hi :)",
+	"are you there?",
+	"<b>lunch</b> at noon? :-D",
+	"I &lt;3 this song, http://www.example.com/watch?v=abc&amp;t=42 ;)",
+	"no :( it broke again, see the log at &lt;/tmp/build.log&gt; :-/",
+	"<font color=\"#ff0000\">ok</font> :P brb",
+	"So the thing is that the server kept dropping us every couple of "
+	"minutes, and after I turned off the keepalive it got better, but "
+	"then the file transfers started failing halfway, which makes me "
+	"think it is the proxy after all. Can you try from your side? "
+	"Anyway, thanks for the help, I owe you one :-) B-)",
+	"<a href=\"http://pidgin.im/\">pidgin.im</a> has the release notes "
+	"&amp; the tarballs up now :-) :-) :-)",
+	"lol",
+	"o:-) &gt;:o :-* :'( =-O :-!",
+	NULL
+};
+
+static char **
+imhtml_bench_corpus_load(void)
+{
+	char *filename, *contents;
+	char **corpus;
+
+	/* One message per line, in HTML, like a received IM */
+	filename = g_build_filename(purple_user_dir(), "imhtml-bench-corpus.txt",
+	                            NULL);
+	if (!g_file_get_contents(filename, &contents, NULL, NULL)) {
+		g_free(filename);
+		return g_strdupv((char **)default_corpus);
+	}
+
+	purple_debug_info("imhtml-bench", "Using the corpus in %s\n", filename);
+	corpus = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+	g_free(filename);
+
+	return corpus;
+}
+
+static void
+imhtml_bench_insert(GtkIMHtml *imhtml, char **corpus,
+                    GtkIMHtmlOptions options, const char *what)
+{
+	GTimer *timer;
+	gdouble elapsed = 0;
+	gsize bytes = 0;
+	guint messages = 0, pass, i;
+
+	/* The automaton is compiled on the first lookup; leave that out */
+	gtk_imhtml_append_text(imhtml, ":)", options);
+	gtk_imhtml_clear(imhtml);
+
+	timer = g_timer_new();
+	for (pass = 0; pass < CORPUS_PASSES; pass++) {
+		g_timer_start(timer);
+		for (i = 0; corpus[i] != NULL; i++) {
+			gtk_imhtml_append_text(imhtml, corpus[i], options);
+			gtk_imhtml_append_text(imhtml, "<br>", options);
+			bytes += strlen(corpus[i]);
+			messages++;
+		}
+		g_timer_stop(timer);
+		elapsed += g_timer_elapsed(timer, NULL);
+
+		/* Keep the buffer from growing across passes */
+		gtk_imhtml_clear(imhtml);
+	}
+	g_timer_destroy(timer);
+
+	purple_debug_info("imhtml-bench",
+			"%s: %u messages in %.3f s, %.0f messages/s, %.2f MB/s\n",
+			what, messages, elapsed,
+			elapsed > 0 ? messages / elapsed : 0,
+			elapsed > 0 ? bytes / elapsed / (1024 * 1024) : 0);
+}
+
+/*
+ * Inserts the corpus with no smileys looked up, with the current smiley
+ * theme, and with the theme padded out with hidden smileys to the size
+ * of large custom themes.  The padding shares the ':' prefix of most
+ * real smileys, so the lookups go past the first character.
+ */
+static void
+imhtml_bench_run(void)
+{
+	static const guint extra[] = { 0, 100, 1000, 10000 };
+	GtkWidget *imhtml;
+	GList *padding = NULL;
+	char **corpus;
+	guint added = 0, i;
+
+	corpus = imhtml_bench_corpus_load();
+
+	imhtml = gtk_imhtml_new(NULL, NULL);
+	g_object_ref_sink(imhtml);
+	pidgin_themes_smiley_themeize(imhtml);
+
+	imhtml_bench_insert(GTK_IMHTML(imhtml), corpus, GTK_IMHTML_NO_SMILEY,
+	                    "no smileys");
+
+	for (i = 0; i < G_N_ELEMENTS(extra); i++) {
+		char *what;
+
+		for (; added < extra[i]; added++) {
+			char *shortcut = g_strdup_printf(":bench%u:", added);
+			GtkIMHtmlSmiley *smiley = gtk_imhtml_smiley_create(NULL,
+					shortcut, TRUE, GTK_IMHTML_SMILEY_CUSTOM);
+
+			gtk_imhtml_associate_smiley(GTK_IMHTML(imhtml), NULL, smiley);
+			padding = g_list_prepend(padding, smiley);
+			g_free(shortcut);
+		}
+
+		what = g_strdup_printf("theme %s + %u smileys",
+				current_smiley_theme ? current_smiley_theme->name : "(none)",
+				added);
+		imhtml_bench_insert(GTK_IMHTML(imhtml), corpus, 0, what);
+		g_free(what);
+	}
+
+	g_list_free_full(padding, (GDestroyNotify)gtk_imhtml_smiley_destroy);
+	gtk_widget_destroy(imhtml);
+	g_object_unref(imhtml);
+	g_strfreev(corpus);
+}
+
+static gboolean
+plugin_load(PurplePlugin *plugin)
+{
+	imhtml_bench_run();
+
+	return TRUE;
+}
+
+static PurplePluginInfo info =
+{
+	PURPLE_PLUGIN_MAGIC,
+	PURPLE_MAJOR_VERSION,
+	PURPLE_MINOR_VERSION,
+	PURPLE_PLUGIN_STANDARD,                             /**< type           */
+	PIDGIN_PLUGIN_TYPE,                             /**< ui_requirement */
+	0,                                                /**< flags          */
+	NULL,                                             /**< dependencies   */
+	PURPLE_PRIORITY_DEFAULT,                            /**< priority       */
+
+	IMHTML_BENCH_PLUGIN_ID,                           /**< id             */
+	N_("GtkIMHtml Benchmark"),                          /**< name           */
+	DISPLAY_VERSION,                                  /**< version        */
+	                                                  /**  summary        */
+	N_("Times message insertion with smiley themes of growing size."),
+	                                                  /**  description    */
+	N_("Times message insertion with smiley themes of growing size, "
+	   "and reports the results to the debug window when loaded."),
+	NULL,                                             /**< author         */
+	PURPLE_WEBSITE,                                     /**< homepage       */
+
+	plugin_load,                                      /**< load           */
+	NULL,                                             /**< unload         */
+	NULL,                                             /**< destroy        */
+
+	NULL,                                             /**< ui_info        */
+	NULL,                                             /**< extra_info     */
+	NULL,
+	NULL,
+
+	/* padding */
+	NULL,
+	NULL,
+	NULL,
+	NULL
+};
+
+static void
+init_plugin(PurplePlugin *plugin)
+{
+}
+
+PURPLE_INIT_PLUGIN(imhtmlbench, init_plugin, info)